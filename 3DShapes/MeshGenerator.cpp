@@ -0,0 +1,376 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshgenerator.cpp
+// ============
+// generate the vertices and indices of the round 3D primitives at any
+// tessellation
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshGenerator.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	// fewest segments, slices and rings that still make a closed shape
+	const int MIN_SEGMENTS = 3;
+	const int MIN_STACKS = 2;
+
+	// radius of the top of the tapered cylinder
+	const float TAPERED_TOP_RADIUS = 0.5f;
+
+	// parts of the capped shapes, in the order of their indices
+	const int PART_BOTTOM = 0;
+	const int PART_TOP = 1;
+	const int PART_SIDES = 2;
+
+	// write one interleaved vertex and return where the next one goes
+	float* WriteVertex(float* pVertex, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv)
+	{
+		pVertex[0] = position.x;
+		pVertex[1] = position.y;
+		pVertex[2] = position.z;
+		pVertex[3] = normal.x;
+		pVertex[4] = normal.y;
+		pVertex[5] = normal.z;
+		pVertex[6] = uv.x;
+		pVertex[7] = uv.y;
+		return(pVertex + MeshGenerator::VERTEX_FLOATS);
+	}
+
+	// write one triangle and return where the next one goes
+	unsigned int* WriteTriangle(unsigned int* pIndex, unsigned int a, unsigned int b, unsigned int c)
+	{
+		pIndex[0] = a;
+		pIndex[1] = b;
+		pIndex[2] = c;
+		return(pIndex + 3);
+	}
+}
+
+/***********************************************************
+ *  GetSphereSize()
+ *
+ *  This method is used to get the size of a sphere with the
+ *  given slices around and stacks from top to bottom.  Every
+ *  ring has a copy of its first vertex for the texture seam,
+ *  and the triangles that would meet at the poles in a
+ *  point are left out.
+ ***********************************************************/
+MeshGenerator::MESH_SIZE MeshGenerator::GetSphereSize(int slices, int stacks)
+{
+	slices = std::max(slices, MIN_SEGMENTS);
+	stacks = std::max(stacks, MIN_STACKS);
+
+	MESH_SIZE size;
+	size.vertexCount = (size_t)(slices + 1) * (stacks + 1);
+	size.indexCount = (size_t)6 * slices * (stacks - 1);
+	size.partIndexCounts[PART_BOTTOM] = 0;
+	size.partIndexCounts[PART_TOP] = 0;
+	size.partIndexCounts[PART_SIDES] = size.indexCount;
+	return(size);
+}
+
+/***********************************************************
+ *  GenerateSphere()
+ *
+ *  This method is used to generate a sphere into buffers of
+ *  the size that GetSphereSize() returns.  The first vertex
+ *  of every ring is on the +Z axis, like the vertices of
+ *  ShapeMeshes::LoadSphereMesh().
+ ***********************************************************/
+void MeshGenerator::GenerateSphere(
+	int slices,
+	int stacks,
+	float* pVertices,
+	unsigned int* pIndices)
+{
+	slices = std::max(slices, MIN_SEGMENTS);
+	stacks = std::max(stacks, MIN_STACKS);
+
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		float phi = glm::pi<float>() * stack / stacks;
+		for (int slice = 0; slice <= slices; slice++)
+		{
+			float theta = glm::two_pi<float>() * slice / slices;
+			glm::vec3 position(std::sin(phi) * std::sin(theta), std::cos(phi), std::sin(phi) * std::cos(theta));
+			pVertices = WriteVertex(pVertices, position, position,
+				glm::vec2((float)slice / slices, 1.0f - (float)stack / stacks));
+		}
+	}
+
+	const unsigned int ringVertices = slices + 1;
+	for (int stack = 0; stack < stacks; stack++)
+	{
+		for (int slice = 0; slice < slices; slice++)
+		{
+			unsigned int upper = stack * ringVertices + slice;
+			unsigned int lower = upper + ringVertices;
+			if (stack != 0)
+			{
+				pIndices = WriteTriangle(pIndices, upper, lower, upper + 1);
+			}
+			if (stack != stacks - 1)
+			{
+				pIndices = WriteTriangle(pIndices, upper + 1, lower, lower + 1);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  GetConeSize()
+ *
+ *  This method is used to get the size of a cone with the
+ *  given segments around.
+ ***********************************************************/
+MeshGenerator::MESH_SIZE MeshGenerator::GetConeSize(int segments)
+{
+	return(GetFrustumSize(segments, 0.0f));
+}
+
+/***********************************************************
+ *  GenerateCone()
+ *
+ *  This method is used to generate a cone into buffers of
+ *  the size that GetConeSize() returns.
+ ***********************************************************/
+void MeshGenerator::GenerateCone(
+	int segments,
+	float* pVertices,
+	unsigned int* pIndices)
+{
+	GenerateFrustum(segments, 0.0f, pVertices, pIndices);
+}
+
+/***********************************************************
+ *  GetCylinderSize()
+ *
+ *  This method is used to get the size of a cylinder with
+ *  the given segments around.
+ ***********************************************************/
+MeshGenerator::MESH_SIZE MeshGenerator::GetCylinderSize(int segments)
+{
+	return(GetFrustumSize(segments, 1.0f));
+}
+
+/***********************************************************
+ *  GenerateCylinder()
+ *
+ *  This method is used to generate a cylinder into buffers
+ *  of the size that GetCylinderSize() returns.
+ ***********************************************************/
+void MeshGenerator::GenerateCylinder(
+	int segments,
+	float* pVertices,
+	unsigned int* pIndices)
+{
+	GenerateFrustum(segments, 1.0f, pVertices, pIndices);
+}
+
+/***********************************************************
+ *  GetTaperedCylinderSize()
+ *
+ *  This method is used to get the size of a tapered
+ *  cylinder with the given segments around.
+ ***********************************************************/
+MeshGenerator::MESH_SIZE MeshGenerator::GetTaperedCylinderSize(int segments)
+{
+	return(GetFrustumSize(segments, TAPERED_TOP_RADIUS));
+}
+
+/***********************************************************
+ *  GenerateTaperedCylinder()
+ *
+ *  This method is used to generate a tapered cylinder into
+ *  buffers of the size that GetTaperedCylinderSize()
+ *  returns.
+ ***********************************************************/
+void MeshGenerator::GenerateTaperedCylinder(
+	int segments,
+	float* pVertices,
+	unsigned int* pIndices)
+{
+	GenerateFrustum(segments, TAPERED_TOP_RADIUS, pVertices, pIndices);
+}
+
+/***********************************************************
+ *  GetTorusSize()
+ *
+ *  This method is used to get the size of a torus with the
+ *  given segments around its main ring and around its tube.
+ *  Both rings have a copy of their first vertices for the
+ *  texture seams.
+ ***********************************************************/
+MeshGenerator::MESH_SIZE MeshGenerator::GetTorusSize(int mainSegments, int tubeSegments)
+{
+	mainSegments = std::max(mainSegments, MIN_SEGMENTS);
+	tubeSegments = std::max(tubeSegments, MIN_SEGMENTS);
+
+	MESH_SIZE size;
+	size.vertexCount = (size_t)(mainSegments + 1) * (tubeSegments + 1);
+	size.indexCount = (size_t)6 * mainSegments * tubeSegments;
+	size.partIndexCounts[PART_BOTTOM] = 0;
+	size.partIndexCounts[PART_TOP] = 0;
+	size.partIndexCounts[PART_SIDES] = size.indexCount;
+	return(size);
+}
+
+/***********************************************************
+ *  GenerateTorus()
+ *
+ *  This method is used to generate a torus into buffers of
+ *  the size that GetTorusSize() returns.  The main ring
+ *  lies in the XY plane and starts on the +X axis, like the
+ *  torus of ShapeMeshes::LoadTorusMesh().
+ ***********************************************************/
+void MeshGenerator::GenerateTorus(
+	int mainSegments,
+	int tubeSegments,
+	float tubeRadius,
+	float* pVertices,
+	unsigned int* pIndices)
+{
+	mainSegments = std::max(mainSegments, MIN_SEGMENTS);
+	tubeSegments = std::max(tubeSegments, MIN_SEGMENTS);
+
+	for (int main = 0; main <= mainSegments; main++)
+	{
+		float mainAngle = glm::two_pi<float>() * main / mainSegments;
+		for (int tube = 0; tube <= tubeSegments; tube++)
+		{
+			float tubeAngle = glm::two_pi<float>() * tube / tubeSegments;
+			glm::vec3 normal(
+				std::cos(tubeAngle) * std::cos(mainAngle),
+				std::cos(tubeAngle) * std::sin(mainAngle),
+				std::sin(tubeAngle));
+			glm::vec3 position = glm::vec3(std::cos(mainAngle), std::sin(mainAngle), 0.0f) + tubeRadius * normal;
+			pVertices = WriteVertex(pVertices, position, normal,
+				glm::vec2((float)main / mainSegments, (float)tube / tubeSegments));
+		}
+	}
+
+	const unsigned int ringVertices = tubeSegments + 1;
+	for (int main = 0; main < mainSegments; main++)
+	{
+		for (int tube = 0; tube < tubeSegments; tube++)
+		{
+			unsigned int current = main * ringVertices + tube;
+			unsigned int next = current + ringVertices;
+			pIndices = WriteTriangle(pIndices, current, next, current + 1);
+			pIndices = WriteTriangle(pIndices, current + 1, next, next + 1);
+		}
+	}
+}
+
+/***********************************************************
+ *  GetFrustumSize()
+ *
+ *  This method is used to get the size of a capped frustum
+ *  with the given segments around.  The caps are fans
+ *  around their first rim vertex, and the sides have a
+ *  bottom and a top vertex for every segment edge.
+ ***********************************************************/
+MeshGenerator::MESH_SIZE MeshGenerator::GetFrustumSize(int segments, float topRadius)
+{
+	segments = std::max(segments, MIN_SEGMENTS);
+	const bool bTopCap = (topRadius > 0.0f);
+
+	MESH_SIZE size;
+	size.vertexCount = (size_t)segments * (bTopCap ? 2 : 1) + (size_t)2 * (segments + 1);
+	size.partIndexCounts[PART_BOTTOM] = (size_t)3 * (segments - 2);
+	size.partIndexCounts[PART_TOP] = bTopCap ? (size_t)3 * (segments - 2) : 0;
+	size.partIndexCounts[PART_SIDES] = (size_t)3 * segments * (bTopCap ? 2 : 1);
+	size.indexCount = size.partIndexCounts[PART_BOTTOM] + size.partIndexCounts[PART_TOP] +
+		size.partIndexCounts[PART_SIDES];
+	return(size);
+}
+
+/***********************************************************
+ *  GenerateFrustum()
+ *
+ *  This method is used to generate a capped frustum into
+ *  buffers of the size that GetFrustumSize() returns.  The
+ *  bottom, the top and the sides follow each other in both
+ *  buffers.  The rims start on the +X axis and turn towards
+ *  -Z, and the texture coordinates of the caps and the
+ *  sides follow ShapeMeshes::LoadCylinderMesh().
+ ***********************************************************/
+void MeshGenerator::GenerateFrustum(
+	int segments,
+	float topRadius,
+	float* pVertices,
+	unsigned int* pIndices)
+{
+	segments = std::max(segments, MIN_SEGMENTS);
+	const bool bTopCap = (topRadius > 0.0f);
+	const float angleStep = glm::two_pi<float>() / segments;
+
+	// the caps, as seen from above
+	for (int cap = PART_BOTTOM; cap <= PART_TOP; cap++)
+	{
+		if ((cap == PART_TOP) && (bTopCap == false))
+		{
+			continue;
+		}
+
+		const float radius = (cap == PART_TOP) ? topRadius : 1.0f;
+		const glm::vec3 normal(0.0f, (cap == PART_TOP) ? 1.0f : -1.0f, 0.0f);
+		for (int segment = 0; segment < segments; segment++)
+		{
+			float x = std::cos(segment * angleStep);
+			float z = -std::sin(segment * angleStep);
+			pVertices = WriteVertex(pVertices, glm::vec3(radius * x, (cap == PART_TOP) ? 1.0f : 0.0f, radius * z),
+				normal, glm::vec2(0.5f + 0.5f * z, 0.5f + 0.5f * x));
+		}
+	}
+
+	// the sides, with a bottom and a top vertex at every edge - the
+	// tip of a cone has the normal of the middle of its segment
+	const float slope = 1.0f - topRadius;
+	for (int edge = 0; edge <= segments; edge++)
+	{
+		float angle = edge * angleStep;
+		float topAngle = (bTopCap == true) ? angle : angle + 0.5f * angleStep;
+		float u = (bTopCap == true) ? (float)edge / segments : (edge + 0.5f) / segments;
+
+		pVertices = WriteVertex(pVertices,
+			glm::vec3(std::cos(angle), 0.0f, -std::sin(angle)),
+			glm::normalize(glm::vec3(std::cos(angle), slope, -std::sin(angle))),
+			glm::vec2((float)edge / segments, 0.0f));
+		pVertices = WriteVertex(pVertices,
+			glm::vec3(topRadius * std::cos(angle), 1.0f, -topRadius * std::sin(angle)),
+			glm::normalize(glm::vec3(std::cos(topAngle), slope, -std::sin(topAngle))),
+			glm::vec2(u, 1.0f));
+	}
+
+	// the bottom cap faces down, so its fan turns the other way
+	for (int segment = 1; segment + 1 < segments; segment++)
+	{
+		pIndices = WriteTriangle(pIndices, 0, segment + 1, segment);
+	}
+	if (bTopCap == true)
+	{
+		for (int segment = 1; segment + 1 < segments; segment++)
+		{
+			pIndices = WriteTriangle(pIndices, segments, segments + segment, segments + segment + 1);
+		}
+	}
+
+	const unsigned int firstSide = segments * (bTopCap ? 2 : 1);
+	for (int edge = 0; edge < segments; edge++)
+	{
+		unsigned int bottom = firstSide + 2 * edge;
+		pIndices = WriteTriangle(pIndices, bottom, bottom + 2, bottom + 1);
+		if (bTopCap == true)
+		{
+			pIndices = WriteTriangle(pIndices, bottom + 1, bottom + 2, bottom + 3);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshgenerator.h
+// ============
+// generate the vertices and indices of the round 3D primitives at any
+// tessellation
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MeshGenerator
+ *
+ *  This class contains the code for generating the sphere,
+ *  cone, cylinder, tapered cylinder and torus from their
+ *  segment and ring counts, in the same place, size and
+ *  texture mapping as the meshes of ShapeMeshes.  The Get
+ *  methods return the size of a mesh, so the caller can
+ *  allocate the buffers that the Generate methods fill in.
+ *  Every vertex holds a position, a normal and texture
+ *  coordinates, and the indices are triangle lists.  The
+ *  methods do not use OpenGL and do not allocate memory.
+ ***********************************************************/
+class MeshGenerator
+{
+public:
+	// floats of every generated vertex: position, normal and
+	// texture coordinates
+	static const int VERTEX_FLOATS = 8;
+
+	// vertex and index counts of a generated mesh - the capped
+	// shapes list the indices of their bottom, top and sides in
+	// that order, the other shapes only have sides
+	struct MESH_SIZE
+	{
+		size_t vertexCount;
+		size_t indexCount;
+		size_t partIndexCounts[3];
+	};
+
+	// sphere of radius 1 around the origin - the rings go from the
+	// top to the bottom, so with an even stack count the first half
+	// of the indices is the upper half of the sphere
+	static MESH_SIZE GetSphereSize(int slices, int stacks);
+	static void GenerateSphere(
+		int slices,
+		int stacks,
+		float* pVertices,
+		unsigned int* pIndices);
+
+	// cone of radius 1 from y = 0 to its tip at y = 1, without a top
+	static MESH_SIZE GetConeSize(int segments);
+	static void GenerateCone(
+		int segments,
+		float* pVertices,
+		unsigned int* pIndices);
+
+	// cylinder of radius 1 from y = 0 to y = 1
+	static MESH_SIZE GetCylinderSize(int segments);
+	static void GenerateCylinder(
+		int segments,
+		float* pVertices,
+		unsigned int* pIndices);
+
+	// cylinder of radius 1 at y = 0 narrowing to radius 0.5 at y = 1
+	static MESH_SIZE GetTaperedCylinderSize(int segments);
+	static void GenerateTaperedCylinder(
+		int segments,
+		float* pVertices,
+		unsigned int* pIndices);
+
+	// torus of radius 1 around the Z axis - with an even count of
+	// main segments the first half of the indices is the upper half
+	static MESH_SIZE GetTorusSize(int mainSegments, int tubeSegments);
+	static void GenerateTorus(
+		int mainSegments,
+		int tubeSegments,
+		float tubeRadius,
+		float* pVertices,
+		unsigned int* pIndices);
+
+private:
+	// the cone and the cylinders are capped frustums - a top
+	// radius of 0 makes a cone, which has no top cap
+	static MESH_SIZE GetFrustumSize(int segments, float topRadius);
+	static void GenerateFrustum(
+		int segments,
+		float topRadius,
+		float* pVertices,
+		unsigned int* pIndices);
+};
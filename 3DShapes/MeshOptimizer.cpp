@@ -0,0 +1,433 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder the triangles and vertices of indexed meshes for the vertex cache,
+// the vertex fetch and overdraw
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// entries of the LRU vertex cache that the Forsyth scores model
+	const int FORSYTH_CACHE_SIZE = 32;
+	// score of the vertices of the last triangle, which are kept
+	// below the rest of the cache to avoid long thin strips
+	const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+	const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+	// vertices with few triangles left are preferred, so that
+	// no lone triangles are left behind
+	const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+	const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+	// score of a vertex at the given cache position, -1 when it is not
+	// cached, that has remainingTriangles triangles left to draw
+	float ForsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+		{
+			return(-1.0f);
+		}
+
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				score = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				float fraction = (float)(cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3);
+				score = std::pow(1.0f - fraction, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+
+		return(score + FORSYTH_VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER));
+	}
+}
+
+/***********************************************************
+ *  AnalyzeVertexCache()
+ *
+ *  This method is used to count the vertex shader runs of a
+ *  triangle list with a FIFO post-transform cache of the
+ *  given size, which is how most GPUs reuse vertices.
+ ***********************************************************/
+MeshOptimizer::CACHE_STATS MeshOptimizer::AnalyzeVertexCache(
+	const unsigned int* pIndices,
+	size_t indexCount,
+	size_t vertexCount,
+	int cacheSize)
+{
+	CACHE_STATS stats = { 0, 0, 0, 0.0f, 0.0f };
+
+	// a vertex is cached while fewer than cacheSize misses
+	// happened since it was loaded
+	m_loadTime.assign(vertexCount, 0);
+	m_vertexUsed.assign(vertexCount, 0);
+	unsigned int time = (unsigned int)cacheSize + 1;
+
+	stats.triangles = (unsigned int)(indexCount / 3);
+	for (size_t i = 0; i < stats.triangles * 3; i++)
+	{
+		unsigned int vertex = pIndices[i];
+
+		if (time - m_loadTime[vertex] > (unsigned int)cacheSize)
+		{
+			m_loadTime[vertex] = time;
+			time++;
+			stats.transforms++;
+		}
+		if (m_vertexUsed[vertex] == 0)
+		{
+			m_vertexUsed[vertex] = 1;
+			stats.vertices++;
+		}
+	}
+
+	stats.acmr = (stats.triangles > 0) ? (float)stats.transforms / stats.triangles : 0.0f;
+	stats.atvr = (stats.vertices > 0) ? (float)stats.transforms / stats.vertices : 0.0f;
+
+	return(stats);
+}
+
+/***********************************************************
+ *  WeldVertices()
+ *
+ *  This method is used to find the vertices that have the
+ *  same bits in every float and to point their indices at
+ *  the first of them, so that the cache can reuse them.
+ ***********************************************************/
+void MeshOptimizer::WeldVertices(
+	unsigned int* pIndices,
+	size_t indexCount,
+	const float* pVertices,
+	size_t vertexFloats,
+	size_t vertexCount)
+{
+	const size_t vertexBytes = sizeof(float) * vertexFloats;
+
+	// sorting the vertices by their bytes puts the copies next to each
+	// other, with the lowest index first - ties are sorted by index,
+	// since std::stable_sort() would allocate its own buffer
+	m_vertexOrder.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		m_vertexOrder[i] = (unsigned int)i;
+	}
+	std::sort(m_vertexOrder.begin(), m_vertexOrder.end(), [&](unsigned int a, unsigned int b) {
+		int order = memcmp(pVertices + a * vertexFloats, pVertices + b * vertexFloats, vertexBytes);
+		return((order < 0) || ((order == 0) && (a < b)));
+	});
+
+	m_firstCopy.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		unsigned int vertex = m_vertexOrder[i];
+		bool bCopy = (i > 0) &&
+			(memcmp(pVertices + vertex * vertexFloats, pVertices + m_vertexOrder[i - 1] * vertexFloats, vertexBytes) == 0);
+		m_firstCopy[vertex] = (bCopy == true) ? m_firstCopy[m_vertexOrder[i - 1]] : vertex;
+	}
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		pIndices[i] = m_firstCopy[pIndices[i]];
+	}
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This method is used to reorder the triangles with Tom
+ *  Forsyth's algorithm.  Every vertex is scored by its
+ *  position in a modelled LRU cache and by how many of its
+ *  triangles are left, and the triangle with the best sum
+ *  of its vertex scores is drawn next.  Only the triangles
+ *  of the cached vertices are scored again after each step.
+ *  When none of them is left, the next triangle in the old
+ *  order is taken.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(
+	unsigned int* pIndices,
+	size_t indexCount,
+	size_t vertexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// the triangles of every vertex - the ones that are still to be
+	// drawn are kept at the front of the list of each vertex
+	m_remaining.assign(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		m_remaining[pIndices[i]]++;
+	}
+	m_adjacencyStart.assign(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		m_adjacencyStart[v + 1] = m_adjacencyStart[v] + m_remaining[v];
+	}
+	m_adjacency.resize(triangleCount * 3);
+	m_filled.assign(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int vertex = pIndices[i];
+		m_adjacency[m_adjacencyStart[vertex] + m_filled[vertex]++] = (unsigned int)(i / 3);
+	}
+
+	m_cachePosition.assign(vertexCount, -1);
+	m_vertexScore.resize(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		m_vertexScore[v] = ForsythVertexScore(-1, m_remaining[v]);
+	}
+	m_triangleScore.resize(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		m_triangleScore[t] = m_vertexScore[pIndices[t * 3]] + m_vertexScore[pIndices[t * 3 + 1]] + m_vertexScore[pIndices[t * 3 + 2]];
+	}
+
+	m_triangleDrawn.assign(triangleCount, 0);
+	m_reordered.clear();
+	m_reordered.reserve(triangleCount * 3);
+
+	// the cache holds up to three more vertices while it is updated
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t nextInOrder = 0;
+	long long best = -1;
+
+	while (m_reordered.size() < triangleCount * 3)
+	{
+		if (best < 0)
+		{
+			while (m_triangleDrawn[nextInOrder] != 0)
+			{
+				nextInOrder++;
+			}
+			best = (long long)nextInOrder;
+		}
+
+		const unsigned int* triangle = pIndices + best * 3;
+		m_triangleDrawn[best] = 1;
+		m_reordered.insert(m_reordered.end(), triangle, triangle + 3);
+
+		// take the triangle off the lists of its vertices
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = triangle[corner];
+			unsigned int* pList = &m_adjacency[m_adjacencyStart[vertex]];
+			for (unsigned int k = 0; k < m_remaining[vertex]; k++)
+			{
+				if (pList[k] == (unsigned int)best)
+				{
+					pList[k] = pList[m_remaining[vertex] - 1];
+					m_remaining[vertex]--;
+					break;
+				}
+			}
+		}
+
+		// the vertices of the triangle move to the front of the cache
+		int newCount = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			if (std::find(newCache, newCache + newCount, triangle[corner]) == newCache + newCount)
+			{
+				newCache[newCount++] = triangle[corner];
+			}
+		}
+		for (int i = 0; i < cacheCount; i++)
+		{
+			if (std::find(triangle, triangle + 3, cache[i]) == triangle + 3)
+			{
+				newCache[newCount++] = cache[i];
+			}
+		}
+
+		// score the vertices again, including the ones that just fell
+		// out of the cache, and then the triangles they still have
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int vertex = newCache[i];
+			m_cachePosition[vertex] = (i < FORSYTH_CACHE_SIZE) ? i : -1;
+			m_vertexScore[vertex] = ForsythVertexScore(m_cachePosition[vertex], m_remaining[vertex]);
+		}
+
+		best = -1;
+		float bestScore = 0.0f;
+		for (int i = 0; i < newCount; i++)
+		{
+			unsigned int vertex = newCache[i];
+			const unsigned int* pList = &m_adjacency[m_adjacencyStart[vertex]];
+			for (unsigned int k = 0; k < m_remaining[vertex]; k++)
+			{
+				unsigned int t = pList[k];
+				m_triangleScore[t] = m_vertexScore[pIndices[t * 3]] + m_vertexScore[pIndices[t * 3 + 1]] + m_vertexScore[pIndices[t * 3 + 2]];
+				if ((best < 0) || (m_triangleScore[t] > bestScore))
+				{
+					best = t;
+					bestScore = m_triangleScore[t];
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+
+	std::copy(m_reordered.begin(), m_reordered.end(), pIndices);
+}
+
+/***********************************************************
+ *  OptimizeOverdraw()
+ *
+ *  This method is used to split the cache ordered triangles
+ *  into groups wherever the order starts over, which is
+ *  where a triangle misses the cache with all of its
+ *  vertices, and to draw the groups that face away from the
+ *  center of the mesh first.  Those are the ones that hide
+ *  the rest of a convex shape.
+ ***********************************************************/
+void MeshOptimizer::OptimizeOverdraw(
+	unsigned int* pIndices,
+	size_t indexCount,
+	const float* pPositions,
+	size_t positionStride,
+	size_t vertexCount,
+	float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// find the groups with the same FIFO cache as AnalyzeVertexCache()
+	m_groupStarts.clear();
+	m_loadTime.assign(vertexCount, 0);
+	unsigned int time = STATS_CACHE_SIZE + 1;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int vertex = pIndices[t * 3 + corner];
+			if (time - m_loadTime[vertex] > STATS_CACHE_SIZE)
+			{
+				m_loadTime[vertex] = time;
+				time++;
+				misses++;
+			}
+		}
+		if ((t == 0) || (misses == 3))
+		{
+			m_groupStarts.push_back(t);
+		}
+	}
+	if (m_groupStarts.size() < 2)
+	{
+		return;
+	}
+	m_groupStarts.push_back(triangleCount);
+
+	const size_t groupCount = m_groupStarts.size() - 1;
+
+	// the center of the mesh and the center and summed, area weighted
+	// normal of every group
+	glm::vec3 meshCenter(0.0f);
+	m_groupCenters.assign(groupCount, glm::vec3(0.0f));
+	m_groupNormals.assign(groupCount, glm::vec3(0.0f));
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		for (size_t t = m_groupStarts[group]; t < m_groupStarts[group + 1]; t++)
+		{
+			glm::vec3 corners[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const float* pPosition = pPositions + pIndices[t * 3 + corner] * positionStride;
+				corners[corner] = glm::vec3(pPosition[0], pPosition[1], pPosition[2]);
+			}
+			glm::vec3 center = (corners[0] + corners[1] + corners[2]) / 3.0f;
+			m_groupCenters[group] += center;
+			m_groupNormals[group] += glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+			meshCenter += center;
+		}
+		m_groupCenters[group] /= (float)(m_groupStarts[group + 1] - m_groupStarts[group]);
+	}
+	meshCenter /= (float)triangleCount;
+
+	m_groupKeys.resize(groupCount);
+	m_groupOrder.resize(groupCount);
+	for (size_t group = 0; group < groupCount; group++)
+	{
+		float length = glm::length(m_groupNormals[group]);
+		glm::vec3 normal = (length > 0.0f) ? m_groupNormals[group] / length : glm::vec3(0.0f);
+		m_groupKeys[group] = glm::dot(m_groupCenters[group] - meshCenter, normal);
+		m_groupOrder[group] = group;
+	}
+	std::sort(m_groupOrder.begin(), m_groupOrder.end(), [&](size_t a, size_t b) {
+		return((m_groupKeys[a] > m_groupKeys[b]) || ((m_groupKeys[a] == m_groupKeys[b]) && (a < b)));
+	});
+
+	m_reordered.clear();
+	m_reordered.reserve(triangleCount * 3);
+	for (size_t i = 0; i < groupCount; i++)
+	{
+		size_t group = m_groupOrder[i];
+		m_reordered.insert(m_reordered.end(), pIndices + m_groupStarts[group] * 3, pIndices + m_groupStarts[group + 1] * 3);
+	}
+
+	// the groups end where the cache starts over, so their order
+	// should hardly change the cache misses - keep the old order if
+	// it does
+	CACHE_STATS before = AnalyzeVertexCache(pIndices, triangleCount * 3, vertexCount);
+	CACHE_STATS after = AnalyzeVertexCache(&m_reordered[0], triangleCount * 3, vertexCount);
+	if (after.acmr <= before.acmr * threshold)
+	{
+		std::copy(m_reordered.begin(), m_reordered.end(), pIndices);
+	}
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This method is used to number the vertices in the order
+ *  of their first use, so that the vertex fetch walks
+ *  through the vertex buffer instead of jumping around.
+ *  Vertices that no triangle uses are dropped.
+ ***********************************************************/
+size_t MeshOptimizer::OptimizeVertexFetch(
+	unsigned int* pIndices,
+	size_t indexCount,
+	size_t vertexCount,
+	unsigned int* pRemap)
+{
+	std::fill(pRemap, pRemap + vertexCount, ~0u);
+
+	unsigned int nextVertex = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int& remap = pRemap[pIndices[i]];
+		if (remap == ~0u)
+		{
+			remap = nextVertex++;
+		}
+		pIndices[i] = remap;
+	}
+
+	return(nextVertex);
+}
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder the triangles and vertices of indexed meshes for the vertex cache,
+// the vertex fetch and overdraw
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  This class contains the code for reordering indexed
+ *  triangle lists so that the GPU transforms fewer vertices.
+ *  The triangles are ordered for the post-transform vertex
+ *  cache with Tom Forsyth's linear-speed algorithm, groups
+ *  of them can be ordered to draw the outward facing ones
+ *  first, and the vertices are numbered in the order they
+ *  are first used.  The methods do not use OpenGL.  Their
+ *  scratch memory is kept between the calls, so a reused
+ *  optimizer only allocates when a mesh is larger than all
+ *  of the ones before it.
+ ***********************************************************/
+class MeshOptimizer
+{
+public:
+	// entries of the FIFO vertex cache that AnalyzeVertexCache()
+	// simulates when no size is given
+	static const int STATS_CACHE_SIZE = 16;
+
+	// post-transform vertex cache statistics of a triangle list
+	struct CACHE_STATS
+	{
+		unsigned int triangles;
+		unsigned int vertices;      // distinct vertices the triangles use
+		unsigned int transforms;    // vertex shader runs, the cache misses
+		float acmr;                 // transforms per triangle, 0.5 at best
+		float atvr;                 // transforms per vertex, 1.0 at best
+	};
+
+	// simulate a FIFO vertex cache of cacheSize entries over the triangles
+	CACHE_STATS AnalyzeVertexCache(
+		const unsigned int* pIndices,
+		size_t indexCount,
+		size_t vertexCount,
+		int cacheSize = STATS_CACHE_SIZE);
+
+	// point the indices of bit-identical vertices at the first of them -
+	// the vertices have vertexFloats floats each
+	void WeldVertices(
+		unsigned int* pIndices,
+		size_t indexCount,
+		const float* pVertices,
+		size_t vertexFloats,
+		size_t vertexCount);
+
+	// reorder the triangles for the post-transform vertex cache
+	void OptimizeVertexCache(
+		unsigned int* pIndices,
+		size_t indexCount,
+		size_t vertexCount);
+
+	// reorder the groups of cache ordered triangles so that the groups
+	// facing away from the mesh center are drawn first - the new order is
+	// only kept if its ACMR is at most threshold times the old one.  The
+	// positions are the first three floats of every positionStride floats
+	void OptimizeOverdraw(
+		unsigned int* pIndices,
+		size_t indexCount,
+		const float* pPositions,
+		size_t positionStride,
+		size_t vertexCount,
+		float threshold);
+
+	// number the vertices in the order the triangles first use them and
+	// rewrite the indices - pRemap receives the new index of every old
+	// vertex, or ~0u if it is not used.  Returns the used vertex count
+	static size_t OptimizeVertexFetch(
+		unsigned int* pIndices,
+		size_t indexCount,
+		size_t vertexCount,
+		unsigned int* pRemap);
+
+private:
+	// modelled cache of AnalyzeVertexCache() and OptimizeOverdraw()
+	std::vector<unsigned int> m_loadTime;
+	std::vector<unsigned char> m_vertexUsed;
+	// sorted vertices and their first copies of WeldVertices()
+	std::vector<unsigned int> m_vertexOrder;
+	std::vector<unsigned int> m_firstCopy;
+	// triangles of every vertex and the scores of OptimizeVertexCache()
+	std::vector<unsigned int> m_remaining;
+	std::vector<unsigned int> m_adjacencyStart;
+	std::vector<unsigned int> m_adjacency;
+	std::vector<unsigned int> m_filled;
+	std::vector<int> m_cachePosition;
+	std::vector<float> m_vertexScore;
+	std::vector<float> m_triangleScore;
+	std::vector<unsigned char> m_triangleDrawn;
+	// triangles of OptimizeOverdraw() and their groups
+	std::vector<size_t> m_groupStarts;
+	std::vector<glm::vec3> m_groupCenters;
+	std::vector<glm::vec3> m_groupNormals;
+	std::vector<float> m_groupKeys;
+	std::vector<size_t> m_groupOrder;
+	// indices in their new order, before they are copied back
+	std::vector<unsigned int> m_reordered;
+};
@@ -8,14 +8,26 @@
 //	Created for CS-330-Computational Graphics and Visualization, Nov. 7th, 2022
 ///////////////////////////////////////////////////////////////////////////////
 
-#include "shapemeshes.h"
+#include "ShapeMeshes.h"
+#include "MeshGenerator.h"
+#include "GLStateCache.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
 
 #include <vector>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// <cmath> defines these as macros on Linux, which would turn the
+// constants below into a syntax error
+#undef M_PI
+#undef M_PI_2
 
 namespace
 {
@@ -24,11 +36,345 @@ namespace
 	const GLuint g_FloatsPerVertex = 3;	// Number of coordinates per vertex
 	const GLuint g_FloatsPerNormal = 3;	// Number of values per vertex color
 	const GLuint g_FloatsPerUV = 2;		// Number of texture coordinate values
+	const GLuint g_InstanceModelLocation = 3;	// First of the four model matrix column attributes
+	const GLuint g_InstanceColorLocation = 7;	// Attribute of the instance color
+	const GLuint g_InstanceTextureLayersLocation = 8;	// Attribute of the instance texture array layers
+	// the overdraw order is dropped when it costs more vertex cache misses
+	const float g_OverdrawThreshold = 1.05f;
+	const GLuint g_PositionScaleLocation = 9;	// Attribute of the scale that dequantizes the positions
+	const GLuint g_PositionOffsetLocation = 10;	// Attribute of the offset that dequantizes the positions
+	const GLuint g_InstanceNormalLocation = 11;	// First of the three normal matrix column attributes
+	// vertex buffer binding of the position scale and offset - it has a
+	// stride of 0, so every vertex of a draw reads the same values
+	const GLuint g_PositionDequantizeBinding = 9;
+
+	// one vertex in the compact layout
+	struct COMPACT_VERTEX
+	{
+		GLushort position[4];	// fractions of the bounding box, the last one is padding
+		GLuint normal;			// GL_INT_2_10_10_10_REV
+		GLuint uv;				// two half floats
+	};
+	static_assert(sizeof(COMPACT_VERTEX) == 16, "COMPACT_VERTEX must stay 16 bytes");
+
+	// the vertex shader computes position * scale + offset - the values
+	// are stored in the vertex buffer right after the vertices
+	struct POSITION_DEQUANTIZE
+	{
+		glm::vec3 scale;
+		glm::vec3 offset;
+	};
+
+	// parts of a capped shape in its index buffer and in the shared
+	// buffers, in the order they are drawn
+	const int SHARED_PART_BOTTOM = 0;
+	const int SHARED_PART_TOP = 1;
+	const int SHARED_PART_SIDES = 2;
+
+	// vertices of the bottom fan, the top fan and the sides strip
+	// that the capped shapes are defined with, in that order
+	const GLuint g_ConePartVertices[3] = { 36, 0, 108 };
+	const GLuint g_CylinderPartVertices[3] = { 36, 36, 146 };
+
+	// tessellation of the generated levels of detail from LOD 1 on -
+	// every level has about half the triangles of the one before
+	struct LOD_TESSELLATION
+	{
+		int segments;	// slices of the sphere, main segments of the torus
+		int rings;		// stacks of the sphere, tube segments of the torus
+	};
+	const LOD_TESSELLATION g_SphereLods[3] = { { 12, 12 }, { 8, 8 }, { 6, 4 } };
+	const LOD_TESSELLATION g_TorusLods[3] = { { 20, 12 }, { 14, 8 }, { 8, 6 } };
+	const int g_CappedLodSegments[3] = { 18, 10, 6 };
+
+	// convert interleaved float vertices to the given layout and append
+	// them to data, followed by the values that dequantize the positions -
+	// the compact positions are stored as fractions of the passed in box
+	void PackVertices(
+		ShapeMeshes::VertexFormat format,
+		const GLfloat* verts,
+		GLuint vertexCount,
+		const glm::vec3& boxMin,
+		const glm::vec3& boxMax,
+		std::vector<unsigned char>& data)
+	{
+		const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+		const size_t start = data.size();
+		POSITION_DEQUANTIZE dequantize = { glm::vec3(1.0f), glm::vec3(0.0f) };
+
+		if (format == ShapeMeshes::VERTEX_FORMAT_FLOAT)
+		{
+			data.resize(start + sizeof(GLfloat) * floatsPerVertex * vertexCount + sizeof(dequantize));
+			memcpy(&data[start], verts, sizeof(GLfloat) * floatsPerVertex * vertexCount);
+			memcpy(&data[data.size() - sizeof(dequantize)], &dequantize, sizeof(dequantize));
+			return;
+		}
+
+		// a flat box has no extent on one axis, where every vertex gets 0
+		const glm::vec3 extent = boxMax - boxMin;
+		const glm::vec3 inverseExtent(
+			(extent.x > 0.0f) ? 1.0f / extent.x : 0.0f,
+			(extent.y > 0.0f) ? 1.0f / extent.y : 0.0f,
+			(extent.z > 0.0f) ? 1.0f / extent.z : 0.0f);
+
+		data.resize(start + sizeof(COMPACT_VERTEX) * vertexCount + sizeof(dequantize));
+		COMPACT_VERTEX* pCompact = (COMPACT_VERTEX*)&data[start];
+
+		for (GLuint i = 0; i < vertexCount; i++)
+		{
+			const GLfloat* vertex = verts + i * floatsPerVertex;
+
+			glm::vec3 fraction = glm::clamp((glm::make_vec3(vertex) - boxMin) * inverseExtent, 0.0f, 1.0f);
+			pCompact[i].position[0] = (GLushort)(fraction.x * 65535.0f + 0.5f);
+			pCompact[i].position[1] = (GLushort)(fraction.y * 65535.0f + 0.5f);
+			pCompact[i].position[2] = (GLushort)(fraction.z * 65535.0f + 0.5f);
+			pCompact[i].position[3] = 0;
+
+			// the fragment shader normalizes the normal again, so only
+			// its direction has to survive the 10 bits
+			glm::vec3 normal = glm::make_vec3(vertex + g_FloatsPerVertex);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normal /= length;
+			}
+			pCompact[i].normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+
+			pCompact[i].uv = glm::packHalf2x16(glm::make_vec2(vertex + g_FloatsPerVertex + g_FloatsPerNormal));
+		}
+
+		dequantize.scale = extent;
+		dequantize.offset = boxMin;
+		memcpy(&data[data.size() - sizeof(dequantize)], &dequantize, sizeof(dequantize));
+	}
+
+	// convert vertices of the given layout back to interleaved floats
+	void UnpackVertices(
+		ShapeMeshes::VertexFormat format,
+		const unsigned char* pData,
+		GLuint vertexCount,
+		const glm::vec3& boxMin,
+		const glm::vec3& boxMax,
+		GLfloat* verts)
+	{
+		const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+
+		if (format == ShapeMeshes::VERTEX_FORMAT_FLOAT)
+		{
+			memcpy(verts, pData, sizeof(GLfloat) * floatsPerVertex * vertexCount);
+			return;
+		}
+
+		const glm::vec3 extent = boxMax - boxMin;
+		const COMPACT_VERTEX* pCompact = (const COMPACT_VERTEX*)pData;
+
+		for (GLuint i = 0; i < vertexCount; i++)
+		{
+			GLfloat* vertex = verts + i * floatsPerVertex;
+
+			glm::vec3 fraction(pCompact[i].position[0], pCompact[i].position[1], pCompact[i].position[2]);
+			glm::vec3 position = boxMin + fraction / 65535.0f * extent;
+			glm::vec4 normal = glm::unpackSnorm3x10_1x2(pCompact[i].normal);
+			glm::vec2 uv = glm::unpackHalf2x16(pCompact[i].uv);
+
+			vertex[0] = position.x;
+			vertex[1] = position.y;
+			vertex[2] = position.z;
+			vertex[3] = normal.x;
+			vertex[4] = normal.y;
+			vertex[5] = normal.z;
+			vertex[6] = uv.x;
+			vertex[7] = uv.y;
+		}
+	}
+
+	// append the triangles of a draw with the given primitive mode as a
+	// triangle list - pSource holds the indices of an indexed draw and
+	// is NULL for an array draw
+	void AppendTriangleList(
+		std::vector<GLuint>& indices,
+		GLenum mode,
+		const GLuint* pSource,
+		GLuint first,
+		GLuint count)
+	{
+		GLuint vertex[3];
+
+		for (GLuint i = 0; i + 2 < count; )
+		{
+			if (mode == GL_TRIANGLE_STRIP)
+			{
+				// every other strip triangle is flipped to keep the winding
+				vertex[0] = (i % 2 == 0) ? i : i + 1;
+				vertex[1] = (i % 2 == 0) ? i + 1 : i;
+				vertex[2] = i + 2;
+				i++;
+			}
+			else if (mode == GL_TRIANGLE_FAN)
+			{
+				vertex[0] = 0;
+				vertex[1] = i + 1;
+				vertex[2] = i + 2;
+				i++;
+			}
+			else
+			{
+				vertex[0] = i;
+				vertex[1] = i + 1;
+				vertex[2] = i + 2;
+				i += 3;
+			}
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				GLuint index = first + vertex[corner];
+				indices.push_back((NULL != pSource) ? pSource[index] : index);
+			}
+		}
+	}
+
+	// select the parts of a shape to draw from a mask of MeshPart
+	// values - the cone has no top and always draws its sides, the
+	// shapes without parts only draw their sides entry
+	void SelectMeshParts(int meshID, unsigned int parts, bool bDrawParts[3])
+	{
+		switch (meshID)
+		{
+		case ShapeMeshes::MESH_CONE:
+			bDrawParts[SHARED_PART_BOTTOM] = ((parts & ShapeMeshes::PART_BOTTOM) != 0);
+			bDrawParts[SHARED_PART_TOP] = false;
+			bDrawParts[SHARED_PART_SIDES] = true;
+			break;
+		case ShapeMeshes::MESH_CYLINDER:
+		case ShapeMeshes::MESH_TAPERED_CYLINDER:
+			bDrawParts[SHARED_PART_BOTTOM] = ((parts & ShapeMeshes::PART_BOTTOM) != 0);
+			bDrawParts[SHARED_PART_TOP] = ((parts & ShapeMeshes::PART_TOP) != 0);
+			bDrawParts[SHARED_PART_SIDES] = ((parts & ShapeMeshes::PART_SIDES) != 0);
+			break;
+		default:
+			bDrawParts[SHARED_PART_BOTTOM] = false;
+			bDrawParts[SHARED_PART_TOP] = false;
+			bDrawParts[SHARED_PART_SIDES] = true;
+			break;
+		}
+	}
+
+	// the full shape that a half shape draws part of
+	int GetFullMeshID(int meshID)
+	{
+		if (meshID == ShapeMeshes::MESH_HALF_SPHERE)
+		{
+			return(ShapeMeshes::MESH_SPHERE);
+		}
+		if (meshID == ShapeMeshes::MESH_HALF_TORUS)
+		{
+			return(ShapeMeshes::MESH_TORUS);
+		}
+		return(meshID);
+	}
+
+	// size of the generated level of detail lod, from 1 on, of the
+	// shape with the given MeshID
+	MeshGenerator::MESH_SIZE GetLodMeshSize(int meshID, int lod)
+	{
+		switch (meshID)
+		{
+		case ShapeMeshes::MESH_SPHERE:
+			return(MeshGenerator::GetSphereSize(g_SphereLods[lod - 1].segments, g_SphereLods[lod - 1].rings));
+		case ShapeMeshes::MESH_CONE:
+			return(MeshGenerator::GetConeSize(g_CappedLodSegments[lod - 1]));
+		case ShapeMeshes::MESH_CYLINDER:
+			return(MeshGenerator::GetCylinderSize(g_CappedLodSegments[lod - 1]));
+		case ShapeMeshes::MESH_TAPERED_CYLINDER:
+			return(MeshGenerator::GetTaperedCylinderSize(g_CappedLodSegments[lod - 1]));
+		default:
+			return(MeshGenerator::GetTorusSize(g_TorusLods[lod - 1].segments, g_TorusLods[lod - 1].rings));
+		}
+	}
+
+	// generate the level of detail lod, from 1 on, of the shape with
+	// the given MeshID into buffers of the size GetLodMeshSize() returns
+	void GenerateLodMesh(int meshID, int lod, float tubeRadius, GLfloat* pVertices, GLuint* pIndices)
+	{
+		switch (meshID)
+		{
+		case ShapeMeshes::MESH_SPHERE:
+			MeshGenerator::GenerateSphere(g_SphereLods[lod - 1].segments, g_SphereLods[lod - 1].rings, pVertices, pIndices);
+			break;
+		case ShapeMeshes::MESH_CONE:
+			MeshGenerator::GenerateCone(g_CappedLodSegments[lod - 1], pVertices, pIndices);
+			break;
+		case ShapeMeshes::MESH_CYLINDER:
+			MeshGenerator::GenerateCylinder(g_CappedLodSegments[lod - 1], pVertices, pIndices);
+			break;
+		case ShapeMeshes::MESH_TAPERED_CYLINDER:
+			MeshGenerator::GenerateTaperedCylinder(g_CappedLodSegments[lod - 1], pVertices, pIndices);
+			break;
+		default:
+			MeshGenerator::GenerateTorus(g_TorusLods[lod - 1].segments, g_TorusLods[lod - 1].rings, tubeRadius, pVertices, pIndices);
+			break;
+		}
+	}
 }
 
 ShapeMeshes::ShapeMeshes()
 {
 	m_bMemoryLayoutDone = false;
+
+	// no meshes are loaded yet
+	m_vertexFormat = VERTEX_FORMAT_FLOAT;
+	m_bOptimizeMeshes = true;
+
+	GLMesh emptyMesh = {};
+	m_BoxMesh = emptyMesh;
+	m_ConeMesh = emptyMesh;
+	m_CylinderMesh = emptyMesh;
+	m_PlaneMesh = emptyMesh;
+	m_TilingPlaneMesh = emptyMesh;
+	m_PrismMesh = emptyMesh;
+	m_Pyramid3Mesh = emptyMesh;
+	m_Pyramid4Mesh = emptyMesh;
+	m_SphereMesh = emptyMesh;
+	m_TaperedCylinderMesh = emptyMesh;
+	m_TorusMesh = emptyMesh;
+
+	MESH_BOUNDS emptyBounds = { glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f };
+	GLMesh* meshes[] = {
+		&m_BoxMesh, &m_ConeMesh, &m_CylinderMesh, &m_PlaneMesh,
+		&m_TilingPlaneMesh, &m_PrismMesh, &m_Pyramid3Mesh, &m_Pyramid4Mesh,
+		&m_SphereMesh, &m_TaperedCylinderMesh, &m_TorusMesh };
+	for (size_t i = 0; i < sizeof(meshes) / sizeof(meshes[0]); i++)
+	{
+		meshes[i]->bounds = emptyBounds;
+		meshes[i]->format = VERTEX_FORMAT_FLOAT;
+		meshes[i]->vertexBytes = 0;
+	}
+
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		for (int lod = 0; lod < MAX_MESH_LODS - 1; lod++)
+		{
+			m_lodMeshes[meshID][lod] = emptyMesh;
+			m_lodMeshes[meshID][lod].bounds = emptyBounds;
+			m_lodMeshes[meshID][lod].format = VERTEX_FORMAT_FLOAT;
+			m_lodMeshes[meshID][lod].vertexBytes = 0;
+		}
+		m_lodCounts[meshID] = 1;
+	}
+	m_torusTubeRadius = 0.2f;
+
+	m_sharedVao = 0;
+	m_sharedVbos[0] = 0;
+	m_sharedVbos[1] = 0;
+	m_sharedVertexBytes = 0;
+	memset(m_sharedRanges, 0, sizeof(m_sharedRanges));
+	memset(m_sharedCacheStats, 0, sizeof(m_sharedCacheStats));
+	m_instanceBuffer = 0;
+	m_rangeCommandBuffer = 0;
+
+	DRAW_STATS emptyStats = { 0, 0 };
+	m_frameStats = emptyStats;
+	m_lastFrameStats = emptyStats;
 }
 
 ///////////////////////////////////////////////////
@@ -106,19 +452,19 @@ void ShapeMeshes::LoadBoxMesh()
 	m_BoxMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
 
 	glGenVertexArrays(1, &m_BoxMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_BoxMesh.vao);
+	GLStateCache::BindVertexArray(m_BoxMesh.vao);
 
 	// Create 2 buffers: first one for the vertex data; second one for the indices
 	glGenBuffers(2, m_BoxMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_BoxMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_BoxMesh.vbos[0]); // Activates the buffer
+	UploadVertexData(m_BoxMesh, verts, sizeof(verts) / sizeof(verts[0])); // Sends the vertex data to the GPU in the selected layout
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_BoxMesh.vbos[1]); // Activates the buffer
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_BoxMesh.vbos[1]); // Activates the buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_BoxMesh.format, m_BoxMesh.vbos[0], m_BoxMesh.vertexBytes);
 	}
 }
 
@@ -129,10 +475,13 @@ void ShapeMeshes::LoadBoxMesh()
 //  store it in a VAO/VBO.  The normals and texture
 //  coordinates are also set.
 //
+//  The bottom fan (vertices 0-35) and the sides strip
+//  (vertices 36-143) are converted to one indexed
+//  triangle list.
+//
 //  Correct triangle drawing commands:
 //
-//	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-//	glDrawArrays(GL_TRIANGLE_STRIP, 36, 108);	//sides
+//	glDrawElements(GL_TRIANGLES, meshes.gConeMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
 void ShapeMeshes::LoadConeMesh()
 {
@@ -287,22 +636,17 @@ void ShapeMeshes::LoadConeMesh()
 		1.0f, 0.0f, 0.0f,		0.993150651f, 0.0f, 0.116841137f, 	1.0f, 0.5f
 	};
 
-	// store vertex and index count
-	m_ConeMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_ConeMesh.nIndices = 0;
-
 	// Create VAO
 	glGenVertexArrays(1, &m_ConeMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_ConeMesh.vao);
+	GLStateCache::BindVertexArray(m_ConeMesh.vao);
 
-	// Create VBO
-	glGenBuffers(1, m_ConeMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_ConeMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	// Create 2 buffers: first one for the vertex data; second one for the indices
+	glGenBuffers(2, m_ConeMesh.vbos);
+	UploadCappedMesh(m_ConeMesh, verts, sizeof(verts) / sizeof(verts[0]), g_ConePartVertices); // Sends the vertices and the triangle indices to the GPU, storing the vertex and index count
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_ConeMesh.format, m_ConeMesh.vbos[0], m_ConeMesh.vertexBytes);
 	}
 }
 
@@ -313,11 +657,13 @@ void ShapeMeshes::LoadConeMesh()
 //  store it in a VAO/VBO.  The normals and texture
 //  coordinates are also set.
 //
+//  The bottom and top fans (vertices 0-35 and 36-71)
+//  and the sides strip (vertices 72-217) are converted
+//  to one indexed triangle list.
+//
 //  Correct triangle drawing commands:
 //
-//	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-//	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-//	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
+//	glDrawElements(GL_TRIANGLES, meshes.gCylinderMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
 void ShapeMeshes::LoadCylinderMesh()
 {
@@ -551,22 +897,17 @@ void ShapeMeshes::LoadCylinderMesh()
 
 	normal = CalculateTriangleNormal(glm::vec3(.98f, 1.0f, 0.17f), glm::vec3(.98f, 0.0f, 0.17f), glm::vec3(1.0f, 0.0f, 0.0f));
 
-	// store vertex and index count
-	m_CylinderMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_CylinderMesh.nIndices = 0;
-
 	// Create VAO
 	glGenVertexArrays(1, &m_CylinderMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_CylinderMesh.vao);
+	GLStateCache::BindVertexArray(m_CylinderMesh.vao);
 
-	// Create VBO
-	glGenBuffers(1, m_CylinderMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_CylinderMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	// Create 2 buffers: first one for the vertex data; second one for the indices
+	glGenBuffers(2, m_CylinderMesh.vbos);
+	UploadCappedMesh(m_CylinderMesh, verts, sizeof(verts) / sizeof(verts[0]), g_CylinderPartVertices); // Sends the vertices and the triangle indices to the GPU, storing the vertex and index count
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_CylinderMesh.format, m_CylinderMesh.vbos[0], m_CylinderMesh.vertexBytes);
 	}
 }
 
@@ -604,19 +945,19 @@ void ShapeMeshes::LoadPlaneMesh()
 
 	// Generate the VAO for the mesh
 	glGenVertexArrays(1, &m_PlaneMesh.vao);
-	glBindVertexArray(m_PlaneMesh.vao);	// activate the VAO
+	GLStateCache::BindVertexArray(m_PlaneMesh.vao);	// activate the VAO
 
 	// Create VBOs for the mesh
 	glGenBuffers(2, m_PlaneMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_PlaneMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends data to the GPU
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_PlaneMesh.vbos[0]); // Activates the buffer
+	UploadVertexData(m_PlaneMesh, verts, sizeof(verts) / sizeof(verts[0])); // Sends the vertex data to the GPU in the selected layout
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_PlaneMesh.vbos[1]); // Activates the buffer
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_PlaneMesh.vbos[1]); // Activates the buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_PlaneMesh.format, m_PlaneMesh.vbos[0], m_PlaneMesh.vertexBytes);
 	}
 }
 
@@ -659,19 +1000,19 @@ void ShapeMeshes::LoadTilingPlaneMesh(double xTileCount, double yTileCount)
 
 	// Generate the VAO for the mesh
 	glGenVertexArrays(1, &m_TilingPlaneMesh.vao);
-	glBindVertexArray(m_TilingPlaneMesh.vao);	// activate the VAO
+	GLStateCache::BindVertexArray(m_TilingPlaneMesh.vao);	// activate the VAO
 
 	// Create VBOs for the mesh
 	glGenBuffers(2, m_TilingPlaneMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TilingPlaneMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends data to the GPU
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_TilingPlaneMesh.vbos[0]); // Activates the buffer
+	UploadVertexData(m_TilingPlaneMesh, verts, sizeof(verts) / sizeof(verts[0])); // Sends the vertex data to the GPU in the selected layout
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_TilingPlaneMesh.vbos[1]); // Activates the buffer
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_TilingPlaneMesh.vbos[1]); // Activates the buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_TilingPlaneMesh.format, m_TilingPlaneMesh.vbos[0], m_TilingPlaneMesh.vertexBytes);
 	}
 }
 
@@ -740,16 +1081,16 @@ void ShapeMeshes::LoadPrismMesh()
 	m_PrismMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
 
 	glGenVertexArrays(1, &m_PrismMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_PrismMesh.vao);
+	GLStateCache::BindVertexArray(m_PrismMesh.vao);
 
 	// Create 2 buffers: first one for the vertex data; second one for the indices
 	glGenBuffers(1, m_PrismMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_PrismMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_PrismMesh.vbos[0]); // Activates the buffer
+	UploadVertexData(m_PrismMesh, verts, sizeof(verts) / sizeof(verts[0])); // Sends the vertex data to the GPU in the selected layout
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_PrismMesh.format, m_PrismMesh.vbos[0], m_PrismMesh.vertexBytes);
 	}
 }
 
@@ -796,14 +1137,14 @@ void ShapeMeshes::LoadPyramid3Mesh()
 
 	glGenVertexArrays(1, &m_Pyramid3Mesh.vao);				// Creates 1 VAO
 	glGenBuffers(1, m_Pyramid3Mesh.vbos);					// Creates 1 VBO
-	glBindVertexArray(m_Pyramid3Mesh.vao);					// Activates the VAO
-	glBindBuffer(GL_ARRAY_BUFFER, m_Pyramid3Mesh.vbos[0]);	// Activates the VBO
+	GLStateCache::BindVertexArray(m_Pyramid3Mesh.vao);					// Activates the VAO
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_Pyramid3Mesh.vbos[0]);	// Activates the VBO
 	// Sends vertex or coordinate data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+	UploadVertexData(m_Pyramid3Mesh, verts, sizeof(verts) / sizeof(verts[0])); // Sends the vertex data to the GPU in the selected layout
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_Pyramid3Mesh.format, m_Pyramid3Mesh.vbos[0], m_Pyramid3Mesh.vertexBytes);
 	}
 }
 
@@ -859,14 +1200,14 @@ void ShapeMeshes::LoadPyramid4Mesh()
 
 	glGenVertexArrays(1, &m_Pyramid4Mesh.vao);				// Creates 1 VAO
 	glGenBuffers(1, m_Pyramid4Mesh.vbos);					// Creates 1 VBO
-	glBindVertexArray(m_Pyramid4Mesh.vao);					// Activates the VAO
-	glBindBuffer(GL_ARRAY_BUFFER, m_Pyramid4Mesh.vbos[0]);	// Activates the VBO
+	GLStateCache::BindVertexArray(m_Pyramid4Mesh.vao);					// Activates the VAO
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_Pyramid4Mesh.vbos[0]);	// Activates the VBO
 	// Sends vertex or coordinate data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+	UploadVertexData(m_Pyramid4Mesh, verts, sizeof(verts) / sizeof(verts[0])); // Sends the vertex data to the GPU in the selected layout
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_Pyramid4Mesh.format, m_Pyramid4Mesh.vbos[0], m_Pyramid4Mesh.vertexBytes);
 	}
 }
 
@@ -1712,47 +2053,55 @@ void ShapeMeshes::LoadSphereMesh()
 	const GLuint floatsPerUV = 2;
 
 	// store vertex and index count
-	m_SphereMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex));
+	m_SphereMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex + floatsPerUV));
 	m_SphereMesh.nIndices = sizeof(indices) / (sizeof(indices[0]));
 
 	glm::vec3 normal;
 	glm::vec3 vert;
 	glm::vec3 center(0.0f, 0.0f, 0.0f);
-	float u, v;
-	std::vector<GLfloat> combined_values;
 
-	// combine interleaved vertices, normals, and texture coords
-	for (int i = 0; i < sizeof(verts) / (sizeof(verts[0])); i += 5)
+	// combine interleaved vertices, normals, and texture coords into
+	// one buffer of the final size
+	std::vector<GLfloat> combined_values((size_t)m_SphereMesh.nVertices * (floatsPerVertex + floatsPerNormal + floatsPerUV));
+	GLfloat* pVertex = &combined_values[0];
+	for (GLuint i = 0; i < m_SphereMesh.nVertices; i++)
 	{
-		vert = glm::vec3(verts[i], verts[i + 1], verts[i + 2]);
+		const GLfloat* source = verts + i * (floatsPerVertex + floatsPerUV);
+		vert = glm::vec3(source[0], source[1], source[2]);
 		normal = normalize(vert - center);
-		//u = atan2(normal.x, normal.z) / (2 * M_PI) + 0.5;
-		//v = normal.y * 0.5 + 0.5;
-		combined_values.push_back(vert.x);
-		combined_values.push_back(vert.y);
-		combined_values.push_back(vert.z);
-		combined_values.push_back(normal.x);
-		combined_values.push_back(normal.y);
-		combined_values.push_back(normal.z);
-		combined_values.push_back(verts[i + 3]);
-		combined_values.push_back(verts[i + 4]);
+		pVertex[0] = vert.x;
+		pVertex[1] = vert.y;
+		pVertex[2] = vert.z;
+		pVertex[3] = normal.x;
+		pVertex[4] = normal.y;
+		pVertex[5] = normal.z;
+		pVertex[6] = source[3];
+		pVertex[7] = source[4];
+		pVertex += floatsPerVertex + floatsPerNormal + floatsPerUV;
 	}
 
+	// reorder the triangles for the vertex cache - the half sphere
+	// draws the first half of the indices, so both halves keep
+	// their own triangles
+	const GLuint rangeEnds[] = { (m_SphereMesh.nIndices / 2) / 3 * 3, m_SphereMesh.nIndices };
+	OptimizeMesh(combined_values, indices, m_SphereMesh.nIndices, rangeEnds, 2);
+	m_SphereMesh.nVertices = (GLuint)(combined_values.size() / (floatsPerVertex + floatsPerNormal + floatsPerUV));
+
 	// Create VAO
 	glGenVertexArrays(1, &m_SphereMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_SphereMesh.vao);
+	GLStateCache::BindVertexArray(m_SphereMesh.vao);
 
 	// Create VBOs
 	glGenBuffers(2, m_SphereMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_SphereMesh.vbos[0]); // Activates the vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_SphereMesh.vbos[0]); // Activates the vertex buffer
+	UploadVertexData(m_SphereMesh, combined_values.data(), combined_values.size()); // Sends the vertex data to the GPU in the selected layout
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_SphereMesh.vbos[1]); // Activates the index buffer
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_SphereMesh.vbos[1]); // Activates the index buffer
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_SphereMesh.format, m_SphereMesh.vbos[0], m_SphereMesh.vertexBytes);
 	}
 }
 
@@ -1763,11 +2112,13 @@ void ShapeMeshes::LoadSphereMesh()
 //  vertices and store it in a VAO/VBO.  The normals 
 //  and texture coordinates are also set.
 //
+//  The bottom and top fans (vertices 0-35 and 36-71)
+//  and the sides strip (vertices 72-217) are converted
+//  to one indexed triangle list.
+//
 //  Correct triangle drawing commands:
 //
-//	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-//	glDrawArrays(GL_TRIANGLE_FAN, 36, 72);		//top
-//	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
+//	glDrawElements(GL_TRIANGLES, meshes.gTaperedCylinderMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
 void ShapeMeshes::LoadTaperedCylinderMesh()
 {
@@ -1997,22 +2348,17 @@ void ShapeMeshes::LoadTaperedCylinderMesh()
 		1.0f, 0.0f, 0.0f,		0.993150651f, 0.5f, 0.116841137f,	1.0, 0.0
 	};
 
-	// store vertex and index count
-	m_TaperedCylinderMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_TaperedCylinderMesh.nIndices = 0;
-
 	// Create VAO
 	glGenVertexArrays(1, &m_TaperedCylinderMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_TaperedCylinderMesh.vao);
+	GLStateCache::BindVertexArray(m_TaperedCylinderMesh.vao);
 
-	// Create VBO
-	glGenBuffers(1, m_TaperedCylinderMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TaperedCylinderMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	// Create 2 buffers: first one for the vertex data; second one for the indices
+	glGenBuffers(2, m_TaperedCylinderMesh.vbos);
+	UploadCappedMesh(m_TaperedCylinderMesh, verts, sizeof(verts) / sizeof(verts[0]), g_CylinderPartVertices); // Sends the vertices and the triangle indices to the GPU, storing the vertex and index count
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_TaperedCylinderMesh.format, m_TaperedCylinderMesh.vbos[0], m_TaperedCylinderMesh.vertexBytes);
 	}
 }
 
@@ -2029,213 +2375,120 @@ void ShapeMeshes::LoadTaperedCylinderMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::LoadTorusMesh(float thickness)
 {
-	int _mainSegments = 30;
-	int _tubeSegments = 30;
-	float _mainRadius = 1.0f;
-	float _tubeRadius = .1f;
+	const int mainSegments = 30;
+	const int tubeSegments = 30;
+	const float mainRadius = 1.0f;
+	float tubeRadius = .1f;
 
 	if (thickness <= 1.0)
 	{
-		_tubeRadius = thickness;
+		tubeRadius = thickness;
 	}
-
-	auto mainSegmentAngleStep = glm::radians(360.0f / float(_mainSegments));
-	auto tubeSegmentAngleStep = glm::radians(360.0f / float(_tubeSegments));
-
-	std::vector<glm::vec3> vertex_list;
-	std::vector<std::vector<glm::vec3>> segments_list;
-	std::vector<glm::vec2> texture_coords;
-	glm::vec3 center(0.0f, 0.0f, 0.0f);
-	glm::vec3 normal;
-	glm::vec3 vertex;
-	glm::vec2 text_coord;
-
-	// generate the torus vertices
-	auto currentMainSegmentAngle = 0.0f;
-	for (auto i = 0; i < _mainSegments; i++)
-	{
-		// Calculate sine and cosine of main segment angle
-		auto sinMainSegment = sin(currentMainSegmentAngle);
-		auto cosMainSegment = cos(currentMainSegmentAngle);
-		auto currentTubeSegmentAngle = 0.0f;
-		std::vector<glm::vec3> segment_points;
-		for (auto j = 0; j < _tubeSegments; j++)
-		{
-			// Calculate sine and cosine of tube segment angle
-			auto sinTubeSegment = sin(currentTubeSegmentAngle);
-			auto cosTubeSegment = cos(currentTubeSegmentAngle);
-
-			// Calculate vertex position on the surface of torus
-			auto surfacePosition = glm::vec3(
-				(_mainRadius + _tubeRadius * cosTubeSegment) * cosMainSegment,
-				(_mainRadius + _tubeRadius * cosTubeSegment) * sinMainSegment,
-				_tubeRadius * sinTubeSegment);
-
-			//vertex_list.push_back(surfacePosition);
-			segment_points.push_back(surfacePosition);
-
-			// Update current tube angle
-			currentTubeSegmentAngle += tubeSegmentAngleStep;
-		}
-		segments_list.push_back(segment_points);
-		segment_points.clear();
-
-		// Update main segment angle
-		currentMainSegmentAngle += mainSegmentAngleStep;
+	m_torusTubeRadius = tubeRadius;
+
+	// the sine and cosine of every main and tube segment angle are
+	// computed once, instead of for every vertex of every ring
+	float sinMain[mainSegments];
+	float cosMain[mainSegments];
+	float sinTube[tubeSegments];
+	float cosTube[tubeSegments];
+
+	float mainAngleStep = glm::radians(360.0f / float(mainSegments));
+	float tubeAngleStep = glm::radians(360.0f / float(tubeSegments));
+	float angle = 0.0f;
+	for (int i = 0; i < mainSegments; i++)
+	{
+		sinMain[i] = std::sin(angle);
+		cosMain[i] = std::cos(angle);
+		angle += mainAngleStep;
+	}
+	angle = 0.0f;
+	for (int j = 0; j < tubeSegments; j++)
+	{
+		sinTube[j] = std::sin(angle);
+		cosTube[j] = std::cos(angle);
+		angle += tubeAngleStep;
 	}
 
-	float horizontalStep = 1.0 / _mainSegments;
-	float verticalStep = 1.0 / _tubeSegments;
+	// every quad of the surface is written as 7 vertices, its first
+	// corner closing both of its triangles, so the size of the
+	// interleaved buffer is known before it is filled
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+	const GLuint verticesPerQuad = 7;
+	std::vector<GLfloat> combined_values((size_t)mainSegments * tubeSegments * verticesPerQuad * floatsPerVertex);
+	GLfloat* pVertex = &combined_values[0];
+
+	// write the vertex at a main and a tube segment - the normal
+	// points away from the center of the torus
+	auto writeVertex = [&](int main, int tube, float u, float v)
+	{
+		glm::vec3 vertex(
+			(mainRadius + tubeRadius * cosTube[tube]) * cosMain[main],
+			(mainRadius + tubeRadius * cosTube[tube]) * sinMain[main],
+			tubeRadius * sinTube[tube]);
+		glm::vec3 normal = normalize(vertex);
+
+		pVertex[0] = vertex.x;
+		pVertex[1] = vertex.y;
+		pVertex[2] = vertex.z;
+		pVertex[3] = normal.x;
+		pVertex[4] = normal.y;
+		pVertex[5] = normal.z;
+		pVertex[6] = u;
+		pVertex[7] = v;
+		pVertex += floatsPerVertex;
+	};
+
+	float horizontalStep = 1.0 / mainSegments;
+	float verticalStep = 1.0 / tubeSegments;
 	float u = 0.0;
 	float v = 0.0;
 
-	// connect the various segments together, forming triangles
-	for (int i = 0; i < _mainSegments; i++)
+	// connect the various segments together, forming triangles - the
+	// last segments connect back to the first ones
+	for (int i = 0; i < mainSegments; i++)
 	{
-		for (int j = 0; j < _tubeSegments; j++)
+		int nextI = ((i + 1) < mainSegments) ? (i + 1) : 0;
+		float nextU = ((i + 1) < mainSegments) ? (u + horizontalStep) : 0.0f;
+
+		for (int j = 0; j < tubeSegments; j++)
 		{
-			if (((i + 1) < _mainSegments) && ((j + 1) < _tubeSegments))
-			{
-				vertex_list.push_back(segments_list[i][j]);
-				texture_coords.push_back(glm::vec2(u, v));
-				vertex_list.push_back(segments_list[i][j + 1]);
-				texture_coords.push_back(glm::vec2(u, v + verticalStep));
-				vertex_list.push_back(segments_list[i + 1][j + 1]);
-				texture_coords.push_back(glm::vec2(u + horizontalStep, v + verticalStep));
-				vertex_list.push_back(segments_list[i][j]);
-				texture_coords.push_back(glm::vec2(u, v));
-				vertex_list.push_back(segments_list[i + 1][j]);
-				texture_coords.push_back(glm::vec2(u + horizontalStep, v));
-				vertex_list.push_back(segments_list[i + 1][j + 1]);
-				texture_coords.push_back(glm::vec2(u + horizontalStep, v - verticalStep));
-				vertex_list.push_back(segments_list[i][j]);
-				texture_coords.push_back(glm::vec2(u, v));
-			}
-			else
-			{
-				if (((i + 1) == _mainSegments) && ((j + 1) == _tubeSegments))
-				{
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i][0]);
-					texture_coords.push_back(glm::vec2(u, 0));
-					vertex_list.push_back(segments_list[0][0]);
-					texture_coords.push_back(glm::vec2(0, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[0][j]);
-					texture_coords.push_back(glm::vec2(0, v));
-					vertex_list.push_back(segments_list[0][0]);
-					texture_coords.push_back(glm::vec2(0, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-				}
-				else if ((i + 1) == _mainSegments)
-				{
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i][j + 1]);
-					texture_coords.push_back(glm::vec2(u, v + verticalStep));
-					vertex_list.push_back(segments_list[0][j + 1]);
-					texture_coords.push_back(glm::vec2(0, v + verticalStep));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[0][j]);
-					texture_coords.push_back(glm::vec2(0, v));
-					vertex_list.push_back(segments_list[0][j + 1]);
-					texture_coords.push_back(glm::vec2(0, v + verticalStep));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-				}
-				else if ((j + 1) == _tubeSegments)
-				{
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i][0]);
-					texture_coords.push_back(glm::vec2(u, 0));
-					vertex_list.push_back(segments_list[i + 1][0]);
-					texture_coords.push_back(glm::vec2(u + horizontalStep, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i + 1][j]);
-					texture_coords.push_back(glm::vec2(u + horizontalStep, v));
-					vertex_list.push_back(segments_list[i + 1][0]);
-					texture_coords.push_back(glm::vec2(u + horizontalStep, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-				}
+			int nextJ = ((j + 1) < tubeSegments) ? (j + 1) : 0;
+			float nextV = ((j + 1) < tubeSegments) ? (v + verticalStep) : 0.0f;
+			// the quads that do not wrap around map the last corner
+			// of their second triangle one step lower
+			float lastV = (((i + 1) < mainSegments) && ((j + 1) < tubeSegments)) ? (v - verticalStep) : nextV;
+
+			writeVertex(i, j, u, v);
+			writeVertex(i, nextJ, u, nextV);
+			writeVertex(nextI, nextJ, nextU, nextV);
+			writeVertex(i, j, u, v);
+			writeVertex(nextI, j, nextU, v);
+			writeVertex(nextI, nextJ, nextU, lastV);
+			writeVertex(i, j, u, v);
 
-			}
 			v += verticalStep;
 		}
 		v = 0.0;
 		u += horizontalStep;
 	}
 
-	std::vector<GLfloat> combined_values;
-
-	// combine interleaved vertices, normals, and texture coords
-	for (int i = 0; i < vertex_list.size(); i++)
-	{
-		vertex = vertex_list[i];
-		normal = normalize(vertex);
-		if (vertex.x < 0)
-		{
-			if (normal.x > 0)
-				normal.x *= -1;
-		}
-		else if (vertex.x > 0)
-		{
-			if (normal.x < 0)
-				normal.x *= -1;
-		}
-		if (vertex.y < 0)
-		{
-			if (normal.y > 0)
-				normal.y *= -1;
-		}
-		else if (vertex.y > 0)
-		{
-			if (normal.y < 0)
-				normal.y *= -1;
-		}
-		if (vertex.z < 0)
-		{
-			if (normal.z > 0)
-				normal.z *= -1;
-		}
-		else if (vertex.z > 0)
-		{
-			if (normal.z < 0)
-				normal.z *= -1;
-		}
-		text_coord = texture_coords[i];
-		combined_values.push_back(vertex.x);
-		combined_values.push_back(vertex.y);
-		combined_values.push_back(vertex.z);
-		combined_values.push_back(normal.x);
-		combined_values.push_back(normal.y);
-		combined_values.push_back(normal.z);
-		combined_values.push_back(text_coord.x);
-		combined_values.push_back(text_coord.y);
-	}
-
 	// store vertex and index count
-	m_TorusMesh.nVertices = vertex_list.size();
+	m_TorusMesh.nVertices = (GLuint)(combined_values.size() / floatsPerVertex);
 	m_TorusMesh.nIndices = 0;
 
 	// Create VAO
 	glGenVertexArrays(1, &m_TorusMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_TorusMesh.vao);
+	GLStateCache::BindVertexArray(m_TorusMesh.vao);
 
 	// Create VBOs
 	glGenBuffers(1, m_TorusMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TorusMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_TorusMesh.vbos[0]); // Activates the buffer
+	UploadVertexData(m_TorusMesh, combined_values.data(), combined_values.size()); // Sends the vertex data to the GPU in the selected layout
 
 	if (m_bMemoryLayoutDone == false)
 	{
-		SetShaderMemoryLayout();
+		SetShaderMemoryLayout(m_TorusMesh.format, m_TorusMesh.vbos[0], m_TorusMesh.vertexBytes);
 	}
 }
 
@@ -2249,11 +2502,9 @@ void ShapeMeshes::LoadTorusMesh(float thickness)
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawBoxMesh()
 {
-	glBindVertexArray(m_BoxMesh.vao);
+	GLStateCache::BindVertexArray(m_BoxMesh.vao);
 
 	glDrawElements(GL_TRIANGLES, m_BoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2265,15 +2516,7 @@ void ShapeMeshes::DrawBoxMesh()
 void ShapeMeshes::DrawConeMesh(
 	bool bDrawBottom)
 {
-	glBindVertexArray(m_ConeMesh.vao);
-
-	if (bDrawBottom == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	}
-	glDrawArrays(GL_TRIANGLE_STRIP, 36, 108);	//sides
-
-	glBindVertexArray(0);
+	DrawMeshRanges(MESH_CONE, (bDrawBottom == true) ? PART_ALL : PART_SIDES, 0);
 }
 
 ///////////////////////////////////////////////////
@@ -2287,22 +2530,12 @@ void ShapeMeshes::DrawCylinderMesh(
 	bool bDrawBottom,
 	bool bDrawSides)
 {
-	glBindVertexArray(m_CylinderMesh.vao);
-
-	if (bDrawBottom == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);	//bottom
-	}
-	if (bDrawTop == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 36, 36);	//top
-	}
-	if (bDrawSides == true)
-	{
-		glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-	}
+	unsigned int parts = 0;
+	parts |= (bDrawTop == true) ? PART_TOP : 0;
+	parts |= (bDrawBottom == true) ? PART_BOTTOM : 0;
+	parts |= (bDrawSides == true) ? PART_SIDES : 0;
 
-	glBindVertexArray(0);
+	DrawMeshRanges(MESH_CYLINDER, parts, 0);
 }
 
 ///////////////////////////////////////////////////
@@ -2313,11 +2546,9 @@ void ShapeMeshes::DrawCylinderMesh(
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPlaneMesh()
 {
-	glBindVertexArray(m_PlaneMesh.vao);
+	GLStateCache::BindVertexArray(m_PlaneMesh.vao);
 
 	glDrawElements(GL_TRIANGLES, m_PlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2328,11 +2559,9 @@ void ShapeMeshes::DrawPlaneMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawTilingPlaneMesh()
 {
-	glBindVertexArray(m_TilingPlaneMesh.vao);
+	GLStateCache::BindVertexArray(m_TilingPlaneMesh.vao);
 
 	glDrawElements(GL_TRIANGLES, m_TilingPlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2343,11 +2572,9 @@ void ShapeMeshes::DrawTilingPlaneMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPrismMesh()
 {
-	glBindVertexArray(m_PrismMesh.vao);
+	GLStateCache::BindVertexArray(m_PrismMesh.vao);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_PrismMesh.nVertices);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2358,11 +2585,9 @@ void ShapeMeshes::DrawPrismMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPyramid3Mesh()
 {
-	glBindVertexArray(m_Pyramid3Mesh.vao);
+	GLStateCache::BindVertexArray(m_Pyramid3Mesh.vao);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_Pyramid3Mesh.nVertices);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2373,11 +2598,9 @@ void ShapeMeshes::DrawPyramid3Mesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPyramid4Mesh()
 {
-	glBindVertexArray(m_Pyramid4Mesh.vao);
+	GLStateCache::BindVertexArray(m_Pyramid4Mesh.vao);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_Pyramid4Mesh.nVertices);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2388,11 +2611,9 @@ void ShapeMeshes::DrawPyramid4Mesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawSphereMesh()
 {
-	glBindVertexArray(m_SphereMesh.vao);
+	GLStateCache::BindVertexArray(m_SphereMesh.vao);
 
 	glDrawElements(GL_TRIANGLES, m_SphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2403,11 +2624,9 @@ void ShapeMeshes::DrawSphereMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawHalfSphereMesh()
 {
-	glBindVertexArray(m_SphereMesh.vao);
+	GLStateCache::BindVertexArray(m_SphereMesh.vao);
 
 	glDrawElements(GL_TRIANGLES, m_SphereMesh.nIndices/2, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2421,22 +2640,12 @@ void ShapeMeshes::DrawTaperedCylinderMesh(
 	bool bDrawBottom,
 	bool bDrawSides)
 {
-	glBindVertexArray(m_TaperedCylinderMesh.vao);
-
-	if (bDrawBottom == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);	//bottom
-	}
-	if (bDrawTop == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 36, 72);	//top
-	}
-	if (bDrawSides == true)
-	{
-		glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-	}
+	unsigned int parts = 0;
+	parts |= (bDrawTop == true) ? PART_TOP : 0;
+	parts |= (bDrawBottom == true) ? PART_BOTTOM : 0;
+	parts |= (bDrawSides == true) ? PART_SIDES : 0;
 
-	glBindVertexArray(0);
+	DrawMeshRanges(MESH_TAPERED_CYLINDER, parts, 0);
 }
 
 ///////////////////////////////////////////////////
@@ -2447,11 +2656,9 @@ void ShapeMeshes::DrawTaperedCylinderMesh(
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawTorusMesh()
 {
-	glBindVertexArray(m_TorusMesh.vao);
+	GLStateCache::BindVertexArray(m_TorusMesh.vao);
 
 	glDrawArrays(GL_TRIANGLES, 0, m_TorusMesh.nVertices);
-
-	glBindVertexArray(0);
 }
 
 ///////////////////////////////////////////////////
@@ -2462,56 +2669,1285 @@ void ShapeMeshes::DrawTorusMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawHalfTorusMesh()
 {
-	glBindVertexArray(m_TorusMesh.vao);
+	GLStateCache::BindVertexArray(m_TorusMesh.vao);
 
 	glDrawArrays(GL_TRIANGLES, 0, m_TorusMesh.nVertices/2);
+}
+
+///////////////////////////////////////////////////
+//	DrawMesh()
+//
+//	Draw the shape that is identified by the passed
+//  in MeshID, using the selected parts for the
+//  capped shapes.  The generated levels of detail
+//  are drawn from their index ranges.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawMesh(int meshID, unsigned int parts, int lod)
+{
+	bool bDrawTop = ((parts & PART_TOP) != 0);
+	bool bDrawBottom = ((parts & PART_BOTTOM) != 0);
+	bool bDrawSides = ((parts & PART_SIDES) != 0);
+
+	lod = GetDrawnLod(meshID, lod);
+	m_frameStats.drawCalls += CountMeshDrawCalls(meshID, parts, lod);
+
+	if (lod > 0)
+	{
+		DrawMeshRanges(meshID, parts, lod);
+		return;
+	}
 
-	glBindVertexArray(0);
+	switch (meshID)
+	{
+	case MESH_BOX:				DrawBoxMesh(); break;
+	case MESH_CONE:				DrawConeMesh(bDrawBottom); break;
+	case MESH_CYLINDER:			DrawCylinderMesh(bDrawTop, bDrawBottom, bDrawSides); break;
+	case MESH_PLANE:			DrawPlaneMesh(); break;
+	case MESH_TILING_PLANE:		DrawTilingPlaneMesh(); break;
+	case MESH_PRISM:			DrawPrismMesh(); break;
+	case MESH_PYRAMID3:			DrawPyramid3Mesh(); break;
+	case MESH_PYRAMID4:			DrawPyramid4Mesh(); break;
+	case MESH_SPHERE:			DrawSphereMesh(); break;
+	case MESH_HALF_SPHERE:		DrawHalfSphereMesh(); break;
+	case MESH_TAPERED_CYLINDER:	DrawTaperedCylinderMesh(bDrawTop, bDrawBottom, bDrawSides); break;
+	case MESH_TORUS:			DrawTorusMesh(); break;
+	case MESH_HALF_TORUS:		DrawHalfTorusMesh(); break;
+	default: break;
+	}
 }
 
-glm::vec3 ShapeMeshes::CalculateTriangleNormal(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+///////////////////////////////////////////////////
+//	DrawMeshInstanced()
+//
+//	Draw instances of the shape that is identified by
+//  the passed in MeshID, using the same draw commands
+//  as the Draw*Mesh() methods.  The selected parts of
+//  the capped shapes and the generated levels of
+//  detail are drawn from their index ranges.  The
+//  per-instance data is read from the attached
+//  instance buffer.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawMeshInstanced(
+	int meshID,
+	unsigned int parts,
+	GLsizei instanceCount,
+	GLuint baseInstance,
+	int lod)
 {
-	glm::vec3 Normal(0, 0, 0);
-	float v1x = p1.x - p0.x;
-	float v1y = p1.y - p0.y;
-	float v1z = p1.z - p0.z;
-	float v2x = p2.x - p1.x;
-	float v2y = p2.y - p1.y;
-	float v2z = p2.z - p1.z;
-	Normal.x = v1y * v2z - v1z * v2y;
-	Normal.y = v1z * v2x - v1x * v2z;
-	Normal.y = v1x * v2y - v1y * v2x;
-	float len = (float)sqrt(Normal.x * Normal.x + Normal.y * Normal.y + Normal.z * Normal.z);
-	if (len == 0)
+	GLuint firstIndex[MAX_MESH_COMMANDS];
+	GLuint indexCount[MAX_MESH_COMMANDS];
+	lod = GetDrawnLod(meshID, lod);
+	int rangeCount = GetMeshIndexRanges(meshID, parts, lod, firstIndex, indexCount);
+
+	m_frameStats.drawCalls += CountMeshDrawCalls(meshID, parts, lod);
+
+	if (rangeCount == 1)
 	{
-		//throw Exception();
+		GLStateCache::BindVertexArray(GetMesh(meshID, lod).vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, indexCount[0], GL_UNSIGNED_INT,
+			(void*)(sizeof(GLuint) * firstIndex[0]), instanceCount, baseInstance);
+		return;
 	}
-	else
+	if (rangeCount > 1)
 	{
-		Normal.x /= len;
-		Normal.y /= len;
-		Normal.z /= len;
+		// there is no instanced glMultiDrawElements(), so the ranges
+		// are sent as the commands of one indirect multi-draw
+		DRAW_ELEMENTS_INDIRECT_COMMAND commands[MAX_MESH_COMMANDS];
+		for (int range = 0; range < rangeCount; range++)
+		{
+			commands[range].count = indexCount[range];
+			commands[range].instanceCount = (GLuint)instanceCount;
+			commands[range].firstIndex = firstIndex[range];
+			commands[range].baseVertex = 0;
+			commands[range].baseInstance = baseInstance;
+		}
+
+		if (m_rangeCommandBuffer == 0)
+		{
+			glGenBuffers(1, &m_rangeCommandBuffer);
+		}
+		GLStateCache::BindVertexArray(GetMesh(meshID, lod).vao);
+		GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_rangeCommandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, rangeCount * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND), commands, GL_STREAM_DRAW);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)0,
+			rangeCount, sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND));
+		return;
+	}
+
+	switch (meshID)
+	{
+	case MESH_BOX:
+		GLStateCache::BindVertexArray(m_BoxMesh.vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_BoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0, instanceCount, baseInstance);
+		break;
+	case MESH_PLANE:
+		GLStateCache::BindVertexArray(m_PlaneMesh.vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_PlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0, instanceCount, baseInstance);
+		break;
+	case MESH_TILING_PLANE:
+		GLStateCache::BindVertexArray(m_TilingPlaneMesh.vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_TilingPlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0, instanceCount, baseInstance);
+		break;
+	case MESH_PRISM:
+		GLStateCache::BindVertexArray(m_PrismMesh.vao);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, m_PrismMesh.nVertices, instanceCount, baseInstance);
+		break;
+	case MESH_PYRAMID3:
+		GLStateCache::BindVertexArray(m_Pyramid3Mesh.vao);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, m_Pyramid3Mesh.nVertices, instanceCount, baseInstance);
+		break;
+	case MESH_PYRAMID4:
+		GLStateCache::BindVertexArray(m_Pyramid4Mesh.vao);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, m_Pyramid4Mesh.nVertices, instanceCount, baseInstance);
+		break;
+	case MESH_SPHERE:
+		GLStateCache::BindVertexArray(m_SphereMesh.vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_SphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0, instanceCount, baseInstance);
+		break;
+	case MESH_HALF_SPHERE:
+		GLStateCache::BindVertexArray(m_SphereMesh.vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_SphereMesh.nIndices / 2, GL_UNSIGNED_INT, (void*)0, instanceCount, baseInstance);
+		break;
+	case MESH_TORUS:
+		GLStateCache::BindVertexArray(m_TorusMesh.vao);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, m_TorusMesh.nVertices, instanceCount, baseInstance);
+		break;
+	case MESH_HALF_TORUS:
+		GLStateCache::BindVertexArray(m_TorusMesh.vao);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, m_TorusMesh.nVertices / 2, instanceCount, baseInstance);
+		break;
+	default:
+		break;
 	}
-	return Normal;
 }
 
+///////////////////////////////////////////////////
+//	AttachInstanceBuffer()
+//
+//	Add the per-instance attributes, read from the
+//  passed in buffer, to the VAO of every mesh that
+//  has been loaded.
+///////////////////////////////////////////////////
+void ShapeMeshes::AttachInstanceBuffer(GLuint instanceBuffer)
+{
+	GLMesh* meshes[] = {
+		&m_BoxMesh, &m_ConeMesh, &m_CylinderMesh, &m_PlaneMesh,
+		&m_TilingPlaneMesh, &m_PrismMesh, &m_Pyramid3Mesh, &m_Pyramid4Mesh,
+		&m_SphereMesh, &m_TaperedCylinderMesh, &m_TorusMesh };
+
+	for (size_t i = 0; i < sizeof(meshes) / sizeof(meshes[0]); i++)
+	{
+		// skip the meshes that were never loaded
+		if (meshes[i]->vao == 0)
+		{
+			continue;
+		}
+
+		GLStateCache::BindVertexArray(meshes[i]->vao);
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		SetInstanceMemoryLayout();
+	}
+
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		for (int lod = 1; lod < m_lodCounts[meshID]; lod++)
+		{
+			GLStateCache::BindVertexArray(m_lodMeshes[meshID][lod - 1].vao);
+			GLStateCache::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			SetInstanceMemoryLayout();
+		}
+	}
+
+	if (m_sharedVao != 0)
+	{
+		GLStateCache::BindVertexArray(m_sharedVao);
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		SetInstanceMemoryLayout();
+	}
 
+	GLStateCache::BindVertexArray(0);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_instanceBuffer = instanceBuffer;
+}
 
-void ShapeMeshes::SetShaderMemoryLayout()
+///////////////////////////////////////////////////
+//	BuildSharedMeshBuffer()
+//
+//	Pack every loaded mesh into one vertex buffer and
+//  one index buffer behind a single VAO, so that all
+//  shapes can be drawn with multi-draw indirect
+//  calls.  The mesh data is read back from the mesh
+//  VBOs once, and the strips and fans are converted
+//  to triangle lists that cover the same ranges as
+//  the Draw*Mesh() methods.  The triangles of every
+//  part and the vertices of every shape are then
+//  reordered for the vertex cache.  The generated
+//  levels of detail are packed after the loaded
+//  meshes.  The shared vertices use the selected
+//  vertex layout - compact positions are fractions
+//  of the box around all meshes.
+///////////////////////////////////////////////////
+bool ShapeMeshes::BuildSharedMeshBuffer()
 {
-	// The following code defines the layout of the mesh data in memory - each mesh needs
-	// to have the same memory layout so that the data is retrieved properly by the shaders
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+
+	// the draws of every shape, matching the Draw*Mesh() methods -
+	// a count of 0 draws all of the mesh indices or vertices
+	struct SHAPE_DRAW
+	{
+		int meshID;
+		int part;
+		GLMesh* pMesh;
+		GLenum mode;
+		GLuint first;
+		GLuint count;
+		int lod;
+	};
+	const SHAPE_DRAW shapeDraws[] = {
+		{ MESH_BOX,					SHARED_PART_SIDES,	&m_BoxMesh,				GL_TRIANGLES,		0,	0,	0 },
+		{ MESH_CONE,				SHARED_PART_BOTTOM,	&m_ConeMesh,			GL_TRIANGLES,		m_ConeMesh.partFirst[SHARED_PART_BOTTOM],	m_ConeMesh.partCount[SHARED_PART_BOTTOM],	0 },
+		{ MESH_CONE,				SHARED_PART_SIDES,	&m_ConeMesh,			GL_TRIANGLES,		m_ConeMesh.partFirst[SHARED_PART_SIDES],	m_ConeMesh.partCount[SHARED_PART_SIDES],	0 },
+		{ MESH_CYLINDER,			SHARED_PART_BOTTOM,	&m_CylinderMesh,		GL_TRIANGLES,		m_CylinderMesh.partFirst[SHARED_PART_BOTTOM],	m_CylinderMesh.partCount[SHARED_PART_BOTTOM],	0 },
+		{ MESH_CYLINDER,			SHARED_PART_TOP,	&m_CylinderMesh,		GL_TRIANGLES,		m_CylinderMesh.partFirst[SHARED_PART_TOP],	m_CylinderMesh.partCount[SHARED_PART_TOP],	0 },
+		{ MESH_CYLINDER,			SHARED_PART_SIDES,	&m_CylinderMesh,		GL_TRIANGLES,		m_CylinderMesh.partFirst[SHARED_PART_SIDES],	m_CylinderMesh.partCount[SHARED_PART_SIDES],	0 },
+		{ MESH_PLANE,				SHARED_PART_SIDES,	&m_PlaneMesh,			GL_TRIANGLES,		0,	0,	0 },
+		{ MESH_TILING_PLANE,		SHARED_PART_SIDES,	&m_TilingPlaneMesh,		GL_TRIANGLES,		0,	0,	0 },
+		{ MESH_PRISM,				SHARED_PART_SIDES,	&m_PrismMesh,			GL_TRIANGLE_STRIP,	0,	0,	0 },
+		{ MESH_PYRAMID3,			SHARED_PART_SIDES,	&m_Pyramid3Mesh,		GL_TRIANGLE_STRIP,	0,	0,	0 },
+		{ MESH_PYRAMID4,			SHARED_PART_SIDES,	&m_Pyramid4Mesh,		GL_TRIANGLE_STRIP,	0,	0,	0 },
+		{ MESH_SPHERE,				SHARED_PART_SIDES,	&m_SphereMesh,			GL_TRIANGLES,		0,	0,	0 },
+		{ MESH_TAPERED_CYLINDER,	SHARED_PART_BOTTOM,	&m_TaperedCylinderMesh,	GL_TRIANGLES,		m_TaperedCylinderMesh.partFirst[SHARED_PART_BOTTOM],	m_TaperedCylinderMesh.partCount[SHARED_PART_BOTTOM],	0 },
+		{ MESH_TAPERED_CYLINDER,	SHARED_PART_TOP,	&m_TaperedCylinderMesh,	GL_TRIANGLES,		m_TaperedCylinderMesh.partFirst[SHARED_PART_TOP],	m_TaperedCylinderMesh.partCount[SHARED_PART_TOP],	0 },
+		{ MESH_TAPERED_CYLINDER,	SHARED_PART_SIDES,	&m_TaperedCylinderMesh,	GL_TRIANGLES,		m_TaperedCylinderMesh.partFirst[SHARED_PART_SIDES],	m_TaperedCylinderMesh.partCount[SHARED_PART_SIDES],	0 },
+		{ MESH_TORUS,				SHARED_PART_SIDES,	&m_TorusMesh,			GL_TRIANGLES,		0,	0,	0 } };
+
+	GLMesh* loadedMeshes[] = {
+		&m_BoxMesh, &m_ConeMesh, &m_CylinderMesh, &m_PlaneMesh,
+		&m_TilingPlaneMesh, &m_PrismMesh, &m_Pyramid3Mesh, &m_Pyramid4Mesh,
+		&m_SphereMesh, &m_TaperedCylinderMesh, &m_TorusMesh };
+
+	std::vector<SHAPE_DRAW> draws(shapeDraws, shapeDraws + sizeof(shapeDraws) / sizeof(shapeDraws[0]));
+	std::vector<GLMesh*> meshes(loadedMeshes, loadedMeshes + sizeof(loadedMeshes) / sizeof(loadedMeshes[0]));
+
+	// the generated levels of detail are triangle lists with the
+	// parts of their shape - the empty parts are left out, since
+	// a count of 0 would draw the whole mesh
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		for (int lod = 1; lod < m_lodCounts[meshID]; lod++)
+		{
+			GLMesh* pMesh = &m_lodMeshes[meshID][lod - 1];
+			meshes.push_back(pMesh);
+			for (int part = SHARED_PART_BOTTOM; part <= SHARED_PART_SIDES; part++)
+			{
+				if (pMesh->partCount[part] > 0)
+				{
+					SHAPE_DRAW lodDraw = { meshID, part, pMesh, GL_TRIANGLES, pMesh->partFirst[part], pMesh->partCount[part], lod };
+					draws.push_back(lodDraw);
+				}
+			}
+		}
+	}
+
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	std::vector<GLuint> meshIndices;
+	std::vector<unsigned char> meshVertices;
+	std::vector<GLfloat> meshFloats;
+	std::vector<GLuint> rangeEnds;
+	glm::vec3 boxMin(0.0f);
+	glm::vec3 boxMax(0.0f);
+
+	memset(m_sharedRanges, 0, sizeof(m_sharedRanges));
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const GLMesh& mesh = *meshes[i];
+
+		// skip the meshes that were never loaded
+		if (mesh.vao == 0)
+		{
+			continue;
+		}
+
+		GLint baseVertex = (GLint)(vertices.size() / floatsPerVertex);
+
+		// nVertices can be larger than the buffer (the sphere counts its
+		// vertices with the wrong stride), so the uploaded size is used
+		GLuint vertexCount = std::min(mesh.nVertices, mesh.vertexBytes / GetVertexStride(mesh.format));
+
+		meshVertices.resize(vertexCount * GetVertexStride(mesh.format));
+		GLStateCache::BindBuffer(GL_COPY_READ_BUFFER, mesh.vbos[0]);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, meshVertices.size(), &meshVertices[0]);
+
+		vertices.resize(vertices.size() + vertexCount * floatsPerVertex);
+		UnpackVertices(mesh.format, &meshVertices[0], vertexCount, mesh.bounds.boxMin, mesh.bounds.boxMax,
+			&vertices[baseVertex * floatsPerVertex]);
+
+		boxMin = (baseVertex == 0) ? mesh.bounds.boxMin : glm::min(boxMin, mesh.bounds.boxMin);
+		boxMax = (baseVertex == 0) ? mesh.bounds.boxMax : glm::max(boxMax, mesh.bounds.boxMax);
 
-	// Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-	GLint stride = sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV);// The number of floats before each
+		const GLuint meshFirstIndex = (GLuint)indices.size();
+		int meshID = -1;
+		int meshLod = 0;
+		rangeEnds.clear();
 
-	// Create Vertex Attribute Pointers
-	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-	glEnableVertexAttribArray(0);
+		meshIndices.resize(mesh.nIndices);
+		if (mesh.nIndices > 0)
+		{
+			GLStateCache::BindBuffer(GL_COPY_READ_BUFFER, mesh.vbos[1]);
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint) * mesh.nIndices, &meshIndices[0]);
+		}
+
+		for (size_t draw = 0; draw < draws.size(); draw++)
+		{
+			const SHAPE_DRAW& shapeDraw = draws[draw];
+			if (shapeDraw.pMesh != meshes[i])
+			{
+				continue;
+			}
+
+			// never read past the end of the mesh, those vertices
+			// belong to the next mesh in the shared buffer
+			GLuint available = (mesh.nIndices > 0) ? mesh.nIndices : vertexCount;
+			GLuint count = (shapeDraw.count == 0) ? available : shapeDraw.count;
+			count = (shapeDraw.first >= available) ? 0 : std::min(count, available - shapeDraw.first);
+
+			SHARED_RANGE& range = m_sharedRanges[shapeDraw.meshID][shapeDraw.lod][shapeDraw.part];
+			range.firstIndex = (GLuint)indices.size();
+			range.baseVertex = baseVertex;
+			AppendTriangleList(indices, shapeDraw.mode,
+				(mesh.nIndices > 0) ? &meshIndices[0] : NULL, shapeDraw.first, count);
+			range.indexCount = (GLuint)indices.size() - range.firstIndex;
+
+			// the half shapes draw the first half of their full
+			// shape, so the halves keep their own triangles
+			meshID = shapeDraw.meshID;
+			meshLod = shapeDraw.lod;
+			if ((meshID == MESH_SPHERE) || (meshID == MESH_TORUS))
+			{
+				SHARED_RANGE& halfRange = m_sharedRanges[(meshID == MESH_SPHERE) ? MESH_HALF_SPHERE : MESH_HALF_TORUS][meshLod][SHARED_PART_SIDES];
+				halfRange = range;
+				halfRange.indexCount = std::min(range.indexCount, (available / 2) / 3 * 3);
+				rangeEnds.push_back(range.firstIndex - meshFirstIndex + halfRange.indexCount);
+			}
+			rangeEnds.push_back((GLuint)indices.size() - meshFirstIndex);
+		}
+
+		// reorder the shape and put its vertices back in their new order
+		meshFloats.assign(vertices.begin() + baseVertex * floatsPerVertex, vertices.end());
+		GLuint* pMeshIndices = &indices[0] + meshFirstIndex;
+		const size_t meshIndexCount = indices.size() - meshFirstIndex;
+		MESH_CACHE_STATS stats;
+		stats.before = m_meshOptimizer.AnalyzeVertexCache(pMeshIndices, meshIndexCount, meshFloats.size() / floatsPerVertex);
+		OptimizeMesh(meshFloats, pMeshIndices, meshIndexCount,
+			rangeEnds.empty() ? NULL : &rangeEnds[0], rangeEnds.size());
+		stats.after = (m_bOptimizeMeshes == true) ?
+			m_meshOptimizer.AnalyzeVertexCache(pMeshIndices, meshIndexCount, meshFloats.size() / floatsPerVertex) : stats.before;
+		vertices.resize(baseVertex * floatsPerVertex);
+		vertices.insert(vertices.end(), meshFloats.begin(), meshFloats.end());
+		if ((meshID >= 0) && (meshLod == 0))
+		{
+			m_sharedCacheStats[meshID] = stats;
+		}
+	}
+
+	GLStateCache::BindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	if (indices.empty())
+	{
+		return(false);
+	}
+
+	glGenVertexArrays(1, &m_sharedVao);
+	GLStateCache::BindVertexArray(m_sharedVao);
+
+	const GLuint sharedVertexCount = (GLuint)(vertices.size() / floatsPerVertex);
+	m_uploadData.clear();
+	PackVertices(m_vertexFormat, &vertices[0], sharedVertexCount, boxMin, boxMax, m_uploadData);
+	m_sharedVertexBytes = sharedVertexCount * GetVertexStride(m_vertexFormat);
+
+	glGenBuffers(2, m_sharedVbos);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_sharedVbos[0]);
+	glBufferData(GL_ARRAY_BUFFER, m_uploadData.size(), &m_uploadData[0], GL_STATIC_DRAW);
+
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sharedVbos[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+
+	SetShaderMemoryLayout(m_vertexFormat, m_sharedVbos[0], m_sharedVertexBytes);
+
+	GLStateCache::BindVertexArray(0);
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return(true);
+}
+
+///////////////////////////////////////////////////
+//	GetMeshDrawCommands()
+//
+//	Fill in the indirect commands that draw the shape
+//  identified by the passed in MeshID from the shared
+//  buffers, at the passed in level of detail.
+//  Selected parts that follow each other in the
+//  index buffer are merged into one command.
+///////////////////////////////////////////////////
+int ShapeMeshes::GetMeshDrawCommands(
+	int meshID,
+	unsigned int parts,
+	GLuint instanceCount,
+	GLuint baseInstance,
+	DRAW_ELEMENTS_INDIRECT_COMMAND* pCommands,
+	int lod) const
+{
+	if ((meshID < 0) || (meshID >= MESH_COUNT) || (NULL == pCommands))
+	{
+		return(0);
+	}
+
+	bool bDrawParts[3];
+	SelectMeshParts(meshID, parts, bDrawParts);
+	lod = GetDrawnLod(meshID, lod);
+
+	int commandCount = 0;
+	for (int part = SHARED_PART_BOTTOM; part <= SHARED_PART_SIDES; part++)
+	{
+		const SHARED_RANGE& range = m_sharedRanges[meshID][lod][part];
+		if ((bDrawParts[part] == false) || (range.indexCount == 0))
+		{
+			continue;
+		}
+
+		if (commandCount > 0)
+		{
+			DRAW_ELEMENTS_INDIRECT_COMMAND& last = pCommands[commandCount - 1];
+			if ((last.firstIndex + last.count == range.firstIndex) && (last.baseVertex == range.baseVertex))
+			{
+				last.count += range.indexCount;
+				continue;
+			}
+		}
+
+		DRAW_ELEMENTS_INDIRECT_COMMAND& command = pCommands[commandCount++];
+		command.count = range.indexCount;
+		command.instanceCount = instanceCount;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = baseInstance;
+	}
+
+	return(commandCount);
+}
+
+///////////////////////////////////////////////////
+//	DrawSharedMeshesIndirect()
+//
+//	Draw a range of the indirect commands in the bound
+//  GL_DRAW_INDIRECT_BUFFER from the shared buffers,
+//  with a single multi-draw call.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawSharedMeshesIndirect(
+	GLintptr commandOffset,
+	GLsizei commandCount)
+{
+	GLStateCache::BindVertexArray(m_sharedVao);
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)commandOffset,
+		commandCount, sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND));
+
+	m_frameStats.drawCalls++;
+	m_frameStats.indirectCommands += commandCount;
+}
+
+///////////////////////////////////////////////////
+//	BeginFrameStats()
+//
+//	Keep the draw counters of the finished frame
+//  and reset the counters for the new one.
+///////////////////////////////////////////////////
+void ShapeMeshes::BeginFrameStats()
+{
+	m_lastFrameStats = m_frameStats;
+	m_frameStats.drawCalls = 0;
+	m_frameStats.indirectCommands = 0;
+}
+
+///////////////////////////////////////////////////
+//	CountMeshDrawCalls()
+//
+//	Count the draw calls that DrawMesh() and
+//  DrawMeshInstanced() issue for the shape - the
+//  index ranges of the selected parts of a capped
+//  shape are drawn with one multi-draw call.
+///////////////////////////////////////////////////
+unsigned int ShapeMeshes::CountMeshDrawCalls(int meshID, unsigned int parts, int lod) const
+{
+	unsigned int drawCalls = 0;
+	GLuint firstIndex[MAX_MESH_COMMANDS];
+	GLuint indexCount[MAX_MESH_COMMANDS];
+
+	switch (meshID)
+	{
+	case MESH_CONE:
+	case MESH_CYLINDER:
+	case MESH_TAPERED_CYLINDER:
+		drawCalls = (GetMeshIndexRanges(meshID, parts, lod, firstIndex, indexCount) > 0) ? 1 : 0;
+		break;
+	case MESH_BOX:
+	case MESH_PLANE:
+	case MESH_TILING_PLANE:
+	case MESH_PRISM:
+	case MESH_PYRAMID3:
+	case MESH_PYRAMID4:
+	case MESH_SPHERE:
+	case MESH_HALF_SPHERE:
+	case MESH_TORUS:
+	case MESH_HALF_TORUS:
+		drawCalls = 1;
+		break;
+	default:
+		break;
+	}
+
+	return(drawCalls);
+}
+
+///////////////////////////////////////////////////
+//	GetMeshBounds()
+//
+//	Get the local bounding box and bounding sphere of
+//  the shape that is identified by the passed in
+//  MeshID.  The half shapes use the bounds of their
+//  full shape.
+///////////////////////////////////////////////////
+const ShapeMeshes::MESH_BOUNDS& ShapeMeshes::GetMeshBounds(int meshID) const
+{
+	return(GetMesh(meshID).bounds);
+}
+
+///////////////////////////////////////////////////
+//	GetSharedCacheStats()
+//
+//	Get the vertex cache statistics of the shape that
+//  is identified by the passed in MeshID, as it was
+//  packed into the shared buffers.  The half shapes
+//  use the statistics of their full shape.
+///////////////////////////////////////////////////
+const ShapeMeshes::MESH_CACHE_STATS& ShapeMeshes::GetSharedCacheStats(int meshID) const
+{
+	if (meshID == MESH_HALF_SPHERE)
+	{
+		meshID = MESH_SPHERE;
+	}
+	else if (meshID == MESH_HALF_TORUS)
+	{
+		meshID = MESH_TORUS;
+	}
+	return(m_sharedCacheStats[((meshID >= 0) && (meshID < MESH_COUNT)) ? meshID : MESH_BOX]);
+}
+
+///////////////////////////////////////////////////
+//	GetVertexBufferInfo()
+//
+//	Get the layout and size of the vertex buffer of
+//  the shape that is identified by the passed in
+//  MeshID, together with the size the same vertices
+//  take in the float layout.
+///////////////////////////////////////////////////
+ShapeMeshes::VERTEX_BUFFER_INFO ShapeMeshes::GetVertexBufferInfo(int meshID) const
+{
+	const GLMesh& mesh = GetMesh(meshID);
+	VERTEX_BUFFER_INFO info;
+
+	info.format = mesh.format;
+	info.vertexCount = mesh.vertexBytes / GetVertexStride(mesh.format);
+	info.vertexBytes = mesh.vertexBytes;
+	info.floatVertexBytes = info.vertexCount * GetVertexStride(VERTEX_FORMAT_FLOAT);
+
+	return(info);
+}
+
+///////////////////////////////////////////////////
+//	GetVertexStride()
+//
+//	Get the number of bytes that one vertex takes in
+//  the passed in vertex layout.
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::GetVertexStride(VertexFormat format)
+{
+	if (format == VERTEX_FORMAT_COMPACT)
+	{
+		return(sizeof(COMPACT_VERTEX));
+	}
+	return(sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
+}
+
+///////////////////////////////////////////////////
+//	GetMesh()
+//
+//	Get the loaded mesh of the shape that is identified
+//  by the passed in MeshID, at the level of detail it
+//  is drawn with for the passed in one.  The half
+//  shapes use their full shape.
+///////////////////////////////////////////////////
+const ShapeMeshes::GLMesh& ShapeMeshes::GetMesh(int meshID, int lod) const
+{
+	lod = GetDrawnLod(meshID, lod);
+	if (lod > 0)
+	{
+		return(m_lodMeshes[GetFullMeshID(meshID)][lod - 1]);
+	}
+
+	switch (meshID)
+	{
+	case MESH_BOX:				return(m_BoxMesh);
+	case MESH_CONE:				return(m_ConeMesh);
+	case MESH_CYLINDER:			return(m_CylinderMesh);
+	case MESH_PLANE:			return(m_PlaneMesh);
+	case MESH_TILING_PLANE:		return(m_TilingPlaneMesh);
+	case MESH_PRISM:			return(m_PrismMesh);
+	case MESH_PYRAMID3:			return(m_Pyramid3Mesh);
+	case MESH_PYRAMID4:			return(m_Pyramid4Mesh);
+	case MESH_SPHERE:
+	case MESH_HALF_SPHERE:		return(m_SphereMesh);
+	case MESH_TAPERED_CYLINDER:	return(m_TaperedCylinderMesh);
+	case MESH_TORUS:
+	case MESH_HALF_TORUS:		return(m_TorusMesh);
+	default:					return(m_BoxMesh);
+	}
+}
+
+///////////////////////////////////////////////////
+//	ComputeMeshBounds()
+//
+//	Compute the local bounding box of the passed in
+//  interleaved vertex data, and the bounding sphere
+//  around the center of that box.
+///////////////////////////////////////////////////
+void ShapeMeshes::ComputeMeshBounds(GLMesh& mesh, const GLfloat* verts, size_t floatCount)
+{
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+	const GLuint vertexCount = (GLuint)(floatCount / floatsPerVertex);
+
+	if (vertexCount == 0)
+	{
+		return;
+	}
+
+	glm::vec3 boxMin(verts[0], verts[1], verts[2]);
+	glm::vec3 boxMax = boxMin;
+	for (GLuint i = 1; i < vertexCount; i++)
+	{
+		glm::vec3 position(verts[i * floatsPerVertex], verts[i * floatsPerVertex + 1], verts[i * floatsPerVertex + 2]);
+		boxMin = glm::min(boxMin, position);
+		boxMax = glm::max(boxMax, position);
+	}
+
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (GLuint i = 0; i < vertexCount; i++)
+	{
+		glm::vec3 position(verts[i * floatsPerVertex], verts[i * floatsPerVertex + 1], verts[i * floatsPerVertex + 2]);
+		glm::vec3 offset = position - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+
+	mesh.bounds.boxMin = boxMin;
+	mesh.bounds.boxMax = boxMax;
+	mesh.bounds.sphereCenter = center;
+	mesh.bounds.sphereRadius = std::sqrt(radiusSquared);
+}
+
+///////////////////////////////////////////////////
+//	UploadVertexData()
+//
+//	Compute the bounds of the passed in interleaved
+//  float vertex data and send it to the bound
+//  GL_ARRAY_BUFFER in the selected vertex layout.
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadVertexData(GLMesh& mesh, const GLfloat* verts, size_t floatCount)
+{
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+	const GLuint vertexCount = (GLuint)(floatCount / floatsPerVertex);
+
+	ComputeMeshBounds(mesh, verts, floatCount);
+
+	m_uploadData.clear();
+	PackVertices(m_vertexFormat, verts, vertexCount, mesh.bounds.boxMin, mesh.bounds.boxMax, m_uploadData);
+	glBufferData(GL_ARRAY_BUFFER, m_uploadData.size(), &m_uploadData[0], GL_STATIC_DRAW);
+
+	mesh.format = m_vertexFormat;
+	mesh.vertexBytes = vertexCount * GetVertexStride(m_vertexFormat);
+}
+
+///////////////////////////////////////////////////
+//	UploadCappedMesh()
+//
+//	Convert the bottom fan, the top fan and the sides
+//  strip of a capped shape, which follow each other
+//  in the passed in vertices, into one indexed
+//  triangle list.  The index range of every part is
+//  kept so that the parts can still be selected, and
+//  the triangles are reordered within their part.
+//  The vertices are copied, since the reordering
+//  changes them, and they and the indices reuse the
+//  memory of the last generated mesh.
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadCappedMesh(
+	GLMesh& mesh,
+	const GLfloat* verts,
+	size_t floatCount,
+	const GLuint partVertices[3])
+{
+	std::vector<GLfloat>& vertices = m_vertexData;
+	std::vector<GLuint>& indices = m_indexData;
+	GLuint rangeEnds[3];
+	vertices.assign(verts, verts + floatCount);
+	GLuint firstVertex = 0;
+
+	// every fan and strip of n vertices becomes n - 2 triangles
+	size_t indexCount = 0;
+	for (int part = SHARED_PART_BOTTOM; part <= SHARED_PART_SIDES; part++)
+	{
+		indexCount += (partVertices[part] > 2) ? 3 * (partVertices[part] - 2) : 0;
+	}
+	indices.clear();
+	indices.reserve(indexCount);
+
+	for (int part = SHARED_PART_BOTTOM; part <= SHARED_PART_SIDES; part++)
+	{
+		mesh.partFirst[part] = (GLuint)indices.size();
+		AppendTriangleList(indices, (part == SHARED_PART_SIDES) ? GL_TRIANGLE_STRIP : GL_TRIANGLE_FAN,
+			NULL, firstVertex, partVertices[part]);
+		mesh.partCount[part] = (GLuint)indices.size() - mesh.partFirst[part];
+		rangeEnds[part] = (GLuint)indices.size();
+		firstVertex += partVertices[part];
+	}
+
+	UploadIndexedMesh(mesh, vertices, indices, rangeEnds, 3);
+}
+
+///////////////////////////////////////////////////
+//	UploadIndexedMesh()
+//
+//	Reorder the passed in indexed triangle list for
+//  the vertex cache, keeping the triangles within
+//  their ranges, and send it and its vertices to the
+//  buffers of the mesh.
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadIndexedMesh(
+	GLMesh& mesh,
+	std::vector<GLfloat>& vertices,
+	std::vector<GLuint>& indices,
+	const GLuint* pRangeEnds,
+	size_t rangeCount)
+{
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+
+	OptimizeMesh(vertices, &indices[0], indices.size(), pRangeEnds, rangeCount);
+
+	mesh.nVertices = (GLuint)(vertices.size() / floatsPerVertex);
+	mesh.nIndices = (GLuint)indices.size();
+
+	GLStateCache::BindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
+	UploadVertexData(mesh, &vertices[0], vertices.size());
+
+	GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+}
+
+///////////////////////////////////////////////////
+//	LoadMeshLods()
+//
+//	Generate the coarser levels of detail of the shape
+//  that is identified by the passed in MeshID, up to
+//  lodCount levels including the loaded mesh.  Every
+//  level is an indexed triangle list in its own VAO,
+//  with the parts of a capped shape in the same order
+//  as its loaded mesh.  The levels that are already
+//  loaded are kept.
+///////////////////////////////////////////////////
+bool ShapeMeshes::LoadMeshLods(int meshID, int lodCount)
+{
+	if ((meshID != MESH_CONE) && (meshID != MESH_CYLINDER) && (meshID != MESH_TAPERED_CYLINDER) &&
+		(meshID != MESH_SPHERE) && (meshID != MESH_TORUS))
+	{
+		return(false);
+	}
+
+	lodCount = std::max(1, std::min(lodCount, (int)MAX_MESH_LODS));
+
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint>& indices = m_indexData;
+
+	for (int lod = m_lodCounts[meshID]; lod < lodCount; lod++)
+	{
+		GLMesh& mesh = m_lodMeshes[meshID][lod - 1];
+		MeshGenerator::MESH_SIZE size = GetLodMeshSize(meshID, lod);
+
+		vertices.resize(size.vertexCount * MeshGenerator::VERTEX_FLOATS);
+		indices.resize(size.indexCount);
+		GenerateLodMesh(meshID, lod, m_torusTubeRadius, &vertices[0], &indices[0]);
+
+		// the triangles stay within their part, and the half
+		// shapes draw the first half of their full shape
+		GLuint rangeEnds[3];
+		size_t rangeCount = 0;
+		GLuint firstIndex = 0;
+		for (int part = SHARED_PART_BOTTOM; part <= SHARED_PART_SIDES; part++)
+		{
+			mesh.partFirst[part] = firstIndex;
+			mesh.partCount[part] = (GLuint)size.partIndexCounts[part];
+			firstIndex += mesh.partCount[part];
+			rangeEnds[rangeCount++] = firstIndex;
+		}
+		if ((meshID == MESH_SPHERE) || (meshID == MESH_TORUS))
+		{
+			rangeCount = 0;
+			rangeEnds[rangeCount++] = (GLuint)(size.indexCount / 2) / 3 * 3;
+			rangeEnds[rangeCount++] = (GLuint)size.indexCount;
+		}
+
+		glGenVertexArrays(1, &mesh.vao);
+		GLStateCache::BindVertexArray(mesh.vao);
+
+		glGenBuffers(2, mesh.vbos);
+		UploadIndexedMesh(mesh, vertices, indices, rangeEnds, rangeCount);
+
+		SetShaderMemoryLayout(mesh.format, mesh.vbos[0], mesh.vertexBytes);
+		m_lodCounts[meshID] = lod + 1;
+	}
+
+	GLStateCache::BindVertexArray(0);
+	return(true);
+}
+
+///////////////////////////////////////////////////
+//	GetMeshLodCount()
+//
+//	Get the number of loaded levels of detail of the
+//  shape that is identified by the passed in MeshID,
+//  including the loaded mesh itself.
+///////////////////////////////////////////////////
+int ShapeMeshes::GetMeshLodCount(int meshID) const
+{
+	meshID = GetFullMeshID(meshID);
+	if ((meshID < 0) || (meshID >= MESH_COUNT))
+	{
+		return(1);
+	}
+	return(m_lodCounts[meshID]);
+}
+
+///////////////////////////////////////////////////
+//	GetDrawnLod()
+//
+//	Get the level of detail that the shape identified
+//  by the passed in MeshID is drawn with for the
+//  passed in one - a level that is not loaded uses
+//  the coarsest loaded level.
+///////////////////////////////////////////////////
+int ShapeMeshes::GetDrawnLod(int meshID, int lod) const
+{
+	return(std::max(0, std::min(lod, GetMeshLodCount(meshID) - 1)));
+}
+
+///////////////////////////////////////////////////
+//	GetMeshTriangleCount()
+//
+//	Count the triangles that are drawn for the
+//  selected parts of the shape identified by the
+//  passed in MeshID at the passed in level of
+//  detail.  The strips of LOD 0 count one triangle
+//  for every vertex after the first two.
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::GetMeshTriangleCount(int meshID, unsigned int parts, int lod) const
+{
+	GLuint firstIndex[MAX_MESH_COMMANDS];
+	GLuint indexCount[MAX_MESH_COMMANDS];
+	GLuint triangleCount = 0;
+
+	lod = GetDrawnLod(meshID, lod);
+	int rangeCount = GetMeshIndexRanges(meshID, parts, lod, firstIndex, indexCount);
+	if (rangeCount > 0)
+	{
+		for (int range = 0; range < rangeCount; range++)
+		{
+			triangleCount += indexCount[range] / 3;
+		}
+		return(triangleCount);
+	}
+
+	const GLMesh& mesh = GetMesh(meshID);
+	switch (meshID)
+	{
+	case MESH_BOX:
+	case MESH_PLANE:
+	case MESH_TILING_PLANE:
+	case MESH_SPHERE:
+		triangleCount = mesh.nIndices / 3;
+		break;
+	case MESH_HALF_SPHERE:
+		triangleCount = (mesh.nIndices / 2) / 3;
+		break;
+	case MESH_PRISM:
+	case MESH_PYRAMID3:
+	case MESH_PYRAMID4:
+		triangleCount = (mesh.nVertices > 2) ? (mesh.nVertices - 2) : 0;
+		break;
+	case MESH_TORUS:
+		triangleCount = mesh.nVertices / 3;
+		break;
+	case MESH_HALF_TORUS:
+		triangleCount = (mesh.nVertices / 2) / 3;
+		break;
+	default:
+		break;
+	}
+
+	return(triangleCount);
+}
+
+///////////////////////////////////////////////////
+//	GetMeshIndexRanges()
+//
+//	Merge the selected parts of the indexed shape that
+//  is identified by the passed in MeshID into index
+//  ranges.  The bottom, top and sides of a capped
+//  shape follow each other in the index buffer, so
+//  every selection but the bottom and sides without
+//  the top of a cylinder is drawn with one range.
+//  The generated levels of detail of the sphere and
+//  torus are one range, and their half shapes draw
+//  the first half of it.
+///////////////////////////////////////////////////
+int ShapeMeshes::GetMeshIndexRanges(
+	int meshID,
+	unsigned int parts,
+	int lod,
+	GLuint* pFirstIndex,
+	GLuint* pIndexCount) const
+{
+	lod = GetDrawnLod(meshID, lod);
+	const GLMesh& mesh = GetMesh(meshID, lod);
+
+	switch (meshID)
+	{
+	case MESH_CONE:
+	case MESH_CYLINDER:
+	case MESH_TAPERED_CYLINDER:
+		break;
+	case MESH_SPHERE:
+	case MESH_TORUS:
+		if (lod == 0)
+		{
+			return(0);
+		}
+		pFirstIndex[0] = 0;
+		pIndexCount[0] = mesh.nIndices;
+		return(1);
+	case MESH_HALF_SPHERE:
+	case MESH_HALF_TORUS:
+		if (lod == 0)
+		{
+			return(0);
+		}
+		pFirstIndex[0] = 0;
+		pIndexCount[0] = (mesh.nIndices / 2) / 3 * 3;
+		return(1);
+	default:
+		return(0);
+	}
+
+	bool bDrawParts[3];
+	SelectMeshParts(meshID, parts, bDrawParts);
+
+	int rangeCount = 0;
+	for (int part = SHARED_PART_BOTTOM; part <= SHARED_PART_SIDES; part++)
+	{
+		if ((bDrawParts[part] == false) || (mesh.partCount[part] == 0))
+		{
+			continue;
+		}
+
+		if ((rangeCount > 0) && (pFirstIndex[rangeCount - 1] + pIndexCount[rangeCount - 1] == mesh.partFirst[part]))
+		{
+			pIndexCount[rangeCount - 1] += mesh.partCount[part];
+			continue;
+		}
+
+		pFirstIndex[rangeCount] = mesh.partFirst[part];
+		pIndexCount[rangeCount] = mesh.partCount[part];
+		rangeCount++;
+	}
+
+	return(rangeCount);
+}
+
+///////////////////////////////////////////////////
+//	DrawMeshRanges()
+//
+//	Draw the selected parts of the indexed shape that
+//  is identified by the passed in MeshID from its
+//  index buffer, at the passed in level of detail.
+//  More than one index range is drawn with a single
+//  glMultiDrawElements() call.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawMeshRanges(int meshID, unsigned int parts, int lod)
+{
+	GLuint firstIndex[MAX_MESH_COMMANDS];
+	GLuint indexCount[MAX_MESH_COMMANDS];
+	int rangeCount = GetMeshIndexRanges(meshID, parts, lod, firstIndex, indexCount);
+	if (rangeCount == 0)
+	{
+		return;
+	}
+
+	GLStateCache::BindVertexArray(GetMesh(meshID, lod).vao);
+
+	if (rangeCount == 1)
+	{
+		glDrawElements(GL_TRIANGLES, indexCount[0], GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * firstIndex[0]));
+		return;
+	}
+
+	GLsizei counts[MAX_MESH_COMMANDS];
+	const void* offsets[MAX_MESH_COMMANDS];
+	for (int range = 0; range < rangeCount; range++)
+	{
+		counts[range] = (GLsizei)indexCount[range];
+		offsets[range] = (const void*)(sizeof(GLuint) * firstIndex[range]);
+	}
+	glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, rangeCount);
+}
+
+///////////////////////////////////////////////////
+//	OptimizeMesh()
+//
+//	Reorder the triangles of an indexed triangle list
+//  for the post-transform vertex cache and then its
+//  vertices in the order the triangles use them.  The
+//  copies of a vertex are merged first, and the
+//  vertices that no triangle uses are dropped.  The
+//  triangles never leave the range they are in.
+//  The scratch memory is kept in the optimizer and in
+//  the members, so reloading a mesh allocates nothing
+//  here.  Nothing is done when the optimization is
+//  turned off.
+///////////////////////////////////////////////////
+void ShapeMeshes::OptimizeMesh(
+	std::vector<GLfloat>& vertices,
+	GLuint* pIndices,
+	size_t indexCount,
+	const GLuint* pRangeEnds,
+	size_t rangeCount)
+{
+	if ((m_bOptimizeMeshes == false) || (indexCount == 0))
+	{
+		return;
+	}
+
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+	const size_t vertexCount = vertices.size() / floatsPerVertex;
+
+	m_meshOptimizer.WeldVertices(pIndices, indexCount, &vertices[0], floatsPerVertex, vertexCount);
+
+	GLuint rangeStart = 0;
+	for (size_t i = 0; i < rangeCount; i++)
+	{
+		m_meshOptimizer.OptimizeVertexCache(pIndices + rangeStart, pRangeEnds[i] - rangeStart, vertexCount);
+		m_meshOptimizer.OptimizeOverdraw(pIndices + rangeStart, pRangeEnds[i] - rangeStart,
+			&vertices[0], floatsPerVertex, vertexCount, g_OverdrawThreshold);
+		rangeStart = pRangeEnds[i];
+	}
+
+	m_vertexRemap.resize(vertexCount);
+	size_t usedCount = MeshOptimizer::OptimizeVertexFetch(pIndices, indexCount, vertexCount, &m_vertexRemap[0]);
+
+	// the vertices are put in their new order in the scratch copy,
+	// and copied back so that the passed in vector keeps its memory
+	m_reorderedVertices.resize(usedCount * floatsPerVertex);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (m_vertexRemap[v] != ~0u)
+		{
+			std::copy(vertices.begin() + v * floatsPerVertex, vertices.begin() + (v + 1) * floatsPerVertex,
+				m_reorderedVertices.begin() + m_vertexRemap[v] * floatsPerVertex);
+		}
+	}
+	vertices.assign(m_reorderedVertices.begin(), m_reorderedVertices.end());
+}
+
+///////////////////////////////////////////////////
+//	DestroyMeshes()
+//
+//	Delete the VAOs and buffers of every loaded mesh
+//  and of the shared buffers.  The meshes can be
+//  loaded again afterwards.
+///////////////////////////////////////////////////
+void ShapeMeshes::DestroyMeshes()
+{
+	GLMesh* meshes[] = {
+		&m_BoxMesh, &m_ConeMesh, &m_CylinderMesh, &m_PlaneMesh,
+		&m_TilingPlaneMesh, &m_PrismMesh, &m_Pyramid3Mesh, &m_Pyramid4Mesh,
+		&m_SphereMesh, &m_TaperedCylinderMesh, &m_TorusMesh };
+
+	for (size_t i = 0; i < sizeof(meshes) / sizeof(meshes[0]); i++)
+	{
+		if (meshes[i]->vao == 0)
+		{
+			continue;
+		}
+
+		GLStateCache::DeleteVertexArrays(1, &meshes[i]->vao);
+		GLStateCache::DeleteBuffers(2, meshes[i]->vbos);
+		meshes[i]->vao = 0;
+		meshes[i]->vbos[0] = 0;
+		meshes[i]->vbos[1] = 0;
+		meshes[i]->vertexBytes = 0;
+	}
+
+	for (int meshID = 0; meshID < MESH_COUNT; meshID++)
+	{
+		for (int lod = 1; lod < m_lodCounts[meshID]; lod++)
+		{
+			GLMesh& mesh = m_lodMeshes[meshID][lod - 1];
+			GLStateCache::DeleteVertexArrays(1, &mesh.vao);
+			GLStateCache::DeleteBuffers(2, mesh.vbos);
+			mesh.vao = 0;
+			mesh.vbos[0] = 0;
+			mesh.vbos[1] = 0;
+			mesh.vertexBytes = 0;
+		}
+		m_lodCounts[meshID] = 1;
+	}
+
+	if (m_sharedVao != 0)
+	{
+		GLStateCache::DeleteVertexArrays(1, &m_sharedVao);
+		GLStateCache::DeleteBuffers(2, m_sharedVbos);
+		m_sharedVao = 0;
+		m_sharedVbos[0] = 0;
+		m_sharedVbos[1] = 0;
+		m_sharedVertexBytes = 0;
+		memset(m_sharedRanges, 0, sizeof(m_sharedRanges));
+	}
+
+	if (m_rangeCommandBuffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_rangeCommandBuffer);
+		m_rangeCommandBuffer = 0;
+	}
+
+	m_instanceBuffer = 0;
+}
+
+glm::vec3 ShapeMeshes::CalculateTriangleNormal(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+{
+	glm::vec3 Normal(0, 0, 0);
+	float v1x = p1.x - p0.x;
+	float v1y = p1.y - p0.y;
+	float v1z = p1.z - p0.z;
+	float v2x = p2.x - p1.x;
+	float v2y = p2.y - p1.y;
+	float v2z = p2.z - p1.z;
+	Normal.x = v1y * v2z - v1z * v2y;
+	Normal.y = v1z * v2x - v1x * v2z;
+	Normal.y = v1x * v2y - v1y * v2x;
+	float len = (float)sqrt(Normal.x * Normal.x + Normal.y * Normal.y + Normal.z * Normal.z);
+	if (len == 0)
+	{
+		//throw Exception();
+	}
+	else
+	{
+		Normal.x /= len;
+		Normal.y /= len;
+		Normal.z /= len;
+	}
+	return Normal;
+}
+
+
+
+void ShapeMeshes::SetShaderMemoryLayout(VertexFormat format, GLuint vertexBuffer, GLuint vertexBytes)
+{
+	// The following code defines the layout of the mesh data in memory - each mesh needs
+	// to have the same memory layout so that the data is retrieved properly by the shaders
+
+	if (format == VERTEX_FORMAT_COMPACT)
+	{
+		// the positions are normalized to fractions of the bounding box, the normals
+		// to -1..1, and the half floats are converted to floats by the vertex fetch
+		GLint stride = sizeof(COMPACT_VERTEX);
+
+		glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(COMPACT_VERTEX, position));
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(COMPACT_VERTEX, normal));
+		glEnableVertexAttribArray(1);
+
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(COMPACT_VERTEX, uv));
+		glEnableVertexAttribArray(2);
+	}
+	else
+	{
+		// Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
+		GLint stride = sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV);// The number of floats before each
+
+		// Create Vertex Attribute Pointers
+		glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+		glEnableVertexAttribArray(0);
+
+		glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * g_FloatsPerVertex));
+		glEnableVertexAttribArray(1);
+
+		glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal)));
+		glEnableVertexAttribArray(2);
+	}
+
+	// the scale and offset that dequantize the positions follow the vertices - the
+	// binding has a stride of 0, so they are the same for every vertex of the buffer
+	// and every draw path picks them up from the VAO
+	glBindVertexBuffer(g_PositionDequantizeBinding, vertexBuffer, vertexBytes, 0);
+
+	glVertexAttribFormat(g_PositionScaleLocation, 3, GL_FLOAT, GL_FALSE, offsetof(POSITION_DEQUANTIZE, scale));
+	glVertexAttribBinding(g_PositionScaleLocation, g_PositionDequantizeBinding);
+	glEnableVertexAttribArray(g_PositionScaleLocation);
+
+	glVertexAttribFormat(g_PositionOffsetLocation, 3, GL_FLOAT, GL_FALSE, offsetof(POSITION_DEQUANTIZE, offset));
+	glVertexAttribBinding(g_PositionOffsetLocation, g_PositionDequantizeBinding);
+	glEnableVertexAttribArray(g_PositionOffsetLocation);
+}
+
+void ShapeMeshes::SetInstanceMemoryLayout()
+{
+	// The per-instance data is one INSTANCE_DATA per instance - the model matrix
+	// takes four vec4 attribute slots, one per column, the normal matrix three
+	// vec3 slots, followed by the color and the texture layers
+	GLint stride = sizeof(INSTANCE_DATA);
+
+	for (GLuint column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(g_InstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(glm::vec4) * column));
+		glEnableVertexAttribArray(g_InstanceModelLocation + column);
+		glVertexAttribDivisor(g_InstanceModelLocation + column, 1);
+	}
+
+	for (GLuint column = 0; column < 3; column++)
+	{
+		glVertexAttribPointer(g_InstanceNormalLocation + column, 3, GL_FLOAT, GL_FALSE, stride,
+			(void*)(offsetof(INSTANCE_DATA, normal) + sizeof(glm::vec3) * column));
+		glEnableVertexAttribArray(g_InstanceNormalLocation + column);
+		glVertexAttribDivisor(g_InstanceNormalLocation + column, 1);
+	}
 
-	glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * g_FloatsPerVertex));
-	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(g_InstanceColorLocation, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(INSTANCE_DATA, color));
+	glEnableVertexAttribArray(g_InstanceColorLocation);
+	glVertexAttribDivisor(g_InstanceColorLocation, 1);
 
-	glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal)));
-	glEnableVertexAttribArray(2);
+	// the texture layers are integers, so they are not converted to floats
+	glVertexAttribIPointer(g_InstanceTextureLayersLocation, 2, GL_INT, stride, (void*)offsetof(INSTANCE_DATA, textureLayers));
+	glEnableVertexAttribArray(g_InstanceTextureLayersLocation);
+	glVertexAttribDivisor(g_InstanceTextureLayersLocation, 1);
 }
\ No newline at end of file
@@ -10,10 +10,14 @@
 
 #pragma once
 
+#include "MeshOptimizer.h"
+
 #include <GL/glew.h>
 
 #include <glm/glm.hpp>
 
+#include <vector>
+
 /***********************************************************
  *  ShapeMeshes
  *
@@ -26,6 +30,114 @@ public:
 	// constructor
 	ShapeMeshes();
 
+	// identifiers for the available 3D shapes, for callers that
+	// keep the mesh to draw as data rather than as a draw function
+	enum MeshID
+	{
+		MESH_BOX,
+		MESH_CONE,
+		MESH_CYLINDER,
+		MESH_PLANE,
+		MESH_TILING_PLANE,
+		MESH_PRISM,
+		MESH_PYRAMID3,
+		MESH_PYRAMID4,
+		MESH_SPHERE,
+		MESH_HALF_SPHERE,
+		MESH_TAPERED_CYLINDER,
+		MESH_TORUS,
+		MESH_HALF_TORUS,
+		MESH_COUNT
+	};
+
+	// parts of the capped shapes (cone, cylinder, tapered cylinder)
+	// that can be selected when drawing them
+	enum MeshPart
+	{
+		PART_TOP = 1,
+		PART_BOTTOM = 2,
+		PART_SIDES = 4,
+		PART_ALL = PART_TOP | PART_BOTTOM | PART_SIDES
+	};
+
+	// per-instance data read by the instanced vertex shader path -
+	// the model matrix uses attribute locations 3 to 6, the color
+	// uses location 7, the texture and overlay texture array
+	// layers use location 8 and the normal matrix uses locations
+	// 11 to 13
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::mat3 normal;
+		glm::vec4 color;
+		glm::ivec2 textureLayers;
+	};
+
+	// layouts of the vertex buffers - the float layout keeps every
+	// value in 32 bits, the compact layout stores the positions as
+	// 16-bit fractions of the mesh bounding box, the normals as
+	// 10-bit values and the texture coordinates as half floats
+	enum VertexFormat
+	{
+		VERTEX_FORMAT_FLOAT,    // 32 bytes per vertex
+		VERTEX_FORMAT_COMPACT   // 16 bytes per vertex
+	};
+
+	// size of the vertex buffer of a loaded mesh, and what it
+	// would take in the float layout
+	struct VERTEX_BUFFER_INFO
+	{
+		VertexFormat format;
+		GLuint vertexCount;
+		GLuint vertexBytes;
+		GLuint floatVertexBytes;
+	};
+
+	// post-transform vertex cache statistics of a shape before and
+	// after the triangles and vertices were reordered
+	struct MESH_CACHE_STATS
+	{
+		MeshOptimizer::CACHE_STATS before;
+		MeshOptimizer::CACHE_STATS after;
+	};
+
+	// bounding volumes of a shape in its local space
+	struct MESH_BOUNDS
+	{
+		glm::vec3 boxMin;
+		glm::vec3 boxMax;
+		glm::vec3 sphereCenter;
+		float sphereRadius;
+	};
+
+	// one command of a multi-draw indirect call, in the layout
+	// that OpenGL reads from the indirect buffer
+	struct DRAW_ELEMENTS_INDIRECT_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// most indirect commands that drawing one shape can take,
+	// one for each of the bottom, top and sides
+	static const int MAX_MESH_COMMANDS = 3;
+
+	// most levels of detail of a shape - LOD 0 is the mesh that
+	// the Load*Mesh() methods load, the coarser ones are generated
+	static const int MAX_MESH_LODS = 4;
+
+	// counters of the draws issued through DrawMesh(),
+	// DrawMeshInstanced() and DrawSharedMeshesIndirect(),
+	// gathered over one frame
+	struct DRAW_STATS
+	{
+		unsigned int drawCalls;           // glDraw* and glMultiDraw* calls
+		unsigned int indirectCommands;    // commands read by the multi-draw calls
+	};
+
 private:
 
 	// stores the GL data relative to a given mesh
@@ -35,6 +147,11 @@ private:
 		GLuint vbos[2];     // Handles for the vertex buffer objects
 		GLuint nVertices;	// Number of vertices for the mesh
 		GLuint nIndices;    // Number of indices for the mesh
+		MESH_BOUNDS bounds; // Local bounding volumes of the mesh
+		VertexFormat format; // Layout of the vertex buffer
+		GLuint vertexBytes; // Size of the vertices in the vertex buffer
+		GLuint partFirst[3]; // First index of the bottom, top and sides of a capped shape
+		GLuint partCount[3]; // Index count of the bottom, top and sides of a capped shape
 	};
 
 	// the available 3D shapes
@@ -50,9 +167,77 @@ private:
 	GLMesh m_TaperedCylinderMesh;
 	GLMesh m_TorusMesh;
 
+	// the generated levels of detail from LOD 1 on, by MeshID, and
+	// how many levels of every shape are loaded including LOD 0
+	GLMesh m_lodMeshes[MESH_COUNT][MAX_MESH_LODS - 1];
+	int m_lodCounts[MESH_COUNT];
+	// tube radius of the loaded torus, which its levels of detail keep
+	float m_torusTubeRadius;
+
 	bool m_bMemoryLayoutDone;
 
+	// layout of the meshes that are loaded from now on and of
+	// the shared buffers
+	VertexFormat m_vertexFormat;
+	// the vertex data of the last upload, kept to reuse its memory
+	std::vector<unsigned char> m_uploadData;
+	// the vertices and indices of the last generated indexed
+	// mesh, kept to reuse their memory
+	std::vector<GLfloat> m_vertexData;
+	std::vector<GLuint> m_indexData;
+	// reorders the indexed meshes, keeping its scratch memory
+	// between the meshes
+	MeshOptimizer m_meshOptimizer;
+	// new position of every vertex and the reordered vertices of
+	// the last optimized mesh
+	std::vector<GLuint> m_vertexRemap;
+	std::vector<GLfloat> m_reorderedVertices;
+	// reorder the triangles and vertices of the indexed meshes
+	// and of the shared buffers
+	bool m_bOptimizeMeshes;
+
+	// index range of one shape, or one part of a capped shape,
+	// in the shared buffers
+	struct SHARED_RANGE
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+	};
+
+	// every loaded mesh packed into one vertex buffer and one
+	// index buffer of triangle lists, behind a single VAO
+	GLuint m_sharedVao;
+	GLuint m_sharedVbos[2];
+	GLuint m_sharedVertexBytes;
+	// ranges of the shapes in the shared buffers, by MeshID, level
+	// of detail and part - the shapes without parts only use the
+	// sides entry
+	SHARED_RANGE m_sharedRanges[MESH_COUNT][MAX_MESH_LODS][3];
+	// vertex cache statistics of the shapes in the shared buffers
+	MESH_CACHE_STATS m_sharedCacheStats[MESH_COUNT];
+
+	// buffer that the per-instance attributes of the VAOs are
+	// read from, 0 until AttachInstanceBuffer() is called
+	GLuint m_instanceBuffer;
+	// indirect buffer for the instanced draws of the capped shapes
+	// whose parts take more than one index range, created on use
+	GLuint m_rangeCommandBuffer;
+
+	// draw counters of the current and of the last completed frame
+	DRAW_STATS m_frameStats;
+	DRAW_STATS m_lastFrameStats;
+
 public:
+	// choose the vertex layout of the meshes that are loaded from
+	// now on and of the shared buffers
+	void SetVertexFormat(VertexFormat format) { m_vertexFormat = format; }
+	VertexFormat GetVertexFormat() const { return m_vertexFormat; }
+	// choose whether the meshes that are loaded from now on and the
+	// shared buffers are reordered for the vertex cache
+	void SetOptimizeMeshes(bool bOptimize) { m_bOptimizeMeshes = bOptimize; }
+	bool GetOptimizeMeshes() const { return m_bOptimizeMeshes; }
+
 	// methods for loading the shape mesh data 
 	// into memory
 	void LoadBoxMesh();
@@ -67,6 +252,18 @@ public:
 	void LoadTaperedCylinderMesh();
 	void LoadTorusMesh(float thickness = 0.2);
 
+	// generate the levels of detail 1 to lodCount - 1 of the shape
+	// with the given MeshID, each with about half the triangles of
+	// the one before - call after the shape itself is loaded.
+	// Returns false for the shapes that have no generator
+	bool LoadMeshLods(int meshID, int lodCount);
+	// number of loaded levels of detail of the shape with the given
+	// MeshID, including LOD 0
+	int GetMeshLodCount(int meshID) const;
+	// number of triangles that DrawMesh() draws for the selected
+	// parts of the shape with the given MeshID
+	GLuint GetMeshTriangleCount(int meshID, unsigned int parts, int lod) const;
+
 	// methods for drawing the shape mesh in the
 	// display window
 	void DrawBoxMesh();
@@ -90,6 +287,74 @@ public:
 	void DrawTorusMesh();
 	void DrawHalfTorusMesh();
 
+	// draw the shape with the given MeshID - parts is a mask of
+	// MeshPart values and is only used by the capped shapes.  A
+	// level of detail that is not loaded draws the coarsest one
+	void DrawMesh(int meshID, unsigned int parts = PART_ALL, int lod = 0);
+
+	// draw instanceCount instances of the shape with the given MeshID,
+	// reading INSTANCE_DATA from the attached instance buffer starting
+	// at baseInstance
+	void DrawMeshInstanced(
+		int meshID,
+		unsigned int parts,
+		GLsizei instanceCount,
+		GLuint baseInstance,
+		int lod = 0);
+
+	// add the per-instance attributes of the passed in buffer to the
+	// VAOs of all loaded meshes - call after the meshes are loaded
+	void AttachInstanceBuffer(GLuint instanceBuffer);
+	// buffer passed to the last AttachInstanceBuffer() call
+	GLuint GetInstanceBuffer() const { return m_instanceBuffer; }
+
+	// pack all loaded meshes into the shared buffers, converting
+	// the strips and fans to triangle lists - call after the meshes
+	// are loaded and before AttachInstanceBuffer()
+	bool BuildSharedMeshBuffer();
+	bool HasSharedMeshBuffer() const { return m_sharedVao != 0; }
+
+	// delete the VAOs and buffers of all loaded meshes and of the
+	// shared buffers
+	void DestroyMeshes();
+
+	// get the local bounding volumes of the shape with the given MeshID,
+	// computed when the mesh was loaded
+	const MESH_BOUNDS& GetMeshBounds(int meshID) const;
+
+	// get the size of the vertex buffer of the shape with the given
+	// MeshID, and of the vertices in the shared buffer
+	VERTEX_BUFFER_INFO GetVertexBufferInfo(int meshID) const;
+	GLuint GetSharedVertexBytes() const { return m_sharedVertexBytes; }
+	// get the vertex cache statistics of the shape with the given MeshID
+	// in the shared buffers, from before and after it was reordered
+	const MESH_CACHE_STATS& GetSharedCacheStats(int meshID) const;
+	// bytes that one vertex takes in the given layout
+	static GLuint GetVertexStride(VertexFormat format);
+
+	// fill in the indirect commands that draw the shape with the given
+	// MeshID from the shared buffers - returns the number of commands,
+	// at most MAX_MESH_COMMANDS
+	int GetMeshDrawCommands(
+		int meshID,
+		unsigned int parts,
+		GLuint instanceCount,
+		GLuint baseInstance,
+		DRAW_ELEMENTS_INDIRECT_COMMAND* pCommands,
+		int lod = 0) const;
+
+	// issue commandCount indirect commands from the shared buffers,
+	// read from the bound GL_DRAW_INDIRECT_BUFFER at commandOffset
+	void DrawSharedMeshesIndirect(
+		GLintptr commandOffset,
+		GLsizei commandCount);
+
+	// called once at the start of every frame - the counters of the
+	// frame that just ended are kept for GetLastFrameStats()
+	void BeginFrameStats();
+	// draw counters of the last completed frame
+	DRAW_STATS GetLastFrameStats() const { return m_lastFrameStats; }
+
 
 private:
 
@@ -98,7 +363,78 @@ private:
 	glm::vec3 CalculateTriangleNormal(
 		glm::vec3 px, glm::vec3 py, glm::vec3 pz);
 
+	// called to compute the bounding volumes
+	// of the loaded vertex data
+	void ComputeMeshBounds(GLMesh& mesh, const GLfloat* verts, size_t floatCount);
+
+	// called to send the interleaved float vertex data
+	// to the bound GL_ARRAY_BUFFER in the selected layout
+	void UploadVertexData(GLMesh& mesh, const GLfloat* verts, size_t floatCount);
+
+	// called to reorder an indexed triangle list and its
+	// vertices for the vertex cache and the vertex fetch -
+	// the triangles stay within the ranges that end at
+	// the passed in indices
+	void OptimizeMesh(
+		std::vector<GLfloat>& vertices,
+		GLuint* pIndices,
+		size_t indexCount,
+		const GLuint* pRangeEnds,
+		size_t rangeCount);
+
+	// called to convert the bottom and top fans and the sides
+	// strip of a capped shape into one indexed triangle list,
+	// and send it and the vertices to the buffers of the mesh
+	void UploadCappedMesh(
+		GLMesh& mesh,
+		const GLfloat* verts,
+		size_t floatCount,
+		const GLuint partVertices[3]);
+
+	// called to reorder an indexed triangle list and send it
+	// and its vertices to the buffers of the mesh
+	void UploadIndexedMesh(
+		GLMesh& mesh,
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		const GLuint* pRangeEnds,
+		size_t rangeCount);
+
+	// called to get the index ranges that draw the selected
+	// parts of an indexed shape, merging the parts that follow
+	// each other - returns the number of ranges, at most
+	// MAX_MESH_COMMANDS, or 0 for the shapes that the
+	// Draw*Mesh() methods draw whole
+	int GetMeshIndexRanges(
+		int meshID,
+		unsigned int parts,
+		int lod,
+		GLuint* pFirstIndex,
+		GLuint* pIndexCount) const;
+
+	// called to draw the selected parts of an indexed shape
+	// from its index ranges with one draw call
+	void DrawMeshRanges(int meshID, unsigned int parts, int lod);
+
+	// the loaded level of detail of the shape with the given
+	// MeshID that a requested one is drawn with
+	int GetDrawnLod(int meshID, int lod) const;
+
+	// the loaded mesh of the shape with the given MeshID -
+	// the half shapes use their full shape
+	const GLMesh& GetMesh(int meshID, int lod = 0) const;
+
+	// number of draw calls that drawing the selected
+	// parts of the shape with the given MeshID takes
+	unsigned int CountMeshDrawCalls(int meshID, unsigned int parts, int lod) const;
+
 	// called to set the memory layout 
-	// template for shader data
-	void SetShaderMemoryLayout();
+	// template for shader data - the position
+	// scale and offset of the vertex buffer
+	// follow its vertices
+	void SetShaderMemoryLayout(VertexFormat format, GLuint vertexBuffer, GLuint vertexBytes);
+
+	// called to set the memory layout of the
+	// per-instance data for shader
+	void SetInstanceMemoryLayout();
 };
\ No newline at end of file
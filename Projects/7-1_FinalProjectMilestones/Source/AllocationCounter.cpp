@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// allocationcounter.cpp
+// ============
+// count the allocations that are made through the global operator new
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// declaration of global variables
+namespace
+{
+	// allocations made through operator new - the texture loader
+	// threads allocate as well, so the count is atomic
+	std::atomic<unsigned long long> g_allocationCount(0);
+}
+
+/***********************************************************
+ *  operator new()
+ *
+ *  The replacement of the global operator new, which counts
+ *  every allocation.  The array and nothrow forms of the
+ *  standard library call this one.  It stays in every build,
+ *  since the benchmarks run from the same program, and the
+ *  count only costs one relaxed atomic add per allocation.
+ ***********************************************************/
+void* operator new(std::size_t size)
+{
+	g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* pMemory = std::malloc((size > 0) ? size : 1);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+
+/***********************************************************
+ *  operator delete()
+ *
+ *  The replacement of the global operator delete, which
+ *  frees the memory of the replaced operator new.
+ ***********************************************************/
+void operator delete(void* pMemory) noexcept
+{
+	std::free(pMemory);
+}
+
+/***********************************************************
+ *  operator delete()
+ *
+ *  The replacement of the sized global operator delete, which
+ *  the compiler calls when it knows the size of the freed
+ *  object.  It is replaced together with the unsized one, so
+ *  both forms visibly free the memory with std::free().
+ ***********************************************************/
+void operator delete(void* pMemory, std::size_t) noexcept
+{
+	std::free(pMemory);
+}
+
+/***********************************************************
+ *  GetCount()
+ *
+ *  This method is used for getting the number of
+ *  allocations made so far.
+ ***********************************************************/
+unsigned long long AllocationCounter::GetCount()
+{
+	return(g_allocationCount.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,26 @@
+///////////////////////////////////////////////////////////////////////////////
+// allocationcounter.h
+// ============
+// count the allocations that are made through the global operator new
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  AllocationCounter
+ *
+ *  This class contains the code for reading how many
+ *  allocations the program made so far.  The global
+ *  operator new is replaced to count them, so the
+ *  benchmarks can check how often a piece of code
+ *  allocates by reading the count before and after it.
+ *  The count includes the allocations of every thread.
+ ***********************************************************/
+class AllocationCounter
+{
+public:
+	// number of allocations made through operator new since the
+	// program started
+	static unsigned long long GetCount();
+};
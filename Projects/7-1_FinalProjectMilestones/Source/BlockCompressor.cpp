@@ -0,0 +1,1034 @@
+///////////////////////////////////////////////////////////////////////////////
+// blockcompressor.cpp
+// ============
+// encode texture images into BC1, BC3 and BC7 compressed blocks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// SSE2 is always there on x64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define BLOCK_COMPRESSOR_SSE
+#endif
+
+// declaration of global variables
+namespace
+{
+	// interpolation weights of the 16 BC7 indices, out of 64
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	// fraction of the second endpoint that each BC1 index selects
+	const float BC1_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	// least squares passes of QUALITY_HIGH
+	const int REFINE_ITERATIONS = 2;
+
+	// index of the palette entry closest to every pixel of the
+	// block, over the first channelCount channels - ties go to the
+	// lower index - returns the summed squared error
+	unsigned int MatchPalette(
+		const unsigned char pixels[16][4],
+		const int palette[16][4],
+		int paletteSize,
+		int channelCount,
+		unsigned char indices[16])
+	{
+		unsigned int totalError = 0;
+
+#if defined(BLOCK_COMPRESSOR_SSE)
+		// four palette entries per register - the squared errors of
+		// bytes are exact in single precision
+		if ((paletteSize % 4) == 0)
+		{
+			__m128 paletteChannels[4][4];
+			__m128 paletteIndices[4];
+			for (int group = 0; group < paletteSize / 4; group++)
+			{
+				const int first = group * 4;
+				for (int c = 0; c < channelCount; c++)
+				{
+					paletteChannels[group][c] = _mm_setr_ps(
+						(float)palette[first][c], (float)palette[first + 1][c],
+						(float)palette[first + 2][c], (float)palette[first + 3][c]);
+				}
+				paletteIndices[group] = _mm_setr_ps(
+					(float)first, (float)(first + 1), (float)(first + 2), (float)(first + 3));
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				__m128 bestError = _mm_set1_ps(std::numeric_limits<float>::max());
+				__m128 bestIndex = _mm_setzero_ps();
+				for (int group = 0; group < paletteSize / 4; group++)
+				{
+					__m128 error = _mm_setzero_ps();
+					for (int c = 0; c < channelCount; c++)
+					{
+						__m128 difference = _mm_sub_ps(paletteChannels[group][c], _mm_set1_ps((float)pixels[i][c]));
+						error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+					}
+					__m128 better = _mm_cmplt_ps(error, bestError);
+					bestError = _mm_or_ps(_mm_and_ps(better, error), _mm_andnot_ps(better, bestError));
+					bestIndex = _mm_or_ps(_mm_and_ps(better, paletteIndices[group]), _mm_andnot_ps(better, bestIndex));
+				}
+
+				float laneErrors[4];
+				float laneIndices[4];
+				_mm_storeu_ps(laneErrors, bestError);
+				_mm_storeu_ps(laneIndices, bestIndex);
+				int bestLane = 0;
+				for (int lane = 1; lane < 4; lane++)
+				{
+					if ((laneErrors[lane] < laneErrors[bestLane]) ||
+						((laneErrors[lane] == laneErrors[bestLane]) && (laneIndices[lane] < laneIndices[bestLane])))
+					{
+						bestLane = lane;
+					}
+				}
+				indices[i] = (unsigned char)laneIndices[bestLane];
+				totalError += (unsigned int)laneErrors[bestLane];
+			}
+			return(totalError);
+		}
+#endif
+
+		for (int i = 0; i < 16; i++)
+		{
+			unsigned int bestError = std::numeric_limits<unsigned int>::max();
+			for (int entry = 0; entry < paletteSize; entry++)
+			{
+				unsigned int error = 0;
+				for (int c = 0; c < channelCount; c++)
+				{
+					int difference = palette[entry][c] - (int)pixels[i][c];
+					error += (unsigned int)(difference * difference);
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					indices[i] = (unsigned char)entry;
+				}
+			}
+			totalError += bestError;
+		}
+		return(totalError);
+	}
+
+	// per-channel minimum and maximum of the block colors
+	void ComputeBoundingBox(
+		const unsigned char pixels[16][4],
+		int channelCount,
+		float minimum[4],
+		float maximum[4])
+	{
+		for (int c = 0; c < channelCount; c++)
+		{
+			minimum[c] = 255.0f;
+			maximum[c] = 0.0f;
+			for (int i = 0; i < 16; i++)
+			{
+				minimum[c] = std::min(minimum[c], (float)pixels[i][c]);
+				maximum[c] = std::max(maximum[c], (float)pixels[i][c]);
+			}
+		}
+	}
+
+	// endpoints at the extremes of the block colors along their
+	// principal axis, which is found by power iteration on the
+	// covariance matrix
+	void ComputePrincipalEndpoints(
+		const unsigned char pixels[16][4],
+		int channelCount,
+		float endpoint0[4],
+		float endpoint1[4])
+	{
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < channelCount; c++)
+			{
+				mean[c] += (float)pixels[i][c] / 16.0f;
+			}
+		}
+
+		float covariance[4][4];
+		memset(covariance, 0, sizeof(covariance));
+		for (int i = 0; i < 16; i++)
+		{
+			float offset[4];
+			for (int c = 0; c < channelCount; c++)
+			{
+				offset[c] = (float)pixels[i][c] - mean[c];
+			}
+			for (int row = 0; row < channelCount; row++)
+			{
+				for (int column = 0; column < channelCount; column++)
+				{
+					covariance[row][column] += offset[row] * offset[column];
+				}
+			}
+		}
+
+		// start along the bounding box diagonal, which is usually
+		// close to the principal axis already
+		float minimum[4];
+		float maximum[4];
+		ComputeBoundingBox(pixels, channelCount, minimum, maximum);
+		float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int c = 0; c < channelCount; c++)
+		{
+			axis[c] = maximum[c] - minimum[c];
+		}
+
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float length = 0.0f;
+			for (int row = 0; row < channelCount; row++)
+			{
+				for (int column = 0; column < channelCount; column++)
+				{
+					next[row] += covariance[row][column] * axis[column];
+				}
+				length = std::max(length, std::fabs(next[row]));
+			}
+			if (length <= 0.0f)
+			{
+				break;
+			}
+			for (int c = 0; c < channelCount; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float axisLength = 0.0f;
+		for (int c = 0; c < channelCount; c++)
+		{
+			axisLength += axis[c] * axis[c];
+		}
+
+		float minProjection = 0.0f;
+		float maxProjection = 0.0f;
+		if (axisLength > 0.0f)
+		{
+			for (int c = 0; c < channelCount; c++)
+			{
+				axis[c] /= std::sqrt(axisLength);
+			}
+			for (int i = 0; i < 16; i++)
+			{
+				float projection = 0.0f;
+				for (int c = 0; c < channelCount; c++)
+				{
+					projection += ((float)pixels[i][c] - mean[c]) * axis[c];
+				}
+				minProjection = std::min(minProjection, projection);
+				maxProjection = std::max(maxProjection, projection);
+			}
+		}
+
+		for (int c = 0; c < channelCount; c++)
+		{
+			endpoint0[c] = std::min(std::max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f);
+			endpoint1[c] = std::min(std::max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f);
+		}
+	}
+
+	// endpoints that minimize the squared error of the block for
+	// the chosen indices, where weights[] is the fraction of
+	// endpoint1 that every index selects - returns false if the
+	// indices do not determine two endpoints
+	bool SolveEndpoints(
+		const unsigned char pixels[16][4],
+		const unsigned char indices[16],
+		const float* weights,
+		int channelCount,
+		float endpoint0[4],
+		float endpoint1[4])
+	{
+		float a00 = 0.0f;
+		float a01 = 0.0f;
+		float a11 = 0.0f;
+		float b0[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float b1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			float weight = weights[indices[i]];
+			float inverse = 1.0f - weight;
+			a00 += inverse * inverse;
+			a01 += inverse * weight;
+			a11 += weight * weight;
+			for (int c = 0; c < channelCount; c++)
+			{
+				b0[c] += inverse * (float)pixels[i][c];
+				b1[c] += weight * (float)pixels[i][c];
+			}
+		}
+
+		float determinant = a00 * a11 - a01 * a01;
+		if (std::fabs(determinant) < 1e-6f)
+		{
+			return(false);
+		}
+
+		for (int c = 0; c < channelCount; c++)
+		{
+			endpoint0[c] = std::min(std::max((a11 * b0[c] - a01 * b1[c]) / determinant, 0.0f), 255.0f);
+			endpoint1[c] = std::min(std::max((a00 * b1[c] - a01 * b0[c]) / determinant, 0.0f), 255.0f);
+		}
+		return(true);
+	}
+
+	// quantize a color to RGB565 and expand it back to 8 bits
+	unsigned short PackRGB565(const float color[4])
+	{
+		int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return((unsigned short)((r << 11) | (g << 5) | b));
+	}
+
+	void UnpackRGB565(unsigned short packed, int color[4])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+		color[3] = 255;
+	}
+
+	// quantize the endpoints and write the BC1 block of the block
+	// colors, always in the four color mode - returns the error
+	unsigned int WriteBC1Block(
+		const unsigned char pixels[16][4],
+		const float endpoint0[4],
+		const float endpoint1[4],
+		unsigned char* pBlock,
+		unsigned char indices[16])
+	{
+		unsigned short color0 = PackRGB565(endpoint0);
+		unsigned short color1 = PackRGB565(endpoint1);
+		// the four color mode is selected by color0 > color1
+		if (color0 < color1)
+		{
+			std::swap(color0, color1);
+		}
+
+		int palette[16][4];
+		UnpackRGB565(color0, palette[0]);
+		UnpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 4; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		unsigned int error = MatchPalette(pixels, palette, 4, 3, indices);
+
+		unsigned int packedIndices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			// equal colors fall into the three color mode, where
+			// index 0 is the only one that is still color0
+			if (color0 == color1)
+			{
+				indices[i] = 0;
+			}
+			packedIndices |= (unsigned int)indices[i] << (i * 2);
+		}
+
+		pBlock[0] = (unsigned char)(color0 & 0xFF);
+		pBlock[1] = (unsigned char)(color0 >> 8);
+		pBlock[2] = (unsigned char)(color1 & 0xFF);
+		pBlock[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			pBlock[4 + i] = (unsigned char)(packedIndices >> (i * 8));
+		}
+		return(error);
+	}
+
+	// quantize an endpoint to 7 bits per channel plus the shared
+	// p-bit of BC7 mode 6 - the p-bit is chosen for the smallest
+	// error unless it is given as 0 or 1
+	void QuantizeBC7Endpoint(const float endpoint[4], int forcedPBit, int quantized[4], int& pBit)
+	{
+		unsigned int bestError = std::numeric_limits<unsigned int>::max();
+		for (int candidate = 0; candidate < 2; candidate++)
+		{
+			if ((forcedPBit >= 0) && (candidate != forcedPBit))
+			{
+				continue;
+			}
+
+			int values[4];
+			unsigned int error = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				values[c] = std::min(std::max((int)((endpoint[c] - (float)candidate) / 2.0f + 0.5f), 0), 127);
+				int difference = ((values[c] << 1) | candidate) - (int)(endpoint[c] + 0.5f);
+				error += (unsigned int)(difference * difference);
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				pBit = candidate;
+				memcpy(quantized, values, sizeof(values));
+			}
+		}
+	}
+
+	// append bitCount bits of value to a zeroed block, lowest first
+	void WriteBits(unsigned char* pBlock, int& bitPosition, unsigned int value, int bitCount)
+	{
+		for (int i = 0; i < bitCount; i++, bitPosition++)
+		{
+			if (((value >> i) & 1) != 0)
+			{
+				pBlock[bitPosition >> 3] |= (unsigned char)(1 << (bitPosition & 7));
+			}
+		}
+	}
+
+	unsigned int ReadBits(const unsigned char* pBlock, int& bitPosition, int bitCount)
+	{
+		unsigned int value = 0;
+		for (int i = 0; i < bitCount; i++, bitPosition++)
+		{
+			value |= (unsigned int)((pBlock[bitPosition >> 3] >> (bitPosition & 7)) & 1) << i;
+		}
+		return(value);
+	}
+
+	// quantize the endpoints and write the BC7 mode 6 block of the
+	// block colors - the p-bits are chosen per endpoint unless they
+	// are given as 0 or 1 - returns the error
+	unsigned int WriteBC7Block(
+		const unsigned char pixels[16][4],
+		const float endpoint0[4],
+		const float endpoint1[4],
+		int forcedPBit0,
+		int forcedPBit1,
+		unsigned char* pBlock,
+		unsigned char indices[16])
+	{
+		int quantized[2][4];
+		int pBits[2] = { 0, 0 };
+		QuantizeBC7Endpoint(endpoint0, forcedPBit0, quantized[0], pBits[0]);
+		QuantizeBC7Endpoint(endpoint1, forcedPBit1, quantized[1], pBits[1]);
+
+		int palette[16][4];
+		for (int entry = 0; entry < 16; entry++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int value0 = (quantized[0][c] << 1) | pBits[0];
+				int value1 = (quantized[1][c] << 1) | pBits[1];
+				palette[entry][c] = ((64 - BC7_WEIGHTS[entry]) * value0 + BC7_WEIGHTS[entry] * value1 + 32) >> 6;
+			}
+		}
+
+		unsigned int error = MatchPalette(pixels, palette, 16, 4, indices);
+
+		// the highest bit of the first index is implied to be 0 - the
+		// weights are symmetric, so swapping the endpoints and
+		// mirroring the indices keeps the colors
+		if (indices[0] >= 8)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				std::swap(quantized[0][c], quantized[1][c]);
+			}
+			std::swap(pBits[0], pBits[1]);
+			for (int i = 0; i < 16; i++)
+			{
+				indices[i] = (unsigned char)(15 - indices[i]);
+			}
+		}
+
+		memset(pBlock, 0, 16);
+		int bitPosition = 0;
+		// mode 6 is six 0 bits followed by a 1
+		WriteBits(pBlock, bitPosition, 1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			WriteBits(pBlock, bitPosition, (unsigned int)quantized[0][c], 7);
+			WriteBits(pBlock, bitPosition, (unsigned int)quantized[1][c], 7);
+		}
+		WriteBits(pBlock, bitPosition, (unsigned int)pBits[0], 1);
+		WriteBits(pBlock, bitPosition, (unsigned int)pBits[1], 1);
+		WriteBits(pBlock, bitPosition, indices[0], 3);
+		for (int i = 1; i < 16; i++)
+		{
+			WriteBits(pBlock, bitPosition, indices[i], 4);
+		}
+		return(error);
+	}
+}
+
+/***********************************************************
+ *  GetBlockBytes()
+ *
+ *  This method is used to get the size of one 4x4 block.
+ ***********************************************************/
+int BlockCompressor::GetBlockBytes(Format format)
+{
+	switch (format)
+	{
+	case FORMAT_BC1:
+		return(8);
+	case FORMAT_BC3:
+	case FORMAT_BC7:
+		return(16);
+	default:
+		return(0);
+	}
+}
+
+/***********************************************************
+ *  GetCompressedBytes()
+ *
+ *  This method is used to get the size of a compressed
+ *  image, which is stored in whole blocks.
+ ***********************************************************/
+size_t BlockCompressor::GetCompressedBytes(Format format, int width, int height)
+{
+	return((size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format));
+}
+
+/***********************************************************
+ *  CompressImage()
+ *
+ *  This method is used to compress an image block by block.
+ *  The pixels of 3 channel images get an opaque alpha.
+ ***********************************************************/
+void BlockCompressor::CompressImage(
+	Format format,
+	Quality quality,
+	const unsigned char* pPixels,
+	int width,
+	int height,
+	int channels,
+	unsigned char* pBlocks)
+{
+	const int blockBytes = GetBlockBytes(format);
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+
+	for (int blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksX; blockX++)
+		{
+			unsigned char pixels[16][4];
+			for (int y = 0; y < 4; y++)
+			{
+				const int sourceY = std::min(blockY * 4 + y, height - 1);
+				for (int x = 0; x < 4; x++)
+				{
+					const int sourceX = std::min(blockX * 4 + x, width - 1);
+					const unsigned char* pSource = pPixels + ((size_t)sourceY * width + sourceX) * channels;
+					unsigned char* pPixel = pixels[y * 4 + x];
+					pPixel[0] = pSource[0];
+					pPixel[1] = pSource[1];
+					pPixel[2] = pSource[2];
+					pPixel[3] = (channels == 4) ? pSource[3] : 255;
+				}
+			}
+
+			unsigned char* pBlock = pBlocks + ((size_t)blockY * blocksX + blockX) * blockBytes;
+			switch (format)
+			{
+			case FORMAT_BC1:
+				EncodeBC1Block(pixels, quality, pBlock);
+				break;
+			case FORMAT_BC3:
+				EncodeAlphaBlock(pixels, quality, pBlock);
+				EncodeBC1Block(pixels, quality, pBlock + 8);
+				break;
+			case FORMAT_BC7:
+				EncodeBC7Block(pixels, quality, pBlock);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  DecompressImage()
+ *
+ *  This method is used to decompress an image block by
+ *  block, for measuring the error of the compression.
+ ***********************************************************/
+void BlockCompressor::DecompressImage(
+	Format format,
+	const unsigned char* pBlocks,
+	int width,
+	int height,
+	int channels,
+	unsigned char* pPixels)
+{
+	const int blockBytes = GetBlockBytes(format);
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+
+	for (int blockY = 0; blockY < blocksY; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksX; blockX++)
+		{
+			const unsigned char* pBlock = pBlocks + ((size_t)blockY * blocksX + blockX) * blockBytes;
+			unsigned char pixels[16][4];
+			switch (format)
+			{
+			case FORMAT_BC1:
+				DecodeBC1Block(pBlock, pixels);
+				break;
+			case FORMAT_BC3:
+				DecodeBC1Block(pBlock + 8, pixels);
+				DecodeAlphaBlock(pBlock, pixels);
+				break;
+			case FORMAT_BC7:
+				DecodeBC7Block(pBlock, pixels);
+				break;
+			default:
+				memset(pixels, 0, sizeof(pixels));
+				break;
+			}
+
+			for (int y = 0; (y < 4) && (blockY * 4 + y < height); y++)
+			{
+				for (int x = 0; (x < 4) && (blockX * 4 + x < width); x++)
+				{
+					unsigned char* pTarget = pPixels + ((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * channels;
+					memcpy(pTarget, pixels[y * 4 + x], channels);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  ComputePSNR()
+ *
+ *  This method is used to measure how close the compressed
+ *  image is to the original one.  Identical images have an
+ *  infinite PSNR, and about 35 dB and more is hard to tell
+ *  apart on textures.
+ ***********************************************************/
+double BlockCompressor::ComputePSNR(
+	Format format,
+	const unsigned char* pPixels,
+	const unsigned char* pBlocks,
+	int width,
+	int height,
+	int channels)
+{
+	const size_t byteCount = (size_t)width * height * channels;
+	std::vector<unsigned char> decompressed(byteCount);
+	DecompressImage(format, pBlocks, width, height, channels, decompressed.data());
+
+	double squaredError = 0.0;
+	for (size_t i = 0; i < byteCount; i++)
+	{
+		double difference = (double)pPixels[i] - (double)decompressed[i];
+		squaredError += difference * difference;
+	}
+	if ((squaredError <= 0.0) || (byteCount == 0))
+	{
+		return(std::numeric_limits<double>::infinity());
+	}
+
+	double meanSquaredError = squaredError / (double)byteCount;
+	return(10.0 * std::log10(255.0 * 255.0 / meanSquaredError));
+}
+
+/***********************************************************
+ *  GetFormatName()
+ *
+ *  This method is used to get the name of a block format.
+ ***********************************************************/
+const char* BlockCompressor::GetFormatName(Format format)
+{
+	switch (format)
+	{
+	case FORMAT_BC1:
+		return("BC1");
+	case FORMAT_BC3:
+		return("BC3");
+	case FORMAT_BC7:
+		return("BC7");
+	default:
+		return("uncompressed");
+	}
+}
+
+/***********************************************************
+ *  GetQualityName()
+ *
+ *  This method is used to get the name of an encoder quality.
+ ***********************************************************/
+const char* BlockCompressor::GetQualityName(Quality quality)
+{
+	switch (quality)
+	{
+	case QUALITY_FAST:
+		return("fast");
+	case QUALITY_HIGH:
+		return("high");
+	default:
+		return("normal");
+	}
+}
+
+/***********************************************************
+ *  EncodeBC1Block()
+ *
+ *  This method is used to encode the colors of a block as
+ *  two RGB565 endpoints with 2-bit indices.  The fast encoder
+ *  insets the bounding box of the colors, the others take the
+ *  extremes along the principal axis.  The high quality
+ *  encoder refines the endpoints from the chosen indices and
+ *  keeps the best of all the candidates.
+ ***********************************************************/
+void BlockCompressor::EncodeBC1Block(const unsigned char pixels[16][4], Quality quality, unsigned char* pBlock)
+{
+	float endpoint0[4];
+	float endpoint1[4];
+	unsigned char indices[16];
+
+	if (quality == QUALITY_FAST)
+	{
+		ComputeBoundingBox(pixels, 3, endpoint0, endpoint1);
+		for (int c = 0; c < 3; c++)
+		{
+			float inset = (endpoint1[c] - endpoint0[c]) / 16.0f;
+			endpoint0[c] += inset;
+			endpoint1[c] -= inset;
+		}
+		WriteBC1Block(pixels, endpoint0, endpoint1, pBlock, indices);
+		return;
+	}
+
+	ComputePrincipalEndpoints(pixels, 3, endpoint0, endpoint1);
+	unsigned int bestError = WriteBC1Block(pixels, endpoint0, endpoint1, pBlock, indices);
+	if (quality != QUALITY_HIGH)
+	{
+		return;
+	}
+
+	unsigned char candidate[8];
+	unsigned char candidateIndices[16];
+	for (int iteration = 0; (iteration < REFINE_ITERATIONS) && (bestError > 0); iteration++)
+	{
+		if (SolveEndpoints(pixels, indices, BC1_WEIGHTS, 3, endpoint0, endpoint1) == false)
+		{
+			break;
+		}
+		unsigned int error = WriteBC1Block(pixels, endpoint0, endpoint1, candidate, candidateIndices);
+		if (error >= bestError)
+		{
+			break;
+		}
+		bestError = error;
+		memcpy(pBlock, candidate, sizeof(candidate));
+		memcpy(indices, candidateIndices, sizeof(candidateIndices));
+	}
+}
+
+/***********************************************************
+ *  EncodeAlphaBlock()
+ *
+ *  This method is used to encode the alpha of a block as the
+ *  first half of a BC3 block, with two 8-bit endpoints and
+ *  3-bit indices.  The endpoints span the alpha values with
+ *  six interpolated steps - the high quality encoder also
+ *  tries four steps plus exact 0 and 255, which suits blocks
+ *  with cut-out edges.
+ ***********************************************************/
+void BlockCompressor::EncodeAlphaBlock(const unsigned char pixels[16][4], Quality quality, unsigned char* pBlock)
+{
+	int minimum = 255;
+	int maximum = 0;
+	int innerMinimum = 255;
+	int innerMaximum = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int alpha = pixels[i][3];
+		minimum = std::min(minimum, alpha);
+		maximum = std::max(maximum, alpha);
+		if ((alpha != 0) && (alpha != 255))
+		{
+			innerMinimum = std::min(innerMinimum, alpha);
+			innerMaximum = std::max(innerMaximum, alpha);
+		}
+	}
+
+	// the alpha is kept in the first channel of the matched pixels
+	unsigned char alphaPixels[16][4];
+	for (int i = 0; i < 16; i++)
+	{
+		alphaPixels[i][0] = pixels[i][3];
+	}
+
+	// eight alpha values when alpha0 > alpha1
+	int alpha0 = maximum;
+	int alpha1 = minimum;
+	int palette[16][4];
+	palette[0][0] = alpha0;
+	palette[1][0] = alpha1;
+	for (int step = 1; step < 7; step++)
+	{
+		palette[step + 1][0] = ((7 - step) * alpha0 + step * alpha1) / 7;
+	}
+	unsigned char indices[16];
+	unsigned int bestError = MatchPalette(alphaPixels, palette, 8, 1, indices);
+
+	// six alpha values plus 0 and 255 when alpha0 <= alpha1
+	if ((quality == QUALITY_HIGH) && (bestError > 0) && ((minimum == 0) || (maximum == 255)))
+	{
+		int innerAlpha0 = std::min(innerMinimum, innerMaximum);
+		int innerAlpha1 = innerMaximum;
+		int innerPalette[16][4];
+		innerPalette[0][0] = innerAlpha0;
+		innerPalette[1][0] = innerAlpha1;
+		for (int step = 1; step < 5; step++)
+		{
+			innerPalette[step + 1][0] = ((5 - step) * innerAlpha0 + step * innerAlpha1) / 5;
+		}
+		innerPalette[6][0] = 0;
+		innerPalette[7][0] = 255;
+
+		unsigned char innerIndices[16];
+		unsigned int error = MatchPalette(alphaPixels, innerPalette, 8, 1, innerIndices);
+		if (error < bestError)
+		{
+			alpha0 = innerAlpha0;
+			alpha1 = innerAlpha1;
+			memcpy(indices, innerIndices, sizeof(indices));
+		}
+	}
+
+	pBlock[0] = (unsigned char)alpha0;
+	pBlock[1] = (unsigned char)alpha1;
+	unsigned long long packedIndices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		packedIndices |= (unsigned long long)indices[i] << (i * 3);
+	}
+	for (int i = 0; i < 6; i++)
+	{
+		pBlock[2 + i] = (unsigned char)(packedIndices >> (i * 8));
+	}
+}
+
+/***********************************************************
+ *  EncodeBC7Block()
+ *
+ *  This method is used to encode a block in BC7 mode 6, one
+ *  RGBA line with 7-bit endpoints, a p-bit each and 4-bit
+ *  indices.  The endpoints are found the same way as for
+ *  BC1, and the high quality encoder also tries every
+ *  combination of p-bits.  Opaque blocks keep the p-bits at
+ *  1, so their alpha stays exactly 255.
+ ***********************************************************/
+void BlockCompressor::EncodeBC7Block(const unsigned char pixels[16][4], Quality quality, unsigned char* pBlock)
+{
+	bool bOpaque = true;
+	for (int i = 0; (i < 16) && (bOpaque == true); i++)
+	{
+		bOpaque = (pixels[i][3] == 255);
+	}
+	const int forcedPBit = (bOpaque == true) ? 1 : -1;
+
+	float endpoint0[4];
+	float endpoint1[4];
+	unsigned char indices[16];
+
+	if (quality == QUALITY_FAST)
+	{
+		ComputeBoundingBox(pixels, 4, endpoint0, endpoint1);
+		WriteBC7Block(pixels, endpoint0, endpoint1, forcedPBit, forcedPBit, pBlock, indices);
+		return;
+	}
+
+	ComputePrincipalEndpoints(pixels, 4, endpoint0, endpoint1);
+	unsigned int bestError = WriteBC7Block(pixels, endpoint0, endpoint1, forcedPBit, forcedPBit, pBlock, indices);
+	if (quality != QUALITY_HIGH)
+	{
+		return;
+	}
+
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+	{
+		weights[i] = (float)BC7_WEIGHTS[i] / 64.0f;
+	}
+
+	unsigned char candidate[16];
+	unsigned char candidateIndices[16];
+	for (int iteration = 0; (iteration < REFINE_ITERATIONS) && (bestError > 0); iteration++)
+	{
+		float refined0[4];
+		float refined1[4];
+		if (SolveEndpoints(pixels, indices, weights, 4, refined0, refined1) == false)
+		{
+			break;
+		}
+		unsigned int error = WriteBC7Block(pixels, refined0, refined1, forcedPBit, forcedPBit, candidate, candidateIndices);
+		if (error >= bestError)
+		{
+			break;
+		}
+		bestError = error;
+		memcpy(endpoint0, refined0, sizeof(refined0));
+		memcpy(endpoint1, refined1, sizeof(refined1));
+		memcpy(pBlock, candidate, sizeof(candidate));
+		memcpy(indices, candidateIndices, sizeof(candidateIndices));
+	}
+
+	for (int pBits = 0; (pBits < 4) && (bOpaque == false) && (bestError > 0); pBits++)
+	{
+		unsigned int error = WriteBC7Block(pixels, endpoint0, endpoint1, pBits & 1, pBits >> 1, candidate, candidateIndices);
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(pBlock, candidate, sizeof(candidate));
+		}
+	}
+}
+
+/***********************************************************
+ *  DecodeBC1Block()
+ *
+ *  This method is used to decode a BC1 block, in the four
+ *  color mode when color0 > color1 and otherwise in the
+ *  three color mode with black as the fourth color.
+ ***********************************************************/
+void BlockCompressor::DecodeBC1Block(const unsigned char* pBlock, unsigned char pixels[16][4])
+{
+	unsigned short color0 = (unsigned short)(pBlock[0] | (pBlock[1] << 8));
+	unsigned short color1 = (unsigned short)(pBlock[2] | (pBlock[3] << 8));
+
+	int palette[4][4];
+	UnpackRGB565(color0, palette[0]);
+	UnpackRGB565(color1, palette[1]);
+	for (int c = 0; c < 4; c++)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+
+	unsigned int packedIndices = (unsigned int)pBlock[4] | ((unsigned int)pBlock[5] << 8) |
+		((unsigned int)pBlock[6] << 16) | ((unsigned int)pBlock[7] << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		const int* pColor = palette[(packedIndices >> (i * 2)) & 3];
+		for (int c = 0; c < 4; c++)
+		{
+			pixels[i][c] = (unsigned char)pColor[c];
+		}
+	}
+}
+
+/***********************************************************
+ *  DecodeAlphaBlock()
+ *
+ *  This method is used to decode the alpha half of a BC3
+ *  block into the alpha of the pixels.
+ ***********************************************************/
+void BlockCompressor::DecodeAlphaBlock(const unsigned char* pBlock, unsigned char pixels[16][4])
+{
+	int alpha0 = pBlock[0];
+	int alpha1 = pBlock[1];
+
+	int palette[8];
+	palette[0] = alpha0;
+	palette[1] = alpha1;
+	if (alpha0 > alpha1)
+	{
+		for (int step = 1; step < 7; step++)
+		{
+			palette[step + 1] = ((7 - step) * alpha0 + step * alpha1) / 7;
+		}
+	}
+	else
+	{
+		for (int step = 1; step < 5; step++)
+		{
+			palette[step + 1] = ((5 - step) * alpha0 + step * alpha1) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	unsigned long long packedIndices = 0;
+	for (int i = 0; i < 6; i++)
+	{
+		packedIndices |= (unsigned long long)pBlock[2 + i] << (i * 8);
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		pixels[i][3] = (unsigned char)palette[(packedIndices >> (i * 3)) & 7];
+	}
+}
+
+/***********************************************************
+ *  DecodeBC7Block()
+ *
+ *  This method is used to decode a BC7 mode 6 block, the
+ *  only mode the encoder writes.  Blocks of the other modes
+ *  decode to magenta.
+ ***********************************************************/
+void BlockCompressor::DecodeBC7Block(const unsigned char* pBlock, unsigned char pixels[16][4])
+{
+	if ((pBlock[0] & 0x7F) != 0x40)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			pixels[i][0] = 255;
+			pixels[i][1] = 0;
+			pixels[i][2] = 255;
+			pixels[i][3] = 255;
+		}
+		return;
+	}
+
+	int bitPosition = 7;
+	int quantized[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		quantized[0][c] = (int)ReadBits(pBlock, bitPosition, 7);
+		quantized[1][c] = (int)ReadBits(pBlock, bitPosition, 7);
+	}
+	int pBit0 = (int)ReadBits(pBlock, bitPosition, 1);
+	int pBit1 = (int)ReadBits(pBlock, bitPosition, 1);
+
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (int)ReadBits(pBlock, bitPosition, (i == 0) ? 3 : 4);
+		for (int c = 0; c < 4; c++)
+		{
+			int value0 = (quantized[0][c] << 1) | pBit0;
+			int value1 = (quantized[1][c] << 1) | pBit1;
+			pixels[i][c] = (unsigned char)(((64 - BC7_WEIGHTS[index]) * value0 + BC7_WEIGHTS[index] * value1 + 32) >> 6);
+		}
+	}
+}
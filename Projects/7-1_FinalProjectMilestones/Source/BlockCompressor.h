@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+// blockcompressor.h
+// ============
+// encode texture images into BC1, BC3 and BC7 compressed blocks
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  BlockCompressor
+ *
+ *  This class contains the code for compressing texture
+ *  images into the block formats that the GPU samples
+ *  directly.  Every 4x4 pixel block is stored in 8 bytes
+ *  (BC1, opaque) or 16 bytes (BC3 and BC7, with alpha).  The
+ *  palette matching of the encoder uses SSE when it is
+ *  available.  The methods do not use OpenGL, so the images
+ *  can be compressed on any thread.
+ ***********************************************************/
+class BlockCompressor
+{
+public:
+	// block formats the images can be compressed into
+	enum Format
+	{
+		FORMAT_NONE,    // not compressed
+		FORMAT_BC1,     // RGB, 4 bits per pixel
+		FORMAT_BC3,     // RGBA, 8 bits per pixel
+		FORMAT_BC7      // RGBA, 8 bits per pixel, mode 6 blocks only
+	};
+
+	// how hard the encoder searches for the block endpoints
+	enum Quality
+	{
+		QUALITY_FAST,   // bounding box of the block colors
+		QUALITY_NORMAL, // principal axis of the block colors
+		QUALITY_HIGH    // principal axis refined by least squares
+	};
+
+	// size of one 4x4 block, 0 for FORMAT_NONE
+	static int GetBlockBytes(Format format);
+	// size of an image of the given size in the given format
+	static size_t GetCompressedBytes(Format format, int width, int height);
+
+	// compress an image of tightly packed rows with 3 or 4 color
+	// channels - pBlocks receives GetCompressedBytes() bytes, the
+	// blocks of the partial row and column repeat the edge pixels
+	static void CompressImage(
+		Format format,
+		Quality quality,
+		const unsigned char* pPixels,
+		int width,
+		int height,
+		int channels,
+		unsigned char* pBlocks);
+	// decompress the blocks into an image of tightly packed rows
+	// with 3 or 4 color channels
+	static void DecompressImage(
+		Format format,
+		const unsigned char* pBlocks,
+		int width,
+		int height,
+		int channels,
+		unsigned char* pPixels);
+	// peak signal to noise ratio in dB of the compressed image
+	// against the original one, over all of its color channels
+	static double ComputePSNR(
+		Format format,
+		const unsigned char* pPixels,
+		const unsigned char* pBlocks,
+		int width,
+		int height,
+		int channels);
+
+	static const char* GetFormatName(Format format);
+	static const char* GetQualityName(Quality quality);
+
+private:
+	// encode one block of 16 RGBA pixels
+	static void EncodeBC1Block(const unsigned char pixels[16][4], Quality quality, unsigned char* pBlock);
+	static void EncodeAlphaBlock(const unsigned char pixels[16][4], Quality quality, unsigned char* pBlock);
+	static void EncodeBC7Block(const unsigned char pixels[16][4], Quality quality, unsigned char* pBlock);
+
+	// decode one block into 16 RGBA pixels
+	static void DecodeBC1Block(const unsigned char* pBlock, unsigned char pixels[16][4]);
+	static void DecodeAlphaBlock(const unsigned char* pBlock, unsigned char pixels[16][4]);
+	static void DecodeBC7Block(const unsigned char* pBlock, unsigned char pixels[16][4]);
+};
@@ -0,0 +1,592 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.cpp
+// ============
+// measure the CPU and GPU time of the sections of every frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _DEBUG
+#include <imgui.h>
+#endif
+
+// declaration of global variables
+namespace
+{
+	// bars of the frame time histogram in the UI panel
+	const int HISTOGRAM_BINS = 32;
+
+	double ElapsedMilliseconds(
+		std::chrono::steady_clock::time_point start,
+		std::chrono::steady_clock::time_point end)
+	{
+		return(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+}
+
+/***********************************************************
+ *  ScopedSection()
+ *
+ *  The constructor for the class - starts the section
+ ***********************************************************/
+FrameProfiler::ScopedSection::ScopedSection(FrameProfiler* pProfiler, int section)
+{
+	m_pProfiler = pProfiler;
+	m_section = section;
+
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->BeginSection(m_section);
+	}
+}
+
+/***********************************************************
+ *  ~ScopedSection()
+ *
+ *  The destructor for the class - ends the section
+ ***********************************************************/
+FrameProfiler::ScopedSection::~ScopedSection()
+{
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->EndSection(m_section);
+	}
+}
+
+/***********************************************************
+ *  FrameProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameProfiler::FrameProfiler()
+{
+	m_frameHistory.values.assign(HISTORY_FRAMES, 0.0f);
+	m_frameHistory.next = 0;
+	m_frameHistory.count = 0;
+
+	m_frameNumber = 0;
+	for (int set = 0; set < QUERY_SETS; set++)
+	{
+		m_setFrameNumbers[set] = -1;
+		m_frameMilliseconds[set] = 0.0f;
+	}
+	m_bInFrame = false;
+	m_activeGpuSection = -1;
+	m_csvFile = NULL;
+}
+
+/***********************************************************
+ *  ~FrameProfiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameProfiler::~FrameProfiler()
+{
+	if (NULL != m_csvFile)
+	{
+		fclose(m_csvFile);
+		m_csvFile = NULL;
+	}
+
+	for (size_t i = 0; i < m_sections.size(); i++)
+	{
+		glDeleteQueries(QUERY_SETS, m_sections[i].queries);
+	}
+}
+
+/***********************************************************
+ *  AddSection()
+ *
+ *  This method is used for adding a named section with its
+ *  GPU queries.  The returned index is passed to
+ *  BeginSection() and EndSection().
+ ***********************************************************/
+int FrameProfiler::AddSection(const std::string& name)
+{
+	SECTION section;
+	section.name = name;
+	glGenQueries(QUERY_SETS, section.queries);
+	for (int set = 0; set < QUERY_SETS; set++)
+	{
+		section.bQueryIssued[set] = false;
+		section.cpuMilliseconds[set] = 0.0f;
+	}
+	section.cpuHistory.values.assign(HISTORY_FRAMES, 0.0f);
+	section.cpuHistory.next = 0;
+	section.cpuHistory.count = 0;
+	section.gpuHistory = section.cpuHistory;
+
+	m_sections.push_back(section);
+	return((int)m_sections.size() - 1);
+}
+
+/***********************************************************
+ *  AddCounter()
+ *
+ *  This method is used for adding a named counter.  The
+ *  returned index is passed to SetCounter().
+ ***********************************************************/
+int FrameProfiler::AddCounter(const std::string& name)
+{
+	COUNTER counter;
+	counter.name = name;
+	for (int set = 0; set < QUERY_SETS; set++)
+	{
+		counter.values[set] = 0.0f;
+	}
+	counter.history.values.assign(HISTORY_FRAMES, 0.0f);
+	counter.history.next = 0;
+	counter.history.count = 0;
+
+	m_counters.push_back(counter);
+	return((int)m_counters.size() - 1);
+}
+
+/***********************************************************
+ *  SetCounter()
+ *
+ *  This method is used for setting the value of a counter
+ *  in the frame that is recorded.
+ ***********************************************************/
+void FrameProfiler::SetCounter(int counter, double value)
+{
+	if ((m_bInFrame == false) || (counter < 0) || (counter >= (int)m_counters.size()))
+	{
+		return;
+	}
+
+	m_counters[counter].values[GetCurrentSet()] = (float)value;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame.  The query
+ *  set of the new frame is still holding the frame from two
+ *  frames ago, whose times are read first.
+ ***********************************************************/
+void FrameProfiler::BeginFrame()
+{
+	int set = GetCurrentSet();
+	ResolveSet(set);
+
+	for (size_t i = 0; i < m_sections.size(); i++)
+	{
+		m_sections[i].bQueryIssued[set] = false;
+		m_sections[i].cpuMilliseconds[set] = 0.0f;
+	}
+	for (size_t i = 0; i < m_counters.size(); i++)
+	{
+		m_counters[i].values[set] = 0.0f;
+	}
+	m_setFrameNumbers[set] = m_frameNumber;
+	m_frameStart = ProfileClock::now();
+	m_bInFrame = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for ending the recorded frame.
+ ***********************************************************/
+void FrameProfiler::EndFrame()
+{
+	if (m_bInFrame == false)
+	{
+		return;
+	}
+
+	m_frameMilliseconds[GetCurrentSet()] = (float)ElapsedMilliseconds(m_frameStart, ProfileClock::now());
+	m_bInFrame = false;
+	m_frameNumber++;
+}
+
+/***********************************************************
+ *  BeginSection()
+ *
+ *  This method is used for starting the CPU timer and, if
+ *  no other section is timed on the GPU, the GPU query of a
+ *  section.  A section that is started several times in one
+ *  frame adds up its CPU time, but only its first run is
+ *  timed on the GPU.
+ ***********************************************************/
+void FrameProfiler::BeginSection(int section)
+{
+	if ((m_bInFrame == false) || (section < 0) || (section >= (int)m_sections.size()))
+	{
+		return;
+	}
+
+	SECTION& current = m_sections[section];
+	int set = GetCurrentSet();
+
+	if ((m_activeGpuSection < 0) && (current.bQueryIssued[set] == false))
+	{
+		glBeginQuery(GL_TIME_ELAPSED, current.queries[set]);
+		current.bQueryIssued[set] = true;
+		m_activeGpuSection = section;
+	}
+
+	current.start = ProfileClock::now();
+}
+
+/***********************************************************
+ *  EndSection()
+ *
+ *  This method is used for stopping the timers of a section.
+ ***********************************************************/
+void FrameProfiler::EndSection(int section)
+{
+	if ((m_bInFrame == false) || (section < 0) || (section >= (int)m_sections.size()))
+	{
+		return;
+	}
+
+	SECTION& current = m_sections[section];
+	current.cpuMilliseconds[GetCurrentSet()] += (float)ElapsedMilliseconds(current.start, ProfileClock::now());
+
+	if (m_activeGpuSection == section)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_activeGpuSection = -1;
+	}
+}
+
+/***********************************************************
+ *  OpenCsv()
+ *
+ *  This method is used for opening the CSV file that every
+ *  finished frame is written to and writing its header.
+ ***********************************************************/
+bool FrameProfiler::OpenCsv(const std::string& filename)
+{
+	if (NULL != m_csvFile)
+	{
+		fclose(m_csvFile);
+	}
+
+	m_csvFile = fopen(filename.c_str(), "w");
+	if (NULL == m_csvFile)
+	{
+		std::cout << "Could not open profile file:" << filename << std::endl;
+		return(false);
+	}
+
+	fprintf(m_csvFile, "frame,frame_cpu_ms");
+	for (size_t i = 0; i < m_sections.size(); i++)
+	{
+		fprintf(m_csvFile, ",%s_cpu_ms,%s_gpu_ms", m_sections[i].name.c_str(), m_sections[i].name.c_str());
+	}
+	for (size_t i = 0; i < m_counters.size(); i++)
+	{
+		fprintf(m_csvFile, ",%s", m_counters[i].name.c_str());
+	}
+	fprintf(m_csvFile, "\n");
+
+	return(true);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for reading the times of the frames
+ *  that are still in flight, oldest first, and closing the
+ *  CSV file.
+ ***********************************************************/
+void FrameProfiler::Finish()
+{
+	for (int i = 0; i < QUERY_SETS; i++)
+	{
+		ResolveSet((int)((m_frameNumber + i) % QUERY_SETS));
+	}
+
+	if (NULL != m_csvFile)
+	{
+		fclose(m_csvFile);
+		m_csvFile = NULL;
+	}
+}
+
+/***********************************************************
+ *  ResolveSet()
+ *
+ *  This method is used for reading the GPU times of the
+ *  frame that was recorded into a query set and adding the
+ *  times and counters of that frame to the statistics and
+ *  the CSV file.
+ *  A section without a GPU query gets a GPU time of -1 in
+ *  the CSV file and is left out of the GPU statistics.
+ ***********************************************************/
+void FrameProfiler::ResolveSet(int set)
+{
+	if (m_setFrameNumbers[set] < 0)
+	{
+		return;
+	}
+
+	m_frameHistory.Add(m_frameMilliseconds[set]);
+	if (NULL != m_csvFile)
+	{
+		fprintf(m_csvFile, "%lld,%.4f", m_setFrameNumbers[set], m_frameMilliseconds[set]);
+	}
+
+	for (size_t i = 0; i < m_sections.size(); i++)
+	{
+		SECTION& section = m_sections[i];
+		float gpuMilliseconds = -1.0f;
+
+		if (section.bQueryIssued[set] == true)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(section.queries[set], GL_QUERY_RESULT, &nanoseconds);
+			gpuMilliseconds = (float)((double)nanoseconds / 1000000.0);
+			section.gpuHistory.Add(gpuMilliseconds);
+			section.bQueryIssued[set] = false;
+		}
+		section.cpuHistory.Add(section.cpuMilliseconds[set]);
+
+		if (NULL != m_csvFile)
+		{
+			fprintf(m_csvFile, ",%.4f,%.4f", section.cpuMilliseconds[set], gpuMilliseconds);
+		}
+	}
+
+	for (size_t i = 0; i < m_counters.size(); i++)
+	{
+		m_counters[i].history.Add(m_counters[i].values[set]);
+		if (NULL != m_csvFile)
+		{
+			fprintf(m_csvFile, ",%.0f", m_counters[i].values[set]);
+		}
+	}
+
+	if (NULL != m_csvFile)
+	{
+		fprintf(m_csvFile, "\n");
+	}
+
+	m_setFrameNumbers[set] = -1;
+}
+
+/***********************************************************
+ *  GetFrameStats()
+ *
+ *  This method is used for getting the statistics of the
+ *  CPU time from the start to the end of the frames.
+ ***********************************************************/
+FrameProfiler::SECTION_STATS FrameProfiler::GetFrameStats() const
+{
+	return(m_frameHistory.GetStats());
+}
+
+/***********************************************************
+ *  GetCpuStats()
+ *
+ *  This method is used for getting the statistics of the
+ *  CPU time of a section.
+ ***********************************************************/
+FrameProfiler::SECTION_STATS FrameProfiler::GetCpuStats(int section) const
+{
+	return(m_sections[section].cpuHistory.GetStats());
+}
+
+/***********************************************************
+ *  GetGpuStats()
+ *
+ *  This method is used for getting the statistics of the
+ *  GPU time of a section.
+ ***********************************************************/
+FrameProfiler::SECTION_STATS FrameProfiler::GetGpuStats(int section) const
+{
+	return(m_sections[section].gpuHistory.GetStats());
+}
+
+/***********************************************************
+ *  GetCounterStats()
+ *
+ *  This method is used for getting the statistics of the
+ *  values of a counter.
+ ***********************************************************/
+FrameProfiler::SECTION_STATS FrameProfiler::GetCounterStats(int counter) const
+{
+	return(m_counters[counter].history.GetStats());
+}
+
+/***********************************************************
+ *  PrintSummary()
+ *
+ *  This method is used for printing the statistics of the
+ *  frame and of every section on the console.
+ ***********************************************************/
+void FrameProfiler::PrintSummary() const
+{
+	SECTION_STATS frame = GetFrameStats();
+
+	printf("\nFrame profile over the last %d frames (ms)\n", frame.samples);
+	printf("%-16s  %8s  %8s  %8s  %8s    %8s  %8s  %8s  %8s\n",
+		"section", "cpu min", "cpu p50", "cpu p99", "cpu max",
+		"gpu min", "gpu p50", "gpu p99", "gpu max");
+	printf("%-16s  %8.3f  %8.3f  %8.3f  %8.3f\n",
+		"frame", frame.minimum, frame.p50, frame.p99, frame.maximum);
+
+	for (int i = 0; i < GetSectionCount(); i++)
+	{
+		SECTION_STATS cpu = GetCpuStats(i);
+		SECTION_STATS gpu = GetGpuStats(i);
+
+		printf("%-16s  %8.3f  %8.3f  %8.3f  %8.3f    %8.3f  %8.3f  %8.3f  %8.3f\n",
+			m_sections[i].name.c_str(),
+			cpu.minimum, cpu.p50, cpu.p99, cpu.maximum,
+			gpu.minimum, gpu.p50, gpu.p99, gpu.maximum);
+	}
+
+	if (m_counters.empty())
+	{
+		return;
+	}
+
+	printf("\n%-20s  %12s  %12s  %12s  %12s\n", "counter", "min", "p50", "p99", "max");
+	for (int i = 0; i < GetCounterCount(); i++)
+	{
+		SECTION_STATS counter = GetCounterStats(i);
+		printf("%-20s  %12.0f  %12.0f  %12.0f  %12.0f\n",
+			m_counters[i].name.c_str(),
+			counter.minimum, counter.p50, counter.p99, counter.maximum);
+	}
+}
+
+#ifdef _DEBUG
+/***********************************************************
+ *  ShowUiPanel()
+ *
+ *  This method is used for showing the statistics of every
+ *  section in a table and a histogram of the frame times in
+ *  an ImGui window.
+ ***********************************************************/
+void FrameProfiler::ShowUiPanel()
+{
+	ImGui::Begin("Frame Profiler", nullptr);
+
+	SECTION_STATS frame = GetFrameStats();
+	ImGui::Text("CPU frame: p50 %.3f ms, p99 %.3f ms over %d frames", frame.p50, frame.p99, frame.samples);
+
+	// frame times, binned from the fastest to the slowest kept frame
+	float bins[HISTOGRAM_BINS] = { 0.0f };
+	float binWidth = (frame.maximum - frame.minimum) / (float)HISTOGRAM_BINS;
+	for (int i = 0; i < m_frameHistory.count; i++)
+	{
+		int bin = (binWidth > 0.0f) ? (int)((m_frameHistory.values[i] - frame.minimum) / binWidth) : 0;
+		bins[std::min(std::max(bin, 0), HISTOGRAM_BINS - 1)] += 1.0f;
+	}
+	ImGui::PlotHistogram("##frame_histogram", bins, HISTOGRAM_BINS, 0, nullptr, 0.0f, 3.4e38f, ImVec2(0, 60));
+	ImGui::Text("%.3f ms .. %.3f ms", frame.minimum, frame.maximum);
+
+	if (ImGui::BeginTable("##profiler_sections", 9, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		const char* columns[] = { "section", "cpu min", "cpu p50", "cpu p99", "cpu max",
+			"gpu min", "gpu p50", "gpu p99", "gpu max" };
+		for (int column = 0; column < 9; column++)
+		{
+			ImGui::TableSetupColumn(columns[column]);
+		}
+		ImGui::TableHeadersRow();
+
+		for (int i = 0; i < GetSectionCount(); i++)
+		{
+			SECTION_STATS cpu = GetCpuStats(i);
+			SECTION_STATS gpu = GetGpuStats(i);
+			float values[] = { cpu.minimum, cpu.p50, cpu.p99, cpu.maximum,
+				gpu.minimum, gpu.p50, gpu.p99, gpu.maximum };
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", m_sections[i].name.c_str());
+			for (int column = 0; column < 8; column++)
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", values[column]);
+			}
+		}
+
+		ImGui::EndTable();
+	}
+
+	if ((m_counters.empty() == false) &&
+		ImGui::BeginTable("##profiler_counters", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		const char* columns[] = { "counter", "min", "p50", "p99", "max" };
+		for (int column = 0; column < 5; column++)
+		{
+			ImGui::TableSetupColumn(columns[column]);
+		}
+		ImGui::TableHeadersRow();
+
+		for (int i = 0; i < GetCounterCount(); i++)
+		{
+			SECTION_STATS counter = GetCounterStats(i);
+			float values[] = { counter.minimum, counter.p50, counter.p99, counter.maximum };
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", m_counters[i].name.c_str());
+			for (int column = 0; column < 4; column++)
+			{
+				ImGui::TableNextColumn();
+				ImGui::Text("%.0f", values[column]);
+			}
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+#endif
+
+/***********************************************************
+ *  HISTORY::Add()
+ *
+ *  This method is used for keeping a value, overwriting the
+ *  oldest value once the history is full.
+ ***********************************************************/
+void FrameProfiler::HISTORY::Add(float value)
+{
+	values[next] = value;
+	next = (next + 1) % (int)values.size();
+	count = std::min(count + 1, (int)values.size());
+}
+
+/***********************************************************
+ *  HISTORY::GetStats()
+ *
+ *  This method is used for getting the min, max, p50 and
+ *  p99 of the kept values, using the nearest rank.
+ ***********************************************************/
+FrameProfiler::SECTION_STATS FrameProfiler::HISTORY::GetStats() const
+{
+	SECTION_STATS stats;
+	stats.samples = count;
+	stats.minimum = 0.0f;
+	stats.maximum = 0.0f;
+	stats.p50 = 0.0f;
+	stats.p99 = 0.0f;
+
+	if (count == 0)
+	{
+		return(stats);
+	}
+
+	std::vector<float> sorted(values.begin(), values.begin() + count);
+	std::sort(sorted.begin(), sorted.end());
+
+	stats.minimum = sorted.front();
+	stats.maximum = sorted.back();
+	stats.p50 = sorted[(size_t)((count - 1) * 0.50f + 0.5f)];
+	stats.p99 = sorted[(size_t)((count - 1) * 0.99f + 0.5f)];
+
+	return(stats);
+}
@@ -0,0 +1,161 @@
+///////////////////////////////////////////////////////////////////////////////
+// frameprofiler.h
+// ============
+// measure the CPU and GPU time of the sections of every frame
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FrameProfiler
+ *
+ *  This class contains the code for timing named sections
+ *  of the frame on the CPU and, with GL_TIME_ELAPSED queries,
+ *  on the GPU.  The queries are double-buffered, so the GPU
+ *  times of a frame are read two frames later without
+ *  waiting for the GPU.  Named counters hold one value per
+ *  frame, such as the triangles drawn.  The last frames are
+ *  kept for the min, max, p50 and p99 statistics and can be
+ *  written to a CSV file, one row per frame.
+ ***********************************************************/
+class FrameProfiler
+{
+public:
+	// statistics of one section over the kept frames, in milliseconds
+	struct SECTION_STATS
+	{
+		int samples;
+		float minimum;
+		float maximum;
+		float p50;
+		float p99;
+	};
+
+	// times a section from its construction to its destruction -
+	// nothing is timed if the profiler is NULL
+	class ScopedSection
+	{
+	public:
+		ScopedSection(FrameProfiler* pProfiler, int section);
+		~ScopedSection();
+
+	private:
+		FrameProfiler* m_pProfiler;
+		int m_section;
+	};
+
+	// constructor
+	FrameProfiler();
+	// destructor
+	~FrameProfiler();
+
+	// add a named section and return its index - call this
+	// before the first frame, with a current GL context
+	int AddSection(const std::string& name);
+	// number of added sections
+	int GetSectionCount() const { return (int)m_sections.size(); }
+	// name of an added section
+	const std::string& GetSectionName(int section) const { return m_sections[section].name; }
+
+	// add a named counter and return its index - call this before
+	// the first frame.  A counter is 0 in every frame it is not set
+	int AddCounter(const std::string& name);
+	// number of added counters
+	int GetCounterCount() const { return (int)m_counters.size(); }
+	// name of an added counter
+	const std::string& GetCounterName(int counter) const { return m_counters[counter].name; }
+	// set the value of a counter in the current frame
+	void SetCounter(int counter, double value);
+
+	// mark the start and the end of a frame
+	void BeginFrame();
+	void EndFrame();
+	// mark the start and the end of a section in the current frame -
+	// sections must not overlap to be timed on the GPU
+	void BeginSection(int section);
+	void EndSection(int section);
+
+	// write every finished frame to a CSV file
+	bool OpenCsv(const std::string& filename);
+	// read the outstanding GPU times and close the CSV file
+	void Finish();
+
+	// statistics of the kept frames
+	SECTION_STATS GetFrameStats() const;
+	SECTION_STATS GetCpuStats(int section) const;
+	SECTION_STATS GetGpuStats(int section) const;
+	SECTION_STATS GetCounterStats(int counter) const;
+
+	// print the statistics of every section on the console
+	void PrintSummary() const;
+#ifdef _DEBUG
+	// show the statistics in an ImGui window
+	void ShowUiPanel();
+#endif
+
+private:
+	typedef std::chrono::steady_clock ProfileClock;
+
+	// frames that are in flight before their queries are read
+	static const int QUERY_SETS = 2;
+	// frames that are kept for the statistics
+	static const int HISTORY_FRAMES = 240;
+
+	// the last frames of one value, oldest overwritten first
+	struct HISTORY
+	{
+		std::vector<float> values;
+		int next;
+		int count;
+
+		void Add(float value);
+		SECTION_STATS GetStats() const;
+	};
+
+	struct SECTION
+	{
+		std::string name;
+		GLuint queries[QUERY_SETS];
+		bool bQueryIssued[QUERY_SETS];
+		float cpuMilliseconds[QUERY_SETS];
+		ProfileClock::time_point start;
+		HISTORY cpuHistory;
+		HISTORY gpuHistory;
+	};
+
+	struct COUNTER
+	{
+		std::string name;
+		float values[QUERY_SETS];
+		HISTORY history;
+	};
+
+	std::vector<SECTION> m_sections;
+	std::vector<COUNTER> m_counters;
+	HISTORY m_frameHistory;
+
+	// number of the frame that is recorded and of the frame
+	// that was recorded into each query set, or -1
+	long long m_frameNumber;
+	long long m_setFrameNumbers[QUERY_SETS];
+	float m_frameMilliseconds[QUERY_SETS];
+	ProfileClock::time_point m_frameStart;
+	bool m_bInFrame;
+	// section whose GPU query is running, or -1
+	int m_activeGpuSection;
+
+	FILE* m_csvFile;
+
+	// query set of the frame that is recorded
+	int GetCurrentSet() const { return (int)(m_frameNumber % QUERY_SETS); }
+	// read the times of the frame recorded into a query set
+	void ResolveSet(int set);
+};
@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.cpp
+// ============
+// test world space bounding boxes against the view frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+
+#include <cmath>
+
+// AVX is only used when the compiler is allowed to emit it (/arch:AVX
+// or -mavx), SSE2 is always there on x64
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX
+#define FRUSTUM_CULLER_SSE
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE
+#endif
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	// nothing is culled until a view is set
+	for (int i = 0; i < 6; i++)
+	{
+		m_planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+/***********************************************************
+ *  SetViewProjection()
+ *
+ *  This method is used for extracting the six frustum planes
+ *  from the rows of the view-projection matrix, as described
+ *  by Gribb and Hartmann.
+ ***********************************************************/
+void FrustumCuller::SetViewProjection(const glm::mat4& viewProjection)
+{
+	// glm matrices are column-major, so row i is m[0..3][i]
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; row++)
+	{
+		rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row],
+			viewProjection[2][row], viewProjection[3][row]);
+	}
+
+	m_planes[0] = rows[3] + rows[0];	// left
+	m_planes[1] = rows[3] - rows[0];	// right
+	m_planes[2] = rows[3] + rows[1];	// bottom
+	m_planes[3] = rows[3] - rows[1];	// top
+	m_planes[4] = rows[3] + rows[2];	// near
+	m_planes[5] = rows[3] - rows[2];	// far
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.0f)
+		{
+			m_planes[i] /= length;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetSimdWidth()
+ *
+ *  This method is used for getting the number of boxes that
+ *  CullBoxes() tests with one SIMD instruction.
+ ***********************************************************/
+int FrustumCuller::GetSimdWidth()
+{
+#if defined(FRUSTUM_CULLER_AVX)
+	return(8);
+#elif defined(FRUSTUM_CULLER_SSE)
+	return(4);
+#else
+	return(1);
+#endif
+}
+
+/***********************************************************
+ *  TransformBox()
+ *
+ *  This method is used for getting the world space box that
+ *  encloses a transformed local box.  The center is moved by
+ *  the model matrix and each world extent is the sum of the
+ *  local extents weighted by the absolute matrix entries, as
+ *  described by Arvo.
+ ***********************************************************/
+void FrustumCuller::TransformBox(
+	const glm::mat4& modelMatrix,
+	const glm::vec3& localMin,
+	const glm::vec3& localMax,
+	glm::vec3& worldCenter,
+	glm::vec3& worldExtent)
+{
+	glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+	glm::vec3 localExtent = (localMax - localMin) * 0.5f;
+
+	worldCenter = glm::vec3(modelMatrix * glm::vec4(localCenter, 1.0f));
+
+	for (int row = 0; row < 3; row++)
+	{
+		worldExtent[row] =
+			std::fabs(modelMatrix[0][row]) * localExtent.x +
+			std::fabs(modelMatrix[1][row]) * localExtent.y +
+			std::fabs(modelMatrix[2][row]) * localExtent.z;
+	}
+}
+
+/***********************************************************
+ *  CullBoxes()
+ *
+ *  This method is used for testing the boxes against the
+ *  frustum planes, eight at a time with AVX or four at a time
+ *  with SSE.  A box is culled when it lies completely on the
+ *  outer side of any plane.
+ ***********************************************************/
+size_t FrustumCuller::CullBoxes(const BOX_ARRAYS& boxes, unsigned char* pVisible) const
+{
+	const size_t count = boxes.Size();
+	size_t visibleCount = 0;
+	size_t i = 0;
+
+#if defined(FRUSTUM_CULLER_AVX)
+	{
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m256 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			planeX[plane] = _mm256_set1_ps(m_planes[plane].x);
+			planeY[plane] = _mm256_set1_ps(m_planes[plane].y);
+			planeZ[plane] = _mm256_set1_ps(m_planes[plane].z);
+			planeW[plane] = _mm256_set1_ps(m_planes[plane].w);
+			absPlaneX[plane] = _mm256_set1_ps(std::fabs(m_planes[plane].x));
+			absPlaneY[plane] = _mm256_set1_ps(std::fabs(m_planes[plane].y));
+			absPlaneZ[plane] = _mm256_set1_ps(std::fabs(m_planes[plane].z));
+		}
+		const __m256 zero = _mm256_setzero_ps();
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 centerX = _mm256_loadu_ps(&boxes.centerX[i]);
+			__m256 centerY = _mm256_loadu_ps(&boxes.centerY[i]);
+			__m256 centerZ = _mm256_loadu_ps(&boxes.centerZ[i]);
+			__m256 extentX = _mm256_loadu_ps(&boxes.extentX[i]);
+			__m256 extentY = _mm256_loadu_ps(&boxes.extentY[i]);
+			__m256 extentZ = _mm256_loadu_ps(&boxes.extentZ[i]);
+			__m256 outside = zero;
+
+			for (int plane = 0; plane < 6; plane++)
+			{
+				__m256 distance = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(centerX, planeX[plane]), _mm256_mul_ps(centerY, planeY[plane])),
+					_mm256_add_ps(_mm256_mul_ps(centerZ, planeZ[plane]), planeW[plane]));
+				__m256 radius = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(extentX, absPlaneX[plane]), _mm256_mul_ps(extentY, absPlaneY[plane])),
+					_mm256_mul_ps(extentZ, absPlaneZ[plane]));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+			}
+
+			int outsideMask = _mm256_movemask_ps(outside);
+			for (int lane = 0; lane < 8; lane++)
+			{
+				unsigned char bVisible = ((outsideMask >> lane) & 1) ? 0 : 1;
+				pVisible[i + lane] = bVisible;
+				visibleCount += bVisible;
+			}
+		}
+	}
+#endif
+
+#if defined(FRUSTUM_CULLER_SSE)
+	{
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		__m128 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			planeX[plane] = _mm_set1_ps(m_planes[plane].x);
+			planeY[plane] = _mm_set1_ps(m_planes[plane].y);
+			planeZ[plane] = _mm_set1_ps(m_planes[plane].z);
+			planeW[plane] = _mm_set1_ps(m_planes[plane].w);
+			absPlaneX[plane] = _mm_set1_ps(std::fabs(m_planes[plane].x));
+			absPlaneY[plane] = _mm_set1_ps(std::fabs(m_planes[plane].y));
+			absPlaneZ[plane] = _mm_set1_ps(std::fabs(m_planes[plane].z));
+		}
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 centerX = _mm_loadu_ps(&boxes.centerX[i]);
+			__m128 centerY = _mm_loadu_ps(&boxes.centerY[i]);
+			__m128 centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+			__m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+			__m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+			__m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+			__m128 outside = zero;
+
+			for (int plane = 0; plane < 6; plane++)
+			{
+				__m128 distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(centerX, planeX[plane]), _mm_mul_ps(centerY, planeY[plane])),
+					_mm_add_ps(_mm_mul_ps(centerZ, planeZ[plane]), planeW[plane]));
+				__m128 radius = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(extentX, absPlaneX[plane]), _mm_mul_ps(extentY, absPlaneY[plane])),
+					_mm_mul_ps(extentZ, absPlaneZ[plane]));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			int outsideMask = _mm_movemask_ps(outside);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				unsigned char bVisible = ((outsideMask >> lane) & 1) ? 0 : 1;
+				pVisible[i + lane] = bVisible;
+				visibleCount += bVisible;
+			}
+		}
+	}
+#endif
+
+	// the boxes left over at the end are tested one at a time
+	return(visibleCount + CullBoxRange(boxes, i, pVisible));
+}
+
+/***********************************************************
+ *  CullBoxesScalar()
+ *
+ *  This method is used for testing the boxes against the
+ *  frustum planes one box at a time.
+ ***********************************************************/
+size_t FrustumCuller::CullBoxesScalar(const BOX_ARRAYS& boxes, unsigned char* pVisible) const
+{
+	return(CullBoxRange(boxes, 0, pVisible));
+}
+
+/***********************************************************
+ *  CullBoxRange()
+ *
+ *  This method is used for testing the boxes from the first
+ *  passed in index to the end, one box at a time.
+ ***********************************************************/
+size_t FrustumCuller::CullBoxRange(
+	const BOX_ARRAYS& boxes,
+	size_t first,
+	unsigned char* pVisible) const
+{
+	const size_t count = boxes.Size();
+	size_t visibleCount = 0;
+
+	for (size_t i = first; i < count; i++)
+	{
+		unsigned char bVisible = 1;
+
+		for (int plane = 0; plane < 6; plane++)
+		{
+			const glm::vec4& p = m_planes[plane];
+			float distance = boxes.centerX[i] * p.x + boxes.centerY[i] * p.y + boxes.centerZ[i] * p.z + p.w;
+			float radius = boxes.extentX[i] * std::fabs(p.x) + boxes.extentY[i] * std::fabs(p.y) +
+				boxes.extentZ[i] * std::fabs(p.z);
+
+			if (distance + radius < 0.0f)
+			{
+				bVisible = 0;
+				break;
+			}
+		}
+
+		pVisible[i] = bVisible;
+		visibleCount += bVisible;
+	}
+
+	return(visibleCount);
+}
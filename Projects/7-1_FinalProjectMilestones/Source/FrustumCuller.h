@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustumculler.h
+// ============
+// test world space bounding boxes against the view frustum
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class contains the code for extracting the frustum
+ *  planes from a view-projection matrix and testing
+ *  axis-aligned bounding boxes against them, four or eight
+ *  boxes at a time with SSE or AVX.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// world space bounding boxes, stored as a structure of arrays
+	// so the SIMD test can load the same component of several
+	// boxes at once - entry i of every array belongs to box i
+	struct BOX_ARRAYS
+	{
+		std::vector<float> centerX;
+		std::vector<float> centerY;
+		std::vector<float> centerZ;
+		std::vector<float> extentX;
+		std::vector<float> extentY;
+		std::vector<float> extentZ;
+
+		size_t Size() const { return centerX.size(); }
+		void Resize(size_t count)
+		{
+			centerX.resize(count);
+			centerY.resize(count);
+			centerZ.resize(count);
+			extentX.resize(count);
+			extentY.resize(count);
+			extentZ.resize(count);
+		}
+		void Set(size_t index, const glm::vec3& center, const glm::vec3& extent)
+		{
+			centerX[index] = center.x;
+			centerY[index] = center.y;
+			centerZ[index] = center.z;
+			extentX[index] = extent.x;
+			extentY[index] = extent.y;
+			extentZ[index] = extent.z;
+		}
+	};
+
+	// constructor
+	FrustumCuller();
+
+	// extract the six frustum planes from the view-projection matrix
+	void SetViewProjection(const glm::mat4& viewProjection);
+
+	// test every box against the frustum and write 1 for the visible
+	// and 0 for the culled boxes into pVisible - returns the number
+	// of visible boxes
+	size_t CullBoxes(const BOX_ARRAYS& boxes, unsigned char* pVisible) const;
+	// the same test, one box at a time - kept for comparison
+	size_t CullBoxesScalar(const BOX_ARRAYS& boxes, unsigned char* pVisible) const;
+
+	// number of boxes that CullBoxes() tests at once
+	static int GetSimdWidth();
+
+	// get the world space box around a local box that is transformed
+	// by the model matrix, as a center and half extents
+	static void TransformBox(
+		const glm::mat4& modelMatrix,
+		const glm::vec3& localMin,
+		const glm::vec3& localMax,
+		glm::vec3& worldCenter,
+		glm::vec3& worldExtent);
+
+private:
+	// left, right, bottom, top, near and far planes - the normals
+	// point into the frustum and are normalized
+	glm::vec4 m_planes[6];
+
+	// test the boxes from index first on, one at a time
+	size_t CullBoxRange(
+		const BOX_ARRAYS& boxes,
+		size_t first,
+		unsigned char* pVisible) const;
+};
@@ -0,0 +1,229 @@
+///////////////////////////////////////////////////////////////////////////////
+// headlesscontext.cpp
+// ============
+// create an OpenGL context without a display window and render offscreen
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HeadlessContext.h"
+
+#include <iostream>
+
+#ifdef HEADLESS_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// older EGL headers do not know the Mesa surfaceless platform
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+// declaration of global variables
+namespace
+{
+#ifdef HEADLESS_USE_EGL
+	// core profile versions that are tried in order, newest first -
+	// the shaders are GLSL 4.40, so nothing older than 4.4 can run them
+	const EGLint CONTEXT_VERSIONS[][2] = { { 4, 6 }, { 4, 5 }, { 4, 4 } };
+#endif
+}
+
+/***********************************************************
+ *  HeadlessContext()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+HeadlessContext::HeadlessContext()
+{
+#ifdef HEADLESS_USE_EGL
+	m_display = NULL;
+	m_context = NULL;
+#else
+	m_pWindow = NULL;
+#endif
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~HeadlessContext()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+HeadlessContext::~HeadlessContext()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the OpenGL context and to
+ *  make it current.  With EGL no surface is created at all,
+ *  so the frames can only be rendered into the framebuffer
+ *  object from CreateFramebuffer().
+ ***********************************************************/
+bool HeadlessContext::Create(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+#ifdef HEADLESS_USE_EGL
+	// prefer the surfaceless platform, which needs neither an X server
+	// nor a GPU device, and fall back to the default display
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (NULL != getPlatformDisplay)
+	{
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (EGL_NO_DISPLAY == display)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if ((EGL_NO_DISPLAY == display) || (eglInitialize(display, NULL, NULL) == EGL_FALSE))
+	{
+		std::cout << "Failed to initialize the EGL display" << std::endl;
+		return(false);
+	}
+	m_display = display;
+
+	// any config that can render OpenGL - the frames go to a
+	// framebuffer object, so no surface type is required
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE };
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	if ((eglChooseConfig(display, configAttributes, &config, 1, &configCount) == EGL_FALSE) ||
+		(configCount == 0) ||
+		(eglBindAPI(EGL_OPENGL_API) == EGL_FALSE))
+	{
+		std::cout << "Failed to find an EGL config for OpenGL" << std::endl;
+		Destroy();
+		return(false);
+	}
+
+	EGLContext context = EGL_NO_CONTEXT;
+	for (size_t i = 0; (i < sizeof(CONTEXT_VERSIONS) / sizeof(CONTEXT_VERSIONS[0])) && (EGL_NO_CONTEXT == context); i++)
+	{
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION, CONTEXT_VERSIONS[i][0],
+			EGL_CONTEXT_MINOR_VERSION, CONTEXT_VERSIONS[i][1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+			EGL_NONE };
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	}
+	if (EGL_NO_CONTEXT == context)
+	{
+		std::cout << "Failed to create an EGL context - OpenGL 4.4 core profile or newer is required" << std::endl;
+		Destroy();
+		return(false);
+	}
+	m_context = context;
+
+	if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_FALSE)
+	{
+		std::cout << "Failed to make the EGL context current" << std::endl;
+		Destroy();
+		return(false);
+	}
+#else
+	// the context version hints were set when GLFW was initialized
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_pWindow = glfwCreateWindow(width, height, "headless", NULL, NULL);
+	if (NULL == m_pWindow)
+	{
+		std::cout << "Failed to create the hidden GLFW window" << std::endl;
+		return(false);
+	}
+	glfwMakeContextCurrent(m_pWindow);
+#endif
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateFramebuffer()
+ *
+ *  This method is used to create the offscreen framebuffer
+ *  and to bind it for drawing and reading.
+ ***********************************************************/
+bool HeadlessContext::CreateFramebuffer()
+{
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_width, m_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "The offscreen framebuffer is incomplete" << std::endl;
+		return(false);
+	}
+
+	glViewport(0, 0, m_width, m_height);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to release the offscreen framebuffer
+ *  and the context.
+ ***********************************************************/
+void HeadlessContext::Destroy()
+{
+	if (0 != m_framebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_colorBuffer)
+	{
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		m_colorBuffer = 0;
+	}
+	if (0 != m_depthBuffer)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+
+#ifdef HEADLESS_USE_EGL
+	if (NULL != m_display)
+	{
+		eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (NULL != m_context)
+		{
+			eglDestroyContext(m_display, m_context);
+			m_context = NULL;
+		}
+		eglTerminate(m_display);
+		m_display = NULL;
+	}
+#else
+	if (NULL != m_pWindow)
+	{
+		glfwDestroyWindow(m_pWindow);
+		m_pWindow = NULL;
+	}
+#endif
+}
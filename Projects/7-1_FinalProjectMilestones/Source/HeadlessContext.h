@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// headlesscontext.h
+// ============
+// create an OpenGL context without a display window and render offscreen
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// on Linux the context is created through EGL without any surface, which
+// also works on Mesa llvmpipe without an X server - the other platforms
+// fall back to a hidden GLFW window
+#if defined(__linux__)
+#define HEADLESS_USE_EGL
+#else
+#include "GLFW/glfw3.h"
+#endif
+
+/***********************************************************
+ *  HeadlessContext
+ *
+ *  This class contains the code for creating an OpenGL
+ *  context that is not tied to a visible window, along with
+ *  a framebuffer object of a fixed size that the frames are
+ *  rendered into and read back from.
+ ***********************************************************/
+class HeadlessContext
+{
+public:
+	// constructor
+	HeadlessContext();
+	// destructor
+	~HeadlessContext();
+
+	// create the context for frames of the given size and make it
+	// current - returns false if no context could be created
+	bool Create(int width, int height);
+	// create and bind the offscreen framebuffer - call after GLEW
+	// is initialized, since it needs the GL functions
+	bool CreateFramebuffer();
+	// release the framebuffer and the context
+	void Destroy();
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+private:
+#ifdef HEADLESS_USE_EGL
+	// EGL handles, kept as void pointers so the EGL headers are
+	// only needed by the source file
+	void* m_display;
+	void* m_context;
+#else
+	// hidden window that owns the context
+	GLFWwindow* m_pWindow;
+#endif
+
+	// offscreen framebuffer with a color and a depth-stencil buffer
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+};
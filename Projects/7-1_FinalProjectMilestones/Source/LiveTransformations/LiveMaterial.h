@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+class LiveMaterial
+{
+public:
+	std::string materialTag = "";
+
+	LiveMaterial(
+		const std::string materialTag,     // tag of the material in the SceneManager
+		float ambientR,  float ambientG,  float ambientB,  float ambientStrength,
+		float diffuseR,  float diffuseG,  float diffuseB,
+		float specularR, float specularG, float specularB, float shininess)
+		: materialTag(materialTag),
+		ambientStrength(ambientStrength),
+		shininess(shininess)
+	{
+		ambientColor[0] = ambientR;   ambientColor[1] = ambientG;   ambientColor[2] = ambientB;
+		diffuseColor[0] = diffuseR;   diffuseColor[1] = diffuseG;   diffuseColor[2] = diffuseB;
+		specularColor[0] = specularR; specularColor[1] = specularG; specularColor[2] = specularB;
+	}
+
+	// ADJUSTMENTS
+	float ambientColor[3];
+	float ambientStrength;
+	float diffuseColor[3];
+	float specularColor[3];
+	float shininess;
+
+	// set by the UI when a value was adjusted, cleared by
+	// the SceneManager once the change has been uploaded
+	bool dirty = false;
+};
@@ -98,6 +98,11 @@ void LiveTransformationUi::ShowUi()
     // set up the UI controls
 	ShowTransformationUiControls();
 
+    // set up the additional windows
+    for (size_t i = 0; i < this->panels.size(); i++) {
+        this->panels[i]();
+    }
+
     // render the UI
 	ImGui::Render();
 	int display_w, display_h;
@@ -159,7 +164,7 @@ void LiveTransformationUi::ShowTransformationUiControls() {
         ImGui::SetClipboardText(copyString.c_str());
     }
     if (ImGui::IsItemHovered()) {
-        ImGui::SetTooltip("Copy the TransformAndRender code block with current transformations");
+        ImGui::SetTooltip("Copy the AddSceneObject code block with current transformations");
     }
 
     // Label: "Adjust Scale" (Bold)
@@ -211,6 +216,52 @@ void LiveTransformationUi::ShowTransformationUiControls() {
     selectedXfmr->GcolorAdjusted = color.y;
     selectedXfmr->BcolorAdjusted = color.z;
     
+    ShowMaterialUiControls();
 
     ImGui::End();
+}
+
+void LiveTransformationUi::ShowMaterialUiControls() {
+
+    if (this->xfrms->getMaterialCount() == 0) {
+        return;
+    }
+
+    if (!ImGui::CollapsingHeader("Materials")) {
+        return;
+    }
+
+    if (this->selectedMaterialIndex >= this->xfrms->getMaterialCount())
+        this->selectedMaterialIndex = 0;
+
+    LiveMaterial* selectedMaterial = this->xfrms->getMaterial(this->selectedMaterialIndex);
+
+    if (ImGui::BeginCombo("##selected_material", selectedMaterial->materialTag.c_str(), ImGuiComboFlags_WidthFitPreview)) {
+        for (size_t i = 0; i < this->xfrms->getMaterialCount(); i++) {
+            if (ImGui::Selectable(this->xfrms->getMaterial(i)->materialTag.c_str(), i == this->selectedMaterialIndex)) {
+                this->selectedMaterialIndex = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Select which material to adjust");
+    }
+
+    selectedMaterial = this->xfrms->getMaterial(this->selectedMaterialIndex);
+
+    // any changed control marks the material so only its slot is re-uploaded
+    bool changed = false;
+
+    ImGui::PushItemWidth(200.0f);
+    changed |= ImGui::ColorEdit3("Ambient", selectedMaterial->ambientColor);
+    changed |= ImGui::SliderFloat("Ambient Strength", &selectedMaterial->ambientStrength, 0.0f, 1.0f);
+    changed |= ImGui::ColorEdit3("Diffuse", selectedMaterial->diffuseColor);
+    changed |= ImGui::ColorEdit3("Specular", selectedMaterial->specularColor);
+    changed |= ImGui::SliderFloat("Shininess", &selectedMaterial->shininess, 0.0f, 128.0f);
+    ImGui::PopItemWidth();
+
+    if (changed) {
+        selectedMaterial->dirty = true;
+    }
 }
\ No newline at end of file
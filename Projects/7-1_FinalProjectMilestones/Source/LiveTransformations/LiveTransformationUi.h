@@ -5,6 +5,8 @@
 #include <backends/imgui_impl_opengl3.h>
 #include <memory>
 #include <string>
+#include <vector>
+#include <functional>
 
 //#include "LiveTransformers.h"
 
@@ -17,11 +19,15 @@ private:
 	LiveTransformers* xfrms;
 
 	std::string selectedObjectName;
+	size_t selectedMaterialIndex = 0;
 
 	ImGuiIO io;
 
 	// set this to True to show the UI next render
 	bool shouldShowUi = false;
+
+	// additional windows shown along with the UI controls
+	std::vector<std::function<void()>> panels;
 public:
 
 	LiveTransformationUi(GLFWwindow* window, LiveTransformers* xfrms);
@@ -42,6 +48,11 @@ public:
 
 	void ShowTransformationUiControls();
 
+	void ShowMaterialUiControls();
+
+	// show an additional ImGui window whenever the UI is shown
+	void addPanel(std::function<void()> showPanel) { panels.push_back(showPanel); }
+
 	void selectObject(std::string objectName) { selectedObjectName = objectName; }
 	const std::string getSelectedObject() { return selectedObjectName; }
 
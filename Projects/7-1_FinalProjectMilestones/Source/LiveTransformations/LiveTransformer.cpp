@@ -12,9 +12,9 @@ std::string LiveTransformer::getTransformAndRenderCodeString()
 	// Set the precision to 2 decimal places and fixed point notation
 	oss << std::fixed << std::setprecision(2);
 
-	oss << "    TransformAndRender(" << std::endl
+	oss << "    AddSceneObject(" << std::endl
 	    << "        \"" << objectName << "\"," << std::endl
-	    << "        std::bind(&ShapeMeshes::Draw____Mesh, m_basicMeshes)," << std::endl
+	    << "        ShapeMeshes::MESH_____," << std::endl
 	    << "        //  x           y           z" << std::endl
 		<< "        " << std::setw(7) << XscaleAdjusted    << "f,   " << std::setw(7) << YscaleAdjusted    << "f,   " << std::setw(7) << ZscaleAdjusted    << "f,      // scale" << std::endl
 	    << "        " << std::setw(7) << XrotationAdjusted << "f,   " << std::setw(7) << YrotationAdjusted << "f,   " << std::setw(7) << ZrotationAdjusted << "f,      // rotation" << std::endl
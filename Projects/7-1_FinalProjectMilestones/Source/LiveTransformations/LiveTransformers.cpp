@@ -60,6 +60,37 @@ void LiveTransformers::RegisterNewObject(
 	objectNames.push_back(objectName);
 }
 
+void LiveTransformers::RegisterNewMaterial(
+	const std::string materialTag,
+	float ambientR,  float ambientG,  float ambientB,  float ambientStrength,
+	float diffuseR,  float diffuseG,  float diffuseB,
+	float specularR, float specularG, float specularB, float shininess)
+{
+	// silently ignore materials that were already registered
+	for (const auto& material : this->materials) {
+		if (material.materialTag == materialTag) {
+			return;
+		}
+	}
+
+	this->materials.push_back(LiveMaterial(
+		materialTag,
+		ambientR,  ambientG,  ambientB,  ambientStrength,
+		diffuseR,  diffuseG,  diffuseB,
+		specularR, specularG, specularB, shininess
+	));
+}
+
+LiveMaterial* LiveTransformers::getMaterial(size_t index)
+{
+	return &materials.at(index);
+}
+
+size_t LiveTransformers::getMaterialCount()
+{
+	return this->materials.size();
+}
+
 LiveTransformationUi& LiveTransformers::getUi()
 {
 	return this->ui;
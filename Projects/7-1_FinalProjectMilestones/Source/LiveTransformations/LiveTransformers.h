@@ -1,6 +1,7 @@
 #pragma once
 
 #include "LiveTransformer.h"
+#include "LiveMaterial.h"
 #include "LiveTransformationUi.h"
 
 #include <unordered_map>
@@ -13,6 +14,7 @@ class LiveTransformers
 private:
 	std::vector<std::string> objectNames;
 	std::unordered_map<std::string, LiveTransformer> objectTransformers;
+	std::vector<LiveMaterial> materials;
 	LiveTransformationUi ui;
 
 	
@@ -34,6 +36,19 @@ public:
 		float baseColorR,    float baseColorG,    float baseColorB       // color data
 	);
 
+	// register a material so it can be adjusted in the UI - materials
+	// are kept in registration order, matching the SceneManager's list
+	void RegisterNewMaterial(
+		const std::string materialTag,
+		float ambientR,  float ambientG,  float ambientB,  float ambientStrength,
+		float diffuseR,  float diffuseG,  float diffuseB,
+		float specularR, float specularG, float specularB, float shininess
+	);
+
+	LiveMaterial* getMaterial(size_t index);
+
+	size_t getMaterialCount();
+
 	LiveTransformationUi& getUi();
 
 	std::vector<std::string> getObjectNames();
@@ -1,5 +1,8 @@
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <cctype>           // isdigit
+#include <chrono>           // time to first frame
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -13,6 +16,9 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "SceneBenchmarks.h"
+#include "FrameProfiler.h"
+#include "GLStateCache.h"
 
 #ifdef _DEBUG
 #include "LiveTransformations/LiveTransformer.h"
@@ -39,7 +45,7 @@ namespace
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
-bool InitializeGLEW();
+bool InitializeGLEW(bool bHeadless);
 
 
 /***********************************************************
@@ -50,6 +56,175 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// the time to the first frame is measured from here
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+	// name of the benchmark to run instead of the interactive loop
+	const char* benchmarkName = NULL;
+	// file the per-frame profile is written to, if any
+	const char* profileCsvName = NULL;
+	// print the frame profile when the application closes
+	bool bPrintProfile = false;
+	// render offscreen without a display window
+	bool bHeadless = false;
+	// frames of the camera path that is flown in headless mode
+	int headlessFrames = 300;
+	// file the last headless frame is written to, if any
+	const char* headlessImageName = NULL;
+	// file the 3D scene is loaded from
+	const char* sceneFilename = "../../Utilities/scenes/desk-scene.yaml";
+	// load the scene from its compiled cache when it is up to date
+	bool bUseSceneCache = true;
+	// load the texture mip chains from their caches when they are up to date
+	bool bUseTextureCache = true;
+	// restore the linked shader program from its binary cache
+	bool bUseProgramCache = true;
+	// store the meshes in the compact vertex layout
+	bool bCompactVertices = false;
+	// reorder the mesh triangles and vertices for the vertex cache
+	bool bOptimizeMeshes = true;
+	// write the per-frame data into the persistently mapped ring buffer
+	bool bUsePersistentBuffers = true;
+	// draw the shapes with levels of detail at the level that matches
+	// their size on the screen
+	bool bUseLod = true;
+	// projected diameter in pixels below which a draw drops to LOD 1,
+	// halved for every further level - 0 keeps the defaults
+	float lodPixels = 0.0f;
+	// fraction of a threshold that the diameter has to cross it by
+	// before the level changes - negative keeps the default
+	float lodHysteresis = -1.0f;
+	// only write the texture caches of the scene and exit
+	bool bWarmTextureCache = false;
+	// block format and encoder quality of the textures
+	SceneManager::TextureCompression textureCompression = SceneManager::TEXTURE_COMPRESSION_NONE;
+	BlockCompressor::Quality compressionQuality = BlockCompressor::QUALITY_NORMAL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--benchmark") == 0) && (i + 1 < argc))
+		{
+			benchmarkName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			SceneBenchmarks::PrintBenchmarkNames();
+			return(EXIT_FAILURE);
+		}
+		else if ((strcmp(argv[i], "--profile-csv") == 0) && (i + 1 < argc))
+		{
+			profileCsvName = argv[++i];
+			bPrintProfile = true;
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			bPrintProfile = true;
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			bHeadless = true;
+			// the frame count is optional
+			if ((i + 1 < argc) && (isdigit((unsigned char)argv[i + 1][0]) != 0))
+			{
+				headlessFrames = atoi(argv[++i]);
+			}
+		}
+		else if ((strcmp(argv[i], "--headless-image") == 0) && (i + 1 < argc))
+		{
+			headlessImageName = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--scene") == 0) && (i + 1 < argc))
+		{
+			sceneFilename = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-scene-cache") == 0)
+		{
+			bUseSceneCache = false;
+		}
+		else if (strcmp(argv[i], "--no-texture-cache") == 0)
+		{
+			bUseTextureCache = false;
+		}
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+		{
+			bUseProgramCache = false;
+		}
+		else if (strcmp(argv[i], "--compact-vertices") == 0)
+		{
+			bCompactVertices = true;
+		}
+		else if (strcmp(argv[i], "--no-mesh-optimization") == 0)
+		{
+			bOptimizeMeshes = false;
+		}
+		else if (strcmp(argv[i], "--no-persistent-buffers") == 0)
+		{
+			bUsePersistentBuffers = false;
+		}
+		else if (strcmp(argv[i], "--no-lod") == 0)
+		{
+			bUseLod = false;
+		}
+		else if ((strcmp(argv[i], "--lod-pixels") == 0) && (i + 1 < argc))
+		{
+			lodPixels = (float)atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--lod-hysteresis") == 0) && (i + 1 < argc))
+		{
+			lodHysteresis = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--warm-texture-cache") == 0)
+		{
+			bWarmTextureCache = true;
+		}
+		else if ((strcmp(argv[i], "--compress-textures") == 0) && (i + 1 < argc))
+		{
+			// bc picks BC1 for RGB and BC3 for RGBA images
+			++i;
+			if (strcmp(argv[i], "bc") == 0)
+			{
+				textureCompression = SceneManager::TEXTURE_COMPRESSION_BC;
+			}
+			else if (strcmp(argv[i], "bc7") == 0)
+			{
+				textureCompression = SceneManager::TEXTURE_COMPRESSION_BC7;
+			}
+			else
+			{
+				std::cout << "Unknown texture compression '" << argv[i] << "', use bc or bc7" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--compression-quality") == 0) && (i + 1 < argc))
+		{
+			++i;
+			if (strcmp(argv[i], "fast") == 0)
+			{
+				compressionQuality = BlockCompressor::QUALITY_FAST;
+			}
+			else if (strcmp(argv[i], "normal") == 0)
+			{
+				compressionQuality = BlockCompressor::QUALITY_NORMAL;
+			}
+			else if (strcmp(argv[i], "high") == 0)
+			{
+				compressionQuality = BlockCompressor::QUALITY_HIGH;
+			}
+			else
+			{
+				std::cout << "Unknown compression quality '" << argv[i] << "', use fast, normal or high" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// the texture caches are written without any OpenGL context
+	if (bWarmTextureCache == true)
+	{
+		return((SceneManager::WarmTextureCache(sceneFilename, textureCompression, compressionQuality) == true) ?
+			EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -62,11 +237,28 @@ int main(int argc, char* argv[])
 	g_ViewManager = new ViewManager(
 		g_ShaderManager);
 
-	// try to create the main display window
-	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	if (bHeadless == true)
+	{
+		// try to create the offscreen context instead of a window
+		if (g_ViewManager->CreateHeadlessContext() == false)
+		{
+			return(EXIT_FAILURE);
+		}
+	}
+	else
+	{
+		// try to create the main display window
+		g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	}
 
 	// if GLEW fails initialization, then terminate the application
-	if (InitializeGLEW() == false)
+	if (InitializeGLEW(bHeadless) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// the frames of the offscreen context go to a framebuffer object
+	if ((bHeadless == true) && (g_ViewManager->GetHeadlessContext()->CreateFramebuffer() == false))
 	{
 		return(EXIT_FAILURE);
 	}
@@ -74,56 +266,184 @@ int main(int argc, char* argv[])
 	// load the shader code from the external GLSL files
 	g_ShaderManager->LoadShaders(
 		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+		"../../Utilities/shaders/fragmentShader.glsl",
+		bUseProgramCache);
 	g_ShaderManager->use();
 
-	// try to create a new scene manager object and prepare the 3D scene
+	// try to create a new scene manager object
 	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+	g_SceneManager->SetTextureCompression(textureCompression, compressionQuality);
+	g_SceneManager->SetMeshVertexFormat((bCompactVertices == true) ?
+		ShapeMeshes::VERTEX_FORMAT_COMPACT : ShapeMeshes::VERTEX_FORMAT_FLOAT);
+	g_SceneManager->SetOptimizeMeshes(bOptimizeMeshes);
+	g_SceneManager->SetPersistentBuffers(bUsePersistentBuffers);
+	g_SceneManager->SetLodSelection(bUseLod);
+	if (lodPixels > 0.0f)
+	{
+		const float lodThresholds[ShapeMeshes::MAX_MESH_LODS - 1] = { lodPixels, lodPixels / 2.0f, lodPixels / 4.0f };
+		g_SceneManager->SetLodThresholds(lodThresholds);
+	}
+	if (lodHysteresis >= 0.0f)
+	{
+		g_SceneManager->SetLodHysteresis(lodHysteresis);
+	}
+
+	// time the sections of every frame - the scene manager adds
+	// the stages of RenderScene() between view and ui
+	FrameProfiler profiler;
+	const int clearSection = profiler.AddSection("clear");
+	const int viewSection = profiler.AddSection("view");
+	g_SceneManager->SetProfiler(&profiler);
+#ifdef _DEBUG
+	const int uiSection = profiler.AddSection("ui");
+#endif
+	const int swapSection = profiler.AddSection("swap");
+	// count the state calls that were sent and that were skipped
+	const int stateCallsIssuedCounter = profiler.AddCounter("state_calls_issued");
+	const int stateCallsElidedCounter = profiler.AddCounter("state_calls_elided");
+	// count the shader variant switches
+	const int variantSwitchesCounter = profiler.AddCounter("shader_variant_switches");
+	if (NULL != profileCsvName)
+	{
+		profiler.OpenCsv(profileCsvName);
+	}
 
 #ifdef _DEBUG
 	// set up and wire up the transformation manager that allows the `ViewManager` to capture
-	// keypresses and send scale, translation, and rotation adjustments to the `SceneManager`
-	LiveTransformers xfmrs(g_Window);
+	// keypresses and send scale, translation, and rotation adjustments to the `SceneManager` -
+	// there is nothing to capture without a display window
+	LiveTransformers* pXfmrs = NULL;
+	if (NULL != g_Window)
+	{
+		pXfmrs = new LiveTransformers(g_Window);
 
-	g_SceneManager->xfmrs = &xfmrs;   // needs reference to access current adjustment amounts
+		g_SceneManager->xfmrs = pXfmrs;   // needs reference to access current adjustment amounts
+
+		// show the frame profile along with the transformation controls
+		pXfmrs->getUi().addPanel([&profiler]() { profiler.ShowUiPanel(); });
+	}
 #endif
 
+	// prepare the 3D scene - the scene objects are registered with
+	// the transformation manager when the scene is compiled
+	if (g_SceneManager->PrepareScene(sceneFilename, bUseSceneCache, bUseTextureCache) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	// run the requested benchmark, or fly the camera path when there
+	// is no display window, and skip the interactive loop
+	if ((NULL != benchmarkName) || (bHeadless == true))
+	{
+		// the measured frames must not include the texture streaming
+		g_SceneManager->FinishTextureUploads();
+
+		SceneBenchmarks benchmarks(g_SceneManager, g_ShaderManager, g_ViewManager);
+		if (NULL != benchmarkName)
+		{
+			benchmarks.Run(benchmarkName);
+		}
+		else
+		{
+			benchmarks.RunCameraPath(headlessFrames, headlessImageName);
+		}
+
+		if (NULL != g_Window)
+		{
+			glfwSetWindowShouldClose(g_Window, GLFW_TRUE);
+		}
+	}
+
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
+	bool bFirstFrame = true;
+	// the state calls and uniform uploads of the scene setup are
+	// not part of a frame
+	GLStateCache::BeginFrameStats();
+	g_ShaderManager->BeginFrameStats();
+	while ((NULL != g_Window) && !glfwWindowShouldClose(g_Window))
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		profiler.BeginFrame();
+
+		{
+			FrameProfiler::ScopedSection section(&profiler, clearSection);
+
+			// Enable z-depth
+			GLStateCache::Enable(GL_DEPTH_TEST);
+
+			// Clear the frame and z buffers
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
 
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		{
+			FrameProfiler::ScopedSection section(&profiler, viewSection);
 
-		// convert from 3D object space to 2D view
-		g_ViewManager->PrepareSceneView();
+			// convert from 3D object space to 2D view
+			g_ViewManager->PrepareSceneView();
+			g_SceneManager->SetViewParameters(
+				g_ViewManager->GetViewMatrix(),
+				g_ViewManager->GetProjectionMatrix(),
+				g_ViewManager->GetCameraPosition(),
+				g_ViewManager->GetViewportHeight());
+		}
 
 		// refresh the 3D scene
 		g_SceneManager->RenderScene();
 
 #ifdef _DEBUG
-		// TODO: clean this mess up
-		if (g_ViewManager->showTransformerUi) {
-			xfmrs.getUi().enableUi();
-		}
-		else {
-			xfmrs.getUi().disableUi();
+		{
+			FrameProfiler::ScopedSection section(&profiler, uiSection);
+
+			// TODO: clean this mess up
+			if (g_ViewManager->showTransformerUi) {
+				pXfmrs->getUi().enableUi();
+			}
+			else {
+				pXfmrs->getUi().disableUi();
+			}
+
+			pXfmrs->getUi().ShowUi();
 		}
-
-		xfmrs.getUi().ShowUi();
 #endif
 
+		{
+			FrameProfiler::ScopedSection section(&profiler, swapSection);
+
+			// Flips the the back buffer with the front buffer every frame.
+			glfwSwapBuffers(g_Window);
+		}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+		// the textures keep streaming in after the first frame
+		if (bFirstFrame == true)
+		{
+			std::cout << "Time to first frame: "
+				<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count()
+				<< " ms" << std::endl;
+			bFirstFrame = false;
+		}
 
 		// query the latest GLFW events
 		glfwPollEvents();
+
+		// the state calls of this frame move to the last frame stats
+		GLStateCache::BeginFrameStats();
+		profiler.SetCounter(stateCallsIssuedCounter, GLStateCache::GetLastFrameStats().callsIssued);
+		profiler.SetCounter(stateCallsElidedCounter, GLStateCache::GetLastFrameStats().callsElided);
+
+		// the uniform uploads and variant switches of this frame move
+		// to the last frame stats
+		g_ShaderManager->BeginFrameStats();
+		profiler.SetCounter(variantSwitchesCounter, g_ShaderManager->GetLastFrameStats().variantSwitches);
+
+		profiler.EndFrame();
+	}
+
+	// read the times of the last frames and report them
+	profiler.Finish();
+	if (bPrintProfile == true)
+	{
+		profiler.PrintSummary();
 	}
 
 	// clear the allocated manager objects from memory
@@ -132,6 +452,13 @@ int main(int argc, char* argv[])
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
+#ifdef _DEBUG
+	if (NULL != pXfmrs)
+	{
+		delete pXfmrs;
+		pXfmrs = NULL;
+	}
+#endif
 	if (NULL != g_ViewManager)
 	{
 		delete g_ViewManager;
@@ -178,8 +505,11 @@ bool InitializeGLFW()
  *	InitializeGLEW()
  *
  *  This function is used to initialize the GLEW library.
+ *  Without a display window there is no GLX display, so a
+ *  GLEW that is built for GLX reports an error after the GL
+ *  functions are already loaded - that error is ignored.
  ***********************************************************/
-bool InitializeGLEW()
+bool InitializeGLEW(bool bHeadless)
 {
 	// GLEW: initialize
 	// -----------------------------------------
@@ -187,6 +517,12 @@ bool InitializeGLEW()
 
 	// try to initialize the GLEW library
 	GLEWInitResult = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	if ((bHeadless == true) && (GLEW_ERROR_NO_GLX_DISPLAY == GLEWInitResult))
+	{
+		GLEWInitResult = GLEW_OK;
+	}
+#endif
 	if (GLEW_OK != GLEWInitResult)
 	{
 		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.cpp
+// ============
+// map a file read-only into memory
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#endif
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used to map the whole file read-only.
+ ***********************************************************/
+bool MappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == file)
+	{
+		return(false);
+	}
+	m_file = file;
+
+	LARGE_INTEGER fileSize;
+	if ((GetFileSizeEx(file, &fileSize) == FALSE) || (fileSize.QuadPart == 0))
+	{
+		Close();
+		return(false);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == mapping)
+	{
+		Close();
+		return(false);
+	}
+	m_mapping = mapping;
+
+	m_pData = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (NULL == m_pData)
+	{
+		Close();
+		return(false);
+	}
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return(false);
+	}
+
+	struct stat fileStat;
+	if ((fstat(file, &fileStat) != 0) || (fileStat.st_size == 0))
+	{
+		close(file);
+		return(false);
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	void* pData = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (MAP_FAILED == pData)
+	{
+		return(false);
+	}
+	m_pData = (const unsigned char*)pData;
+	m_size = (size_t)fileStat.st_size;
+#endif
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used to unmap the file.
+ ***********************************************************/
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (NULL != m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (NULL != m_mapping)
+	{
+		CloseHandle((HANDLE)m_mapping);
+		m_mapping = NULL;
+	}
+	if (INVALID_HANDLE_VALUE != m_file)
+	{
+		CloseHandle((HANDLE)m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (NULL != m_pData)
+	{
+		munmap((void*)m_pData, m_size);
+	}
+#endif
+
+	m_pData = NULL;
+	m_size = 0;
+}
+
+/***********************************************************
+ *  GetFileStamp()
+ *
+ *  This method is used to get the size and the last write
+ *  time of a file, which change whenever the file is saved.
+ *  The time is in the finest units the platform keeps, so
+ *  it is only meant to be compared for equality.
+ ***********************************************************/
+bool MappedFile::GetFileStamp(
+	const std::string& filename,
+	uint64_t& size,
+	int64_t& modifiedTime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes) == FALSE)
+	{
+		return(false);
+	}
+	size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	modifiedTime = (int64_t)(((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+		attributes.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat fileStat;
+	if (stat(filename.c_str(), &fileStat) != 0)
+	{
+		return(false);
+	}
+	size = (uint64_t)fileStat.st_size;
+#ifdef __APPLE__
+	modifiedTime = (int64_t)fileStat.st_mtimespec.tv_sec * 1000000000LL + fileStat.st_mtimespec.tv_nsec;
+#else
+	modifiedTime = (int64_t)fileStat.st_mtim.tv_sec * 1000000000LL + fileStat.st_mtim.tv_nsec;
+#endif
+#endif
+
+	return(true);
+}
@@ -0,0 +1,57 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// map a file read-only into memory
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class contains the code for mapping a whole file
+ *  read-only into the address space, so its contents can be
+ *  used in place without reading them into a buffer first.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map the file - returns false if it does not exist, is
+	// empty or could not be mapped
+	bool Open(const std::string& filename);
+	// unmap the file
+	void Close();
+
+	bool IsOpen() const { return NULL != m_pData; }
+	const unsigned char* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+	// get the size and the modification time of a file without
+	// opening it - returns false if the file does not exist
+	static bool GetFileStamp(
+		const std::string& filename,
+		uint64_t& size,
+		int64_t& modifiedTime);
+
+private:
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+
+	// the mapping can not be shared between two objects
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
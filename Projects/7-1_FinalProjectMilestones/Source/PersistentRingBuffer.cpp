@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+// persistentringbuffer.cpp
+// ============
+// write per-frame data straight into persistently mapped buffer memory
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PersistentRingBuffer.h"
+#include "GLStateCache.h"
+
+#include <chrono>
+
+// declaration of global variables
+namespace
+{
+	// the buffer is only written by the CPU, and the writes are
+	// seen by the GPU without flushing them
+	const GLbitfield MAP_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	// longest single wait on a fence, in nanoseconds - the wait
+	// is repeated until the fence signals
+	const GLuint64 FENCE_WAIT_NANOSECONDS = 100000000;
+}
+
+/***********************************************************
+ *  PersistentRingBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PersistentRingBuffer::PersistentRingBuffer()
+{
+	m_buffer = 0;
+	m_regionBytes = 0;
+	m_pMapped = NULL;
+	m_region = 0;
+	for (int i = 0; i < REGION_COUNT; i++)
+	{
+		m_fences[i] = NULL;
+	}
+	m_bRegionOpen = false;
+	m_stats.regionsWritten = 0;
+	m_stats.waits = 0;
+	m_stats.waitMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~PersistentRingBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PersistentRingBuffer::~PersistentRingBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used to create the immutable storage of
+ *  the buffer and to map all of it once.  The mapping stays
+ *  valid until Destroy() is called.
+ ***********************************************************/
+bool PersistentRingBuffer::Create(GLsizeiptr regionBytes)
+{
+	Destroy();
+
+	if (!(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) || (regionBytes <= 0))
+	{
+		return(false);
+	}
+
+	const GLsizeiptr bufferBytes = regionBytes * REGION_COUNT;
+
+	glGenBuffers(1, &m_buffer);
+	GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, bufferBytes, NULL, MAP_FLAGS);
+	m_pMapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bufferBytes, MAP_FLAGS);
+	GLStateCache::BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (NULL == m_pMapped)
+	{
+		Destroy();
+		return(false);
+	}
+
+	m_regionBytes = regionBytes;
+	// the first BeginRegion() moves to region 0
+	m_region = REGION_COUNT - 1;
+	m_bRegionOpen = false;
+	m_stats.regionsWritten = 0;
+	m_stats.waits = 0;
+	m_stats.waitMilliseconds = 0.0;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used to wait until the GPU is done with
+ *  every fenced region and to delete the buffer, which also
+ *  unmaps it.  OpenGL keeps the storage alive for the draws
+ *  of the last region that are still pending.
+ ***********************************************************/
+void PersistentRingBuffer::Destroy()
+{
+	for (int i = 0; i < REGION_COUNT; i++)
+	{
+		WaitForRegion(i);
+	}
+
+	if (m_buffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_pMapped = NULL;
+	m_regionBytes = 0;
+	m_bRegionOpen = false;
+}
+
+/***********************************************************
+ *  BeginRegion()
+ *
+ *  This method is used to move to the next region of the
+ *  ring.  The region of the frame before is fenced first,
+ *  so that its fence follows every command of that frame -
+ *  some drivers flush on a fence, and this way they flush
+ *  a whole frame instead of stalling in the middle of one.
+ *  The CPU only waits here when the GPU has not finished
+ *  the frame that wrote the next region REGION_COUNT frames
+ *  ago.
+ ***********************************************************/
+unsigned char* PersistentRingBuffer::BeginRegion()
+{
+	if (NULL == m_pMapped)
+	{
+		return(NULL);
+	}
+
+	if (m_bRegionOpen == true)
+	{
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	m_region = (m_region + 1) % REGION_COUNT;
+	WaitForRegion(m_region);
+	m_bRegionOpen = true;
+	m_stats.regionsWritten++;
+
+	return(m_pMapped + GetRegionOffset());
+}
+
+/***********************************************************
+ *  WaitForRegion()
+ *
+ *  This method is used to wait until the fence of a region
+ *  has signaled.  The fence is polled first, so that the
+ *  waits that block the CPU can be counted.
+ ***********************************************************/
+void PersistentRingBuffer::WaitForRegion(int region)
+{
+	GLsync fence = m_fences[region];
+	if (NULL == fence)
+	{
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// the first wait flushes the commands, so that the
+		// fence is sure to reach the GPU
+		GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		do
+		{
+			result = glClientWaitSync(fence, waitFlags, FENCE_WAIT_NANOSECONDS);
+			waitFlags = 0;
+		} while (result == GL_TIMEOUT_EXPIRED);
+
+		m_stats.waits++;
+		m_stats.waitMilliseconds += std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+	}
+
+	glDeleteSync(fence);
+	m_fences[region] = NULL;
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// persistentringbuffer.h
+// ============
+// write per-frame data straight into persistently mapped buffer memory
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  PersistentRingBuffer
+ *
+ *  This class contains the code for a buffer that is split
+ *  into REGION_COUNT regions of the same size and stays
+ *  mapped for its whole life, with glBufferStorage() and
+ *  the persistent and coherent map bits.  Every frame
+ *  writes its data into the next region, so the CPU fills
+ *  one region while the GPU still reads the regions of the
+ *  frames before.  A fence is placed after the commands of
+ *  the frame that wrote a region, and the region is only
+ *  written again once that fence has signaled.
+ ***********************************************************/
+class PersistentRingBuffer
+{
+public:
+	// frames that can be in flight - the CPU only waits when
+	// the GPU is this many frames behind
+	static const int REGION_COUNT = 3;
+
+	// counters of the fence waits since the buffer was created
+	struct RING_STATS
+	{
+		unsigned int regionsWritten;
+		unsigned int waits;             // regions whose fence had not signaled yet
+		double waitMilliseconds;        // time spent in those waits
+	};
+
+	// constructor
+	PersistentRingBuffer();
+	// destructor
+	~PersistentRingBuffer();
+
+	// create and map the buffer with REGION_COUNT regions of
+	// regionBytes each - returns false if the driver has no
+	// buffer storage or the buffer could not be mapped
+	bool Create(GLsizeiptr regionBytes);
+	// wait for the fences, unmap and delete the buffer
+	void Destroy();
+	bool IsCreated() const { return m_buffer != 0; }
+
+	// fence the region of the frame before, move to the next
+	// region and wait until the GPU is done reading it - call
+	// this once per frame, before the frame writes its data.
+	// Returns the mapped memory of the region
+	unsigned char* BeginRegion();
+
+	GLuint GetBuffer() const { return m_buffer; }
+	// bytes of one region
+	GLsizeiptr GetRegionBytes() const { return m_regionBytes; }
+	// index of the current region, and its offset in the buffer
+	int GetRegion() const { return m_region; }
+	GLintptr GetRegionOffset() const { return (GLintptr)m_region * m_regionBytes; }
+
+	RING_STATS GetStats() const { return m_stats; }
+
+private:
+	GLuint m_buffer;
+	GLsizeiptr m_regionBytes;
+	// start of the mapped buffer
+	unsigned char* m_pMapped;
+	// region the current frame writes into
+	int m_region;
+	// fence placed after the frame that wrote every region, or NULL
+	GLsync m_fences[REGION_COUNT];
+	// set while the current region has no fence yet
+	bool m_bRegionOpen;
+	RING_STATS m_stats;
+
+	// wait until the fence of a region has signaled, then delete it
+	void WaitForRegion(int region);
+};
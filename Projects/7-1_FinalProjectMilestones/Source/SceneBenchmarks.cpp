@@ -0,0 +1,1532 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebenchmarks.cpp
+// ============
+// measure the cost of the different scene rendering paths
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBenchmarks.h"
+#include "AllocationCounter.h"
+#include "GLStateCache.h"
+
+#include "stb_image.h"
+
+#include <GL/glew.h>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// frames that are rendered before the timing starts
+	const int BENCHMARK_WARMUP_FRAMES = 3;
+	// each measurement runs for at least this many frames and seconds
+	const int BENCHMARK_MIN_FRAMES = 10;
+	const int BENCHMARK_MAX_FRAMES = 1000;
+	const double BENCHMARK_MIN_SECONDS = 1.0;
+
+	// distance between the copies of the scene in a synthetic scene
+	const float SYNTHETIC_SCENE_SPACING = 6.0f;
+
+	// texture loads that are timed with each texture cache state
+	const int TEXTURE_CACHE_RUNS = 5;
+
+	// loads of every mesh in the mesh generation benchmark - the
+	// first one also grows the buffers that are reused
+	const int MESH_GENERATION_LOADS = 20;
+
+	// frames of the camera benchmark when no count is given
+	const int CAMERA_PATH_FRAMES = 300;
+	// the camera circles this point, starting from the default view
+	const glm::vec3 CAMERA_PATH_TARGET = glm::vec3(0.0f, 2.0f, 0.0f);
+	const float CAMERA_PATH_RADIUS = 12.0f;
+	const float CAMERA_PATH_HEIGHT = 3.0f;
+
+	typedef std::chrono::steady_clock BenchmarkClock;
+
+	double ElapsedMilliseconds(BenchmarkClock::time_point start, BenchmarkClock::time_point end)
+	{
+		return(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	// run a CPU-only piece of work repeatedly, like the frame loop,
+	// and return the average milliseconds per run
+	template <typename Work>
+	double TimeRepeated(Work work)
+	{
+		int runs = 0;
+		double total = 0.0;
+
+		while ((runs < BENCHMARK_MAX_FRAMES) &&
+			((runs < BENCHMARK_MIN_FRAMES) || (total < BENCHMARK_MIN_SECONDS * 1000.0)))
+		{
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			work();
+			total += ElapsedMilliseconds(start, BenchmarkClock::now());
+			runs++;
+		}
+
+		return(total / runs);
+	}
+
+	// value at the given fraction of the sorted values
+	double Percentile(const std::vector<double>& sortedValues, double fraction)
+	{
+		size_t index = (size_t)(fraction * (double)(sortedValues.size() - 1) + 0.5);
+		return(sortedValues[std::min(index, sortedValues.size() - 1)]);
+	}
+
+	// load the round shape with the given MeshID - the thickness
+	// is the tube radius of the torus
+	void LoadRoundMesh(ShapeMeshes& meshes, int meshID, float thickness)
+	{
+		switch (meshID)
+		{
+		case ShapeMeshes::MESH_CONE:				meshes.LoadConeMesh(); break;
+		case ShapeMeshes::MESH_CYLINDER:			meshes.LoadCylinderMesh(); break;
+		case ShapeMeshes::MESH_SPHERE:				meshes.LoadSphereMesh(); break;
+		case ShapeMeshes::MESH_TAPERED_CYLINDER:	meshes.LoadTaperedCylinderMesh(); break;
+		case ShapeMeshes::MESH_TORUS:				meshes.LoadTorusMesh(thickness); break;
+		default: break;
+		}
+	}
+
+	// 64-bit FNV-1a hash of a block of bytes
+	unsigned long long HashBytes(const unsigned char* pBytes, size_t size)
+	{
+		unsigned long long hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return(hash);
+	}
+}
+
+/***********************************************************
+ *  SceneBenchmarks()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBenchmarks::SceneBenchmarks(
+	SceneManager* pSceneManager,
+	ShaderManager* pShaderManager,
+	ViewManager* pViewManager)
+{
+	m_pSceneManager = pSceneManager;
+	m_pShaderManager = pShaderManager;
+	m_pViewManager = pViewManager;
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for running the benchmark with the
+ *  passed in name.
+ ***********************************************************/
+bool SceneBenchmarks::Run(const std::string& name)
+{
+	if ((NULL == m_pSceneManager) || (NULL == m_pShaderManager) || (NULL == m_pViewManager))
+	{
+		return(false);
+	}
+
+#ifdef _DEBUG
+	std::cout << "WARNING: benchmarking a debug build, the numbers are not representative" << std::endl;
+#endif
+
+	if (name == "drawlist")
+	{
+		BenchmarkDrawList();
+		return(true);
+	}
+	if (name == "instancing")
+	{
+		BenchmarkInstancing();
+		return(true);
+	}
+	if (name == "sorting")
+	{
+		BenchmarkSorting();
+		return(true);
+	}
+	if (name == "multidraw")
+	{
+		BenchmarkMultiDraw();
+		return(true);
+	}
+	if (name == "culling")
+	{
+		BenchmarkCulling();
+		return(true);
+	}
+	if (name == "transforms")
+	{
+		BenchmarkTransforms();
+		return(true);
+	}
+	if (name == "texturecache")
+	{
+		BenchmarkTextureCache();
+		return(true);
+	}
+	if (name == "compression")
+	{
+		BenchmarkCompression();
+		return(true);
+	}
+	if (name == "vertexformat")
+	{
+		BenchmarkVertexFormat();
+		return(true);
+	}
+	if (name == "meshcache")
+	{
+		BenchmarkMeshCache();
+		return(true);
+	}
+	if (name == "lod")
+	{
+		BenchmarkLod();
+		return(true);
+	}
+	if (name == "meshgen")
+	{
+		BenchmarkMeshGeneration();
+		return(true);
+	}
+	if (name == "ring")
+	{
+		BenchmarkPersistentBuffers();
+		return(true);
+	}
+	if (name == "camera")
+	{
+		RunCameraPath(CAMERA_PATH_FRAMES, NULL);
+		return(true);
+	}
+
+	std::cout << "Unknown benchmark '" << name << "'" << std::endl;
+	PrintBenchmarkNames();
+	return(false);
+}
+
+/***********************************************************
+ *  PrintBenchmarkNames()
+ *
+ *  This method is used for listing the available benchmarks.
+ ***********************************************************/
+void SceneBenchmarks::PrintBenchmarkNames()
+{
+	std::cout << "Available benchmarks:" << std::endl;
+	std::cout << "  drawlist      compiled draw list vs. immediate TransformAndRender()" << std::endl;
+	std::cout << "  instancing    instanced batches vs. one draw per object" << std::endl;
+	std::cout << "  sorting       render queue sort time and state changes saved" << std::endl;
+	std::cout << "  multidraw     multi-draw indirect calls vs. one draw per batch" << std::endl;
+	std::cout << "  culling       SIMD frustum culling vs. one box at a time" << std::endl;
+	std::cout << "  transforms    closed-form model matrices vs. chained matrix multiplies" << std::endl;
+	std::cout << "  texturecache  texture startup with cold vs. warm texture caches" << std::endl;
+	std::cout << "  compression   texture block compression speed and PSNR per format and quality" << std::endl;
+	std::cout << "  vertexformat  vertex bytes and frame times of the compact vs. float vertex layout" << std::endl;
+	std::cout << "  meshcache     vertex cache ACMR/ATVR and frame times of the reordered vs. original meshes" << std::endl;
+	std::cout << "  lod           triangles, frame times and LOD switches of screen-size LOD selection vs. LOD 0" << std::endl;
+	std::cout << "  meshgen       allocations and load times of the generated round meshes" << std::endl;
+	std::cout << "  ring          per-frame data written into a persistently mapped ring vs. glBufferData" << std::endl;
+	std::cout << "  camera        frame times, draw calls and image hash along a camera path" << std::endl;
+}
+
+/***********************************************************
+ *  RunCameraPath()
+ *
+ *  This method is used for rendering the scene from a camera
+ *  that flies a fixed path around it.  The camera only
+ *  depends on the frame number, so the same build renders
+ *  the same frames on every run and the hash of the last
+ *  frame can be compared between runs.  Every frame is
+ *  finished with glFinish() before the next one starts.
+ ***********************************************************/
+void SceneBenchmarks::RunCameraPath(int frameCount, const char* imageName)
+{
+	if (frameCount < 1)
+	{
+		frameCount = 1;
+	}
+
+	ShapeMeshes* pMeshes = m_pSceneManager->m_basicMeshes;
+	std::vector<double> frameMilliseconds;
+	frameMilliseconds.reserve(frameCount);
+	unsigned long long drawCallTotal = 0;
+	unsigned long long indirectCommandTotal = 0;
+	unsigned int drawCallsMin = 0;
+	unsigned int drawCallsMax = 0;
+	unsigned long long stateCallsIssuedTotal = 0;
+	unsigned long long stateCallsElidedTotal = 0;
+
+	glm::vec3 position;
+	glm::vec3 target;
+
+	// the warmup frames are rendered from the first pose and are not
+	// part of the results - the first frames also compile the shaders
+	for (int frame = -BENCHMARK_WARMUP_FRAMES; frame < frameCount; frame++)
+	{
+		GetCameraPathPose(std::max(frame, 0), frameCount, position, target);
+
+		m_pShaderManager->BeginFrameStats();
+		pMeshes->BeginFrameStats();
+		GLStateCache::BeginFrameStats();
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+
+		GLStateCache::Enable(GL_DEPTH_TEST);
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		m_pViewManager->PrepareSceneView(position, target);
+		m_pSceneManager->SetViewParameters(
+			m_pViewManager->GetViewMatrix(),
+			m_pViewManager->GetProjectionMatrix(),
+			m_pViewManager->GetCameraPosition(),
+			m_pViewManager->GetViewportHeight());
+		m_pSceneManager->RenderScene();
+		glFinish();
+
+		BenchmarkClock::time_point finished = BenchmarkClock::now();
+
+		if (frame < 0)
+		{
+			continue;
+		}
+
+		// the counters of this frame move to the last frame stats
+		pMeshes->BeginFrameStats();
+		ShapeMeshes::DRAW_STATS drawStats = pMeshes->GetLastFrameStats();
+		GLStateCache::BeginFrameStats();
+		GLStateCache::STATE_STATS stateStats = GLStateCache::GetLastFrameStats();
+
+		frameMilliseconds.push_back(ElapsedMilliseconds(start, finished));
+		drawCallTotal += drawStats.drawCalls;
+		indirectCommandTotal += drawStats.indirectCommands;
+		drawCallsMin = (frame == 0) ? drawStats.drawCalls : std::min(drawCallsMin, drawStats.drawCalls);
+		drawCallsMax = std::max(drawCallsMax, drawStats.drawCalls);
+		stateCallsIssuedTotal += stateStats.callsIssued;
+		stateCallsElidedTotal += stateStats.callsElided;
+	}
+
+	// read back the last frame
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	const int width = viewport[2];
+	const int height = viewport[3];
+	std::vector<unsigned char> pixels((size_t)width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(viewport[0], viewport[1], width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	unsigned long long imageHash = HashBytes(pixels.data(), pixels.size());
+
+	double frameTotal = 0.0;
+	for (size_t i = 0; i < frameMilliseconds.size(); i++)
+	{
+		frameTotal += frameMilliseconds[i];
+	}
+	std::vector<double> sortedMilliseconds = frameMilliseconds;
+	std::sort(sortedMilliseconds.begin(), sortedMilliseconds.end());
+
+	printf("\nCamera path: %d frames at %dx%d (%s)\n", frameCount, width, height, glGetString(GL_RENDERER));
+	printf("%10s  %9s  %9s  %9s  %9s  %9s  %9s\n", "", "min", "p50", "p95", "p99", "max", "mean");
+	printf("%10s  %9.3f  %9.3f  %9.3f  %9.3f  %9.3f  %9.3f\n", "frame ms",
+		sortedMilliseconds.front(),
+		Percentile(sortedMilliseconds, 0.50),
+		Percentile(sortedMilliseconds, 0.95),
+		Percentile(sortedMilliseconds, 0.99),
+		sortedMilliseconds.back(),
+		frameTotal / frameMilliseconds.size());
+	printf("Draw calls per frame: %.1f (min %u, max %u), indirect commands per frame: %.1f\n",
+		(double)drawCallTotal / frameCount, drawCallsMin, drawCallsMax,
+		(double)indirectCommandTotal / frameCount);
+	printf("State calls per frame: %.1f issued, %.1f elided\n",
+		(double)stateCallsIssuedTotal / frameCount, (double)stateCallsElidedTotal / frameCount);
+	printf("Final image hash: %016llx\n", imageHash);
+
+	if (NULL == imageName)
+	{
+		return;
+	}
+
+	// write the last frame as a binary PPM, top row first
+	FILE* file = fopen(imageName, "wb");
+	if (NULL == file)
+	{
+		std::cout << "Could not write the final image to " << imageName << std::endl;
+		return;
+	}
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			fwrite(&pixels[((size_t)y * width + x) * 4], 1, 3, file);
+		}
+	}
+	fclose(file);
+	std::cout << "Final image written to " << imageName << std::endl;
+}
+
+/***********************************************************
+ *  BenchmarkDrawList()
+ *
+ *  This method is used for comparing the compiled draw list
+ *  of RenderScene() against passing every object through
+ *  TransformAndRender() each frame.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkDrawList()
+{
+	CompareRenderPaths(RENDER_IMMEDIATE, RENDER_DRAWLIST, "immediate", "drawlist");
+}
+
+/***********************************************************
+ *  BenchmarkInstancing()
+ *
+ *  This method is used for comparing the instanced batches
+ *  against drawing every entry of the draw list on its own.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkInstancing()
+{
+	CompareRenderPaths(RENDER_DRAWLIST, RENDER_INSTANCED, "drawlist", "instanced");
+
+	std::cout << "Instanced batches in the original scene: " << m_pSceneManager->m_instanceBatches.size()
+		<< " for " << m_pSceneManager->m_batchedDraws.size() << " opaque draws" << std::endl;
+}
+
+/***********************************************************
+ *  BenchmarkSorting()
+ *
+ *  This method is used for measuring how long building and
+ *  sorting the render queue takes, and how many state
+ *  changes the sort order saves, on synthetic scenes of 10,
+ *  1k and 100k objects.  Both the single draws and the
+ *  instanced batches are measured.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkSorting()
+{
+	const size_t objectCounts[] = { 10, 1000, 100000 };
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+	bool bUseInstancing = m_pSceneManager->m_bUseInstancing;
+
+	if (baseObjects.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	m_pViewManager->PrepareSceneView();
+	m_pSceneManager->SetViewParameters(
+		m_pViewManager->GetViewMatrix(),
+		m_pViewManager->GetProjectionMatrix(),
+		m_pViewManager->GetCameraPosition(),
+		m_pViewManager->GetViewportHeight());
+
+	printf("\n%10s  %10s  %10s  %12s  %14s  %14s\n",
+		"objects", "queue", "items", "sort/frame", "state changes", "changes saved");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		for (int instanced = 0; instanced < 2; instanced++)
+		{
+			m_pSceneManager->m_bUseInstancing = (instanced != 0);
+
+			// sorting only touches the CPU, so it is timed on its own
+			int frames = 0;
+			double sortTotal = 0.0;
+			while ((frames < BENCHMARK_MAX_FRAMES) &&
+				((frames < BENCHMARK_MIN_FRAMES) || (sortTotal < BENCHMARK_MIN_SECONDS * 1000.0)))
+			{
+				BenchmarkClock::time_point start = BenchmarkClock::now();
+				m_pSceneManager->BuildRenderQueue();
+				sortTotal += ElapsedMilliseconds(start, BenchmarkClock::now());
+				frames++;
+			}
+
+			SceneManager::SORT_STATS stats = m_pSceneManager->GetLastFrameSortStats();
+			printf("%10u  %10s  %10u  %9.3f ms  %14u  %14u\n",
+				(unsigned int)objectCounts[i],
+				(instanced != 0) ? "instanced" : "drawlist",
+				stats.renderItems,
+				sortTotal / frames,
+				stats.stateChanges,
+				stats.stateChangesSaved);
+		}
+	}
+
+	// put the original scene back
+	m_pSceneManager->m_bUseInstancing = bUseInstancing;
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  BenchmarkMultiDraw()
+ *
+ *  This method is used for comparing the submission of the
+ *  render queue with multi-draw indirect calls from the
+ *  shared mesh buffers against one draw call per batch.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkMultiDraw()
+{
+	if (m_pSceneManager->m_bMultiDrawSupported == false)
+	{
+		std::cout << "Multi-draw indirect is not supported by this driver" << std::endl;
+		return;
+	}
+
+	CompareRenderPaths(RENDER_INSTANCED, RENDER_MULTIDRAW, "instanced", "multidraw");
+
+	std::cout << "Multi-draw calls in the last measured frame: " << m_pSceneManager->m_multiDrawCalls.size()
+		<< " for " << m_pSceneManager->m_indirectCommands.size() << " indirect commands" << std::endl;
+}
+
+/***********************************************************
+ *  BenchmarkCulling()
+ *
+ *  This method is used for comparing the SIMD frustum test
+ *  against testing the bounding boxes one at a time, on
+ *  synthetic scenes of 10, 1k and 100k objects seen from
+ *  the current camera.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkCulling()
+{
+	const size_t objectCounts[] = { 10, 1000, 100000 };
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+
+	if (baseObjects.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	m_pViewManager->PrepareSceneView();
+	m_pSceneManager->SetViewParameters(
+		m_pViewManager->GetViewMatrix(),
+		m_pViewManager->GetProjectionMatrix(),
+		m_pViewManager->GetCameraPosition(),
+		m_pViewManager->GetViewportHeight());
+
+	const FrustumCuller& culler = m_pSceneManager->m_frustumCuller;
+	std::vector<unsigned char> visible;
+
+	printf("\nSIMD width: %d boxes per test\n", FrustumCuller::GetSimdWidth());
+	printf("%10s  %10s  %10s  %12s  %12s  %9s\n",
+		"objects", "visible", "culled", "scalar", "simd", "speedup");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		const FrustumCuller::BOX_ARRAYS& boxes = m_pSceneManager->m_drawBounds;
+		visible.resize(boxes.Size());
+
+		double scalarMilliseconds = TimeRepeated([&]() { culler.CullBoxesScalar(boxes, visible.data()); });
+		double simdMilliseconds = TimeRepeated([&]() { culler.CullBoxes(boxes, visible.data()); });
+
+		m_pSceneManager->CullDrawList();
+		SceneManager::CULL_STATS stats = m_pSceneManager->GetLastFrameCullStats();
+
+		printf("%10u  %10u  %10u  %9.4f ms  %9.4f ms  %8.2fx\n",
+			(unsigned int)objectCounts[i],
+			stats.visible,
+			stats.culled,
+			scalarMilliseconds,
+			simdMilliseconds,
+			(simdMilliseconds > 0.0) ? scalarMilliseconds / simdMilliseconds : 0.0);
+	}
+
+	// put the original scene back
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  BenchmarkTransforms()
+ *
+ *  This method is used for comparing the closed-form model
+ *  matrix of ComposeModelMatrix() against multiplying the
+ *  separate scale, rotation and translation matrices, on the
+ *  transformations of synthetic scenes of 10, 1k and 100k
+ *  objects.  Every object gets a different rotation so that
+ *  no two matrices are the same.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkTransforms()
+{
+	const size_t objectCounts[] = { 10, 1000, 100000 };
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+
+	if (baseObjects.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	std::vector<glm::mat4> chainedMatrices;
+	std::vector<glm::mat4> closedFormMatrices;
+
+	printf("\n%10s  %14s  %14s  %9s  %12s\n",
+		"objects", "chained", "closed-form", "speedup", "max error");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		std::vector<SceneManager::SCENE_OBJECT>& objects = m_pSceneManager->m_sceneObjects;
+		for (size_t j = 0; j < objects.size(); j++)
+		{
+			objects[j].rotation += glm::vec3((float)(j % 360), (float)((j * 7) % 360), (float)((j * 13) % 360));
+		}
+
+		chainedMatrices.resize(objects.size());
+		closedFormMatrices.resize(objects.size());
+
+		double chainedMilliseconds = TimeRepeated([&]() {
+			for (size_t j = 0; j < objects.size(); j++)
+			{
+				chainedMatrices[j] = SceneManager::ComposeModelMatrixChained(
+					objects[j].scale, objects[j].rotation, objects[j].position);
+			}
+		});
+		double closedFormMilliseconds = TimeRepeated([&]() {
+			for (size_t j = 0; j < objects.size(); j++)
+			{
+				closedFormMatrices[j] = SceneManager::ComposeModelMatrix(
+					objects[j].scale, objects[j].rotation, objects[j].position);
+			}
+		});
+
+		// the two ways only differ by float rounding
+		float maxError = 0.0f;
+		for (size_t j = 0; j < objects.size(); j++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					maxError = std::max(maxError,
+						std::fabs(chainedMatrices[j][column][row] - closedFormMatrices[j][column][row]));
+				}
+			}
+		}
+
+		double nanosecondsPerMatrix = 1000000.0 / (double)objects.size();
+		printf("%10u  %8.2f ns/mat  %8.2f ns/mat  %8.2fx  %12.3g\n",
+			(unsigned int)objects.size(),
+			chainedMilliseconds * nanosecondsPerMatrix,
+			closedFormMilliseconds * nanosecondsPerMatrix,
+			(closedFormMilliseconds > 0.0) ? chainedMilliseconds / closedFormMilliseconds : 0.0,
+			maxError);
+	}
+
+	// put the original scene back
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  BenchmarkTextureCache()
+ *
+ *  This method is used for timing the texture startup of the
+ *  scene from the queueing of the images until every texture
+ *  is resident.  Without the cache every image is decoded
+ *  and its mip chain built, a cold cache adds writing the
+ *  cache files, and a warm cache maps them instead.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkTextureCache()
+{
+	if (m_pSceneManager->m_textures.empty())
+	{
+		std::cout << "The scene has no textures to benchmark" << std::endl;
+		return;
+	}
+
+	const char* modeNames[] = { "no cache", "cold cache", "warm cache" };
+	double minMilliseconds[3];
+	double averageMilliseconds[3];
+
+	for (int mode = 0; mode < 3; mode++)
+	{
+		minMilliseconds[mode] = 0.0;
+		averageMilliseconds[mode] = 0.0;
+
+		for (int run = 0; run < TEXTURE_CACHE_RUNS; run++)
+		{
+			// the warm runs find the caches the last cold run wrote
+			double milliseconds = ReloadTextures(mode != 0, mode == 1);
+			minMilliseconds[mode] = (run == 0) ? milliseconds : std::min(minMilliseconds[mode], milliseconds);
+			averageMilliseconds[mode] += milliseconds / TEXTURE_CACHE_RUNS;
+		}
+	}
+
+	printf("\n%d textures, %d loads each\n", (int)m_pSceneManager->m_textures.size(), TEXTURE_CACHE_RUNS);
+	printf("%12s  %12s  %12s  %9s\n", "", "min", "average", "speedup");
+	for (int mode = 0; mode < 3; mode++)
+	{
+		printf("%12s  %9.2f ms  %9.2f ms  %8.2fx\n",
+			modeNames[mode],
+			minMilliseconds[mode],
+			averageMilliseconds[mode],
+			(averageMilliseconds[mode] > 0.0) ? averageMilliseconds[0] / averageMilliseconds[mode] : 0.0);
+	}
+}
+
+/***********************************************************
+ *  BenchmarkCompression()
+ *
+ *  This method is used for timing the block compression of
+ *  the first level of every scene texture in each format it
+ *  can be stored in and at each encoder quality, together
+ *  with the PSNR of the result.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkCompression()
+{
+	const std::vector<SceneManager::TEXTURE_INFO>& textures = m_pSceneManager->m_textures;
+	if (textures.empty())
+	{
+		std::cout << "The scene has no textures to benchmark" << std::endl;
+		return;
+	}
+
+	printf("\n%-28s  %9s  %6s  %7s  %10s  %12s  %9s\n",
+		"texture", "size", "format", "quality", "time", "throughput", "PSNR");
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		TextureCache image;
+		if ((stbi_info(textures[i].filename.c_str(), &width, &height, &channels) == 0) ||
+			(image.Load(textures[i].filename, channels, BlockCompressor::FORMAT_NONE,
+				BlockCompressor::QUALITY_NORMAL, false) == false))
+		{
+			continue;
+		}
+
+		const BlockCompressor::Format formats[] = {
+			(channels == 4) ? BlockCompressor::FORMAT_BC3 : BlockCompressor::FORMAT_BC1,
+			BlockCompressor::FORMAT_BC7 };
+		for (size_t format = 0; format < sizeof(formats) / sizeof(formats[0]); format++)
+		{
+			std::vector<unsigned char> blocks(BlockCompressor::GetCompressedBytes(formats[format], width, height));
+			for (int quality = BlockCompressor::QUALITY_FAST; quality <= BlockCompressor::QUALITY_HIGH; quality++)
+			{
+				BenchmarkClock::time_point start = BenchmarkClock::now();
+				BlockCompressor::CompressImage(formats[format], (BlockCompressor::Quality)quality,
+					image.GetLevelData(0), width, height, channels, blocks.data());
+				double milliseconds = ElapsedMilliseconds(start, BenchmarkClock::now());
+
+				printf("%-28s  %4dx%-4d  %6s  %7s  %7.1f ms  %6.1f MPix/s  %6.2f dB\n",
+					textures[i].tag.c_str(),
+					width,
+					height,
+					BlockCompressor::GetFormatName(formats[format]),
+					BlockCompressor::GetQualityName((BlockCompressor::Quality)quality),
+					milliseconds,
+					(milliseconds > 0.0) ? (double)width * height / (milliseconds * 1000.0) : 0.0,
+					BlockCompressor::ComputePSNR(formats[format], image.GetLevelData(0), blocks.data(),
+						width, height, channels));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  BenchmarkVertexFormat()
+ *
+ *  This method is used for loading the meshes of the scene
+ *  in the float and in the compact vertex layout, reporting
+ *  the vertex buffer bytes that the compact layout saves for
+ *  every mesh, and timing both layouts on synthetic scenes
+ *  of 1k and 100k objects.  The vertex data per frame adds
+ *  up the vertex buffers of the draws that passed culling.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkVertexFormat()
+{
+	const ShapeMeshes::VertexFormat formats[] = { ShapeMeshes::VERTEX_FORMAT_FLOAT, ShapeMeshes::VERTEX_FORMAT_COMPACT };
+	const char* const formatNames[] = { "float", "compact" };
+	const std::vector<SceneFile::MESH_RECORD>& sceneMeshes = m_pSceneManager->m_sceneMeshes;
+
+	if (m_pSceneManager->m_sceneObjects.empty() || sceneMeshes.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	// both layouts are loaded next to the meshes of the scene
+	ShapeMeshes* pSceneMeshes = m_pSceneManager->m_basicMeshes;
+	ShapeMeshes formatMeshes[2];
+	for (int format = 0; format < 2; format++)
+	{
+		formatMeshes[format].SetVertexFormat(formats[format]);
+		LoadBenchmarkMeshes(formatMeshes[format]);
+	}
+
+	printf("\n%-18s  %9s  %12s  %12s  %17s\n", "mesh", "vertices", "float", "compact", "saved");
+
+	GLuint totalBytes[2] = { 0, 0 };
+	for (size_t i = 0; i < sceneMeshes.size(); i++)
+	{
+		ShapeMeshes::VERTEX_BUFFER_INFO info[2];
+		for (int format = 0; format < 2; format++)
+		{
+			info[format] = formatMeshes[format].GetVertexBufferInfo(sceneMeshes[i].meshID);
+			totalBytes[format] += info[format].vertexBytes;
+		}
+
+		printf("%-18s  %9u  %9u B  %9u B  %9u B %5.1f%%\n",
+			SceneFile::GetMeshName(sceneMeshes[i].meshID),
+			info[0].vertexCount,
+			info[0].vertexBytes,
+			info[1].vertexBytes,
+			info[0].vertexBytes - info[1].vertexBytes,
+			(info[0].vertexBytes > 0) ? 100.0 * (info[0].vertexBytes - info[1].vertexBytes) / info[0].vertexBytes : 0.0);
+	}
+	printf("%-18s  %9s  %9u B  %9u B  %9u B %5.1f%%\n",
+		"all meshes", "",
+		totalBytes[0],
+		totalBytes[1],
+		totalBytes[0] - totalBytes[1],
+		(totalBytes[0] > 0) ? 100.0 * (totalBytes[0] - totalBytes[1]) / totalBytes[0] : 0.0);
+	if (pSceneMeshes->HasSharedMeshBuffer() == true)
+	{
+		GLuint sharedBytes[2] = { formatMeshes[0].GetSharedVertexBytes(), formatMeshes[1].GetSharedVertexBytes() };
+		printf("%-18s  %9s  %9u B  %9u B  %9u B %5.1f%%\n",
+			"shared buffer", "",
+			sharedBytes[0],
+			sharedBytes[1],
+			sharedBytes[0] - sharedBytes[1],
+			(sharedBytes[0] > 0) ? 100.0 * (sharedBytes[0] - sharedBytes[1]) / sharedBytes[0] : 0.0);
+	}
+
+	CompareMeshes(formatMeshes, formatNames);
+
+	for (int format = 0; format < 2; format++)
+	{
+		formatMeshes[format].DestroyMeshes();
+	}
+}
+
+/***********************************************************
+ *  BenchmarkMeshCache()
+ *
+ *  This method is used for loading the meshes of the scene
+ *  with and without the vertex cache reordering, reporting
+ *  the ACMR (vertex shader runs per triangle) and the ATVR
+ *  (runs per vertex) of a 16 entry FIFO cache for every
+ *  shape in the shared buffers before and after it was
+ *  reordered, and timing both on synthetic scenes.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkMeshCache()
+{
+	const char* const optimizeNames[] = { "original", "reordered" };
+	const std::vector<SceneFile::MESH_RECORD>& sceneMeshes = m_pSceneManager->m_sceneMeshes;
+	ShapeMeshes* pSceneMeshes = m_pSceneManager->m_basicMeshes;
+
+	if (m_pSceneManager->m_sceneObjects.empty() || sceneMeshes.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+	if (pSceneMeshes->HasSharedMeshBuffer() == false)
+	{
+		std::cout << "The meshes are only reordered into the shared buffers of the multi-draw path, "
+			<< "which the driver does not support" << std::endl;
+		return;
+	}
+
+	ShapeMeshes optimizeMeshes[2];
+	double loadMilliseconds[2] = { 0.0, 0.0 };
+	for (int optimize = 0; optimize < 2; optimize++)
+	{
+		optimizeMeshes[optimize].SetVertexFormat(pSceneMeshes->GetVertexFormat());
+		optimizeMeshes[optimize].SetOptimizeMeshes(optimize == 1);
+
+		glFinish();
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		LoadBenchmarkMeshes(optimizeMeshes[optimize]);
+		loadMilliseconds[optimize] = ElapsedMilliseconds(start, BenchmarkClock::now());
+	}
+
+	printf("\n%-18s  %9s  %15s  %15s  %17s\n", "mesh", "triangles", "ACMR", "ATVR", "transforms");
+
+	unsigned int totalTransforms[2] = { 0, 0 };
+	for (size_t i = 0; i < sceneMeshes.size(); i++)
+	{
+		// the meshes that are reordered when they are loaded are
+		// only in their original order in the first set
+		const MeshOptimizer::CACHE_STATS& before = optimizeMeshes[0].GetSharedCacheStats(sceneMeshes[i].meshID).before;
+		const MeshOptimizer::CACHE_STATS& after = optimizeMeshes[1].GetSharedCacheStats(sceneMeshes[i].meshID).after;
+		totalTransforms[0] += before.transforms;
+		totalTransforms[1] += after.transforms;
+
+		printf("%-18s  %9u  %6.3f -> %5.3f  %6.3f -> %5.3f  %7u -> %6u\n",
+			SceneFile::GetMeshName(sceneMeshes[i].meshID),
+			before.triangles,
+			before.acmr,
+			after.acmr,
+			before.atvr,
+			after.atvr,
+			before.transforms,
+			after.transforms);
+	}
+	printf("%-18s  %9s  %15s  %15s  %7u -> %6u\n",
+		"all meshes", "", "", "",
+		totalTransforms[0],
+		totalTransforms[1]);
+	printf("\nLoading the meshes took %.3f ms without and %.3f ms with the reordering\n",
+		loadMilliseconds[0], loadMilliseconds[1]);
+
+	CompareMeshes(optimizeMeshes, optimizeNames);
+
+	for (int optimize = 0; optimize < 2; optimize++)
+	{
+		optimizeMeshes[optimize].DestroyMeshes();
+	}
+}
+
+/***********************************************************
+ *  BenchmarkLod()
+ *
+ *  This method is used for loading the meshes of the scene
+ *  with every level of detail and comparing the scene drawn
+ *  at LOD 0 against the levels picked from the size of the
+ *  objects on the screen, on synthetic scenes of 1k and
+ *  100k objects.  The LOD switches along the camera path
+ *  are counted without and with the hysteresis.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkLod()
+{
+	const std::vector<SceneFile::MESH_RECORD>& sceneMeshes = m_pSceneManager->m_sceneMeshes;
+
+	if (m_pSceneManager->m_sceneObjects.empty() || sceneMeshes.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	ShapeMeshes* pSceneMeshes = m_pSceneManager->m_basicMeshes;
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+	const bool bUseLod = m_pSceneManager->m_bUseLod;
+	const float lodHysteresis = m_pSceneManager->m_lodHysteresis;
+
+	ShapeMeshes lodMeshes;
+	lodMeshes.SetVertexFormat(pSceneMeshes->GetVertexFormat());
+	LoadBenchmarkMeshes(lodMeshes, ShapeMeshes::MAX_MESH_LODS);
+	m_pSceneManager->m_basicMeshes = &lodMeshes;
+
+	printf("\n%-18s  %9s  %9s  %9s  %9s\n", "mesh triangles", "LOD 0", "LOD 1", "LOD 2", "LOD 3");
+	for (size_t i = 0; i < sceneMeshes.size(); i++)
+	{
+		int meshID = sceneMeshes[i].meshID;
+		printf("%-18s", SceneFile::GetMeshName(meshID));
+		for (int lod = 0; lod < ShapeMeshes::MAX_MESH_LODS; lod++)
+		{
+			if (lod < lodMeshes.GetMeshLodCount(meshID))
+			{
+				printf("  %9u", lodMeshes.GetMeshTriangleCount(meshID, ShapeMeshes::PART_ALL, lod));
+			}
+			else
+			{
+				printf("  %9s", "-");
+			}
+		}
+		printf("\n");
+	}
+
+	// the scene is drawn the way it is rendered by default
+	const RenderPath renderPath = m_pSceneManager->m_bMultiDrawSupported ? RENDER_MULTIDRAW : RENDER_INSTANCED;
+	const size_t objectCounts[] = { 1000, 100000 };
+	const char* const lodNames[] = { "LOD 0", "by size" };
+
+	printf("\n%10s  %8s  %18s  %18s  %12s  %9s\n",
+		"objects", "LOD", "triangles", "saved", "frame", "speedup");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		double frameMilliseconds[2] = { 0.0, 0.0 };
+		for (int select = 0; select < 2; select++)
+		{
+			m_pSceneManager->m_bUseLod = (select == 1);
+			FRAME_TIMING timing = TimeFrames(renderPath);
+			frameMilliseconds[select] = timing.frameMilliseconds;
+
+			// the view does not move, so the last frame stands for all
+			SceneManager::LOD_STATS stats = m_pSceneManager->GetLastFrameLodStats();
+			printf("%10u  %8s  %11u/frame  %11u/frame  %9.3f ms  %8.2fx\n",
+				(unsigned int)objectCounts[i],
+				lodNames[select],
+				stats.trianglesSubmitted,
+				stats.trianglesSaved,
+				timing.frameMilliseconds,
+				(frameMilliseconds[select] > 0.0) ? frameMilliseconds[0] / frameMilliseconds[select] : 0.0);
+		}
+	}
+
+	// without the hysteresis the objects whose size on the screen
+	// hovers around a threshold switch back and forth
+	const float hysteresisValues[] = { 0.0f, lodHysteresis };
+	BuildSyntheticScene(baseObjects, objectCounts[0]);
+	m_pSceneManager->m_bUseLod = true;
+
+	printf("\n%10u objects along the camera path, %d frames\n", (unsigned int)objectCounts[0], CAMERA_PATH_FRAMES);
+	printf("%12s  %14s  %16s\n", "hysteresis", "LOD switches", "switches/frame");
+
+	for (int i = 0; i < 2; i++)
+	{
+		m_pSceneManager->m_lodHysteresis = hysteresisValues[i];
+
+		unsigned long long switches = 0;
+		glm::vec3 position;
+		glm::vec3 target;
+		for (int frame = -BENCHMARK_WARMUP_FRAMES; frame < CAMERA_PATH_FRAMES; frame++)
+		{
+			GetCameraPathPose(std::max(frame, 0), CAMERA_PATH_FRAMES, position, target);
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			m_pViewManager->PrepareSceneView(position, target);
+			m_pSceneManager->SetViewParameters(
+				m_pViewManager->GetViewMatrix(),
+				m_pViewManager->GetProjectionMatrix(),
+				m_pViewManager->GetCameraPosition(),
+				m_pViewManager->GetViewportHeight());
+			m_pSceneManager->RenderScene();
+
+			if (frame >= 0)
+			{
+				switches += m_pSceneManager->GetLastFrameLodStats().lodChanges;
+			}
+		}
+		glFinish();
+
+		printf("%11.0f%%  %14llu  %16.2f\n",
+			hysteresisValues[i] * 100.0f,
+			switches,
+			(double)switches / CAMERA_PATH_FRAMES);
+	}
+
+	// put the original scene back
+	m_pSceneManager->m_bUseLod = bUseLod;
+	m_pSceneManager->m_lodHysteresis = lodHysteresis;
+	m_pSceneManager->m_basicMeshes = pSceneMeshes;
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+
+	lodMeshes.DestroyMeshes();
+}
+
+/***********************************************************
+ *  BenchmarkMeshGeneration()
+ *
+ *  This method is used for counting the allocations and
+ *  timing the loads of the round meshes, with the torus at
+ *  several thicknesses, and of their levels of detail.
+ *  Every mesh is loaded repeatedly into the same shapes, so
+ *  the first load also grows the buffers that are reused
+ *  and the reloads only show the allocations of the mesh
+ *  generation.  The meshes are reordered for the vertex
+ *  cache as in the program, so its scratch memory is
+ *  counted as well.  A reload that takes more than one
+ *  allocation for every generated mesh is reported as a
+ *  failure.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkMeshGeneration()
+{
+	struct GENERATED_MESH
+	{
+		const char* name;
+		int meshID;
+		float thickness;      // tube radius of the torus
+		bool bLods;           // count the generation of LOD 1-3 only
+	};
+	const GENERATED_MESH generatedMeshes[] = {
+		{ "sphere",				ShapeMeshes::MESH_SPHERE,			0.0f,	false },
+		{ "torus 0.1",			ShapeMeshes::MESH_TORUS,			0.1f,	false },
+		{ "torus 0.25",			ShapeMeshes::MESH_TORUS,			0.25f,	false },
+		{ "torus 0.5",			ShapeMeshes::MESH_TORUS,			0.5f,	false },
+		{ "cone",				ShapeMeshes::MESH_CONE,				0.0f,	false },
+		{ "cylinder",			ShapeMeshes::MESH_CYLINDER,			0.0f,	false },
+		{ "tapered cylinder",	ShapeMeshes::MESH_TAPERED_CYLINDER,	0.0f,	false },
+		{ "sphere LOD 1-3",		ShapeMeshes::MESH_SPHERE,			0.0f,	true },
+		{ "torus LOD 1-3",		ShapeMeshes::MESH_TORUS,			0.1f,	true },
+		{ "cylinder LOD 1-3",	ShapeMeshes::MESH_CYLINDER,			0.0f,	true },
+	};
+
+	printf("\n%-18s  %9s  %11s  %11s  %12s  %s\n", "mesh", "vertices", "first load", "reload", "load", "check");
+	bool bAllPassed = true;
+
+	for (size_t i = 0; i < sizeof(generatedMeshes) / sizeof(generatedMeshes[0]); i++)
+	{
+		const GENERATED_MESH& generated = generatedMeshes[i];
+
+		ShapeMeshes meshes;
+		meshes.SetVertexFormat(m_pSceneManager->m_basicMeshes->GetVertexFormat());
+		meshes.SetOptimizeMeshes(m_pSceneManager->m_basicMeshes->GetOptimizeMeshes());
+
+		unsigned long long firstAllocations = 0;
+		unsigned long long reloadAllocations = 0;
+		double loadTotal = 0.0;
+		GLuint vertexCount = 0;
+
+		for (int load = 0; load < MESH_GENERATION_LOADS; load++)
+		{
+			// the levels of detail are generated for a loaded shape
+			if (generated.bLods == true)
+			{
+				LoadRoundMesh(meshes, generated.meshID, generated.thickness);
+			}
+
+			unsigned long long allocations = AllocationCounter::GetCount();
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			if (generated.bLods == true)
+			{
+				meshes.LoadMeshLods(generated.meshID, ShapeMeshes::MAX_MESH_LODS);
+			}
+			else
+			{
+				LoadRoundMesh(meshes, generated.meshID, generated.thickness);
+			}
+			loadTotal += ElapsedMilliseconds(start, BenchmarkClock::now());
+			allocations = AllocationCounter::GetCount() - allocations;
+
+			if (load == 0)
+			{
+				firstAllocations = allocations;
+			}
+			else
+			{
+				reloadAllocations += allocations;
+			}
+
+			vertexCount = meshes.GetVertexBufferInfo(generated.meshID).vertexCount;
+			meshes.DestroyMeshes();
+		}
+
+		// every load generates LOD 1-3 or the one mesh
+		const unsigned long long meshesPerLoad = (generated.bLods == true) ? ShapeMeshes::MAX_MESH_LODS - 1 : 1;
+		const bool bPassed = (reloadAllocations <= meshesPerLoad * (MESH_GENERATION_LOADS - 1));
+		bAllPassed = bAllPassed && bPassed;
+
+		printf("%-18s  %9s  %11llu  %11.1f  %9.3f ms  %s\n",
+			generated.name,
+			(generated.bLods == true) ? "-" : std::to_string(vertexCount).c_str(),
+			firstAllocations,
+			(double)reloadAllocations / (MESH_GENERATION_LOADS - 1),
+			loadTotal / MESH_GENERATION_LOADS,
+			(bPassed == true) ? "ok" : "FAILED");
+	}
+
+	std::cout << std::endl << ((bAllPassed == true) ?
+		"Every reload made at most one allocation per mesh" :
+		"FAILED: a reload made more than one allocation per mesh") << std::endl;
+}
+
+/***********************************************************
+ *  BenchmarkPersistentBuffers()
+ *
+ *  This method is used for timing the instanced and the
+ *  multi-draw paths with their per-frame data uploaded with
+ *  glBufferData() and written into the persistently mapped
+ *  ring, on synthetic scenes of growing size.  The instance
+ *  data is written every frame, as if every object moved.
+ *  The frames are finished one at a time, so the ring
+ *  should never have to wait on a fence here.
+ ***********************************************************/
+void SceneBenchmarks::BenchmarkPersistentBuffers()
+{
+	const size_t objectCounts[] = { 10, 1000, 100000 };
+	const RenderPath renderPaths[] = { RENDER_INSTANCED, RENDER_MULTIDRAW };
+	const char* const pathNames[] = { "instanced", "multidraw" };
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+	const bool bUseDynamicRing = m_pSceneManager->m_bUseDynamicRing;
+
+	if (baseObjects.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	m_pSceneManager->SetPersistentBuffers(true);
+	if (m_pSceneManager->m_dynamicRing.IsCreated() == false)
+	{
+		std::cout << "Persistent buffer storage is not supported by this driver" << std::endl;
+		m_pSceneManager->SetPersistentBuffers(bUseDynamicRing);
+		return;
+	}
+
+	printf("\n%10s  %10s  %12s submit/frame  %12s submit/frame  %9s  %11s\n",
+		"objects", "path", "glBufferData", "ring", "speedup", "waits/frame");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		for (size_t path = 0; path < sizeof(renderPaths) / sizeof(renderPaths[0]); path++)
+		{
+			if ((renderPaths[path] == RENDER_MULTIDRAW) && (m_pSceneManager->m_bMultiDrawSupported == false))
+			{
+				continue;
+			}
+
+			m_pSceneManager->SetPersistentBuffers(false);
+			FRAME_TIMING uploaded = TimeFrames(renderPaths[path], true);
+
+			m_pSceneManager->SetPersistentBuffers(true);
+			PersistentRingBuffer::RING_STATS before = m_pSceneManager->GetRingStats();
+			FRAME_TIMING mapped = TimeFrames(renderPaths[path], true);
+			PersistentRingBuffer::RING_STATS after = m_pSceneManager->GetRingStats();
+
+			printf("%10u  %10s  %22.3f ms  %22.3f ms  %8.2fx  %11.2f\n",
+				(unsigned int)objectCounts[i],
+				pathNames[path],
+				uploaded.submitMilliseconds,
+				mapped.submitMilliseconds,
+				(mapped.submitMilliseconds > 0.0) ? uploaded.submitMilliseconds / mapped.submitMilliseconds : 0.0,
+				(double)(after.waits - before.waits) / std::max(after.regionsWritten - before.regionsWritten, 1u));
+			printf("%10s  %10s  %19.3f ms total  %19.3f ms total  (%d/%d frames)\n",
+				"",
+				"",
+				uploaded.frameMilliseconds,
+				mapped.frameMilliseconds,
+				uploaded.frames,
+				mapped.frames);
+		}
+	}
+
+	// put the original scene back
+	m_pSceneManager->SetPersistentBuffers(bUseDynamicRing);
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  LoadBenchmarkMeshes()
+ *
+ *  This method is used for loading the meshes of the scene
+ *  into the passed in shapes, next to the meshes that the
+ *  scene is drawn with.  The round shapes get at least the
+ *  passed in number of levels of detail.  The shared
+ *  buffers are built when the scene has them.
+ ***********************************************************/
+void SceneBenchmarks::LoadBenchmarkMeshes(ShapeMeshes& meshes, int lodCount)
+{
+	m_pSceneManager->LoadMeshes(&meshes);
+	for (size_t i = 0; (lodCount > 1) && (i < m_pSceneManager->m_sceneMeshes.size()); i++)
+	{
+		meshes.LoadMeshLods(m_pSceneManager->m_sceneMeshes[i].meshID, lodCount);
+	}
+	if (m_pSceneManager->m_basicMeshes->HasSharedMeshBuffer() == true)
+	{
+		meshes.BuildSharedMeshBuffer();
+	}
+	meshes.AttachInstanceBuffer(m_pSceneManager->m_instanceBuffer);
+}
+
+/***********************************************************
+ *  CompareMeshes()
+ *
+ *  This method is used for timing the scene drawn from each
+ *  of the two passed in sets of meshes on synthetic scenes
+ *  of 1k and 100k objects.  The vertex data per frame adds
+ *  up the vertex buffers of the draws that passed culling.
+ *  The meshes and the objects of the scene are put back
+ *  afterwards.
+ ***********************************************************/
+void SceneBenchmarks::CompareMeshes(
+	ShapeMeshes meshes[2],
+	const char* const names[2])
+{
+	const size_t objectCounts[] = { 1000, 100000 };
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+	ShapeMeshes* pSceneMeshes = m_pSceneManager->m_basicMeshes;
+
+	// the scene is drawn the way it is rendered by default
+	const RenderPath renderPath = m_pSceneManager->m_bMultiDrawSupported ? RENDER_MULTIDRAW : RENDER_INSTANCED;
+
+	printf("\n%10s  %10s  %16s  %12s  %12s  %9s\n",
+		"objects", "meshes", "vertex data", "submit", "frame", "speedup");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		double frameMilliseconds[2] = { 0.0, 0.0 };
+		for (int set = 0; set < 2; set++)
+		{
+			m_pSceneManager->m_basicMeshes = &meshes[set];
+			FRAME_TIMING timing = TimeFrames(renderPath);
+			frameMilliseconds[set] = timing.frameMilliseconds;
+
+			// the vertices the draws of the last frame read
+			double vertexBytes = 0.0;
+			const SceneManager::DRAW_LIST& drawList = m_pSceneManager->m_drawList;
+			for (size_t draw = 0; draw < drawList.Size(); draw++)
+			{
+				if ((draw < m_pSceneManager->m_drawVisible.size()) && (m_pSceneManager->m_drawVisible[draw] == 0))
+				{
+					continue;
+				}
+				vertexBytes += meshes[set].GetVertexBufferInfo(drawList.meshIDs[draw]).vertexBytes;
+			}
+
+			printf("%10u  %10s  %8.2f MB/frame  %9.3f ms  %9.3f ms  %8.2fx\n",
+				(unsigned int)objectCounts[i],
+				names[set],
+				vertexBytes / (1024.0 * 1024.0),
+				timing.submitMilliseconds,
+				timing.frameMilliseconds,
+				(frameMilliseconds[set] > 0.0) ? frameMilliseconds[0] / frameMilliseconds[set] : 0.0);
+		}
+	}
+
+	// put the original scene back
+	m_pSceneManager->m_basicMeshes = pSceneMeshes;
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  ReloadTextures()
+ *
+ *  This method is used for destroying the textures of the
+ *  scene and loading them again through the same path as
+ *  PrepareScene(), optionally deleting their texture caches
+ *  first.  The draw list is pointed at the new texture
+ *  arrays once they are resident.
+ ***********************************************************/
+double SceneBenchmarks::ReloadTextures(bool bUseTextureCache, bool bClearTextureCache)
+{
+	std::vector<SceneManager::TEXTURE_INFO> textures = m_pSceneManager->m_textures;
+
+	m_pSceneManager->DestroyGLTextures();
+	m_pSceneManager->m_textures.clear();
+	m_pSceneManager->m_textureHandles.clear();
+
+	if (bClearTextureCache == true)
+	{
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			remove(TextureCache::GetCacheFilename(textures[i].filename).c_str());
+		}
+	}
+
+	glFinish();
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+
+	const bool bPreviousUseTextureCache = m_pSceneManager->m_bUseTextureCache;
+	m_pSceneManager->m_bUseTextureCache = bUseTextureCache;
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		m_pSceneManager->CreateGLTexture(textures[i].filename.c_str(), textures[i].tag);
+	}
+	m_pSceneManager->BindGLTextures();
+	m_pSceneManager->FinishTextureUploads();
+	m_pSceneManager->m_bUseTextureCache = bPreviousUseTextureCache;
+
+	glFinish();
+	return(ElapsedMilliseconds(start, BenchmarkClock::now()));
+}
+
+/***********************************************************
+ *  CompareRenderPaths()
+ *
+ *  This method is used for timing two rendering paths on
+ *  synthetic scenes of 10, 1k and 100k objects.  The
+ *  original scene is restored afterwards.
+ ***********************************************************/
+void SceneBenchmarks::CompareRenderPaths(
+	RenderPath firstPath,
+	RenderPath secondPath,
+	const char* firstName,
+	const char* secondName)
+{
+	const size_t objectCounts[] = { 10, 1000, 100000 };
+	const std::vector<SceneManager::SCENE_OBJECT> baseObjects = m_pSceneManager->m_sceneObjects;
+
+	if (baseObjects.empty())
+	{
+		std::cout << "The scene has no objects to benchmark" << std::endl;
+		return;
+	}
+
+	printf("\n%10s  %15s submit/frame  %15s submit/frame  %9s  %17s\n",
+		"objects", firstName, secondName, "speedup", "uploads/frame");
+
+	for (size_t i = 0; i < sizeof(objectCounts) / sizeof(objectCounts[0]); i++)
+	{
+		BuildSyntheticScene(baseObjects, objectCounts[i]);
+
+		FRAME_TIMING first = TimeFrames(firstPath);
+		FRAME_TIMING second = TimeFrames(secondPath);
+
+		printf("%10u  %25.3f ms  %25.3f ms  %8.2fx  %8.0f/%-8.0f\n",
+			(unsigned int)objectCounts[i],
+			first.submitMilliseconds,
+			second.submitMilliseconds,
+			(second.submitMilliseconds > 0.0) ? first.submitMilliseconds / second.submitMilliseconds : 0.0,
+			first.uniformUploads,
+			second.uniformUploads);
+		printf("%10s  %22.3f ms total  %22.3f ms total  (%d/%d frames)\n",
+			"",
+			first.frameMilliseconds,
+			second.frameMilliseconds,
+			first.frames,
+			second.frames);
+	}
+
+	// put the original scene back
+	m_pSceneManager->m_sceneObjects = baseObjects;
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  BuildSyntheticScene()
+ *
+ *  This method is used for replacing the scene objects with
+ *  objectCount objects, made by copying the passed in objects
+ *  onto a grid, and compiling them into the draw list.
+ ***********************************************************/
+void SceneBenchmarks::BuildSyntheticScene(
+	const std::vector<SceneManager::SCENE_OBJECT>& baseObjects,
+	size_t objectCount)
+{
+	size_t copies = (objectCount + baseObjects.size() - 1) / baseObjects.size();
+	size_t gridSide = (size_t)std::ceil(std::sqrt((double)copies));
+
+	std::vector<SceneManager::SCENE_OBJECT>& sceneObjects = m_pSceneManager->m_sceneObjects;
+	sceneObjects.clear();
+	sceneObjects.reserve(objectCount);
+
+	for (size_t i = 0; i < objectCount; i++)
+	{
+		size_t copy = i / baseObjects.size();
+		SceneManager::SCENE_OBJECT object = baseObjects[i % baseObjects.size()];
+
+		object.name += "#" + std::to_string(copy);
+		object.position.x += (float)(copy % gridSide) * SYNTHETIC_SCENE_SPACING;
+		object.position.z -= (float)(copy / gridSide) * SYNTHETIC_SCENE_SPACING;
+
+		sceneObjects.push_back(object);
+	}
+
+	m_pSceneManager->CompileDrawList();
+}
+
+/***********************************************************
+ *  TimeFrames()
+ *
+ *  This method is used for rendering frames of the current
+ *  scene with the given rendering path and measuring how
+ *  long they take.  The submit time covers the
+ *  CPU work of issuing the frame, the frame time also waits
+ *  for the GPU to finish it.
+ ***********************************************************/
+SceneBenchmarks::FRAME_TIMING SceneBenchmarks::TimeFrames(RenderPath renderPath, bool bMoveObjects)
+{
+	FRAME_TIMING timing = { 0, 0.0, 0.0, 0.0 };
+	double submitTotal = 0.0;
+	double frameTotal = 0.0;
+	double uploadTotal = 0.0;
+	bool bUseInstancing = m_pSceneManager->m_bUseInstancing;
+	bool bUseMultiDraw = m_pSceneManager->m_bUseMultiDraw;
+
+	m_pSceneManager->m_bUseInstancing = ((renderPath == RENDER_INSTANCED) || (renderPath == RENDER_MULTIDRAW));
+	m_pSceneManager->m_bUseMultiDraw = (renderPath == RENDER_MULTIDRAW);
+
+	for (int frame = 0; ; frame++)
+	{
+		m_pShaderManager->BeginFrameStats();
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		m_pViewManager->PrepareSceneView();
+		m_pSceneManager->SetViewParameters(
+			m_pViewManager->GetViewMatrix(),
+			m_pViewManager->GetProjectionMatrix(),
+			m_pViewManager->GetCameraPosition(),
+			m_pViewManager->GetViewportHeight());
+
+		if (bMoveObjects == true)
+		{
+			m_pSceneManager->m_bInstanceDataDirty = true;
+		}
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		if (renderPath == RENDER_IMMEDIATE)
+		{
+			m_pSceneManager->RenderSceneImmediate();
+		}
+		else
+		{
+			m_pSceneManager->RenderScene();
+		}
+		BenchmarkClock::time_point submitted = BenchmarkClock::now();
+		glFinish();
+		BenchmarkClock::time_point finished = BenchmarkClock::now();
+
+		if (frame < BENCHMARK_WARMUP_FRAMES)
+		{
+			continue;
+		}
+
+		// the stats of the frame before are complete now
+		m_pShaderManager->BeginFrameStats();
+		uploadTotal += m_pShaderManager->GetLastFrameStats().uploadsIssued;
+
+		submitTotal += ElapsedMilliseconds(start, submitted);
+		frameTotal += ElapsedMilliseconds(start, finished);
+		timing.frames++;
+
+		if ((timing.frames >= BENCHMARK_MAX_FRAMES) ||
+			((timing.frames >= BENCHMARK_MIN_FRAMES) && (frameTotal >= BENCHMARK_MIN_SECONDS * 1000.0)))
+		{
+			break;
+		}
+	}
+
+	m_pSceneManager->m_bUseInstancing = bUseInstancing;
+	m_pSceneManager->m_bUseMultiDraw = bUseMultiDraw;
+
+	timing.submitMilliseconds = submitTotal / timing.frames;
+	timing.frameMilliseconds = frameTotal / timing.frames;
+	timing.uniformUploads = uploadTotal / timing.frames;
+
+	return(timing);
+}
+
+/***********************************************************
+ *  GetCameraPathPose()
+ *
+ *  This method is used for placing the camera of a frame on
+ *  the camera path.  The camera circles the scene once over
+ *  the frames, moving closer at the sides and bobbing up and
+ *  down, and starts from the default view of the scene.
+ ***********************************************************/
+void SceneBenchmarks::GetCameraPathPose(
+	int frame,
+	int frameCount,
+	glm::vec3& position,
+	glm::vec3& target)
+{
+	const float angle = 2.0f * glm::pi<float>() * (float)frame / (float)frameCount;
+	const float sine = std::sin(angle);
+	const float radius = CAMERA_PATH_RADIUS - 3.0f * sine * sine;
+
+	position = CAMERA_PATH_TARGET + glm::vec3(
+		radius * sine,
+		CAMERA_PATH_HEIGHT + std::sin(2.0f * angle),
+		radius * std::cos(angle));
+	target = CAMERA_PATH_TARGET;
+}
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebenchmarks.h
+// ============
+// measure the cost of the different scene rendering paths
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneManager.h"
+#include "ViewManager.h"
+#include "ShaderManager.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneBenchmarks
+ *
+ *  This class contains the benchmarks that can be run with
+ *  the --benchmark <name> command line option.  They use the
+ *  already prepared scene and report their results on the
+ *  console.
+ ***********************************************************/
+class SceneBenchmarks
+{
+public:
+	// constructor
+	SceneBenchmarks(
+		SceneManager* pSceneManager,
+		ShaderManager* pShaderManager,
+		ViewManager* pViewManager);
+
+	// run the named benchmark - returns false if there is
+	// no benchmark with that name
+	bool Run(const std::string& name);
+
+	// fly the camera along a fixed path for frameCount frames and
+	// report the frame times, the draw calls and a hash of the last
+	// frame, which is also written to imageName if that is not NULL
+	void RunCameraPath(int frameCount, const char* imageName);
+
+	// print the names of the available benchmarks
+	static void PrintBenchmarkNames();
+
+private:
+	// rendering paths that can be timed
+	enum RenderPath
+	{
+		RENDER_IMMEDIATE,   // TransformAndRender() for every object
+		RENDER_DRAWLIST,    // compiled draw list, one draw per object
+		RENDER_INSTANCED,   // compiled draw list, instanced batches
+		RENDER_MULTIDRAW    // instanced batches in multi-draw indirect calls
+	};
+
+	// timing results for one rendering path
+	struct FRAME_TIMING
+	{
+		int frames;
+		double submitMilliseconds;    // CPU time to issue one frame
+		double frameMilliseconds;     // time until the GPU finished one frame
+		double uniformUploads;        // uniform uploads issued per frame
+	};
+
+	// pointer to scene manager object
+	SceneManager* m_pSceneManager;
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// pointer to view manager object
+	ViewManager* m_pViewManager;
+
+	// compare the compiled draw list against immediate rendering
+	void BenchmarkDrawList();
+	// compare instanced batches against one draw per object
+	void BenchmarkInstancing();
+	// measure the render queue sort
+	void BenchmarkSorting();
+	// compare multi-draw indirect calls against one call per batch
+	void BenchmarkMultiDraw();
+	// compare the SIMD frustum test against testing one box at a time
+	void BenchmarkCulling();
+	// compare the closed-form model matrix against chained matrix multiplies
+	void BenchmarkTransforms();
+	// compare the texture startup with cold and warm texture caches
+	void BenchmarkTextureCache();
+	// measure the speed and the error of the texture block compression
+	void BenchmarkCompression();
+	// compare the compact vertex layout against the float layout
+	void BenchmarkVertexFormat();
+	// compare the vertex cache reordered meshes against the original ones
+	void BenchmarkMeshCache();
+	// compare the levels of detail picked by screen size against LOD 0
+	void BenchmarkLod();
+	// count the allocations and time the generation of the round meshes
+	void BenchmarkMeshGeneration();
+	// compare the persistently mapped ring against glBufferData uploads
+	void BenchmarkPersistentBuffers();
+
+	// time two rendering paths on synthetic scenes of growing size
+	void CompareRenderPaths(
+		RenderPath firstPath,
+		RenderPath secondPath,
+		const char* firstName,
+		const char* secondName);
+
+	// load the meshes of the scene into the given shapes, with the
+	// shared buffers when the scene uses them - the round shapes get
+	// at least lodCount levels of detail
+	void LoadBenchmarkMeshes(ShapeMeshes& meshes, int lodCount = 1);
+
+	// time the scene drawn from two sets of meshes on synthetic
+	// scenes of growing size
+	void CompareMeshes(
+		ShapeMeshes meshes[2],
+		const char* const names[2]);
+
+	// replace the scene with objectCount copies of the given objects
+	void BuildSyntheticScene(
+		const std::vector<SceneManager::SCENE_OBJECT>& baseObjects,
+		size_t objectCount);
+
+	// render frames with the given path and measure them - with
+	// bMoveObjects the instance data is written again every frame,
+	// as if every object had moved
+	FRAME_TIMING TimeFrames(RenderPath renderPath, bool bMoveObjects = false);
+
+	// load the textures of the scene again and wait until they are
+	// resident - returns the milliseconds that took
+	double ReloadTextures(bool bUseTextureCache, bool bClearTextureCache);
+
+	// camera position and target of a frame on the camera path
+	static void GetCameraPathPose(
+		int frame,
+		int frameCount,
+		glm::vec3& position,
+		glm::vec3& target);
+};
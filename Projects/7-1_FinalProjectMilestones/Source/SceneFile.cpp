@@ -0,0 +1,666 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// load the scene description from a YAML file or its compiled binary cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+#include "ShapeMeshes.h"
+
+#include <yaml-cpp/yaml.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+// declaration of global variables
+namespace
+{
+	const char CACHE_MAGIC[4] = { 'S', 'C', 'N', 'C' };
+	const char* const CACHE_EXTENSION = ".scenecache";
+
+	// names of the meshes in the scene file, by ShapeMeshes::MeshID
+	const char* const MESH_NAMES[ShapeMeshes::MESH_COUNT] = {
+		"box",
+		"cone",
+		"cylinder",
+		"plane",
+		"tiling-plane",
+		"prism",
+		"pyramid3",
+		"pyramid4",
+		"sphere",
+		"half-sphere",
+		"tapered-cylinder",
+		"torus",
+		"half-torus" };
+
+	// parameters of the meshes that are not given in the scene file
+	const float DEFAULT_PLANE_TILES = 1.0f;
+	const float DEFAULT_TORUS_THICKNESS = 0.2f;
+	const int32_t DEFAULT_LOD_COUNT = 1;
+
+	// the half shapes are drawn from the mesh of their full shape,
+	// so only the full shape is loaded
+	int GetLoadedMeshID(int meshID)
+	{
+		if (meshID == ShapeMeshes::MESH_HALF_SPHERE)
+		{
+			return(ShapeMeshes::MESH_SPHERE);
+		}
+		if (meshID == ShapeMeshes::MESH_HALF_TORUS)
+		{
+			return(ShapeMeshes::MESH_TORUS);
+		}
+		return(meshID);
+	}
+
+	// the strings of the compiled scene, each stored once -
+	// offset 0 is always the empty string
+	struct STRING_TABLE
+	{
+		std::vector<char> bytes;
+		std::unordered_map<std::string, uint32_t> offsets;
+
+		STRING_TABLE()
+		{
+			bytes.push_back('\0');
+			offsets[""] = 0;
+		}
+
+		uint32_t Add(const std::string& value)
+		{
+			std::unordered_map<std::string, uint32_t>::const_iterator found = offsets.find(value);
+			if (found != offsets.end())
+			{
+				return(found->second);
+			}
+
+			uint32_t offset = (uint32_t)bytes.size();
+			bytes.insert(bytes.end(), value.begin(), value.end());
+			bytes.push_back('\0');
+			offsets[value] = offset;
+			return(offset);
+		}
+	};
+
+	// read a list of between minCount and maxCount numbers - the
+	// values are left as they are if the key is missing
+	void ReadFloats(
+		const YAML::Node& node,
+		const char* key,
+		float* pValues,
+		size_t minCount,
+		size_t maxCount)
+	{
+		const YAML::Node value = node[key];
+		if (!value)
+		{
+			return;
+		}
+		if (!value.IsSequence() || (value.size() < minCount) || (value.size() > maxCount))
+		{
+			throw YAML::Exception(value.Mark(), std::string("'") + key + "' needs " +
+				std::to_string(minCount) + ((minCount == maxCount) ? "" : " or " + std::to_string(maxCount)) +
+				" numbers");
+		}
+		for (size_t i = 0; i < value.size(); i++)
+		{
+			pValues[i] = value[i].as<float>();
+		}
+	}
+
+	// read a single number, left as it is if the key is missing
+	void ReadFloat(const YAML::Node& node, const char* key, float& value)
+	{
+		if (node[key])
+		{
+			value = node[key].as<float>();
+		}
+	}
+
+	// read a whole number between minValue and maxValue, left as
+	// it is if the key is missing
+	void ReadInt(const YAML::Node& node, const char* key, int32_t& value, int32_t minValue, int32_t maxValue)
+	{
+		const YAML::Node number = node[key];
+		if (!number)
+		{
+			return;
+		}
+		int32_t read = number.as<int32_t>();
+		if ((read < minValue) || (read > maxValue))
+		{
+			throw YAML::Exception(number.Mark(), std::string("'") + key + "' needs a number from " +
+				std::to_string(minValue) + " to " + std::to_string(maxValue));
+		}
+		value = read;
+	}
+
+	// read a string that must be given
+	std::string ReadRequiredString(const YAML::Node& node, const char* key)
+	{
+		if (!node[key])
+		{
+			throw YAML::Exception(node.Mark(), std::string("missing '") + key + "'");
+		}
+		return(node[key].as<std::string>());
+	}
+
+	// read a string, empty if the key is missing
+	std::string ReadString(const YAML::Node& node, const char* key)
+	{
+		return(node[key] ? node[key].as<std::string>() : std::string());
+	}
+
+	// sections of the cache start on 8 byte boundaries
+	size_t AlignOffset(size_t offset)
+	{
+		return((offset + 7) & ~(size_t)7);
+	}
+
+	// copy the records of one section into the compiled scene
+	template <typename RECORD>
+	void CopySection(std::vector<unsigned char>& compiled, uint32_t offset, const std::vector<RECORD>& records)
+	{
+		if (!records.empty())
+		{
+			memcpy(&compiled[offset], records.data(), records.size() * sizeof(RECORD));
+		}
+	}
+
+	// point to the records of one section, or NULL if the section
+	// is not inside the data
+	template <typename RECORD>
+	const RECORD* GetSection(const unsigned char* pData, size_t size, uint32_t offset, uint32_t count)
+	{
+		if (((offset % sizeof(uint32_t)) != 0) || (offset > size) ||
+			((size - offset) / sizeof(RECORD) < count))
+		{
+			return(NULL);
+		}
+		return((const RECORD*)(pData + offset));
+	}
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_bFromCache = false;
+	m_meshCount = 0;
+	m_pMeshes = NULL;
+	m_textureCount = 0;
+	m_pTextures = NULL;
+	m_materialCount = 0;
+	m_pMaterials = NULL;
+	m_lightCount = 0;
+	m_pLights = NULL;
+	m_objectCount = 0;
+	m_pObjects = NULL;
+	m_pStrings = "";
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used to load the scene.  The cache is only
+ *  used when it was compiled by the same CACHE_VERSION from
+ *  a YAML file of the same size and modification time, so
+ *  any edit of the YAML file recompiles it.
+ ***********************************************************/
+bool SceneFile::Load(const std::string& filename, bool bUseCache)
+{
+	m_mapping.Close();
+	m_compiled.clear();
+	m_bFromCache = false;
+
+	uint64_t sourceSize = 0;
+	int64_t sourceModifiedTime = 0;
+	if (MappedFile::GetFileStamp(filename, sourceSize, sourceModifiedTime) == false)
+	{
+		std::cout << "Could not find the scene file " << filename << std::endl;
+		return(false);
+	}
+
+	const std::string cacheFilename = GetCacheFilename(filename);
+	if ((bUseCache == true) && (m_mapping.Open(cacheFilename) == true))
+	{
+		if (AttachRecords(m_mapping.GetData(), m_mapping.GetSize(), sourceSize, sourceModifiedTime) == true)
+		{
+			m_bFromCache = true;
+			return(true);
+		}
+
+		// the cache is out of date or damaged
+		m_mapping.Close();
+	}
+
+	if ((CompileYaml(filename, sourceSize, sourceModifiedTime) == false) ||
+		(AttachRecords(m_compiled.data(), m_compiled.size(), sourceSize, sourceModifiedTime) == false))
+	{
+		m_compiled.clear();
+		return(false);
+	}
+
+	// a scene that can not be cached still works, it is only
+	// parsed again on the next start
+	if ((bUseCache == true) && (WriteCache(cacheFilename) == false))
+	{
+		std::cout << "Could not write the scene cache " << cacheFilename << std::endl;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetCacheFilename()
+ *
+ *  This method is used to get the name of the cache file,
+ *  which replaces the extension of the YAML file.
+ ***********************************************************/
+std::string SceneFile::GetCacheFilename(const std::string& filename)
+{
+	size_t directoryEnd = filename.find_last_of("/\\");
+	size_t extensionStart = filename.find_last_of('.');
+	if ((extensionStart == std::string::npos) ||
+		((directoryEnd != std::string::npos) && (extensionStart < directoryEnd)))
+	{
+		return(filename + CACHE_EXTENSION);
+	}
+	return(filename.substr(0, extensionStart) + CACHE_EXTENSION);
+}
+
+/***********************************************************
+ *  FindMeshID()
+ *
+ *  This method is used to get the ShapeMeshes::MeshID of a
+ *  mesh name that is used in the scene file.
+ ***********************************************************/
+int SceneFile::FindMeshID(const std::string& name)
+{
+	for (int meshID = 0; meshID < ShapeMeshes::MESH_COUNT; meshID++)
+	{
+		if (name == MESH_NAMES[meshID])
+		{
+			return(meshID);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  GetMeshName()
+ *
+ *  This method is used to get the name that the scene file
+ *  uses for a ShapeMeshes::MeshID.
+ ***********************************************************/
+const char* SceneFile::GetMeshName(int meshID)
+{
+	if ((meshID < 0) || (meshID >= ShapeMeshes::MESH_COUNT))
+	{
+		return("unknown");
+	}
+	return(MESH_NAMES[meshID]);
+}
+
+/***********************************************************
+ *  CompileYaml()
+ *
+ *  This method is used to parse the YAML file and to lay the
+ *  records out the same way as in the cache file.  The
+ *  texture files are relative to the YAML file.  Meshes that
+ *  the objects use but that are not listed are added with
+ *  their default parameters.
+ ***********************************************************/
+bool SceneFile::CompileYaml(
+	const std::string& filename,
+	uint64_t sourceSize,
+	int64_t sourceModifiedTime)
+{
+	std::vector<MESH_RECORD> meshes;
+	std::vector<TEXTURE_RECORD> textures;
+	std::vector<MATERIAL_RECORD> materials;
+	std::vector<LIGHT_RECORD> lights;
+	std::vector<OBJECT_RECORD> objects;
+	STRING_TABLE strings;
+
+	size_t directoryEnd = filename.find_last_of("/\\");
+	const std::string directory = (directoryEnd == std::string::npos) ? "" : filename.substr(0, directoryEnd + 1);
+
+	try
+	{
+		const YAML::Node root = YAML::LoadFile(filename);
+
+		bool bMeshListed[ShapeMeshes::MESH_COUNT] = { false };
+		const YAML::Node meshNodes = root["meshes"];
+		for (size_t i = 0; i < meshNodes.size(); i++)
+		{
+			const YAML::Node& node = meshNodes[i];
+			const std::string shape = ReadRequiredString(node, "shape");
+			int meshID = FindMeshID(shape);
+			if (meshID < 0)
+			{
+				throw YAML::Exception(node.Mark(), "unknown mesh '" + shape + "'");
+			}
+			meshID = GetLoadedMeshID(meshID);
+			if (bMeshListed[meshID] == true)
+			{
+				continue;
+			}
+			bMeshListed[meshID] = true;
+
+			MESH_RECORD mesh = { meshID, { 0.0f, 0.0f }, DEFAULT_LOD_COUNT };
+			ReadInt(node, "lods", mesh.lodCount, 1, ShapeMeshes::MAX_MESH_LODS);
+			if (meshID == ShapeMeshes::MESH_TILING_PLANE)
+			{
+				mesh.parameters[0] = DEFAULT_PLANE_TILES;
+				mesh.parameters[1] = DEFAULT_PLANE_TILES;
+				ReadFloats(node, "tiles", mesh.parameters, 2, 2);
+			}
+			else if (meshID == ShapeMeshes::MESH_TORUS)
+			{
+				mesh.parameters[0] = DEFAULT_TORUS_THICKNESS;
+				ReadFloat(node, "thickness", mesh.parameters[0]);
+			}
+			meshes.push_back(mesh);
+		}
+
+		const YAML::Node textureNodes = root["textures"];
+		for (size_t i = 0; i < textureNodes.size(); i++)
+		{
+			const YAML::Node& node = textureNodes[i];
+			std::string file = ReadRequiredString(node, "file");
+			// relative paths start at the directory of the scene file
+			if (!file.empty() && (file.find(':') == std::string::npos) && (file[0] != '/') && (file[0] != '\\'))
+			{
+				file = directory + file;
+			}
+
+			TEXTURE_RECORD texture;
+			texture.filename = strings.Add(file);
+			texture.tag = strings.Add(ReadRequiredString(node, "tag"));
+			textures.push_back(texture);
+		}
+
+		const YAML::Node materialNodes = root["materials"];
+		for (size_t i = 0; i < materialNodes.size(); i++)
+		{
+			const YAML::Node& node = materialNodes[i];
+			MATERIAL_RECORD material = {
+				0,
+				{ 0.2f, 0.2f, 0.2f }, 0.1f,
+				{ 1.0f, 1.0f, 1.0f },
+				{ 1.0f, 1.0f, 1.0f }, 10.0f };
+			material.tag = strings.Add(ReadRequiredString(node, "tag"));
+			ReadFloats(node, "ambient-color", material.ambientColor, 3, 3);
+			ReadFloat(node, "ambient-strength", material.ambientStrength);
+			ReadFloats(node, "diffuse-color", material.diffuseColor, 3, 3);
+			ReadFloats(node, "specular-color", material.specularColor, 3, 3);
+			ReadFloat(node, "shininess", material.shininess);
+			materials.push_back(material);
+		}
+
+		const YAML::Node lightNodes = root["lights"];
+		for (size_t i = 0; i < lightNodes.size(); i++)
+		{
+			const YAML::Node& node = lightNodes[i];
+			LIGHT_RECORD light = {
+				{ 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 0.0f },
+				{ 1.0f, 1.0f, 1.0f },
+				{ 1.0f, 1.0f, 1.0f },
+				32.0f, 0.05f };
+			ReadFloats(node, "position", light.position, 3, 3);
+			ReadFloats(node, "ambient-color", light.ambientColor, 3, 3);
+			ReadFloats(node, "diffuse-color", light.diffuseColor, 3, 3);
+			ReadFloats(node, "specular-color", light.specularColor, 3, 3);
+			ReadFloat(node, "focal-strength", light.focalStrength);
+			ReadFloat(node, "specular-intensity", light.specularIntensity);
+			lights.push_back(light);
+		}
+
+		const YAML::Node objectNodes = root["objects"];
+		for (size_t i = 0; i < objectNodes.size(); i++)
+		{
+			const YAML::Node& node = objectNodes[i];
+			OBJECT_RECORD object = {
+				0, 0, ShapeMeshes::PART_ALL,
+				{ 1.0f, 1.0f, 1.0f },
+				{ 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 0.0f },
+				{ 1.0f, 1.0f, 1.0f, 1.0f },
+				0, 0, 0 };
+			const std::string name = ReadRequiredString(node, "name");
+			const std::string shape = ReadRequiredString(node, "mesh");
+			object.name = strings.Add(name);
+			object.meshID = FindMeshID(shape);
+			if (object.meshID < 0)
+			{
+				throw YAML::Exception(node.Mark(), "unknown mesh '" + shape + "' for object '" + name + "'");
+			}
+
+			const YAML::Node partNodes = node["parts"];
+			if (partNodes)
+			{
+				object.meshParts = 0;
+				for (size_t j = 0; j < partNodes.size(); j++)
+				{
+					const std::string part = partNodes[j].as<std::string>();
+					if (part == "top")
+					{
+						object.meshParts |= ShapeMeshes::PART_TOP;
+					}
+					else if (part == "bottom")
+					{
+						object.meshParts |= ShapeMeshes::PART_BOTTOM;
+					}
+					else if (part == "sides")
+					{
+						object.meshParts |= ShapeMeshes::PART_SIDES;
+					}
+					else
+					{
+						throw YAML::Exception(partNodes[j].Mark(), "unknown part '" + part + "'");
+					}
+				}
+			}
+
+			ReadFloats(node, "scale", object.scale, 3, 3);
+			ReadFloats(node, "rotation", object.rotation, 3, 3);
+			ReadFloats(node, "position", object.position, 3, 3);
+			// the alpha is optional
+			ReadFloats(node, "color", object.color, 3, 4);
+			object.textureTag = strings.Add(ReadString(node, "texture"));
+			object.overlayTextureTag = strings.Add(ReadString(node, "overlay-texture"));
+			object.materialTag = strings.Add(ReadString(node, "material"));
+			objects.push_back(object);
+
+			int loadedMeshID = GetLoadedMeshID(object.meshID);
+			if (bMeshListed[loadedMeshID] == false)
+			{
+				bMeshListed[loadedMeshID] = true;
+				MESH_RECORD mesh = { loadedMeshID, { DEFAULT_PLANE_TILES, DEFAULT_PLANE_TILES }, DEFAULT_LOD_COUNT };
+				if (loadedMeshID == ShapeMeshes::MESH_TORUS)
+				{
+					mesh.parameters[0] = DEFAULT_TORUS_THICKNESS;
+				}
+				meshes.push_back(mesh);
+			}
+		}
+	}
+	catch (const YAML::Exception& error)
+	{
+		std::cout << "Could not load the scene file " << filename << ": " << error.what() << std::endl;
+		return(false);
+	}
+
+	// lay out the sections after the header
+	CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceModifiedTime = sourceModifiedTime;
+
+	size_t offset = AlignOffset(sizeof(CACHE_HEADER));
+	header.meshCount = (uint32_t)meshes.size();
+	header.meshOffset = (uint32_t)offset;
+	offset = AlignOffset(offset + meshes.size() * sizeof(MESH_RECORD));
+	header.textureCount = (uint32_t)textures.size();
+	header.textureOffset = (uint32_t)offset;
+	offset = AlignOffset(offset + textures.size() * sizeof(TEXTURE_RECORD));
+	header.materialCount = (uint32_t)materials.size();
+	header.materialOffset = (uint32_t)offset;
+	offset = AlignOffset(offset + materials.size() * sizeof(MATERIAL_RECORD));
+	header.lightCount = (uint32_t)lights.size();
+	header.lightOffset = (uint32_t)offset;
+	offset = AlignOffset(offset + lights.size() * sizeof(LIGHT_RECORD));
+	header.objectCount = (uint32_t)objects.size();
+	header.objectOffset = (uint32_t)offset;
+	offset = AlignOffset(offset + objects.size() * sizeof(OBJECT_RECORD));
+	header.stringBytes = (uint32_t)strings.bytes.size();
+	header.stringOffset = (uint32_t)offset;
+	offset += strings.bytes.size();
+	header.totalBytes = (uint32_t)offset;
+
+	m_compiled.assign(offset, 0);
+	memcpy(&m_compiled[0], &header, sizeof(header));
+	CopySection(m_compiled, header.meshOffset, meshes);
+	CopySection(m_compiled, header.textureOffset, textures);
+	CopySection(m_compiled, header.materialOffset, materials);
+	CopySection(m_compiled, header.lightOffset, lights);
+	CopySection(m_compiled, header.objectOffset, objects);
+	CopySection(m_compiled, header.stringOffset, strings.bytes);
+
+	return(true);
+}
+
+/***********************************************************
+ *  AttachRecords()
+ *
+ *  This method is used to check that a compiled scene
+ *  belongs to the source file and that every section and
+ *  string lies inside of it, and to point the records into
+ *  it.  Nothing is copied.
+ ***********************************************************/
+bool SceneFile::AttachRecords(
+	const unsigned char* pData,
+	size_t size,
+	uint64_t sourceSize,
+	int64_t sourceModifiedTime)
+{
+	if ((NULL == pData) || (size < sizeof(CACHE_HEADER)))
+	{
+		return(false);
+	}
+
+	const CACHE_HEADER* pHeader = (const CACHE_HEADER*)pData;
+	if ((memcmp(pHeader->magic, CACHE_MAGIC, sizeof(pHeader->magic)) != 0) ||
+		(pHeader->version != CACHE_VERSION) ||
+		(pHeader->sourceSize != sourceSize) ||
+		(pHeader->sourceModifiedTime != sourceModifiedTime) ||
+		(pHeader->totalBytes != size))
+	{
+		return(false);
+	}
+
+	const MESH_RECORD* pMeshes = GetSection<MESH_RECORD>(pData, size, pHeader->meshOffset, pHeader->meshCount);
+	const TEXTURE_RECORD* pTextures = GetSection<TEXTURE_RECORD>(pData, size, pHeader->textureOffset, pHeader->textureCount);
+	const MATERIAL_RECORD* pMaterials = GetSection<MATERIAL_RECORD>(pData, size, pHeader->materialOffset, pHeader->materialCount);
+	const LIGHT_RECORD* pLights = GetSection<LIGHT_RECORD>(pData, size, pHeader->lightOffset, pHeader->lightCount);
+	const OBJECT_RECORD* pObjects = GetSection<OBJECT_RECORD>(pData, size, pHeader->objectOffset, pHeader->objectCount);
+	const char* pStrings = GetSection<char>(pData, size, pHeader->stringOffset, pHeader->stringBytes);
+	if ((NULL == pMeshes) || (NULL == pTextures) || (NULL == pMaterials) ||
+		(NULL == pLights) || (NULL == pObjects) || (NULL == pStrings))
+	{
+		return(false);
+	}
+
+	// every string offset must start a string that ends inside the table
+	const uint32_t stringBytes = pHeader->stringBytes;
+	if ((stringBytes == 0) || (pStrings[0] != '\0') || (pStrings[stringBytes - 1] != '\0'))
+	{
+		return(false);
+	}
+	for (uint32_t i = 0; i < pHeader->meshCount; i++)
+	{
+		if ((pMeshes[i].meshID < 0) || (pMeshes[i].meshID >= ShapeMeshes::MESH_COUNT))
+		{
+			return(false);
+		}
+	}
+	for (uint32_t i = 0; i < pHeader->textureCount; i++)
+	{
+		if ((pTextures[i].filename >= stringBytes) || (pTextures[i].tag >= stringBytes))
+		{
+			return(false);
+		}
+	}
+	for (uint32_t i = 0; i < pHeader->materialCount; i++)
+	{
+		if (pMaterials[i].tag >= stringBytes)
+		{
+			return(false);
+		}
+	}
+	for (uint32_t i = 0; i < pHeader->objectCount; i++)
+	{
+		const OBJECT_RECORD& object = pObjects[i];
+		if ((object.meshID < 0) || (object.meshID >= ShapeMeshes::MESH_COUNT) ||
+			(object.name >= stringBytes) || (object.textureTag >= stringBytes) ||
+			(object.overlayTextureTag >= stringBytes) || (object.materialTag >= stringBytes))
+		{
+			return(false);
+		}
+	}
+
+	m_meshCount = pHeader->meshCount;
+	m_pMeshes = pMeshes;
+	m_textureCount = pHeader->textureCount;
+	m_pTextures = pTextures;
+	m_materialCount = pHeader->materialCount;
+	m_pMaterials = pMaterials;
+	m_lightCount = pHeader->lightCount;
+	m_pLights = pLights;
+	m_objectCount = pHeader->objectCount;
+	m_pObjects = pObjects;
+	m_pStrings = pStrings;
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteCache()
+ *
+ *  This method is used to write the compiled scene to the
+ *  cache file.  It is written to a temporary file first, so
+ *  a cache that is only partly written is never mapped.
+ ***********************************************************/
+bool SceneFile::WriteCache(const std::string& cacheFilename) const
+{
+	const std::string temporaryFilename = cacheFilename + ".tmp";
+
+	FILE* file = fopen(temporaryFilename.c_str(), "wb");
+	if (NULL == file)
+	{
+		return(false);
+	}
+	bool bWritten = (fwrite(m_compiled.data(), 1, m_compiled.size(), file) == m_compiled.size());
+	bWritten = (fclose(file) == 0) && bWritten;
+
+	// rename() does not replace an existing file on every platform
+	remove(cacheFilename.c_str());
+	if ((bWritten == false) || (rename(temporaryFilename.c_str(), cacheFilename.c_str()) != 0))
+	{
+		remove(temporaryFilename.c_str());
+		return(false);
+	}
+
+	return(true);
+}
@@ -0,0 +1,178 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// load the scene description from a YAML file or its compiled binary cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class contains the code for loading the meshes,
+ *  textures, materials, lights and objects of a scene from
+ *  a YAML file.  The parsed scene is compiled into flat
+ *  records that are written next to the YAML file as a
+ *  versioned binary cache.  As long as the YAML file does
+ *  not change, later loads map the cache and read the
+ *  records in place without parsing anything.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// version of the cache layout - increase it whenever one of
+	// the records below changes, so old caches are recompiled
+	static const uint32_t CACHE_VERSION = 2;
+
+	// the records of the compiled scene - the strings are byte
+	// offsets into the string table, where 0 is the empty string
+
+	// a mesh to load, with the parameters of the shapes that
+	// take any (tile counts of the tiling plane, torus thickness)
+	// and the number of levels of detail to load for it
+	struct MESH_RECORD
+	{
+		int32_t meshID;
+		float parameters[2];
+		int32_t lodCount;
+	};
+
+	// a texture image and the tag the objects refer to it by
+	struct TEXTURE_RECORD
+	{
+		uint32_t filename;
+		uint32_t tag;
+	};
+
+	struct MATERIAL_RECORD
+	{
+		uint32_t tag;
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float specularColor[3];
+		float shininess;
+	};
+
+	struct LIGHT_RECORD
+	{
+		float position[3];
+		float ambientColor[3];
+		float diffuseColor[3];
+		float specularColor[3];
+		float focalStrength;
+		float specularIntensity;
+	};
+
+	struct OBJECT_RECORD
+	{
+		uint32_t name;
+		int32_t meshID;
+		uint32_t meshParts;
+		float scale[3];
+		float rotation[3];
+		float position[3];
+		float color[4];
+		uint32_t textureTag;
+		uint32_t overlayTextureTag;
+		uint32_t materialTag;
+	};
+
+	// constructor
+	SceneFile();
+
+	// load the scene from the cache next to the YAML file if it is
+	// up to date, or parse the YAML file and write a new cache -
+	// returns false if neither could be loaded
+	bool Load(const std::string& filename, bool bUseCache = true);
+	// true if the last Load() read the cache instead of the YAML file
+	bool IsFromCache() const { return m_bFromCache; }
+
+	// the records of the loaded scene
+	size_t GetMeshCount() const { return m_meshCount; }
+	const MESH_RECORD* GetMeshes() const { return m_pMeshes; }
+	size_t GetTextureCount() const { return m_textureCount; }
+	const TEXTURE_RECORD* GetTextures() const { return m_pTextures; }
+	size_t GetMaterialCount() const { return m_materialCount; }
+	const MATERIAL_RECORD* GetMaterials() const { return m_pMaterials; }
+	size_t GetLightCount() const { return m_lightCount; }
+	const LIGHT_RECORD* GetLights() const { return m_pLights; }
+	size_t GetObjectCount() const { return m_objectCount; }
+	const OBJECT_RECORD* GetObjects() const { return m_pObjects; }
+
+	// string of the string table at the given offset
+	const char* GetString(uint32_t offset) const { return m_pStrings + offset; }
+
+	// name of the cache file of a YAML scene file
+	static std::string GetCacheFilename(const std::string& filename);
+	// ShapeMeshes::MeshID of a mesh name in the scene file, or -1
+	static int FindMeshID(const std::string& name);
+	// mesh name in the scene file of a ShapeMeshes::MeshID
+	static const char* GetMeshName(int meshID);
+
+private:
+	// start of the cache file - the sections follow in the order of
+	// the counts, each starting at the given offset from the file start
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		// size and modification time of the YAML file the cache
+		// was compiled from
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint32_t meshCount;
+		uint32_t meshOffset;
+		uint32_t textureCount;
+		uint32_t textureOffset;
+		uint32_t materialCount;
+		uint32_t materialOffset;
+		uint32_t lightCount;
+		uint32_t lightOffset;
+		uint32_t objectCount;
+		uint32_t objectOffset;
+		uint32_t stringBytes;
+		uint32_t stringOffset;
+		uint32_t totalBytes;
+	};
+
+	// the mapped cache, or the compiled scene when it was parsed
+	// from the YAML file - the record pointers point into either
+	MappedFile m_mapping;
+	std::vector<unsigned char> m_compiled;
+	bool m_bFromCache;
+
+	size_t m_meshCount;
+	const MESH_RECORD* m_pMeshes;
+	size_t m_textureCount;
+	const TEXTURE_RECORD* m_pTextures;
+	size_t m_materialCount;
+	const MATERIAL_RECORD* m_pMaterials;
+	size_t m_lightCount;
+	const LIGHT_RECORD* m_pLights;
+	size_t m_objectCount;
+	const OBJECT_RECORD* m_pObjects;
+	const char* m_pStrings;
+
+	// parse the YAML file and compile it into m_compiled
+	bool CompileYaml(
+		const std::string& filename,
+		uint64_t sourceSize,
+		int64_t sourceModifiedTime);
+	// check a compiled scene and point the records into it - returns
+	// false if it is not a valid scene for the given source file
+	bool AttachRecords(
+		const unsigned char* pData,
+		size_t size,
+		uint64_t sourceSize,
+		int64_t sourceModifiedTime);
+	// write m_compiled to the cache file
+	bool WriteCache(const std::string& cacheFilename) const;
+};
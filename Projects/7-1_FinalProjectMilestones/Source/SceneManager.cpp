@@ -8,6 +8,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "GLStateCache.h"
 
 #ifdef _DEBUG
 #include "LiveTransformations/LiveTransformer.h"
@@ -19,22 +20,279 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <GLFW/glfw3.h>
 
 #include <functional>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cfloat>
 
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
+	const char* g_NormalMatrixName = "normalMatrix";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_TextureOverlayValueName = "objectTextureOverlay";
-	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseTextureOverlayName = "bUseTextureOverlay";
-	const char* g_UseLightingName = "bUseLighting";
+	const char* g_TextureLayerName = "textureLayer";
+	const char* g_TextureOverlayLayerName = "textureOverlayLayer";
+	const char* g_DrawDataBaseName = "drawDataBase";
+	const char* g_UVscaleName = "UVscale";
+	const char* g_MaterialIndexName = "materialIndex";
+
+	// capacity and binding point of the MaterialBlock uniform
+	// buffer - these must match the defines in fragmentShader.glsl
+	const int MAX_MATERIALS = 64;
+	const GLuint MATERIAL_BLOCK_BINDING = 0;
+	// number of light sources - this must match TOTAL_LIGHTS
+	// in fragmentShader.glsl
+	const size_t MAX_SCENE_LIGHTS = 2;
+	// binding point of the DrawDataBlock storage buffer - this
+	// must match the define in vertexShader.glsl
+	const GLuint DRAW_DATA_BINDING = 1;
+	// bytes of decoded texture images that are uploaded per frame
+	// while the textures stream in - about one 1024x1024 RGBA image
+	const size_t TEXTURE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+	// projected diameters in pixels below which a draw drops to
+	// LOD 1, 2 and 3, and the fraction of a threshold that the
+	// diameter has to cross it by before the level changes
+	const float DEFAULT_LOD_PIXEL_THRESHOLDS[ShapeMeshes::MAX_MESH_LODS - 1] = { 200.0f, 100.0f, 50.0f };
+	const float DEFAULT_LOD_HYSTERESIS = 0.1f;
+
+	// the render queue state of an item is packed into a state word,
+	// lowest sort priority first: mesh parts (3 bits), mesh (9 bits),
+	// material (9 bits), overlay texture array (7 bits), texture array (7 bits),
+	// shader program (3 bits) and render pass (1 bit) - together with the
+	// depth bits this fills 63 bits of the sort key
+	struct STATE_FIELD
+	{
+		int shift;
+		int bits;
+		const char* name;
+	};
+	enum STATE_FIELD_INDEX
+	{
+		STATE_MESH_PARTS = 0,
+		STATE_MESH,
+		STATE_MATERIAL,
+		STATE_OVERLAY_TEXTURE_ARRAY,
+		STATE_TEXTURE_ARRAY,
+		STATE_PROGRAM,
+		STATE_PASS,
+		STATE_FIELD_COUNT
+	};
+	const STATE_FIELD g_StateFields[STATE_FIELD_COUNT] = {
+		{ 0, 3, "mesh parts" },
+		{ 3, 9, "mesh" },
+		{ 12, 9, "material" },
+		{ 21, 7, "overlay texture array" },
+		{ 28, 7, "texture array" },
+		{ 35, 3, "shader program" },
+		{ 38, 1, "render pass" } };
+	const int STATE_PASS_SHIFT = 38;
+	const uint64_t STATE_NO_PASS_MASK = (1ull << STATE_PASS_SHIFT) - 1;
+
+	// set once a value did not fit into its state field, so that the
+	// warning is not repeated for every draw of every frame
+	bool g_StateFieldOverflowLogged[STATE_FIELD_COUNT] = { false };
+
+	// the sort keys hold a quantized view depth next to the state word
+	const int SORT_DEPTH_BITS = 24;
+	const uint64_t SORT_DEPTH_MASK = (1ull << SORT_DEPTH_BITS) - 1;
+	const int SORT_PASS_SHIFT = STATE_PASS_SHIFT + SORT_DEPTH_BITS;
+	// view depths beyond this distance share the last depth bucket
+	const float SORT_MAX_DEPTH = 256.0f;
+
+	// marks a render queue item as an instanced batch
+	const uint32_t RENDER_ITEM_BATCH = 0x80000000u;
+
+	// place a value into its state field - a value that does not fit
+	// is masked, which only costs sorting quality, so it is logged once
+	// instead of failing the frame
+	uint64_t PackStateField(int field, unsigned int value)
+	{
+		const unsigned int mask = (1u << g_StateFields[field].bits) - 1;
+		if ((value > mask) && (g_StateFieldOverflowLogged[field] == false))
+		{
+			std::cout << "The " << g_StateFields[field].name << " index " << value
+				<< " does not fit into its " << g_StateFields[field].bits
+				<< " bit render queue state field - draws may sort less well" << std::endl;
+			g_StateFieldOverflowLogged[field] = true;
+		}
+
+		return((uint64_t)(value & mask) << g_StateFields[field].shift);
+	}
+
+	uint64_t MakeStateWord(
+		bool bTransparent,
+		int meshID,
+		unsigned int meshParts,
+		int materialIndex,
+		int textureArray,
+		int overlayTextureArray)
+	{
+		// the shader variant follows from the textures of the draw,
+		// the lighting and the draw path are the same for all draws
+		const int program =
+			((textureArray >= 0) ? ShaderManager::FEATURE_TEXTURE : 0) |
+			((overlayTextureArray >= 0) ? ShaderManager::FEATURE_TEXTURE_OVERLAY : 0);
+
+		return(PackStateField(STATE_PASS, bTransparent ? 1 : 0) |
+			PackStateField(STATE_PROGRAM, program) |
+			PackStateField(STATE_TEXTURE_ARRAY, textureArray + 1) |
+			PackStateField(STATE_OVERLAY_TEXTURE_ARRAY, overlayTextureArray + 1) |
+			PackStateField(STATE_MATERIAL, materialIndex + 1) |
+			PackStateField(STATE_MESH, meshID) |
+			PackStateField(STATE_MESH_PARTS, meshParts));
+	}
+
+	uint32_t QuantizeDepth(float viewDepth)
+	{
+		float depth = glm::clamp(viewDepth / SORT_MAX_DEPTH, 0.0f, 1.0f);
+		return((uint32_t)(depth * (float)SORT_DEPTH_MASK));
+	}
+
+	// opaque keys sort by state and then front-to-back, transparent keys
+	// sort strictly back-to-front and only then by state
+	uint64_t MakeSortKey(uint64_t stateWord, uint32_t depth)
+	{
+		if (((stateWord >> STATE_PASS_SHIFT) & 1) == 0)
+		{
+			return((stateWord << SORT_DEPTH_BITS) | depth);
+		}
+
+		return((1ull << SORT_PASS_SHIFT) |
+			((uint64_t)(SORT_DEPTH_MASK - depth) << STATE_PASS_SHIFT) |
+			(stateWord & STATE_NO_PASS_MASK));
+	}
+
+	bool IsTransparentKey(uint64_t key)
+	{
+		return(((key >> SORT_PASS_SHIFT) & 1) != 0);
+	}
+
+	uint64_t GetKeyState(uint64_t key)
+	{
+		if (IsTransparentKey(key) == false)
+		{
+			return(key >> SORT_DEPTH_BITS);
+		}
+
+		return((1ull << STATE_PASS_SHIFT) | (key & STATE_NO_PASS_MASK));
+	}
+
+	// count the state fields that change between consecutive keys
+	unsigned int CountStateChanges(const std::vector<uint64_t>& keys)
+	{
+		unsigned int changes = 0;
+
+		for (size_t i = 1; i < keys.size(); i++)
+		{
+			uint64_t previous = GetKeyState(keys[i - 1]);
+			uint64_t current = GetKeyState(keys[i]);
+
+			for (int field = 0; field < STATE_FIELD_COUNT; field++)
+			{
+				uint64_t mask = (1ull << g_StateFields[field].bits) - 1;
+				if (((previous >> g_StateFields[field].shift) & mask) != ((current >> g_StateFields[field].shift) & mask))
+				{
+					changes++;
+				}
+			}
+		}
+
+		return(changes);
+	}
+
+	// stable LSD radix sort of the keys and their items, one byte per
+	// pass - bytes that are equal in every key are skipped
+	void RadixSort(
+		std::vector<uint64_t>& keys,
+		std::vector<uint32_t>& items,
+		std::vector<uint64_t>& scratchKeys,
+		std::vector<uint32_t>& scratchItems)
+	{
+		const size_t count = keys.size();
+		if (count < 2)
+		{
+			return;
+		}
+
+		scratchKeys.resize(count);
+		scratchItems.resize(count);
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			size_t histogram[256] = { 0 };
+
+			for (size_t i = 0; i < count; i++)
+			{
+				histogram[(keys[i] >> shift) & 0xFF]++;
+			}
+			if (histogram[(keys[0] >> shift) & 0xFF] == count)
+			{
+				continue;
+			}
+
+			size_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				size_t bucketSize = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketSize;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				size_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+				scratchKeys[destination] = keys[i];
+				scratchItems[destination] = items[i];
+			}
+
+			keys.swap(scratchKeys);
+			items.swap(scratchItems);
+		}
+	}
+
+	// block format the images with the given color channels are
+	// compressed into
+	BlockCompressor::Format SelectTextureFormat(SceneManager::TextureCompression compression, int channels)
+	{
+		switch (compression)
+		{
+		case SceneManager::TEXTURE_COMPRESSION_BC:
+			return((channels == 4) ? BlockCompressor::FORMAT_BC3 : BlockCompressor::FORMAT_BC1);
+		case SceneManager::TEXTURE_COMPRESSION_BC7:
+			return(BlockCompressor::FORMAT_BC7);
+		default:
+			return(BlockCompressor::FORMAT_NONE);
+		}
+	}
+
+	// size of a texture level in GPU memory
+	size_t GetTextureLevelBytes(GLenum internalFormat, int width, int height)
+	{
+		switch (internalFormat)
+		{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			return(BlockCompressor::GetCompressedBytes(BlockCompressor::FORMAT_BC1, width, height));
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+			return(BlockCompressor::GetCompressedBytes(BlockCompressor::FORMAT_BC7, width, height));
+		case GL_RGB8:
+			return((size_t)width * height * 3);
+		default:
+			return((size_t)width * height * 4);
+		}
+	}
 }
 
+// the material buffer is filled straight from GPU_MATERIAL values
+static_assert(sizeof(SceneManager::GPU_MATERIAL) == 48, "GPU_MATERIAL must match the std140 Material layout");
+
 /***********************************************************
  *  SceneManager()
  *
@@ -45,13 +303,57 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
 	m_pShaderManager = pShaderManager;
 	m_basicMeshes = new ShapeMeshes();
 
-	// initialize the texture collection
-	for (int i = 0; i < 16; i++)
+	m_materialBuffer = 0;
+	m_textureUploadBuffer = 0;
+	m_placeholderArray = -1;
+	m_bDrawTexturesDirty = false;
+	m_bUseTextureCache = true;
+	m_texturesFromCache = 0;
+	m_textureCompression = TEXTURE_COMPRESSION_NONE;
+	m_textureCompressionQuality = BlockCompressor::QUALITY_NORMAL;
+	m_instanceBuffer = 0;
+	m_bInstanceDataDirty = false;
+	m_bUseInstancing = true;
+	m_bMultiDrawSupported = false;
+	m_bUseMultiDraw = false;
+	m_indirectBuffer = 0;
+	m_drawDataBuffer = 0;
+	m_bUseDynamicRing = true;
+	m_pDynamicRegion = NULL;
+	m_ringCommandsOffset = 0;
+	m_ringCommandCapacity = 0;
+	m_ringMaterialsAlignment = 0;
+	m_instanceBase = 0;
+	m_instanceDataVersion = 0;
+	memset(m_regionInstanceVersions, 0, sizeof(m_regionInstanceVersions));
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_cameraPosition = glm::vec3(0.0f);
+	m_sortStats.renderItems = 0;
+	m_sortStats.stateChanges = 0;
+	m_sortStats.stateChangesSaved = 0;
+	m_bUseCulling = true;
+	m_cullStats.tested = 0;
+	m_cullStats.visible = 0;
+	m_cullStats.culled = 0;
+	m_bUseLighting = false;
+	m_bUseLod = true;
+	for (int i = 0; i < ShapeMeshes::MAX_MESH_LODS - 1; i++)
 	{
-		m_textureIDs[i].tag = "/0";
-		m_textureIDs[i].ID = -1;
+		m_lodPixelThresholds[i] = DEFAULT_LOD_PIXEL_THRESHOLDS[i];
 	}
-	m_loadedTextures = 0;
+	m_lodHysteresis = DEFAULT_LOD_HYSTERESIS;
+	m_viewportHeight = 0.0f;
+	memset(&m_lodStats, 0, sizeof(m_lodStats));
+	m_pProfiler = NULL;
+	m_cullSection = -1;
+	m_uploadSection = -1;
+	m_sortSection = -1;
+	m_submitSection = -1;
+	m_textureUploadSection = -1;
+	m_trianglesSubmittedCounter = -1;
+	m_trianglesSavedCounter = -1;
+	m_ringWaitsCounter = -1;
 }
 
 /***********************************************************
@@ -67,909 +369,2688 @@ SceneManager::~SceneManager()
 
 	// destroy the created OpenGL textures
 	DestroyGLTextures();
+
+	if (m_materialBuffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_materialBuffer);
+		m_materialBuffer = 0;
+	}
+	if (m_instanceBuffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_instanceBuffer);
+		m_instanceBuffer = 0;
+	}
+	if (m_indirectBuffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_indirectBuffer);
+		m_indirectBuffer = 0;
+	}
+	if (m_drawDataBuffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_drawDataBuffer);
+		m_drawDataBuffer = 0;
+	}
+	m_dynamicRing.Destroy();
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  This method is used for registering textures from image
+ *  files under the special tag string.  Only the image header
+ *  is read here, for the size and format of the texture - the
+ *  image is queued to be decoded, or read from its texture
+ *  cache, on a worker thread once BindGLTextures() is called.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
 	int width = 0;
 	int height = 0;
 	int colorChannels = 0;
-	GLuint textureID = 0;
 
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
+	// try to parse the image size from the specified image file
+	if (stbi_info(filename, &width, &height, &colorChannels) == 0)
+	{
+		std::cout << "Could not load image:" << filename << std::endl;
 
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+		// Error loading the image
+		return false;
+	}
 
-	// if the image was successfully read from the image file
-	if (image)
+	TEXTURE_INFO texture;
+	texture.tag = tag;
+	texture.filename = filename;
+	texture.width = width;
+	texture.height = height;
+	texture.arrayIndex = -1;
+	texture.layer = 0;
+	texture.bUploaded = false;
+	texture.bResident = false;
+
+	if ((colorChannels != 3) && (colorChannels != 4))
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
+		return false;
+	}
+
+	texture.compressedFormat = SelectTextureFormat(m_textureCompression, colorChannels);
+	// if the image is compressed into GPU blocks
+	if (texture.compressedFormat == BlockCompressor::FORMAT_BC1)
+		texture.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else if (texture.compressedFormat == BlockCompressor::FORMAT_BC3)
+		texture.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else if (texture.compressedFormat == BlockCompressor::FORMAT_BC7)
+		texture.internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+	// if the loaded image is in RGB format
+	else if (colorChannels == 3)
+		texture.internalFormat = GL_RGB8;
+	// if the loaded image is in RGBA format - it supports transparency
+	else
+		texture.internalFormat = GL_RGBA8;
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+	// register the texture and associate it with the special tag string
+	m_textureHandles[tag] = (int)m_textures.size();
+	m_textureLoader.Queue((int)m_textures.size(), filename, colorChannels,
+		texture.compressedFormat, m_textureCompressionQuality);
+	m_textures.push_back(texture);
 
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
+	return true;
+}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+/***********************************************************
+ *  BindGLTextures()
+ *
+ *  This method is used for starting to decode the registered
+ *  textures, allocating their texture arrays and binding
+ *  every texture array to the texture unit that matches its
+ *  index.  The images are uploaded by RenderScene() as they
+ *  are decoded, until then the placeholder is drawn instead.
+ ***********************************************************/
+void SceneManager::BindGLTextures()
+{
+	// decode on the worker threads while the arrays are allocated
+	m_textureLoadStart = std::chrono::steady_clock::now();
+	m_texturesFromCache = 0;
+	m_textureLoader.Start(m_bUseTextureCache);
 
+	BuildTextureArrays();
+	CreatePlaceholderTexture();
 
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+	GLint maxTextureUnits = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
+	if ((GLint)m_textureArrays.size() > maxTextureUnits)
+	{
+		std::cout << "The " << m_textureArrays.size() << " texture arrays exceed the "
+			<< maxTextureUnits << " texture units" << std::endl;
+	}
+
+	for (size_t i = 0; (i < m_textureArrays.size()) && ((GLint)i < maxTextureUnits); i++)
+	{
+		// bind texture arrays on corresponding texture units
+		GLStateCache::ActiveTexture(GL_TEXTURE0 + (GLenum)i);
+		GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, m_textureArrays[i].ID);
+	}
+	GLStateCache::ActiveTexture(GL_TEXTURE0);
+
+	std::cout << "Decoding " << m_textureLoader.GetPendingCount() << " textures on "
+		<< m_textureLoader.GetThreadCount() << " worker threads" << std::endl;
+}
+
+/***********************************************************
+ *  BuildTextureArrays()
+ *
+ *  This method is used for assigning every texture that is
+ *  not in a texture array yet to a new array of its size and
+ *  format and allocating the storage of the arrays.  The
+ *  layers are filled by UploadTextureImage().
+ ***********************************************************/
+void SceneManager::BuildTextureArrays()
+{
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+	const size_t firstNewArray = m_textureArrays.size();
+
+	// group the pending textures by size and format
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		TEXTURE_INFO& texture = m_textures[i];
+		if (texture.arrayIndex >= 0)
+		{
+			continue;
+		}
+
+		for (size_t j = firstNewArray; j < m_textureArrays.size(); j++)
+		{
+			const TEXTURE_ARRAY& textureArray = m_textureArrays[j];
+			if ((textureArray.width == texture.width) &&
+				(textureArray.height == texture.height) &&
+				(textureArray.internalFormat == texture.internalFormat) &&
+				(textureArray.layerCount < maxLayers))
+			{
+				texture.arrayIndex = (int)j;
+				break;
+			}
+		}
+
+		if (texture.arrayIndex < 0)
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			TEXTURE_ARRAY textureArray;
+			textureArray.ID = 0;
+			textureArray.width = texture.width;
+			textureArray.height = texture.height;
+			textureArray.internalFormat = texture.internalFormat;
+			textureArray.layerCount = 0;
+			textureArray.pendingLayers = 0;
+			texture.arrayIndex = (int)m_textureArrays.size();
+			m_textureArrays.push_back(textureArray);
 		}
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+		texture.layer = m_textureArrays[texture.arrayIndex].layerCount++;
+		m_textureArrays[texture.arrayIndex].pendingLayers++;
+	}
+
+	for (size_t i = firstNewArray; i < m_textureArrays.size(); i++)
+	{
+		TEXTURE_ARRAY& textureArray = m_textureArrays[i];
 
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+		// one mipmap level for every halving of the larger side,
+		// the same as the mip chains of the texture cache
+		GLsizei levels = TextureCache::GetFullLevelCount(textureArray.width, textureArray.height);
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+		glGenTextures(1, &textureArray.ID);
+		GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, textureArray.internalFormat,
+			textureArray.width, textureArray.height, textureArray.layerCount);
 
-		return true;
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	if (m_textureArrays.size() > firstNewArray)
+	{
+		size_t textureBytes = 0;
+		for (size_t i = 0; i < m_textureArrays.size(); i++)
+		{
+			const TEXTURE_ARRAY& textureArray = m_textureArrays[i];
+			int levels = TextureCache::GetFullLevelCount(textureArray.width, textureArray.height);
+			for (int level = 0; level < levels; level++)
+			{
+				textureBytes += GetTextureLevelBytes(textureArray.internalFormat,
+					std::max(textureArray.width >> level, 1),
+					std::max(textureArray.height >> level, 1)) * textureArray.layerCount;
+			}
+		}
 
-	// Error loading the image
-	return false;
+		std::cout << "Packed " << m_textures.size() << " textures into "
+			<< m_textureArrays.size() << " texture arrays, "
+			<< (double)textureBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  CreatePlaceholderTexture()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for creating the texture array of the
+ *  placeholder, a single neutral grey texel that the objects
+ *  are drawn with until their own texture is resident.
  ***********************************************************/
-void SceneManager::BindGLTextures()
+void SceneManager::CreatePlaceholderTexture()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	if (m_placeholderArray >= 0)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		return;
 	}
+
+	const unsigned char texel[4] = { 128, 128, 128, 255 };
+
+	TEXTURE_ARRAY textureArray;
+	textureArray.width = 1;
+	textureArray.height = 1;
+	textureArray.internalFormat = GL_RGBA8;
+	textureArray.layerCount = 1;
+	textureArray.pendingLayers = 0;
+
+	glGenTextures(1, &textureArray.ID);
+	GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, 1, 1, 1);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	m_placeholderArray = (int)m_textureArrays.size();
+	m_textureArrays.push_back(textureArray);
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  StreamTextureUploads()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for uploading the images that the
+ *  worker threads have decoded since the last frame.  At
+ *  least one image is uploaded per call, and no more once
+ *  TEXTURE_UPLOAD_BUDGET bytes were copied, so the frame
+ *  time stays bounded while the textures stream in.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+void SceneManager::StreamTextureUploads()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	size_t uploadedBytes = 0;
+	TextureLoader::DECODED_IMAGE image;
+	while ((uploadedBytes < TEXTURE_UPLOAD_BUDGET) && (m_textureLoader.PopDecoded(image) == true))
+	{
+		uploadedBytes += UploadTextureImage(image);
+	}
+
+	if (m_bDrawTexturesDirty == true)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		RefreshDrawTextures();
 	}
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  FinishTextureUploads()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for waiting on the worker threads
+ *  and uploading every remaining image at once.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::FinishTextureUploads()
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	TextureLoader::DECODED_IMAGE image;
+	while (m_textureLoader.WaitDecoded(image) == true)
+	{
+		UploadTextureImage(image);
+	}
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	if (m_bDrawTexturesDirty == true)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		RefreshDrawTextures();
+	}
+}
+
+/***********************************************************
+ *  SetTextureCompression()
+ *
+ *  This method is used for choosing the block format of the
+ *  textures that are created from now on.  BC1 and BC3 need
+ *  GL_EXT_texture_compression_s3tc and BC7 needs OpenGL 4.2
+ *  or GL_ARB_texture_compression_bptc - BC7 falls back to
+ *  BC1 and BC3, and those to uncompressed textures.
+ ***********************************************************/
+void SceneManager::SetTextureCompression(TextureCompression compression, BlockCompressor::Quality quality)
+{
+	if ((TEXTURE_COMPRESSION_BC7 == compression) &&
+		!(GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc))
+	{
+		std::cout << "BC7 textures are not supported by the driver, using BC1 and BC3" << std::endl;
+		compression = TEXTURE_COMPRESSION_BC;
+	}
+	if ((TEXTURE_COMPRESSION_BC == compression) && !GLEW_EXT_texture_compression_s3tc)
+	{
+		std::cout << "BC1 and BC3 textures are not supported by the driver, using uncompressed textures" << std::endl;
+		compression = TEXTURE_COMPRESSION_NONE;
 	}
 
-	return(textureID);
+	m_textureCompression = compression;
+	m_textureCompressionQuality = quality;
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  WarmTextureCache()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for building the texture caches of
+ *  a scene ahead of time, so even the first start of the
+ *  application maps the mip chains instead of decoding the
+ *  images.  The images are decoded on the worker threads of
+ *  a texture loader, the same as when the scene is loaded.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+bool SceneManager::WarmTextureCache(
+	const std::string& sceneFilename,
+	TextureCompression compression,
+	BlockCompressor::Quality quality)
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	SceneFile sceneFile;
+	if (sceneFile.Load(sceneFilename) == false)
+	{
+		return(false);
+	}
+
+	std::chrono::steady_clock::time_point warmStart = std::chrono::steady_clock::now();
+	bool bWarmed = true;
+	int warmCount = 0;
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	TextureLoader textureLoader;
+	const SceneFile::TEXTURE_RECORD* pTextures = sceneFile.GetTextures();
+	for (size_t i = 0; i < sceneFile.GetTextureCount(); i++)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		const char* filename = sceneFile.GetString(pTextures[i].filename);
+
+		// the cache holds the channels the texture is created with
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		if ((stbi_info(filename, &width, &height, &colorChannels) == 0) ||
+			((colorChannels != 3) && (colorChannels != 4)))
+		{
+			std::cout << "Could not load image:" << filename << std::endl;
+			bWarmed = false;
+			continue;
+		}
+		textureLoader.Queue((int)i, filename, colorChannels,
+			SelectTextureFormat(compression, colorChannels), quality);
+	}
+	textureLoader.Start(true);
+
+	TextureLoader::DECODED_IMAGE image;
+	while (textureLoader.WaitDecoded(image) == true)
+	{
+		if (NULL == image.pTexture)
+		{
+			std::cout << "Could not load image:" << image.filename << std::endl;
+			bWarmed = false;
+		}
+		else if (image.pTexture->IsFromCache() == true)
+		{
+			std::cout << "The texture cache of " << image.filename << " is up to date" << std::endl;
+		}
+		else if (image.pTexture->IsCacheWritten() == true)
 		{
-			textureSlot = index;
-			bFound = true;
+			std::cout << "Wrote " << TextureCache::GetCacheFilename(image.filename) << ", "
+				<< image.pTexture->GetLevelCount() << " levels";
+			if (image.pTexture->GetFormat() != BlockCompressor::FORMAT_NONE)
+			{
+				std::cout << ", " << BlockCompressor::GetFormatName(image.pTexture->GetFormat())
+					<< " PSNR " << image.pTexture->GetPSNR() << " dB";
+			}
+			std::cout << std::endl;
+			warmCount++;
 		}
 		else
-			index++;
+		{
+			std::cout << "Could not write the texture cache of " << image.filename << std::endl;
+			bWarmed = false;
+		}
+		delete image.pTexture;
 	}
+	textureLoader.Stop();
+
+	std::cout << "Wrote " << warmCount << " of " << sceneFile.GetTextureCount() << " texture caches in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warmStart).count()
+		<< " ms" << std::endl;
 
-	return(textureSlot);
+	return(bWarmed);
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  UploadTextureImage()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for copying the mip chain of a decoded
+ *  image into the pixel buffer object and from there into
+ *  every level of its texture array layer, which lets the
+ *  driver transfer it asynchronously.  The chain was built
+ *  on the worker thread or mapped from the texture cache, so
+ *  no mipmaps are generated here - the textures of an array
+ *  become resident once all its layers are uploaded.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+size_t SceneManager::UploadTextureImage(TextureLoader::DECODED_IMAGE& image)
 {
-	if (m_objectMaterials.size() == 0)
+	if ((image.handle < 0) || (image.handle >= (int)m_textures.size()))
 	{
-		return(false);
+		delete image.pTexture;
+		image.pTexture = NULL;
+		return(0);
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	TEXTURE_INFO& texture = m_textures[image.handle];
+	TEXTURE_ARRAY& textureArray = m_textureArrays[texture.arrayIndex];
+	size_t imageBytes = 0;
+
+	// the texture array stays bound to the texture unit that
+	// matches its index, so it is updated through that unit
+	GLStateCache::ActiveTexture(GL_TEXTURE0 + (GLenum)texture.arrayIndex);
+	GLStateCache::BindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+
+	// a texture that could not be decoded keeps the placeholder
+	const TextureCache* pTexture = image.pTexture;
+	if ((NULL == pTexture) ||
+		(pTexture->GetWidth() != texture.width) ||
+		(pTexture->GetHeight() != texture.height) ||
+		(pTexture->GetFormat() != texture.compressedFormat))
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		std::cout << "Could not load image:" << image.filename << std::endl;
+	}
+	else
+	{
+		std::cout << "Successfully loaded image:" << image.filename << ", width:" << pTexture->GetWidth() << ", height:" << pTexture->GetHeight() << ", channels:" << pTexture->GetChannels();
+		if (texture.compressedFormat != BlockCompressor::FORMAT_NONE)
+		{
+			std::cout << ", " << BlockCompressor::GetFormatName(texture.compressedFormat)
+				<< " PSNR " << pTexture->GetPSNR() << " dB";
+		}
+		std::cout << (pTexture->IsFromCache() ? ", from the texture cache" : "") << std::endl;
+		if (pTexture->IsFromCache() == true)
+		{
+			m_texturesFromCache++;
+		}
+		else if ((m_bUseTextureCache == true) && (pTexture->IsCacheWritten() == false))
+		{
+			std::cout << "Could not write the texture cache of " << image.filename << std::endl;
+		}
+
+		imageBytes = pTexture->GetChainBytes();
+
+		if (0 == m_textureUploadBuffer)
+		{
+			glGenBuffers(1, &m_textureUploadBuffer);
+		}
+
+		// orphan the storage of the last upload, so the copy never
+		// waits for the driver to finish reading it
+		GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_textureUploadBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, imageBytes, NULL, GL_STREAM_DRAW);
+		void* pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, imageBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (NULL != pMapped)
 		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
+			// the levels keep their offsets in the buffer
+			memcpy(pMapped, pTexture->GetLevelData(0), imageBytes);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+			// the rows of RGB images are not padded to 4 bytes
+			GLenum pixelFormat = (textureArray.internalFormat == GL_RGB8) ? GL_RGB : GL_RGBA;
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			for (int level = 0; level < pTexture->GetLevelCount(); level++)
+			{
+				if (texture.compressedFormat != BlockCompressor::FORMAT_NONE)
+				{
+					glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, texture.layer,
+						pTexture->GetLevelWidth(level), pTexture->GetLevelHeight(level), 1,
+						textureArray.internalFormat, (GLsizei)pTexture->GetLevelBytes(level),
+						(const void*)pTexture->GetLevelOffset(level));
+				}
+				else
+				{
+					glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, texture.layer,
+						pTexture->GetLevelWidth(level), pTexture->GetLevelHeight(level), 1,
+						pixelFormat, GL_UNSIGNED_BYTE, (const void*)pTexture->GetLevelOffset(level));
+				}
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			texture.bUploaded = true;
 		}
 		else
 		{
-			index++;
+			std::cout << "Could not map the texture upload buffer" << std::endl;
+			imageBytes = 0;
 		}
+		GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
 
-	return(true);
-}
+	// free the image data from local memory, or unmap the cache
+	delete image.pTexture;
+	image.pTexture = NULL;
 
+	textureArray.pendingLayers--;
+	if (textureArray.pendingLayers == 0)
+	{
+		for (size_t i = 0; i < m_textures.size(); i++)
+		{
+			if ((m_textures[i].arrayIndex == texture.arrayIndex) && (m_textures[i].bUploaded == true))
+			{
+				m_textures[i].bResident = true;
+			}
+		}
+		m_bDrawTexturesDirty = true;
+	}
+	GLStateCache::ActiveTexture(GL_TEXTURE0);
 
+	if (m_textureLoader.GetPendingCount() == 0)
+	{
+		m_textureLoader.Stop();
+		std::cout << "Textures resident after "
+			<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_textureLoadStart).count()
+			<< " ms, " << m_texturesFromCache << " of " << m_textures.size()
+			<< " from the texture cache" << std::endl;
+	}
 
+	return(imageBytes);
+}
 
 /***********************************************************
- *  SetTransformations()
+ *  RefreshDrawTextures()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for pointing the draws of the draw
+ *  list at the textures that became resident instead of the
+ *  placeholder.  The instanced batches are grouped by texture
+ *  array, so they are built again.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::RefreshDrawTextures()
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	for (size_t i = 0; i < m_drawList.Size(); i++)
+	{
+		const glm::ivec2& handles = m_drawList.textureHandles[i];
+		m_drawList.textureArrays[i] = GetTextureArray(handles.x);
+		m_drawList.overlayTextureArrays[i] = GetTextureArray(handles.y);
+		m_drawList.textureLayers[i] = glm::ivec2(GetTextureLayer(handles.x), GetTextureLayer(handles.y));
+	}
 
-	if (NULL != m_pShaderManager)
+	if (m_drawList.Size() > 0)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		BuildInstanceBatches();
 	}
+
+	m_bDrawTexturesDirty = false;
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  DestroyGLTextures()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
- *  This also resets (toggles off) using an overlay texture
+ *  This method is used for stopping the texture decoding and
+ *  freeing the memory of all the texture arrays.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::DestroyGLTextures()
 {
-	// variables for this method
-	glm::vec4 currentColor;
-
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	m_textureLoader.Stop();
 
-	if (NULL != m_pShaderManager)
+	for (size_t i = 0; i < m_textureArrays.size(); i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setIntValue(g_UseTextureOverlayName, false);
+		if (m_textureArrays[i].ID != 0)
+		{
+			GLStateCache::DeleteTextures(1, &m_textureArrays[i].ID);
+		}
+	}
+	m_textureArrays.clear();
+	m_placeholderArray = -1;
 
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+	if (m_textureUploadBuffer != 0)
+	{
+		GLStateCache::DeleteBuffers(1, &m_textureUploadBuffer);
+		m_textureUploadBuffer = 0;
 	}
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  FindTextureHandle()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
- *  This also resets (toggles off) using an overlay texture
+ *  This method is used for getting the handle of the
+ *  previously loaded texture associated with the passed in
+ *  tag, or -1 if there is no such texture.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+int SceneManager::FindTextureHandle(const std::string& tag) const
 {
-	if (NULL != m_pShaderManager)
+	std::unordered_map<std::string, int>::const_iterator it = m_textureHandles.find(tag);
+	if (it == m_textureHandles.end())
 	{
-		m_pShaderManager->setIntValue(g_UseTextureOverlayName, false);
-
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		return(-1);
 	}
+
+	return(it->second);
 }
 
 /***********************************************************
- *  SetShaderTextureOverlay()
+ *  GetTextureArray()
  *
- *  This method is used for setting a second texture overlay
- *  associated with the passed in ID into the shader.
- *  This texture should have transparency if the "underneath"
- *  texture should be visible.
+ *  This method is used for getting the index of the texture
+ *  array, which is also its texture unit, that holds the
+ *  texture with the passed in handle, or -1 for none.  The
+ *  placeholder array is returned until the texture is
+ *  resident.
  ***********************************************************/
-void SceneManager::SetShaderTextureOverlay(
-	std::string textureTag)
+int SceneManager::GetTextureArray(int textureHandle) const
 {
-	if (NULL != m_pShaderManager)
+	if ((textureHandle < 0) || (textureHandle >= (int)m_textures.size()))
 	{
-		m_pShaderManager->setIntValue(g_UseTextureOverlayName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureOverlayValueName, textureID);
+		return(-1);
+	}
+	if (m_textures[textureHandle].bResident == false)
+	{
+		return(m_placeholderArray);
 	}
+
+	return(m_textures[textureHandle].arrayIndex);
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  GetTextureLayer()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for getting the layer of its texture
+ *  array that holds the texture with the passed in handle.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+int SceneManager::GetTextureLayer(int textureHandle) const
 {
-	if (NULL != m_pShaderManager)
+	if ((textureHandle < 0) || (textureHandle >= (int)m_textures.size()) ||
+		(m_textures[textureHandle].bResident == false))
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		return(0);
 	}
+
+	return(m_textures[textureHandle].layer);
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  FindMaterialIndex()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for getting the index of a material in
+ *  the previously defined materials list that is associated
+ *  with the passed in tag, or -1 if there is no such material.
+ *  Only the materials that fit into the material uniform
+ *  buffer are found, so the shader never reads past it.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+int SceneManager::FindMaterialIndex(const std::string& tag)
 {
-	if (m_objectMaterials.size() > 0)
+	for (size_t index = 0; (index < m_objectMaterials.size()) && (index < MAX_MATERIALS); index++)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		{
+			return((int)index);
+		}
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  ResolveUniformHandles()
+ *
+ *  This method is used for looking up the typed handles of
+ *  the uniforms that are set for every drawn object, so the
+ *  per-draw code never builds strings or queries locations.
+ ***********************************************************/
+void SceneManager::ResolveUniformHandles()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	m_modelUniform = m_pShaderManager->GetUniformHandle<glm::mat4>(g_ModelName);
+	m_normalMatrixUniform = m_pShaderManager->GetUniformHandle<glm::mat3>(g_NormalMatrixName);
+	m_colorUniform = m_pShaderManager->GetUniformHandle<glm::vec4>(g_ColorValueName);
+	m_textureUniform = m_pShaderManager->GetUniformHandle<int>(g_TextureValueName);
+	m_textureOverlayUniform = m_pShaderManager->GetUniformHandle<int>(g_TextureOverlayValueName);
+	m_textureLayerUniform = m_pShaderManager->GetUniformHandle<int>(g_TextureLayerName);
+	m_textureOverlayLayerUniform = m_pShaderManager->GetUniformHandle<int>(g_TextureOverlayLayerName);
+	m_drawDataBaseUniform = m_pShaderManager->GetUniformHandle<int>(g_DrawDataBaseName);
+	m_UVscaleUniform = m_pShaderManager->GetUniformHandle<glm::vec2>(g_UVscaleName);
+	m_materialIndexUniform = m_pShaderManager->GetUniformHandle<int>(g_MaterialIndexName);
+}
+
+/***********************************************************
+ *  GetShaderFeatures()
+ *
+ *  This method is used for getting the feature mask of the
+ *  shader variant that draws an object with or without its
+ *  texture and overlay texture.
+ ***********************************************************/
+unsigned int SceneManager::GetShaderFeatures(bool bTexture, bool bTextureOverlay) const
+{
+	unsigned int features = 0;
+
+	if (bTexture == true)
+	{
+		features |= ShaderManager::FEATURE_TEXTURE;
+	}
+	if (bTextureOverlay == true)
+	{
+		features |= ShaderManager::FEATURE_TEXTURE_OVERLAY;
+	}
+	if (m_bUseLighting == true)
+	{
+		features |= ShaderManager::FEATURE_LIGHTING;
+	}
+
+	return(features);
+}
+
+/***********************************************************
+ *  CreateMaterialBuffer()
+ *
+ *  This method is used for uploading all of the defined
+ *  materials into the uniform buffer that the fragment
+ *  shader reads, so each draw only selects its material
+ *  with a single index.
+ ***********************************************************/
+void SceneManager::CreateMaterialBuffer()
+{
+	if (m_objectMaterials.size() > MAX_MATERIALS)
+	{
+		std::cout << "Only the first " << MAX_MATERIALS << " of " << m_objectMaterials.size()
+			<< " materials fit in the material buffer" << std::endl;
+	}
+
+	// unused slots are left zeroed
+	std::vector<GPU_MATERIAL> gpuMaterials(MAX_MATERIALS);
+	memset(&gpuMaterials[0], 0, gpuMaterials.size() * sizeof(GPU_MATERIAL));
+
+	for (size_t i = 0; (i < m_objectMaterials.size()) && (i < MAX_MATERIALS); i++)
+	{
+		gpuMaterials[i].ambientColor = m_objectMaterials[i].ambientColor;
+		gpuMaterials[i].ambientStrength = m_objectMaterials[i].ambientStrength;
+		gpuMaterials[i].diffuseColor = m_objectMaterials[i].diffuseColor;
+		gpuMaterials[i].specularColor = m_objectMaterials[i].specularColor;
+		gpuMaterials[i].shininess = m_objectMaterials[i].shininess;
+	}
+
+	if (m_materialBuffer == 0)
+	{
+		glGenBuffers(1, &m_materialBuffer);
+	}
+
+	GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, gpuMaterials.size() * sizeof(GPU_MATERIAL), &gpuMaterials[0], GL_DYNAMIC_DRAW);
+	GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	GLStateCache::BindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialBuffer);
+}
+
+/***********************************************************
+ *  UpdateMaterialSlot()
+ *
+ *  This method is used for uploading a single material
+ *  into its slot of the material uniform buffer after its
+ *  values were changed.
+ ***********************************************************/
+void SceneManager::UpdateMaterialSlot(int materialIndex)
+{
+	if ((m_materialBuffer == 0) || (materialIndex < 0) ||
+		(materialIndex >= MAX_MATERIALS) || (materialIndex >= (int)m_objectMaterials.size()))
+	{
+		return;
+	}
+
+	GPU_MATERIAL gpuMaterial;
+	gpuMaterial.ambientColor = m_objectMaterials[materialIndex].ambientColor;
+	gpuMaterial.ambientStrength = m_objectMaterials[materialIndex].ambientStrength;
+	gpuMaterial.diffuseColor = m_objectMaterials[materialIndex].diffuseColor;
+	gpuMaterial.padding = 0.0f;
+	gpuMaterial.specularColor = m_objectMaterials[materialIndex].specularColor;
+	gpuMaterial.shininess = m_objectMaterials[materialIndex].shininess;
+
+	GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, materialIndex * sizeof(GPU_MATERIAL), sizeof(GPU_MATERIAL), &gpuMaterial);
+	GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+#ifdef _DEBUG
+/***********************************************************
+ *  ApplyLiveMaterialEdits()
+ *
+ *  This method is used for copying the materials that were
+ *  adjusted in the live transformation UI back into the
+ *  material list and uploading only their changed slots.
+ ***********************************************************/
+void SceneManager::ApplyLiveMaterialEdits()
+{
+	if (nullptr == this->xfmrs)
+	{
+		return;
+	}
+
+	for (size_t i = 0; (i < this->xfmrs->getMaterialCount()) && (i < m_objectMaterials.size()); i++)
+	{
+		LiveMaterial* liveMaterial = this->xfmrs->getMaterial(i);
+		if (liveMaterial->dirty == false)
+		{
+			continue;
+		}
+
+		OBJECT_MATERIAL& material = m_objectMaterials[i];
+		material.ambientColor = glm::make_vec3(liveMaterial->ambientColor);
+		material.ambientStrength = liveMaterial->ambientStrength;
+		material.diffuseColor = glm::make_vec3(liveMaterial->diffuseColor);
+		material.specularColor = glm::make_vec3(liveMaterial->specularColor);
+		material.shininess = liveMaterial->shininess;
+
+		UpdateMaterialSlot((int)i);
+		liveMaterial->dirty = false;
+	}
+}
+
+/***********************************************************
+ *  ApplyLiveTransformEdits()
+ *
+ *  This method is used for copying the transformations and
+ *  colors that were adjusted in the live transformation UI
+ *  into the scene objects.  Only the draws whose values
+ *  changed get their cached matrices and bounds recomputed.
+ ***********************************************************/
+void SceneManager::ApplyLiveTransformEdits()
+{
+	for (size_t i = 0; (i < m_drawTransformers.size()) && (i < m_sceneObjects.size()); i++)
+	{
+		LiveTransformer* objXfmr = m_drawTransformers[i];
+		if (objXfmr == nullptr)
+		{
+			continue;
+		}
+
+		SCENE_OBJECT& object = m_sceneObjects[i];
+		glm::vec3 scale(objXfmr->XscaleAdjusted, objXfmr->YscaleAdjusted, objXfmr->ZscaleAdjusted);
+		glm::vec3 rotation(objXfmr->XrotationAdjusted, objXfmr->YrotationAdjusted, objXfmr->ZrotationAdjusted);
+		glm::vec3 position(objXfmr->XpositionAdjusted, objXfmr->YpositionAdjusted, objXfmr->ZpositionAdjusted);
+		glm::vec3 color(objXfmr->RcolorAdjusted, objXfmr->GcolorAdjusted, objXfmr->BcolorAdjusted);
+
+		if ((scale != object.scale) || (rotation != object.rotation) || (position != object.position))
+		{
+			object.scale = scale;
+			object.rotation = rotation;
+			object.position = position;
+
+			ComposeTransform(scale, rotation, position,
+				m_drawList.modelMatrices[i], m_drawList.normalMatrices[i]);
+			UpdateDrawBounds(i);
+			m_bInstanceDataDirty = true;
+		}
+
+		if (color != glm::vec3(object.color))
+		{
+			object.color = glm::vec4(color, object.color.a);
+			m_drawList.colors[i] = glm::vec4(color, m_drawList.colors[i].a);
+			m_bInstanceDataDirty = true;
+		}
+	}
+}
+#endif
+
+/***********************************************************
+ *  ComposeModelMatrix()
+ *
+ *  This method is used for building the model matrix from the
+ *  passed in scale, rotation (in degrees) and position values.
+ ***********************************************************/
+glm::mat4 SceneManager::ComposeModelMatrix(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegrees,
+	const glm::vec3& positionXYZ)
+{
+	glm::mat4 modelMatrix;
+	glm::mat3 normalMatrix;
+
+	ComposeTransform(scaleXYZ, rotationDegrees, positionXYZ, modelMatrix, normalMatrix);
+	return(modelMatrix);
+}
+
+/***********************************************************
+ *  ComposeTransform()
+ *
+ *  This method is used for building the model matrix
+ *  translation * rotationX * rotationY * rotationZ * scale
+ *  directly from the sines and cosines of the rotation
+ *  angles, without multiplying 4x4 matrices.  The normal
+ *  matrix, the inverse transpose of the upper 3x3, is the
+ *  rotation with the inverse scale.
+ ***********************************************************/
+void SceneManager::ComposeTransform(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegrees,
+	const glm::vec3& positionXYZ,
+	glm::mat4& modelMatrix,
+	glm::mat3& normalMatrix)
+{
+	glm::vec3 radians = glm::radians(rotationDegrees);
+	float cx = std::cos(radians.x), sx = std::sin(radians.x);
+	float cy = std::cos(radians.y), sy = std::sin(radians.y);
+	float cz = std::cos(radians.z), sz = std::sin(radians.z);
+
+	// columns of rotationX * rotationY * rotationZ
+	glm::vec3 rotation0(cy * cz, cx * sz + sx * sy * cz, sx * sz - cx * sy * cz);
+	glm::vec3 rotation1(-cy * sz, cx * cz - sx * sy * sz, sx * cz + cx * sy * sz);
+	glm::vec3 rotation2(sy, -sx * cy, cx * cy);
+
+	modelMatrix[0] = glm::vec4(rotation0 * scaleXYZ.x, 0.0f);
+	modelMatrix[1] = glm::vec4(rotation1 * scaleXYZ.y, 0.0f);
+	modelMatrix[2] = glm::vec4(rotation2 * scaleXYZ.z, 0.0f);
+	modelMatrix[3] = glm::vec4(positionXYZ, 1.0f);
+
+	// a zero scale flattens the object, its normals are left at zero
+	normalMatrix[0] = rotation0 * ((scaleXYZ.x != 0.0f) ? 1.0f / scaleXYZ.x : 0.0f);
+	normalMatrix[1] = rotation1 * ((scaleXYZ.y != 0.0f) ? 1.0f / scaleXYZ.y : 0.0f);
+	normalMatrix[2] = rotation2 * ((scaleXYZ.z != 0.0f) ? 1.0f / scaleXYZ.z : 0.0f);
+}
+
+/***********************************************************
+ *  ComposeModelMatrixChained()
+ *
+ *  This method is used for building the model matrix by
+ *  multiplying separate scale, rotation and translation
+ *  matrices, the way it was built before ComposeTransform().
+ ***********************************************************/
+glm::mat4 SceneManager::ComposeModelMatrixChained(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegrees,
+	const glm::vec3& positionXYZ)
+{
+	// variables for this method
+	glm::mat4 scale;
+	glm::mat4 rotationX;
+	glm::mat4 rotationY;
+	glm::mat4 rotationZ;
+	glm::mat4 translation;
+
+	// set the scale value in the transform buffer
+	scale = glm::scale(scaleXYZ);
+	// set the rotation values in the transform buffer
+	rotationX = glm::rotate(glm::radians(rotationDegrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotationY = glm::rotate(glm::radians(rotationDegrees.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	rotationZ = glm::rotate(glm::radians(rotationDegrees.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	// set the translation value in the transform buffer
+	translation = glm::translate(positionXYZ);
+
+	return(translation * rotationX * rotationY * rotationZ * scale);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// variables for this method
+	glm::mat4 modelView;
+	glm::mat3 normalMatrix;
+
+	ComposeTransform(
+		scaleXYZ,
+		glm::vec3(XrotationDegrees, YrotationDegrees, ZrotationDegrees),
+		positionXYZ,
+		modelView,
+		normalMatrix);
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->SetUniform(m_modelUniform, modelView);
+		m_pShaderManager->SetUniform(m_normalMatrixUniform, normalMatrix);
+	}
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ *  This also resets (toggles off) using an overlay texture
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->UseVariant(GetShaderFeatures(false, false));
+
+		m_pShaderManager->SetUniform(m_colorUniform, currentColor);
+	}
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ *  This also resets (toggles off) using an overlay texture
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	std::string textureTag)
+{
+	SetShaderTexture(FindTextureHandle(textureTag));
+}
+
+void SceneManager::SetShaderTexture(
+	int textureHandle)
+{
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->UseVariant(GetShaderFeatures(true, false));
+
+		m_pShaderManager->SetUniform(m_textureUniform, GetTextureArray(textureHandle));
+		m_pShaderManager->SetUniform(m_textureLayerUniform, GetTextureLayer(textureHandle));
+	}
+}
+
+/***********************************************************
+ *  SetShaderTextureOverlay()
+ *
+ *  This method is used for setting a second texture overlay
+ *  associated with the passed in ID into the shader.
+ *  This texture should have transparency if the "underneath"
+ *  texture should be visible.
+ ***********************************************************/
+void SceneManager::SetShaderTextureOverlay(
+	std::string textureTag)
+{
+	SetShaderTextureOverlay(FindTextureHandle(textureTag));
+}
+
+void SceneManager::SetShaderTextureOverlay(
+	int textureHandle)
+{
+	if (NULL != m_pShaderManager)
+	{
+		// the overlay keeps the texture or color set before it
+		m_pShaderManager->UseVariant(
+			m_pShaderManager->GetVariantFeatures() | ShaderManager::FEATURE_TEXTURE_OVERLAY);
+
+		m_pShaderManager->SetUniform(m_textureOverlayUniform, GetTextureArray(textureHandle));
+		m_pShaderManager->SetUniform(m_textureOverlayLayerUniform, GetTextureLayer(textureHandle));
+	}
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->SetUniform(m_UVscaleUniform, glm::vec2(u, v));
+	}
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for selecting the material that the
+ *  shader reads from the material uniform buffer.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	std::string materialTag)
+{
+	if (m_objectMaterials.size() > 0)
+	{
+		int materialIndex = FindMaterialIndex(materialTag);
+		if (materialIndex >= 0)
+		{
+			SetShaderMaterial(materialIndex);
+		}
+	}
+}
+
+void SceneManager::SetShaderMaterial(
+	int materialIndex)
+{
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->SetUniform(m_materialIndexUniform, materialIndex);
+	}
+}
+
+/**************************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
+/*** preparing and rendering their own 3D replicated scenes.***/
+/*** Please refer to the code in the OpenGL sample project  ***/
+/*** for assistance.                                        ***/
+/**************************************************************/
+
+ /***********************************************************
+  *  DefineObjectMaterials()
+  *
+  *  This method is used for configuring the various material
+  *  settings for all of the objects within the 3D scene, as
+  *  they are given in the scene file.
+  ***********************************************************/
+void SceneManager::DefineObjectMaterials(const SceneFile& sceneFile)
+{
+	/**
+	 ** Material Properties
+	 **
+	 ** **ambientColor** is a vec3 color value that can be used to set the ambient emission color.
+	 ** **ambientStrength** is a float value that defines how much ambient light is emited.
+	 ** **diffuseColor** is a vec3 color value that defines the diffuse light emission color.
+	 ** **specularColor** is a vec3 color value that defines the specular light reflection color.
+	 ** **shininess** is a float value that tells how shiny the material is and how much specular light will be
+	 **   reflected off the surface.
+	 ** **tag** is a special string that is used to identify the material in the collection.
+	 **/
+
+	const SceneFile::MATERIAL_RECORD* pMaterials = sceneFile.GetMaterials();
+	for (size_t i = 0; i < sceneFile.GetMaterialCount(); i++)
+	{
+		const SceneFile::MATERIAL_RECORD& record = pMaterials[i];
+
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::make_vec3(record.ambientColor);
+		material.ambientStrength = record.ambientStrength;
+		material.diffuseColor = glm::make_vec3(record.diffuseColor);
+		material.specularColor = glm::make_vec3(record.specularColor);
+		material.shininess = record.shininess;
+		material.tag = sceneFile.GetString(record.tag);
+
+		m_objectMaterials.push_back(material);
+	}
+
+	// the objects without a material use the default material, so
+	// it is added if the scene file does not define it - this is
+	// an adaptation of "white rubber" from
+	//  http://www.it.hiof.no/~borres/j3d/explain/light/p-materials.html
+	if (FindMaterialIndex("default") < 0)
+	{
+		OBJECT_MATERIAL defaultMaterial;
+		defaultMaterial.ambientColor = glm::vec3(0.5f, 0.5f, 0.5f);
+		defaultMaterial.ambientStrength = 0.1f;
+		defaultMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
+		defaultMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
+		defaultMaterial.shininess = 10.0;
+		defaultMaterial.tag = "default";
+
+		m_objectMaterials.push_back(defaultMaterial);
+	}
+}
+
+/***********************************************************
+ *  SetupSceneLights()
+ *
+ *  This method is called to add and configure the light
+ *  sources of the scene file for the 3D scene.  There are up
+ *  to MAX_SCENE_LIGHTS light sources.
+ ***********************************************************/
+void SceneManager::SetupSceneLights(const SceneFile& sceneFile)
+{
+	// this line of code is NEEDED for telling the shaders to render 
+	// the 3D scene with custom lighting, if no light sources have
+	// been added then the display window will be black - to use the 
+	// default OpenGL lighting then comment out the following line
+	m_bUseLighting = true;
+
+	/**
+	 ** Light Properties
+	 **
+	 ** **position** is a vec3 value that sets the position of the light source in 3D space.
+	 ** **ambientColor** is a vec3 value that defines the color of the ambient light being emited.
+	 ** **diffuseColor** is a vec3 value that defines the color of the diffuse light being emited.
+	 ** **specularColor** is a vec3 value that defines the color of the specular light being emited.
+	 ** **focalStrength** is a float value that defines the focus of the light beam being emited.
+	 ** **specularIntensity** is a float value that defines the intensity of the emited specular lighting.
+	 **/
+
+	size_t lightCount = sceneFile.GetLightCount();
+	if (lightCount > MAX_SCENE_LIGHTS)
+	{
+		std::cout << "The scene has " << lightCount << " lights, only the first "
+			<< MAX_SCENE_LIGHTS << " are used" << std::endl;
+		lightCount = MAX_SCENE_LIGHTS;
+	}
+
+	const SceneFile::LIGHT_RECORD* pLights = sceneFile.GetLights();
+	for (size_t i = 0; i < lightCount; i++)
+	{
+		const SceneFile::LIGHT_RECORD& light = pLights[i];
+		const std::string name = "lightSources[" + std::to_string(i) + "].";
+
+		m_pShaderManager->setVec3Value(name + "position", glm::make_vec3(light.position));
+		m_pShaderManager->setVec3Value(name + "ambientColor", glm::make_vec3(light.ambientColor));
+		m_pShaderManager->setVec3Value(name + "diffuseColor", glm::make_vec3(light.diffuseColor));
+		m_pShaderManager->setVec3Value(name + "specularColor", glm::make_vec3(light.specularColor));
+		m_pShaderManager->setFloatValue(name + "focalStrength", light.focalStrength);
+		m_pShaderManager->setFloatValue(name + "specularIntensity", light.specularIntensity);
+	}
+}
+
+/***********************************************************
+ *  LoadSceneTextures()
+ *
+ *  This method is used for loading the textures of the scene
+ *  file.  The textures are packed into texture arrays, so
+ *  there is no fixed limit.
+ ***********************************************************/
+void SceneManager::LoadSceneTextures(const SceneFile& sceneFile)
+{
+	const SceneFile::TEXTURE_RECORD* pTextures = sceneFile.GetTextures();
+	for (size_t i = 0; i < sceneFile.GetTextureCount(); i++)
+	{
+		bool bReturn = CreateGLTexture(
+			sceneFile.GetString(pTextures[i].filename),
+			sceneFile.GetString(pTextures[i].tag));
+		if (bReturn == false)
+		{
+			std::cout << "Could not load the texture '" << sceneFile.GetString(pTextures[i].tag) << "'" << std::endl;
+		}
+	}
+
+	// after the texture image data is loaded into memory, the
+	// loaded textures need to be packed into texture arrays and
+	// bound to texture units
+	BindGLTextures();
+}
+
+/***********************************************************
+ *  LoadSceneMeshes()
+ *
+ *  This method is used for loading the meshes of the scene
+ *  file.  Only one instance of a particular mesh needs to be
+ *  loaded in memory no matter how many times it is drawn in
+ *  the rendered 3D scene.
+ ***********************************************************/
+void SceneManager::LoadSceneMeshes(const SceneFile& sceneFile)
+{
+	m_sceneMeshes.assign(sceneFile.GetMeshes(), sceneFile.GetMeshes() + sceneFile.GetMeshCount());
+	LoadMeshes(m_basicMeshes);
+
+	if (m_basicMeshes->GetVertexFormat() == ShapeMeshes::VERTEX_FORMAT_COMPACT)
+	{
+		GLuint vertexBytes = 0;
+		GLuint floatVertexBytes = 0;
+		for (size_t i = 0; i < m_sceneMeshes.size(); i++)
+		{
+			ShapeMeshes::VERTEX_BUFFER_INFO info = m_basicMeshes->GetVertexBufferInfo(m_sceneMeshes[i].meshID);
+			vertexBytes += info.vertexBytes;
+			floatVertexBytes += info.floatVertexBytes;
+		}
+		std::cout << "Loaded the meshes in the compact vertex layout, " << vertexBytes
+			<< " vertex bytes instead of " << floatVertexBytes << std::endl;
+	}
+}
+
+/***********************************************************
+ *  LoadMeshes()
+ *
+ *  This method is used for loading the meshes of the scene
+ *  into the passed in shapes, in their vertex layout, with
+ *  the levels of detail that the scene file asks for.
+ ***********************************************************/
+void SceneManager::LoadMeshes(ShapeMeshes* pMeshes) const
+{
+	for (size_t i = 0; i < m_sceneMeshes.size(); i++)
+	{
+		const SceneFile::MESH_RECORD& mesh = m_sceneMeshes[i];
+
+		switch (mesh.meshID)
+		{
+		case ShapeMeshes::MESH_BOX:					pMeshes->LoadBoxMesh(); break;
+		case ShapeMeshes::MESH_CONE:				pMeshes->LoadConeMesh(); break;
+		case ShapeMeshes::MESH_CYLINDER:			pMeshes->LoadCylinderMesh(); break;
+		case ShapeMeshes::MESH_PLANE:				pMeshes->LoadPlaneMesh(); break;
+		case ShapeMeshes::MESH_TILING_PLANE:		pMeshes->LoadTilingPlaneMesh(mesh.parameters[0], mesh.parameters[1]); break;
+		case ShapeMeshes::MESH_PRISM:				pMeshes->LoadPrismMesh(); break;
+		case ShapeMeshes::MESH_PYRAMID3:			pMeshes->LoadPyramid3Mesh(); break;
+		case ShapeMeshes::MESH_PYRAMID4:			pMeshes->LoadPyramid4Mesh(); break;
+		case ShapeMeshes::MESH_SPHERE:				pMeshes->LoadSphereMesh(); break;
+		case ShapeMeshes::MESH_TAPERED_CYLINDER:	pMeshes->LoadTaperedCylinderMesh(); break;
+		case ShapeMeshes::MESH_TORUS:				pMeshes->LoadTorusMesh(mesh.parameters[0]); break;
+		default: break;
+		}
+
+		// the coarser levels of detail are generated from the
+		// tessellation of the round shapes
+		if (mesh.lodCount > 1)
+		{
+			pMeshes->LoadMeshLods(mesh.meshID, mesh.lodCount);
+		}
+	}
+}
+
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method is used for adding the objects of the scene
+ *  file to the 3D scene.
+ ***********************************************************/
+void SceneManager::DefineSceneObjects(const SceneFile& sceneFile)
+{
+	const SceneFile::OBJECT_RECORD* pObjects = sceneFile.GetObjects();
+	m_sceneObjects.reserve(m_sceneObjects.size() + sceneFile.GetObjectCount());
+
+	for (size_t i = 0; i < sceneFile.GetObjectCount(); i++)
+	{
+		const SceneFile::OBJECT_RECORD& object = pObjects[i];
+
+		AddSceneObject(
+			sceneFile.GetString(object.name),
+			object.meshID,
+			glm::make_vec3(object.scale),
+			glm::make_vec3(object.rotation),
+			glm::make_vec3(object.position),
+			glm::make_vec4(object.color),
+			sceneFile.GetString(object.textureTag),
+			sceneFile.GetString(object.overlayTextureTag),
+			sceneFile.GetString(object.materialTag));
+		m_sceneObjects.back().meshParts = object.meshParts;
+	}
+}
+
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene 
+ *  rendering.  Everything in the scene is read from the
+ *  scene file - returns false if it could not be loaded.
+ ***********************************************************/
+bool SceneManager::PrepareScene(
+	const std::string& sceneFilename,
+	bool bUseSceneCache,
+	bool bUseTextureCache)
+{ 
+	// look up the uniforms that are set for every drawn object
+	ResolveUniformHandles();
+
+	// read the scene file, or its compiled cache if that is up to date
+	std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+	SceneFile sceneFile;
+	if (sceneFile.Load(sceneFilename, bUseSceneCache) == false)
+	{
+		return(false);
+	}
+	std::cout << (sceneFile.IsFromCache() ? "Mapped the scene cache of " : "Compiled the scene file ")
+		<< sceneFilename << " in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count()
+		<< " ms" << std::endl;
+
+	// load the textures for the 3D scene
+	m_bUseTextureCache = bUseTextureCache;
+	LoadSceneTextures(sceneFile);
+
+	// load the materials for scene objects
+	DefineObjectMaterials(sceneFile);
+
+#ifdef _DEBUG
+	// register the materials so they can be adjusted in the live UI
+	if (nullptr != this->xfmrs)
+	{
+		for (size_t i = 0; i < m_objectMaterials.size(); i++)
+		{
+			const OBJECT_MATERIAL& material = m_objectMaterials[i];
+			this->xfmrs->RegisterNewMaterial(
+				material.tag,
+				material.ambientColor.r,  material.ambientColor.g,  material.ambientColor.b,  material.ambientStrength,
+				material.diffuseColor.r,  material.diffuseColor.g,  material.diffuseColor.b,
+				material.specularColor.r, material.specularColor.g, material.specularColor.b, material.shininess);
+		}
+	}
+#endif
+
+	// the shader selects the materials from a uniform buffer
+	// by index, so they only need to be uploaded once
+	CreateMaterialBuffer();
+
+	// load the light sources for the scene
+	SetupSceneLights(sceneFile);
+
+	// load the meshes that the scene objects are drawn with
+	LoadSceneMeshes(sceneFile);
+
+	// pack the loaded meshes into shared buffers so the whole scene
+	// can be drawn with a few multi-draw indirect calls - this needs
+	// OpenGL 4.3 and gl_DrawID, which the shader only has when the
+	// driver supports GL_ARB_shader_draw_parameters
+	if (GLEW_VERSION_4_3 && GLEW_ARB_shader_draw_parameters &&
+		m_basicMeshes->BuildSharedMeshBuffer())
+	{
+		glGenBuffers(1, &m_indirectBuffer);
+		glGenBuffers(1, &m_drawDataBuffer);
+		m_bMultiDrawSupported = true;
+	}
+	else
+	{
+		std::cout << "Multi-draw indirect is not supported, drawing one mesh at a time" << std::endl;
+	}
+	m_bUseMultiDraw = m_bMultiDrawSupported;
+
+	// the instanced draws read their model matrix and color
+	// from the instance buffer, which every mesh VAO refers to
+	glGenBuffers(1, &m_instanceBuffer);
+	m_basicMeshes->AttachInstanceBuffer(m_instanceBuffer);
+
+	// define the objects of the 3D scene
+	DefineSceneObjects(sceneFile);
+
+	// resolve the meshes, textures and materials of the scene
+	// objects once, so rendering only walks the draw list
+	CompileDrawList();
+
+	return(true);
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by 
+ *  walking the compiled draw list and drawing the basic
+ *  3D shapes
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	// upload the textures that were decoded since the last frame
+	if (m_textureLoader.GetPendingCount() > 0)
+	{
+		FrameProfiler::ScopedSection section(m_pProfiler, m_textureUploadSection);
+		StreamTextureUploads();
+	}
+
+	{
+		FrameProfiler::ScopedSection section(m_pProfiler, m_cullSection);
+
+#ifdef _DEBUG
+		// pick up the adjustments made in the live transformation UI
+		ApplyLiveTransformEdits();
+		ApplyLiveMaterialEdits();
+#endif
+
+		// only the draws in the view frustum are uploaded and queued
+		CullDrawList();
+		SelectDrawLods();
+	}
+
+	if (m_bUseInstancing == true)
+	{
+		FrameProfiler::ScopedSection section(m_pProfiler, m_uploadSection);
+		if (m_bInstanceDataDirty == true)
+		{
+			UploadInstanceData();
+		}
+
+		// the ring is created again when it grows and the benchmarks
+		// swap in other meshes, so the VAOs are pointed at the
+		// instance buffer of this frame here
+		GLuint instanceBuffer = m_instanceBuffer;
+		m_instanceBase = 0;
+		if (m_dynamicRing.IsCreated() == true)
+		{
+			BeginDynamicRegion();
+			instanceBuffer = m_dynamicRing.GetBuffer();
+		}
+		if (m_basicMeshes->GetInstanceBuffer() != instanceBuffer)
+		{
+			m_basicMeshes->AttachInstanceBuffer(instanceBuffer);
+		}
+	}
+
+	// sort the batches and draws of this frame by their state and
+	// depth, then draw them in an opaque and a transparent pass
+	{
+		FrameProfiler::ScopedSection section(m_pProfiler, m_sortSection);
+		BuildRenderQueue();
+	}
+
+	FrameProfiler::ScopedSection section(m_pProfiler, m_submitSection);
+	if ((m_bUseInstancing == true) && (m_bUseMultiDraw == true))
+	{
+		SubmitMultiDrawQueue();
+	}
+	else
+	{
+		SubmitRenderQueue();
+	}
+
+	// the ring fences the region when the next frame begins
+	m_pDynamicRegion = NULL;
+}
+
+/***********************************************************
+ *  SetProfiler()
+ *
+ *  This method is used for adding the stages of RenderScene()
+ *  as sections of the passed in profiler.  Passing NULL
+ *  turns the timing off.
+ ***********************************************************/
+void SceneManager::SetProfiler(FrameProfiler* pProfiler)
+{
+	m_pProfiler = pProfiler;
+	if (NULL == m_pProfiler)
+	{
+		return;
+	}
+
+	m_cullSection = m_pProfiler->AddSection("scene_cull");
+	m_uploadSection = m_pProfiler->AddSection("scene_upload");
+	m_sortSection = m_pProfiler->AddSection("scene_sort");
+	m_submitSection = m_pProfiler->AddSection("scene_submit");
+	m_textureUploadSection = m_pProfiler->AddSection("texture_upload");
+	m_trianglesSubmittedCounter = m_pProfiler->AddCounter("triangles_submitted");
+	m_trianglesSavedCounter = m_pProfiler->AddCounter("triangles_saved");
+	m_ringWaitsCounter = m_pProfiler->AddCounter("ring_waits");
+}
+
+/***********************************************************
+ *  SetLodSelection()
+ *
+ *  This method is used for turning the level of detail
+ *  selection on or off.  With it off every draw uses LOD 0.
+ ***********************************************************/
+void SceneManager::SetLodSelection(bool bEnabled)
+{
+	m_bUseLod = bEnabled;
+}
+
+/***********************************************************
+ *  SetPersistentBuffers()
+ *
+ *  This method is used for turning the persistently mapped
+ *  ring buffer on or off.  With it off the instance data,
+ *  the indirect commands and the draw materials are
+ *  uploaded with glBufferData().
+ ***********************************************************/
+void SceneManager::SetPersistentBuffers(bool bEnabled)
+{
+	m_bUseDynamicRing = bEnabled;
+	if (bEnabled == true)
+	{
+		if (m_drawList.Size() > 0)
+		{
+			ReserveDynamicRing();
+		}
+	}
+	else
+	{
+		m_dynamicRing.Destroy();
+	}
+
+	// the buffer of the other path holds older instance data
+	m_bInstanceDataDirty = true;
+}
+
+/***********************************************************
+ *  SetLodThresholds()
+ *
+ *  This method is used for setting the projected diameters
+ *  in pixels below which the draws drop to the next level
+ *  of detail.
+ ***********************************************************/
+void SceneManager::SetLodThresholds(const float pixels[ShapeMeshes::MAX_MESH_LODS - 1])
+{
+	for (int i = 0; i < ShapeMeshes::MAX_MESH_LODS - 1; i++)
+	{
+		m_lodPixelThresholds[i] = pixels[i];
+	}
+}
+
+/***********************************************************
+ *  SetLodHysteresis()
+ *
+ *  This method is used for setting how far the projected
+ *  diameter of a draw has to cross a threshold, as a
+ *  fraction of it, before the level of detail changes.
+ ***********************************************************/
+void SceneManager::SetLodHysteresis(float hysteresis)
+{
+	m_lodHysteresis = std::max(0.0f, std::min(hysteresis, 0.9f));
+}
+
+/***********************************************************
+ *  SetViewParameters()
+ *
+ *  This method is used for setting the view that the next
+ *  frame is rendered from, as prepared by the ViewManager.
+ ***********************************************************/
+void SceneManager::SetViewParameters(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& cameraPosition,
+	float viewportHeight)
+{
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_cameraPosition = cameraPosition;
+
+	m_frustumCuller.SetViewProjection(projection * view);
+
+	// the level of detail is picked from the size on the screen -
+	// the height comes from the ViewManager instead of being read
+	// back from OpenGL every frame
+	m_viewportHeight = viewportHeight;
+}
+
+/***********************************************************
+ *  CullDrawList()
+ *
+ *  This method is used for testing the bounding box of every
+ *  entry in the draw list against the view frustum.  The
+ *  instance data is uploaded again when the set of visible
+ *  draws changed since the frame before.
+ ***********************************************************/
+void SceneManager::CullDrawList()
+{
+	const size_t drawCount = m_drawList.Size();
+
+	m_drawVisible.swap(m_drawVisiblePrevious);
+	m_drawVisible.resize(drawCount);
+
+	size_t visibleCount = drawCount;
+	if (m_bUseCulling == true)
+	{
+		visibleCount = m_frustumCuller.CullBoxes(m_drawBounds, m_drawVisible.data());
+	}
+	else
+	{
+		std::fill(m_drawVisible.begin(), m_drawVisible.end(), (unsigned char)1);
+	}
+
+	if (m_drawVisible != m_drawVisiblePrevious)
+	{
+		m_bInstanceDataDirty = true;
+	}
+
+	m_cullStats.tested = (m_bUseCulling == true) ? (unsigned int)drawCount : 0;
+	m_cullStats.visible = (unsigned int)visibleCount;
+	m_cullStats.culled = (unsigned int)(drawCount - visibleCount);
+}
+
+/***********************************************************
+ *  SelectDrawLods()
+ *
+ *  This method is used for picking the level of detail of
+ *  every visible draw from the projected diameter of its
+ *  bounding sphere.  A draw only moves to another level
+ *  once its diameter crosses the threshold by the
+ *  hysteresis margin, so that it does not switch back and
+ *  forth at a threshold.  A draw that just came into view
+ *  gets the level that its diameter asks for.  The
+ *  triangles drawn, and those saved against drawing every
+ *  draw at LOD 0, are counted for the profiler.
+ ***********************************************************/
+void SceneManager::SelectDrawLods()
+{
+	LOD_STATS stats;
+	memset(&stats, 0, sizeof(stats));
+
+	for (size_t i = 0; i < m_drawList.Size(); i++)
+	{
+		if (m_drawVisible[i] == 0)
+		{
+			continue;
+		}
+
+		int meshID = m_drawList.meshIDs[i];
+		unsigned int meshParts = m_drawList.meshParts[i];
+		int lodCount = m_basicMeshes->GetMeshLodCount(meshID);
+
+		int lod = 0;
+		if ((m_bUseLod == true) && (lodCount > 1))
+		{
+			float pixels = GetProjectedDiameter(i);
+			bool bWasVisible = (i < m_drawVisiblePrevious.size()) && (m_drawVisiblePrevious[i] != 0);
+			float margin = (bWasVisible == true) ? m_lodHysteresis : 0.0f;
+
+			lod = (bWasVisible == true) ? std::min(m_drawLods[i], lodCount - 1) : 0;
+			while ((lod > 0) && (pixels > m_lodPixelThresholds[lod - 1] * (1.0f + margin)))
+			{
+				lod--;
+			}
+			while ((lod < lodCount - 1) && (pixels < m_lodPixelThresholds[lod] * (1.0f - margin)))
+			{
+				lod++;
+			}
+		}
+
+		if (lod != m_drawLods[i])
+		{
+			// the batches pack their instances by level of detail
+			m_drawLods[i] = lod;
+			m_bInstanceDataDirty = true;
+			stats.lodChanges++;
+		}
+
+		GLuint triangles = m_basicMeshes->GetMeshTriangleCount(meshID, meshParts, lod);
+		GLuint fullTriangles = (lod == 0) ? triangles : m_basicMeshes->GetMeshTriangleCount(meshID, meshParts, 0);
+		stats.trianglesSubmitted += triangles;
+		stats.trianglesSaved += fullTriangles - triangles;
+		stats.lodDraws[lod]++;
+	}
+
+	m_lodStats = stats;
+
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->SetCounter(m_trianglesSubmittedCounter, m_lodStats.trianglesSubmitted);
+		m_pProfiler->SetCounter(m_trianglesSavedCounter, m_lodStats.trianglesSaved);
+	}
+}
+
+/***********************************************************
+ *  GetProjectedDiameter()
+ *
+ *  This method is used for getting how many pixels high the
+ *  bounding sphere of a draw is on the screen.  A camera
+ *  inside the sphere of a draw sees it at full size.
+ ***********************************************************/
+float SceneManager::GetProjectedDiameter(size_t drawIndex) const
+{
+	const glm::vec4& sphere = m_drawSpheres[drawIndex];
+	glm::vec4 viewCenter = m_viewMatrix * glm::vec4(glm::vec3(sphere), 1.0f);
+
+	// w of the clip space center - the view depth for a perspective
+	// projection and 1 for an orthographic one
+	float clipW = glm::dot(glm::vec4(m_projectionMatrix[0][3], m_projectionMatrix[1][3],
+		m_projectionMatrix[2][3], m_projectionMatrix[3][3]), viewCenter);
+	bool bPerspective = (m_projectionMatrix[2][3] != 0.0f);
+	if ((clipW <= 0.0f) || ((bPerspective == true) && (-viewCenter.z <= sphere.w)))
+	{
+		return(FLT_MAX);
+	}
+
+	return(sphere.w * m_projectionMatrix[1][1] * m_viewportHeight / clipW);
+}
+
+/***********************************************************
+ *  GetViewDepth()
+ *
+ *  This method is used for getting how far in front of the
+ *  camera the origin of an object is.
+ ***********************************************************/
+float SceneManager::GetViewDepth(const glm::mat4& modelMatrix) const
+{
+	glm::vec4 viewPosition = m_viewMatrix * modelMatrix[3];
+	return(-viewPosition.z);
+}
+
+/***********************************************************
+ *  BuildRenderQueue()
+ *
+ *  This method is used for giving every instanced batch and
+ *  every single draw of this frame a 64-bit sort key made of
+ *  render pass, shader program, texture arrays, material, mesh and
+ *  view depth, and radix sorting them.  The state changes of
+ *  the sorted and the unsorted order are counted.
+ ***********************************************************/
+void SceneManager::BuildRenderQueue()
+{
+	m_sortKeys.clear();
+	m_sortItems.clear();
+
+	if (m_bUseInstancing == true)
+	{
+		// a batch is sorted by its visible instance closest to the
+		// camera, and left out when all of its draws were culled
+		for (size_t i = 0; i < m_instanceBatches.size(); i++)
+		{
+			const INSTANCE_BATCH& batch = m_instanceBatches[i];
+			if (batch.instanceCount == 0)
+			{
+				continue;
+			}
+
+			float depth = SORT_MAX_DEPTH;
+			for (int instance = 0; instance < batch.drawCount; instance++)
+			{
+				int draw = m_batchedDraws[batch.firstInstance + instance];
+				if (m_drawVisible[draw] != 0)
+				{
+					depth = std::min(depth, GetViewDepth(m_drawList.modelMatrices[draw]));
+				}
+			}
+
+			uint64_t state = MakeStateWord(false, batch.meshID, batch.meshParts,
+				batch.materialIndex, batch.textureArray, batch.overlayTextureArray);
+			m_sortKeys.push_back(MakeSortKey(state, QuantizeDepth(depth)));
+			m_sortItems.push_back(RENDER_ITEM_BATCH | (uint32_t)i);
+		}
+	}
+
+	const size_t singleDrawCount = (m_bUseInstancing == true) ? m_unbatchedDraws.size() : m_drawList.Size();
+	for (size_t i = 0; i < singleDrawCount; i++)
+	{
+		int draw = (m_bUseInstancing == true) ? m_unbatchedDraws[i] : (int)i;
+		if (m_drawVisible[draw] == 0)
+		{
+			continue;
+		}
+
+		uint64_t state = MakeStateWord(
+			(m_drawList.colors[draw].a < 1.0f),
+			m_drawList.meshIDs[draw],
+			m_drawList.meshParts[draw],
+			m_drawList.materialIndices[draw],
+			m_drawList.textureArrays[draw],
+			m_drawList.overlayTextureArrays[draw]);
+		m_sortKeys.push_back(MakeSortKey(state, QuantizeDepth(GetViewDepth(m_drawList.modelMatrices[draw]))));
+		m_sortItems.push_back((uint32_t)draw);
+	}
+
+	unsigned int unsortedStateChanges = CountStateChanges(m_sortKeys);
+
+	RadixSort(m_sortKeys, m_sortItems, m_sortKeysScratch, m_sortItemsScratch);
+
+	m_sortStats.renderItems = (unsigned int)m_sortKeys.size();
+	m_sortStats.stateChanges = CountStateChanges(m_sortKeys);
+	m_sortStats.stateChangesSaved = (unsortedStateChanges > m_sortStats.stateChanges) ?
+		(unsortedStateChanges - m_sortStats.stateChanges) : 0;
+}
+
+/***********************************************************
+ *  SubmitRenderQueue()
+ *
+ *  This method is used for drawing the sorted render queue.
+ *  The opaque pass is drawn front-to-back with blending off,
+ *  then the transparent pass back-to-front with blending on
+ *  and without writing depth.
+ ***********************************************************/
+void SceneManager::SubmitRenderQueue()
+{
+	bool bTransparentPass = false;
+	GLStateCache::Disable(GL_BLEND);
+
+	for (size_t i = 0; i < m_sortKeys.size(); i++)
+	{
+		if ((bTransparentPass == false) && IsTransparentKey(m_sortKeys[i]))
+		{
+			bTransparentPass = true;
+			GLStateCache::Enable(GL_BLEND);
+			GLStateCache::DepthMask(GL_FALSE);
+		}
+
+		uint32_t item = m_sortItems[i];
+		if ((item & RENDER_ITEM_BATCH) != 0)
+		{
+			RenderInstanceBatch(item & ~RENDER_ITEM_BATCH);
+		}
+		else if (m_bUseInstancing == true)
+		{
+			RenderDrawInstance(item);
+		}
+		else
+		{
+			RenderDraw(item);
+		}
+	}
+
+	if (bTransparentPass == true)
+	{
+		GLStateCache::DepthMask(GL_TRUE);
+		GLStateCache::Disable(GL_BLEND);
+	}
+}
+
+/***********************************************************
+ *  SubmitMultiDrawQueue()
+ *
+ *  This method is used for drawing the sorted render queue
+ *  from the shared mesh buffers.  Every queue item becomes
+ *  one indirect command per drawn part, reading its model
+ *  matrix and color from the instance buffer through the
+ *  base instance and its material through gl_DrawID.  The
+ *  commands are issued with one multi-draw call for each
+ *  run of items with the same texture arrays and render
+ *  pass - the texture layers come from the instance buffer.
+ ***********************************************************/
+void SceneManager::SubmitMultiDrawQueue()
+{
+	m_indirectCommands.clear();
+	m_drawMaterials.clear();
+	m_multiDrawCalls.clear();
+
+	for (size_t i = 0; i < m_sortKeys.size(); i++)
+	{
+		uint32_t item = m_sortItems[i];
+		int meshID, materialIndex, textureArray, overlayTextureArray;
+		unsigned int meshParts;
+		GLuint baseInstance;
+		// instances of the item at every level of detail, which
+		// follow each other from the base instance
+		int lodInstanceCounts[ShapeMeshes::MAX_MESH_LODS] = { 0 };
+
+		if ((item & RENDER_ITEM_BATCH) != 0)
+		{
+			const INSTANCE_BATCH& batch = m_instanceBatches[item & ~RENDER_ITEM_BATCH];
+			meshID = batch.meshID;
+			meshParts = batch.meshParts;
+			materialIndex = batch.materialIndex;
+			textureArray = batch.textureArray;
+			overlayTextureArray = batch.overlayTextureArray;
+			baseInstance = m_instanceBase + (GLuint)batch.firstInstance;
+			memcpy(lodInstanceCounts, batch.lodInstanceCounts, sizeof(lodInstanceCounts));
+		}
+		else
+		{
+			meshID = m_drawList.meshIDs[item];
+			meshParts = m_drawList.meshParts[item];
+			materialIndex = m_drawList.materialIndices[item];
+			textureArray = m_drawList.textureArrays[item];
+			overlayTextureArray = m_drawList.overlayTextureArrays[item];
+			baseInstance = m_instanceBase + (GLuint)m_drawInstanceSlots[item];
+			lodInstanceCounts[m_drawLods[item]] = 1;
+		}
+
+		bool bTransparent = IsTransparentKey(m_sortKeys[i]);
+		if (m_multiDrawCalls.empty() ||
+			(m_multiDrawCalls.back().textureArray != textureArray) ||
+			(m_multiDrawCalls.back().overlayTextureArray != overlayTextureArray) ||
+			(m_multiDrawCalls.back().bTransparent != bTransparent))
+		{
+			MULTI_DRAW_CALL call;
+			call.firstCommand = (int)m_indirectCommands.size();
+			call.commandCount = 0;
+			call.textureArray = textureArray;
+			call.overlayTextureArray = overlayTextureArray;
+			call.bTransparent = bTransparent;
+			m_multiDrawCalls.push_back(call);
+		}
+
+		for (int lod = 0; lod < ShapeMeshes::MAX_MESH_LODS; lod++)
+		{
+			if (lodInstanceCounts[lod] == 0)
+			{
+				continue;
+			}
+
+			ShapeMeshes::DRAW_ELEMENTS_INDIRECT_COMMAND commands[ShapeMeshes::MAX_MESH_COMMANDS];
+			int commandCount = m_basicMeshes->GetMeshDrawCommands(
+				meshID, meshParts, (GLuint)lodInstanceCounts[lod], baseInstance, commands, lod);
+
+			for (int command = 0; command < commandCount; command++)
+			{
+				m_indirectCommands.push_back(commands[command]);
+				// objects without a material use the first one
+				m_drawMaterials.push_back(std::max(materialIndex, 0));
+			}
+			m_multiDrawCalls.back().commandCount += commandCount;
+			baseInstance += (GLuint)lodInstanceCounts[lod];
+		}
+	}
+
+	if (m_indirectCommands.empty())
+	{
+		return;
+	}
+
+	const size_t commandBytes = m_indirectCommands.size() * sizeof(ShapeMeshes::DRAW_ELEMENTS_INDIRECT_COMMAND);
+	const size_t materialBytes = m_drawMaterials.size() * sizeof(GLint);
+	GLintptr commandsOffset = 0;
+
+	if ((NULL != m_pDynamicRegion) && (m_indirectCommands.size() <= m_ringCommandCapacity))
+	{
+		// the commands follow the instance data in the region of this
+		// frame, and the materials follow the commands at an offset
+		// that the storage buffer range can be bound at
+		const GLintptr regionOffset = m_dynamicRing.GetRegionOffset();
+		commandsOffset = regionOffset + m_ringCommandsOffset;
+		GLintptr materialsOffset = commandsOffset + (GLintptr)commandBytes;
+		materialsOffset = (materialsOffset + m_ringMaterialsAlignment - 1) /
+			m_ringMaterialsAlignment * m_ringMaterialsAlignment;
+
+		memcpy(m_pDynamicRegion + m_ringCommandsOffset, &m_indirectCommands[0], commandBytes);
+		memcpy(m_pDynamicRegion + (materialsOffset - regionOffset), &m_drawMaterials[0], materialBytes);
+
+		GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_dynamicRing.GetBuffer());
+		GLStateCache::BindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING,
+			m_dynamicRing.GetBuffer(), materialsOffset, (GLsizeiptr)materialBytes);
+	}
+	else
+	{
+		GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, &m_indirectCommands[0], GL_STREAM_DRAW);
+
+		GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materialBytes, &m_drawMaterials[0], GL_STREAM_DRAW);
+		GLStateCache::BindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, m_drawDataBuffer);
+	}
+
+	bool bTransparentPass = false;
+	GLStateCache::Disable(GL_BLEND);
+
+	for (size_t i = 0; i < m_multiDrawCalls.size(); i++)
+	{
+		const MULTI_DRAW_CALL& call = m_multiDrawCalls[i];
+
+		if ((bTransparentPass == false) && (call.bTransparent == true))
+		{
+			bTransparentPass = true;
+			GLStateCache::Enable(GL_BLEND);
+			GLStateCache::DepthMask(GL_FALSE);
+		}
+
+		m_pShaderManager->UseVariant(
+			GetShaderFeatures((call.textureArray >= 0), (call.overlayTextureArray >= 0)) |
+			ShaderManager::FEATURE_INSTANCING | ShaderManager::FEATURE_MULTI_DRAW);
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
+		if (call.textureArray >= 0)
+		{
+			m_pShaderManager->SetUniform(m_textureUniform, call.textureArray);
+		}
+		if (call.overlayTextureArray >= 0)
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			m_pShaderManager->SetUniform(m_textureOverlayUniform, call.overlayTextureArray);
 		}
+
+		m_pShaderManager->SetUniform(m_drawDataBaseUniform, call.firstCommand);
+
+		m_basicMeshes->DrawSharedMeshesIndirect(
+			commandsOffset + call.firstCommand * sizeof(ShapeMeshes::DRAW_ELEMENTS_INDIRECT_COMMAND),
+			call.commandCount);
+	}
+
+	if (bTransparentPass == true)
+	{
+		GLStateCache::DepthMask(GL_TRUE);
+		GLStateCache::Disable(GL_BLEND);
 	}
+
+	GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
 
-/**************************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
-/*** preparing and rendering their own 3D replicated scenes.***/
-/*** Please refer to the code in the OpenGL sample project  ***/
-/*** for assistance.                                        ***/
-/**************************************************************/
+/***********************************************************
+ *  RenderDraw()
+ *
+ *  This method is used for drawing a single entry of the
+ *  compiled draw list, without instancing.
+ ***********************************************************/
+void SceneManager::RenderDraw(size_t drawIndex)
+{
+	int textureArray = m_drawList.textureArrays[drawIndex];
+	int overlayTextureArray = m_drawList.overlayTextureArrays[drawIndex];
+	int materialIndex = m_drawList.materialIndices[drawIndex];
 
- /***********************************************************
-  *  DefineObjectMaterials()
-  *
-  *  This method is used for configuring the various material
-  *  settings for all of the objects within the 3D scene.
-  ***********************************************************/
-void SceneManager::DefineObjectMaterials()
+	m_pShaderManager->UseVariant(GetShaderFeatures((textureArray >= 0), (overlayTextureArray >= 0)));
+	m_pShaderManager->SetUniform(m_modelUniform, m_drawList.modelMatrices[drawIndex]);
+	m_pShaderManager->SetUniform(m_normalMatrixUniform, m_drawList.normalMatrices[drawIndex]);
+
+	// the texture is used if one was resolved, otherwise the color
+	if (textureArray >= 0)
+	{
+		m_pShaderManager->SetUniform(m_textureUniform, textureArray);
+		m_pShaderManager->SetUniform(m_textureLayerUniform, m_drawList.textureLayers[drawIndex].x);
+	}
+	else
+	{
+		m_pShaderManager->SetUniform(m_colorUniform, m_drawList.colors[drawIndex]);
+	}
+
+	if (overlayTextureArray >= 0)
+	{
+		m_pShaderManager->SetUniform(m_textureOverlayUniform, overlayTextureArray);
+		m_pShaderManager->SetUniform(m_textureOverlayLayerUniform, m_drawList.textureLayers[drawIndex].y);
+	}
+
+	if (materialIndex >= 0)
+	{
+		SetShaderMaterial(materialIndex);
+	}
+
+	m_basicMeshes->DrawMesh(m_drawList.meshIDs[drawIndex], m_drawList.meshParts[drawIndex], m_drawLods[drawIndex]);
+}
+
+/***********************************************************
+ *  RenderDrawInstance()
+ *
+ *  This method is used for drawing a single entry of the
+ *  compiled draw list with an instanced call of one
+ *  instance.  The model matrix, color and texture layers
+ *  are read from its slot of the instance buffer, so only
+ *  the textures and the material are set per draw.
+ ***********************************************************/
+void SceneManager::RenderDrawInstance(size_t drawIndex)
 {
-	/**
-	 ** Material Properties
-	 **
-	 ** **ambientColor** is a vec3 color value that can be used to set the ambient emission color.
-	 ** **ambientStrength** is a float value that defines how much ambient light is emited.
-	 ** **diffuseColor** is a vec3 color value that defines the diffuse light emission color.
-	 ** **specularColor** is a vec3 color value that defines the specular light reflection color.
-	 ** **shininess** is a float value that tells how shiny the material is and how much specular light will be
-	 **   reflected off the surface.
-	 ** **tag** is a special string that is used to identify the material in the collection.
-	 **/
+	int textureArray = m_drawList.textureArrays[drawIndex];
+	int overlayTextureArray = m_drawList.overlayTextureArrays[drawIndex];
+	int materialIndex = m_drawList.materialIndices[drawIndex];
 
-	// default material is an adaptation of "white rubber" from
-	//  http://www.it.hiof.no/~borres/j3d/explain/light/p-materials.html
+	m_pShaderManager->UseVariant(
+		GetShaderFeatures((textureArray >= 0), (overlayTextureArray >= 0)) |
+		ShaderManager::FEATURE_INSTANCING);
+
+	if (textureArray >= 0)
+	{
+		m_pShaderManager->SetUniform(m_textureUniform, textureArray);
+	}
+	if (overlayTextureArray >= 0)
+	{
+		m_pShaderManager->SetUniform(m_textureOverlayUniform, overlayTextureArray);
+	}
 
-	OBJECT_MATERIAL defaultMaterial;
-	defaultMaterial.ambientColor = glm::vec3(0.5f, 0.5f, 0.5f);
-	defaultMaterial.ambientStrength = 0.1f;
-	defaultMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	defaultMaterial.specularColor = glm::vec3(0.7f, 0.7f, 0.7f);
-	defaultMaterial.shininess = 10.0;
-	defaultMaterial.tag = "default";
-
-	m_objectMaterials.push_back(defaultMaterial);
-	
-	OBJECT_MATERIAL goldMaterial;
-	goldMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.1f);
-	goldMaterial.ambientStrength = 0.1f;
-	goldMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	goldMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	goldMaterial.shininess = 22.0;
-	goldMaterial.tag = "metal";
-
-	m_objectMaterials.push_back(goldMaterial);
-
-	OBJECT_MATERIAL cementMaterial;
-	cementMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	cementMaterial.ambientStrength = 0.1f;
-	cementMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	cementMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	cementMaterial.shininess = 0.5;
-	cementMaterial.tag = "cement";
-
-	m_objectMaterials.push_back(cementMaterial);
-
-	OBJECT_MATERIAL woodMaterial;
-	woodMaterial.ambientColor = glm::vec3(0.4f, 0.3f, 0.1f);
-	woodMaterial.ambientStrength = 0.1;
-	woodMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	woodMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	woodMaterial.shininess = 0.3;
-	woodMaterial.tag = "wood";
-
-	m_objectMaterials.push_back(woodMaterial);
-
-	OBJECT_MATERIAL tileMaterial;
-	tileMaterial.ambientColor = glm::vec3(0.2f, 0.3f, 0.4f);
-	tileMaterial.ambientStrength = 0.1f;
-	tileMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	tileMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	tileMaterial.shininess = 25.0;
-	tileMaterial.tag = "tile";
-
-	m_objectMaterials.push_back(tileMaterial);
-
-	OBJECT_MATERIAL glassMaterial;
-	glassMaterial.ambientColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	glassMaterial.ambientStrength = 0.1f;
-	glassMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	glassMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	glassMaterial.shininess = 85.0;
-	glassMaterial.tag = "glass";
-
-	m_objectMaterials.push_back(glassMaterial);
-
-	OBJECT_MATERIAL clayMaterial;
-	clayMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.3f);
-	clayMaterial.ambientStrength = 0.1f;
-	clayMaterial.diffuseColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	clayMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	clayMaterial.shininess = 0.5;
-	clayMaterial.tag = "clay";
-
-	m_objectMaterials.push_back(clayMaterial);
-
-	OBJECT_MATERIAL tutorialMaterial;
-	tutorialMaterial.ambientColor = glm::vec3(0.74f, 0.38f, 0.45f);
-	tutorialMaterial.ambientStrength = 0.5f;
-	tutorialMaterial.diffuseColor = glm::vec3(0.74f, 0.38f, 0.45f);
-	tutorialMaterial.specularColor = glm::vec3(0.5f, 0.5f, 0.5f);
-	tutorialMaterial.shininess = 32.0f;
-	tutorialMaterial.tag = "light";
-
-	m_objectMaterials.push_back(tutorialMaterial);
+	if (materialIndex >= 0)
+	{
+		SetShaderMaterial(materialIndex);
+	}
 
+	m_basicMeshes->DrawMeshInstanced(
+		m_drawList.meshIDs[drawIndex],
+		m_drawList.meshParts[drawIndex],
+		1,
+		m_instanceBase + (GLuint)m_drawInstanceSlots[drawIndex],
+		m_drawLods[drawIndex]);
 }
 
 /***********************************************************
- *  SetupSceneLights()
+ *  RenderInstanceBatch()
  *
- *  This method is called to add and configure the light
- *  sources for the 3D scene.  There are up to 4 light sources.
+ *  This method is used for drawing one instanced batch with
+ *  an instanced draw call for every level of detail that
+ *  its visible draws use.  The model matrices and colors
+ *  are read from the instance buffer.
  ***********************************************************/
-void SceneManager::SetupSceneLights()
+void SceneManager::RenderInstanceBatch(size_t batchIndex)
 {
-	// this line of code is NEEDED for telling the shaders to render 
-	// the 3D scene with custom lighting, if no light sources have
-	// been added then the display window will be black - to use the 
-	// default OpenGL lighting then comment out the following line
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	const INSTANCE_BATCH& batch = m_instanceBatches[batchIndex];
 
-	/**
-	 ** Light Properties
-	 **
-	 ** **position** is a vec3 value that sets the position of the light source in 3D space.
-	 ** **ambientColor** is a vec3 value that defines the color of the ambient light being emited.
-	 ** **diffuseColor** is a vec3 value that defines the color of the diffuse light being emited.
-	 ** **specularColor** is a vec3 value that defines the color of the specular light being emited.
-	 ** **focalStrength** is a float value that defines the focus of the light beam being emited.
-	 ** **specularIntensity** is a float value that defines the intensity of the emited specular lighting.
-	 **/
+	m_pShaderManager->UseVariant(
+		GetShaderFeatures((batch.textureArray >= 0), (batch.overlayTextureArray >= 0)) |
+		ShaderManager::FEATURE_INSTANCING);
+
+	if (batch.textureArray >= 0)
+	{
+		m_pShaderManager->SetUniform(m_textureUniform, batch.textureArray);
+	}
+	if (batch.overlayTextureArray >= 0)
+	{
+		m_pShaderManager->SetUniform(m_textureOverlayUniform, batch.overlayTextureArray);
+	}
 
-	m_pShaderManager->setVec3Value("lightSources[0].position", 3.0f, 14.0f, 3.0f);
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 32.0f);
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.05f);
-
-	
-	m_pShaderManager->setVec3Value("lightSources[1].position", -5.0f, 3.0f, 8.0f);
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.68f, 0.23f, 0.0f);
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", 1.0f, 1.0f, 1.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 32.0f);
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.05f);
-	
-
-}
-
-void SceneManager::LoadSceneTextures()
-{
-	/*** STUDENTS - add the code BELOW for loading the textures that ***/
-	/*** will be used for mapping to objects in the 3D scene. Up to  ***/
-	/*** 16 textures can be loaded per scene. Refer to the code in   ***/
-	/*** the OpenGL Sample for help.                                 ***/
-
-	bool bReturn = false;
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/book-cover-red-leather.png",
-		"open-book-cover");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/open-book-left-page.png",
-		"open-book-left-page");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/open-book-right-page.png",
-		"open-book-right-page");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/open-book-page-crinkle-effect.png",
-		"open-book-page-crinkle-effect");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/wood_paneling.png",
-		"wood-paneling");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-camera/hay-bales.png",
-		"hay-bales");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/book-cover-image-1.png",
-		"book-cover-image-1");
-	assert(bReturn);
-
-	bReturn = CreateGLTexture(
-		"../../Utilities/textures/from-my-ai/book-cover-image-2.png",
-		"book-cover-image-2");
-	assert(bReturn);
+	if (batch.materialIndex >= 0)
+	{
+		SetShaderMaterial(batch.materialIndex);
+	}
 
-	// after the texture image data is loaded into memory, the
-	// loaded textures need to be bound to texture slots - there
-	// are a total of 16 available slots for scene textures
-	BindGLTextures();
+	GLuint firstInstance = m_instanceBase + (GLuint)batch.firstInstance;
+	for (int lod = 0; lod < ShapeMeshes::MAX_MESH_LODS; lod++)
+	{
+		if (batch.lodInstanceCounts[lod] == 0)
+		{
+			continue;
+		}
+
+		m_basicMeshes->DrawMeshInstanced(
+			batch.meshID,
+			batch.meshParts,
+			batch.lodInstanceCounts[lod],
+			firstInstance,
+			lod);
+		firstInstance += (GLuint)batch.lodInstanceCounts[lod];
+	}
 }
 
 /***********************************************************
- *  PrepareScene()
+ *  BuildInstanceBatches()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  This method is used for grouping the opaque draws of the
+ *  draw list that share mesh, material and texture arrays
+ *  into instanced batches.  Draws with different layers of
+ *  the same texture arrays end up in the same batch.  Transparent draws are never batched,
+ *  since they have to be drawn back-to-front.
  ***********************************************************/
-void SceneManager::PrepareScene()
-{ 
-	// load the textures for the 3D scene
-	LoadSceneTextures();
+void SceneManager::BuildInstanceBatches()
+{
+	m_instanceBatches.clear();
+	m_batchedDraws.clear();
+	m_unbatchedDraws.clear();
 
-	// load the materials for scene objects
-	DefineObjectMaterials();
+	for (size_t i = 0; i < m_drawList.Size(); i++)
+	{
+		if (m_drawList.colors[i].a < 1.0f)
+		{
+			m_unbatchedDraws.push_back((int)i);
+		}
+		else
+		{
+			m_batchedDraws.push_back((int)i);
+		}
+	}
 
-	// load the light sources for the scene
-	SetupSceneLights();
+	// order the draws by batch key so each batch is one range
+	const DRAW_LIST& drawList = m_drawList;
+	std::stable_sort(m_batchedDraws.begin(), m_batchedDraws.end(),
+		[&drawList](int a, int b)
+		{
+			if (drawList.meshIDs[a] != drawList.meshIDs[b])
+				return drawList.meshIDs[a] < drawList.meshIDs[b];
+			if (drawList.meshParts[a] != drawList.meshParts[b])
+				return drawList.meshParts[a] < drawList.meshParts[b];
+			if (drawList.materialIndices[a] != drawList.materialIndices[b])
+				return drawList.materialIndices[a] < drawList.materialIndices[b];
+			if (drawList.textureArrays[a] != drawList.textureArrays[b])
+				return drawList.textureArrays[a] < drawList.textureArrays[b];
+			return drawList.overlayTextureArrays[a] < drawList.overlayTextureArrays[b];
+		});
+
+	for (size_t i = 0; i < m_batchedDraws.size(); i++)
+	{
+		int draw = m_batchedDraws[i];
+
+		bool bNewBatch = m_instanceBatches.empty();
+		if (bNewBatch == false)
+		{
+			const INSTANCE_BATCH& last = m_instanceBatches.back();
+			bNewBatch = (last.meshID != m_drawList.meshIDs[draw]) ||
+				(last.meshParts != m_drawList.meshParts[draw]) ||
+				(last.materialIndex != m_drawList.materialIndices[draw]) ||
+				(last.textureArray != m_drawList.textureArrays[draw]) ||
+				(last.overlayTextureArray != m_drawList.overlayTextureArrays[draw]);
+		}
 
-	// only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
+		if (bNewBatch == true)
+		{
+			INSTANCE_BATCH batch;
+			batch.meshID = m_drawList.meshIDs[draw];
+			batch.meshParts = m_drawList.meshParts[draw];
+			batch.materialIndex = m_drawList.materialIndices[draw];
+			batch.textureArray = m_drawList.textureArrays[draw];
+			batch.overlayTextureArray = m_drawList.overlayTextureArrays[draw];
+			batch.firstInstance = (int)i;
+			batch.instanceCount = 0;
+			batch.drawCount = 0;
+			memset(batch.lodInstanceCounts, 0, sizeof(batch.lodInstanceCounts));
+			m_instanceBatches.push_back(batch);
+		}
+
+		m_instanceBatches.back().instanceCount++;
+		m_instanceBatches.back().drawCount++;
+		m_instanceBatches.back().lodInstanceCounts[0]++;
+	}
+
+	// the unbatched draws follow the batches in the instance buffer,
+	// so that the multi-draw calls can draw them as single instances
+	m_drawInstanceSlots.assign(m_drawList.Size(), -1);
+	for (size_t i = 0; i < m_batchedDraws.size(); i++)
+	{
+		m_drawInstanceSlots[m_batchedDraws[i]] = (int)i;
+	}
+	for (size_t i = 0; i < m_unbatchedDraws.size(); i++)
+	{
+		m_drawInstanceSlots[m_unbatchedDraws[i]] = (int)(m_batchedDraws.size() + i);
+	}
 
-	m_basicMeshes->LoadTilingPlaneMesh(10.0, 5.0);    // floor
-	m_basicMeshes->LoadPlaneMesh();     // pages
-	m_basicMeshes->LoadBoxMesh();       // books
-	m_basicMeshes->LoadCylinderMesh();  // tambourine and rattles
-	m_basicMeshes->LoadTaperedCylinderMesh(); // upturned bowl
+	m_instanceData.resize(m_batchedDraws.size() + m_unbatchedDraws.size());
+	m_bInstanceDataDirty = true;
+	ReserveDynamicRing();
 
+	std::cout << "Grouped " << m_batchedDraws.size() << " opaque draws into "
+		<< m_instanceBatches.size() << " instanced batches" << std::endl;
 }
 
 /***********************************************************
- *  RenderScene()
+ *  UploadInstanceData()
  *
- *  This method is used for rendering the 3D scene by 
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for copying the model matrices,
+ *  colors and texture layers of the visible batched draws, in batch order,
+ *  followed by those of the unbatched draws into the
+ *  instance buffer.  Within a batch the visible draws are
+ *  grouped by their level of detail.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::UploadInstanceData()
 {
-	RenderBackdrop();
-	RenderOpenBook();
-	RenderClosedBook();
-	RenderTambourine();
-	RenderUpturnedBowl();
-	RenderAquarium();
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
+	{
+		INSTANCE_BATCH& batch = m_instanceBatches[i];
+
+		// the visible draws of a batch are packed at the start of
+		// its range, so the batch is drawn with one instanced call
+		// for every level of detail
+		const int lodCount = m_basicMeshes->GetMeshLodCount(batch.meshID);
+		int slot = batch.firstInstance;
+		for (int lod = 0; lod < ShapeMeshes::MAX_MESH_LODS; lod++)
+		{
+			int lodFirstSlot = slot;
+			for (int instance = 0; (lod < lodCount) && (instance < batch.drawCount); instance++)
+			{
+				int draw = m_batchedDraws[batch.firstInstance + instance];
+				if ((m_drawVisible[draw] == 0) || (m_drawLods[draw] != lod))
+				{
+					continue;
+				}
+
+				m_instanceData[slot].model = m_drawList.modelMatrices[draw];
+				m_instanceData[slot].normal = m_drawList.normalMatrices[draw];
+				m_instanceData[slot].color = m_drawList.colors[draw];
+				m_instanceData[slot].textureLayers = m_drawList.textureLayers[draw];
+				slot++;
+			}
+			batch.lodInstanceCounts[lod] = slot - lodFirstSlot;
+		}
+		batch.instanceCount = slot - batch.firstInstance;
+	}
+	for (size_t i = 0; i < m_unbatchedDraws.size(); i++)
+	{
+		size_t slot = m_batchedDraws.size() + i;
+		m_instanceData[slot].model = m_drawList.modelMatrices[m_unbatchedDraws[i]];
+		m_instanceData[slot].normal = m_drawList.normalMatrices[m_unbatchedDraws[i]];
+		m_instanceData[slot].color = m_drawList.colors[m_unbatchedDraws[i]];
+		m_instanceData[slot].textureLayers = m_drawList.textureLayers[m_unbatchedDraws[i]];
+	}
+
+	// with the ring, BeginDynamicRegion() copies the new data into
+	// every region before it is drawn from
+	m_instanceDataVersion++;
+	if (m_dynamicRing.IsCreated() == false)
+	{
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, m_instanceData.size() * sizeof(ShapeMeshes::INSTANCE_DATA),
+			m_instanceData.empty() ? NULL : &m_instanceData[0], GL_DYNAMIC_DRAW);
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	m_bInstanceDataDirty = false;
 }
 
-void SceneManager::RenderBackdrop()
-{	
-	/****** The Floor *******/
-	TransformAndRender(
-		"floor",
-		std::bind(&ShapeMeshes::DrawTilingPlaneMesh, m_basicMeshes),
-		//  x           y           z
-		20.0f,         1.0f,      10.0f,       // scale
-		0.65f,         0.46f,      0.65f,      // rotation
-		0.0f,          0.0f,       0.0f,       // position
-		//  r           g           b
-		0.68,          0.41,       0.17,       // color   ("wood-floor brown")
-		"wood-paneling",                       // texture
-		"",                                    // texture overlay
-		"wood"                                 // material
-	);
+/***********************************************************
+ *  ReserveDynamicRing()
+ *
+ *  This method is used for sizing the regions of the ring
+ *  buffer for the draw list.  A region holds the instance
+ *  data, then room for the most indirect commands and draw
+ *  materials a frame can issue.  Its size is a multiple of
+ *  the instance size, so that every region starts at a
+ *  whole instance.  The ring is only created again when it
+ *  has to grow.
+ ***********************************************************/
+void SceneManager::ReserveDynamicRing()
+{
+	if (m_bUseDynamicRing == false)
+	{
+		return;
+	}
+
+	// a batch issues the commands of every part at every level of
+	// detail, a single draw those of every part at one level
+	size_t commandCapacity = 0;
+	if (m_bMultiDrawSupported == true)
+	{
+		commandCapacity =
+			m_instanceBatches.size() * ShapeMeshes::MAX_MESH_LODS * ShapeMeshes::MAX_MESH_COMMANDS +
+			m_unbatchedDraws.size() * ShapeMeshes::MAX_MESH_COMMANDS;
+		if (m_ringMaterialsAlignment == 0)
+		{
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_ringMaterialsAlignment);
+		}
+	}
+	m_ringMaterialsAlignment = std::max(m_ringMaterialsAlignment, (GLint)sizeof(GLint));
+
+	const size_t instanceBytes = m_instanceData.size() * sizeof(ShapeMeshes::INSTANCE_DATA);
+	size_t regionBytes = instanceBytes +
+		commandCapacity * sizeof(ShapeMeshes::DRAW_ELEMENTS_INDIRECT_COMMAND) +
+		(m_ringMaterialsAlignment - 1) +
+		commandCapacity * sizeof(GLint);
+	regionBytes = std::max(regionBytes, sizeof(ShapeMeshes::INSTANCE_DATA));
+	regionBytes = (regionBytes + sizeof(ShapeMeshes::INSTANCE_DATA) - 1) /
+		sizeof(ShapeMeshes::INSTANCE_DATA) * sizeof(ShapeMeshes::INSTANCE_DATA);
+
+	m_ringCommandsOffset = (GLintptr)instanceBytes;
+	m_ringCommandCapacity = commandCapacity;
+
+	if ((m_dynamicRing.IsCreated() == true) &&
+		((size_t)m_dynamicRing.GetRegionBytes() >= regionBytes))
+	{
+		return;
+	}
+
+	if (m_dynamicRing.Create((GLsizeiptr)regionBytes) == false)
+	{
+		std::cout << "Persistent buffer storage is not supported, uploading the per-frame data with glBufferData" << std::endl;
+		m_bUseDynamicRing = false;
+		return;
+	}
+	memset(m_regionInstanceVersions, 0, sizeof(m_regionInstanceVersions));
+
+	std::cout << "Created a persistently mapped ring of " << PersistentRingBuffer::REGION_COUNT
+		<< " x " << (regionBytes + 1023) / 1024 << " KB for the per-frame data" << std::endl;
 }
 
-void SceneManager::RenderOpenBook()
-{
-	    TransformAndRender(
-        "open-book-cover-left",
-        std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),
-        //  x           y           z
-           2.15f,      0.20f,      2.70f,      // scale
-          90.50f,      0.75f,    -43.00f,      // rotation
-          -0.50f,      1.36f,      6.00f,      // position
-        //  r           g           b
-           0.82f,      0.17f,      0.07f,       // color
-		  "open-book-cover",                     // texture
-		  "",                                   // texture overlay
-		  "glass"                               // material
-    );
-
-    TransformAndRender(
-        "open-book-cover-right",
-        std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),
-        //  x           y           z
-           2.00f,      0.20f,      2.70f,      // scale
-          90.00f,      0.00f,   -141.00f,      // rotation
-           0.95f,      1.36f,      5.96f,      // position
-        //  r           g           b
-           0.82f,      0.17f,      0.07f,       // color
-		"open-book-cover",                     // texture
-		"",                                   // texture overlay
-		"glass"                               // material
-    );
-
-
-	// TODO: add texture to pages
-    TransformAndRender(
-        "open-book-page-left",
-        std::bind(&ShapeMeshes::DrawPlaneMesh, m_basicMeshes),
-        //  x           y           z
-           0.91f,      1.34f,      1.22f,      // scale
-          90.50f,      0.75f,    -43.00f,      // rotation
-          -0.50f,      1.36f,      6.14f,      // position
-        //  r           g           b
-           1.00f,      1.00f,      1.00f,      // color
-		  "open-book-left-page",
-		  "open-book-page-crinkle-effect"
-    );
-
-
-    TransformAndRender(
-        "open-book-page-right",
-        std::bind(&ShapeMeshes::DrawPlaneMesh, m_basicMeshes),
-        //  x           y           z
-           0.91f,      1.34f,      1.22f,      // scale
-          90.00f,      0.00f,   -141.00f,      // rotation
-           0.85f,      1.36f,      6.01f,      // position
-        //  r           g           b
-           1.00f,      1.00f,      1.00f,      // color
-		  "open-book-right-page",
-		  "open-book-page-crinkle-effect"
-    );
+/***********************************************************
+ *  BeginDynamicRegion()
+ *
+ *  This method is used for moving to the region of the ring
+ *  that this frame writes into, which waits until the GPU
+ *  has finished the frame that wrote it before.  The
+ *  instance data is copied into the region when it has
+ *  changed since the region was last written.  Every
+ *  instanced draw of the frame adds the first instance of
+ *  the region to its base instance.
+ ***********************************************************/
+void SceneManager::BeginDynamicRegion()
+{
+	const unsigned int waits = m_dynamicRing.GetStats().waits;
+	m_pDynamicRegion = m_dynamicRing.BeginRegion();
+	if ((NULL != m_pProfiler) && (m_ringWaitsCounter >= 0))
+	{
+		m_pProfiler->SetCounter(m_ringWaitsCounter, m_dynamicRing.GetStats().waits - waits);
+	}
 
+	m_instanceBase = (GLuint)(m_dynamicRing.GetRegionOffset() / sizeof(ShapeMeshes::INSTANCE_DATA));
 
-	TransformAndRender(
-		"open-book-front-cover",
-		std::bind(&ShapeMeshes::DrawPlaneMesh, m_basicMeshes),
-		//  x           y           z
-           0.91f,      1.34f,      1.22f,      // scale
-          89.80f,      0.00f,    137.00f,      // rotation
-          -0.543f,     1.36f,      5.901f,     // position
-        //  r           g           b
-           1.00f,      1.00f,      1.00f,      // color
-		"book-cover-image-2",                  // texture
-		"",                                    // texture overlay
-		"glass"                                // material
-	);
+	const int region = m_dynamicRing.GetRegion();
+	if ((m_regionInstanceVersions[region] != m_instanceDataVersion) && (m_instanceData.empty() == false))
+	{
+		memcpy(m_pDynamicRegion, &m_instanceData[0], m_instanceData.size() * sizeof(ShapeMeshes::INSTANCE_DATA));
+		m_regionInstanceVersions[region] = m_instanceDataVersion;
+	}
 }
 
-void SceneManager::RenderClosedBook()
+/***********************************************************
+ *  RenderSceneImmediate()
+ *
+ *  This method is used for rendering the 3D scene without
+ *  the compiled draw list, by passing every scene object
+ *  through TransformAndRender() on every frame.
+ ***********************************************************/
+void SceneManager::RenderSceneImmediate()
 {
-	TransformAndRender(
-		"closed-book",
-		std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),
-		//  x           y           z
-		   2.00f,      0.20f,      2.60f,      // scale
-		   0.00f,     90.00f,      0.00f,      // rotation
-		   0.43f,      2.77f,      6.09f,      // position
-		//  r           g           b
-		0.82f,         0.17f,      0.07f,      // color
-		"open-book-cover",                     // texture   
-		"",                                    // texture overlay
-		"glass"                                // material
-	);
+	// upload the textures that were decoded since the last frame
+	if (m_textureLoader.GetPendingCount() > 0)
+	{
+		StreamTextureUploads();
+	}
+
+	// this path draws in definition order with blending always on
+	GLStateCache::Enable(GL_BLEND);
+
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
 
 		TransformAndRender(
-		"closed-book-illustration",
-		std::bind(&ShapeMeshes::DrawPlaneMesh, m_basicMeshes),
-        //  x           y           z
-           0.97f,      0.00f,      1.26f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           0.43f,      2.875f,     6.09f,      // position
-		//  r           g           b
-		0.82f,         0.17f,      0.07f,      // color
-		"book-cover-image-1",                  // texture   
-		"",                                    // texture overlay
-		"cement"                                // material
-	);
+			object.name,
+			std::bind(&ShapeMeshes::DrawMesh, m_basicMeshes, object.meshID, object.meshParts, 0),
+			object.scale,
+			object.rotation,
+			object.position,
+			object.color,
+			object.textureTag,
+			object.overlayTextureTag,
+			object.materialTag);
+	}
+
+	GLStateCache::Disable(GL_BLEND);
 }
 
-void SceneManager::RenderTambourine()
+/***********************************************************
+ *  CompileDrawList()
+ *
+ *  This method is used for compiling the scene objects into
+ *  the flat draw list.  The texture arrays and layers, material indices
+ *  and model matrices are resolved here once, so that no
+ *  string lookups are needed while rendering.
+ ***********************************************************/
+void SceneManager::CompileDrawList()
 {
-	TransformAndRender(
-		"tambourine",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-		//  x           y           z
-		0.65f,         0.46f,      0.65f,      // scale
-		0.00f,        90.00f,      0.00f,      // rotation
-		1.03f,         2.87f,      6.42f,      // position
-		//  r           g           b
-		0.73f,         0.59f,      0.44f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"wood"                                 // material
-	);
+	m_drawList.Clear();
+	m_drawList.Reserve(m_sceneObjects.size());
+#ifdef _DEBUG
+	m_drawTransformers.clear();
+	m_drawTransformers.reserve(m_sceneObjects.size());
+#endif
 
-	TransformAndRender(
-		"tambourine-rattle-1",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-		//  x           y           z
-		0.17f,         0.04f,      0.17f,      // scale
-		0.00f,        90.00f,      0.00f,      // rotation
-		0.60f,         3.05f,      6.91f,      // position
-		//  r           g           b
-		0.38f,         0.38f,      0.38f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"metal"                                // material
-	);
+	for (size_t i = 0; i < m_sceneObjects.size(); i++)
+	{
+		const SCENE_OBJECT& object = m_sceneObjects[i];
 
-	TransformAndRender(
-		"tambourine-rattle-2",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-//  x           y           z
-           0.17f,      0.04f,      0.17f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           1.31f,      3.05f,      7.00f,      // position
-        //  r           g           b
-           0.38f,      0.38f,      0.38f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"metal"                                // material
-	);
+#ifdef _DEBUG
+		// register this object with the LiveTransformer
+		// if object has already been registered, this does nothing
+		LiveTransformer* objXfmr = nullptr;
+		if (nullptr != this->xfmrs)
+		{
+			this->xfmrs->RegisterNewObject(
+				object.name,
+				object.scale.x,     object.scale.y,     object.scale.z,
+				object.rotation.x,  object.rotation.y,  object.rotation.z,
+				object.position.x,  object.position.y,  object.position.z,
+				object.color.x,     object.color.y,     object.color.z);
+
+			objXfmr = this->xfmrs->getObjectTransformer(object.name);
+		}
+		m_drawTransformers.push_back(objXfmr);
+#endif
 
-	TransformAndRender(
-		"tambourine-rattle-3",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-        //  x           y           z
-           0.17f,      0.04f,      0.17f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           1.69f,      3.05f,      6.42f,      // position
-        //  r           g           b
-           0.38f,      0.38f,      0.38f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"metal"                                // material
-	);
+		int textureHandle = -1;
+		if (object.textureTag != "")
+		{
+			textureHandle = FindTextureHandle(object.textureTag);
+			if (textureHandle < 0)
+			{
+				std::cout << "Unknown texture '" << object.textureTag << "' for object '" << object.name << "'" << std::endl;
+			}
+		}
 
-	TransformAndRender(
-		"tambourine-rattle-4",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-        //  x           y           z
-           0.17f,      0.04f,      0.17f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           1.36f,      3.05f,      5.82f,      // position
-        //  r           g           b
-           0.38f,      0.38f,      0.38f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"metal"                                // material
-	);
+		int overlayTextureHandle = -1;
+		if (object.overlayTextureTag != "")
+		{
+			overlayTextureHandle = FindTextureHandle(object.overlayTextureTag);
+			if (overlayTextureHandle < 0)
+			{
+				std::cout << "Unknown texture '" << object.overlayTextureTag << "' for object '" << object.name << "'" << std::endl;
+			}
+		}
 
-	TransformAndRender(
-		"tambourine-rattle-5",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-        //  x           y           z
-           0.17f,      0.04f,      0.17f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           0.71f,      3.05f,      5.82f,      // position
-        //  r           g           b
-           0.38f,      0.38f,      0.38f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"metal"                                // material
-	);
+		// use the default material if none is specified or found
+		int materialIndex = FindMaterialIndex((object.materialTag != "") ? object.materialTag : "default");
+		if (materialIndex < 0)
+		{
+			if (object.materialTag != "")
+			{
+				std::cout << "Unknown material '" << object.materialTag << "' for object '" << object.name << "'" << std::endl;
+			}
+			materialIndex = FindMaterialIndex("default");
+		}
 
-	TransformAndRender(
-		"tambourine-rattle-6",
-		std::bind(&ShapeMeshes::DrawCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-        //  x           y           z
-           0.17f,      0.04f,      0.17f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           0.38f,      3.05f,      6.37f,      // position
-        //  r           g           b
-           0.38f,      0.38f,      0.38f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"metal"                                // material
-	);
+		m_drawList.meshIDs.push_back(object.meshID);
+		m_drawList.meshParts.push_back(object.meshParts);
+		m_drawList.materialIndices.push_back(materialIndex);
+		m_drawList.textureArrays.push_back(GetTextureArray(textureHandle));
+		m_drawList.overlayTextureArrays.push_back(GetTextureArray(overlayTextureHandle));
+		m_drawList.textureLayers.push_back(
+			glm::ivec2(GetTextureLayer(textureHandle), GetTextureLayer(overlayTextureHandle)));
+		m_drawList.textureHandles.push_back(glm::ivec2(textureHandle, overlayTextureHandle));
+		m_drawList.colors.push_back(object.color);
+
+		glm::mat4 modelMatrix;
+		glm::mat3 normalMatrix;
+		ComposeTransform(object.scale, object.rotation, object.position, modelMatrix, normalMatrix);
+		m_drawList.modelMatrices.push_back(modelMatrix);
+		m_drawList.normalMatrices.push_back(normalMatrix);
+	}
+
+	// every draw is visible at LOD 0 until the first frame is culled
+	m_drawBounds.Resize(m_drawList.Size());
+	m_drawSpheres.resize(m_drawList.Size());
+	for (size_t i = 0; i < m_drawList.Size(); i++)
+	{
+		UpdateDrawBounds(i);
+	}
+	m_drawVisible.assign(m_drawList.Size(), 1);
+	m_drawLods.assign(m_drawList.Size(), 0);
+
+	std::cout << "Compiled " << m_drawList.Size() << " scene objects into the draw list" << std::endl;
+
+	BuildInstanceBatches();
 }
 
-void SceneManager::RenderUpturnedBowl()
+/***********************************************************
+ *  UpdateDrawBounds()
+ *
+ *  This method is used for computing the world space
+ *  bounding box and bounding sphere of a draw list entry
+ *  from the local bounds of its mesh and its model matrix.
+ *  The sphere grows with the largest scale of the matrix.
+ ***********************************************************/
+void SceneManager::UpdateDrawBounds(size_t drawIndex)
 {
-		TransformAndRender(
-		"bowl",
-		std::bind(&ShapeMeshes::DrawTaperedCylinderMesh, m_basicMeshes, true, true, true),  // drawTop, drawBottom, drawSides
-        //  x           y           z
-           0.50f,      0.46f,      0.50f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-          -0.22f,      2.87f,      5.66f,      // position
-        //  r           g           b
-           0.28f,      0.28f,      0.40f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"clay"                                 // material
-	);
+	const ShapeMeshes::MESH_BOUNDS& bounds = m_basicMeshes->GetMeshBounds(m_drawList.meshIDs[drawIndex]);
+	const glm::mat4& modelMatrix = m_drawList.modelMatrices[drawIndex];
 
-		
-	TransformAndRender(
-		"hay",
-		std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),  // drawTop, drawBottom, drawSides
-        //  x           y           z
-           0.25f,      0.03f,      0.25f,      // scale
-           0.00f,     78.261f,     0.00f,      // rotation
-          -0.111f,     3.342f,     5.606f,     // position
-        //  r           g           b
-           0.28f,      0.28f,      0.40f,      // color
-		"hay-bales",                           // texture   
-		"",                                    // texture overlay
-		"clay"                                 // material
-	);
+	glm::vec3 center, extent;
+	FrustumCuller::TransformBox(modelMatrix, bounds.boxMin, bounds.boxMax, center, extent);
+	m_drawBounds.Set(drawIndex, center, extent);
+
+	float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+		std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+	glm::vec3 sphereCenter = glm::vec3(modelMatrix * glm::vec4(bounds.sphereCenter, 1.0f));
+	m_drawSpheres[drawIndex] = glm::vec4(sphereCenter, bounds.sphereRadius * scale);
 }
 
-void SceneManager::RenderAquarium() {
-	TransformAndRender(
-		"aquarium-bottom",
-		std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),
-        //  x           y           z
-           0.40f,      0.29f,      0.40f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           1.03f,      3.01f,      5.28f,      // position
-        //  r           g           b
-           0.24f,      0.56f,      0.71f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"glass"                                // material
-	);
-	
-	// uses the new overload of TransformAndRender that allows color alpha
-	TransformAndRender(
-		"aquarium-middle",
-		std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),
-               //  x           y           z
-        glm::vec3(0.40f,      0.90f,      0.40f),      // scale
-        glm::vec3(0.00f,     90.00f,      0.00f),      // rotation
-        glm::vec3(1.03f,      3.58f,      5.28f),      // position
-               //  r           g            b            a
-        glm::vec4(0.24f,      0.56f,      0.71f,        0.5f),    // color with alpha
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"glass"                                // material
-	);
-	
-	TransformAndRender(
-		"aquarium-top",
-		std::bind(&ShapeMeshes::DrawBoxMesh, m_basicMeshes),
-        //  x           y           z
-           0.40f,      0.29f,      0.40f,      // scale
-           0.00f,     90.00f,      0.00f,      // rotation
-           1.03f,      4.175f,     5.28f,      // position
-        //  r           g           b
-           0.24f,      0.56f,      0.71f,      // color
-		"",                                    // texture   
-		"",                                    // texture overlay
-		"glass"                                // material
+/***********************************************************
+ *  AddSceneObject()
+ *
+ *  This method is used for adding a single Shape with given
+ *  scale, rotation, translation, and color or texture data
+ *  to the 3D scene.  The arguments have the same meaning as
+ *  for TransformAndRender(), but the shape is given by its
+ *  ShapeMeshes::MeshID and is drawn by RenderScene() from the
+ *  compiled draw list.
+ ***********************************************************/
+void SceneManager::AddSceneObject(
+	const std::string& objName,
+	int meshID,
+	glm::vec3 scale,
+	glm::vec3 rot,
+	glm::vec3 pos,
+	glm::vec4 color,
+	const std::string& textureName,
+	const std::string& overlayTextureName,
+	const std::string& materialName)
+{
+	SCENE_OBJECT object;
+
+	object.name = objName;
+	object.meshID = meshID;
+	object.meshParts = ShapeMeshes::PART_ALL;
+	object.scale = scale;
+	object.rotation = rot;
+	object.position = pos;
+	object.color = color;
+	object.textureTag = textureName;
+	object.overlayTextureTag = overlayTextureName;
+	object.materialTag = materialName;
+
+	m_sceneObjects.push_back(object);
+}
+
+// Overload that is commonly used for non-alpha colored objects
+void SceneManager::AddSceneObject(
+	const std::string& objName,
+	int meshID,
+	float scaleX, float scaleY, float scaleZ,
+	float rotX,   float rotY,   float rotZ,
+	float posX,   float posY,   float posZ,
+	float colorR, float colorG, float colorB,
+	const std::string& textureName,
+	const std::string& overlayTextureName,
+	const std::string& materialName)
+{
+	AddSceneObject(
+		objName,
+		meshID,
+		glm::vec3(scaleX,  scaleY,  scaleZ),
+		glm::vec3(rotX,    rotY,    rotZ),
+		glm::vec3(posX,    posY,    posZ),
+		glm::vec4(colorR,  colorG,  colorB,  1.0f),      // this overload assumes no transparency
+		textureName,
+		overlayTextureName,
+		materialName
 	);
 }
 
@@ -997,38 +3078,43 @@ void SceneManager::TransformAndRender(
 {
 
 #ifdef _DEBUG
-	// register this object with the LiveTransformer
-	// if object has already been registered, this does nothing
-	this->xfmrs->RegisterNewObject(
-		 objName,
-		 scale.x,  scale.y,  scale.z,
-		 rot.x,    rot.y,    rot.z,
-		 pos.x,    pos.y,    pos.z,
-		 color.x,  color.y,  color.z);
-
-	LiveTransformer* objXfmr = this->xfmrs->getObjectTransformer(objName);
-
-	// TODO: handle this better
-	if (objXfmr == nullptr) {
-		std::cerr << "Failed to get object transformer for '" << objName << "'" << std::endl;
-		assert(false);
-	}
-
-	scale.x = objXfmr->XscaleAdjusted;
-	scale.y = objXfmr->YscaleAdjusted;
-	scale.z = objXfmr->ZscaleAdjusted;
-
-	rot.x = objXfmr->XrotationAdjusted;
-	rot.y = objXfmr->YrotationAdjusted;
-	rot.z = objXfmr->ZrotationAdjusted;
-
-	pos.x = objXfmr->XpositionAdjusted;
-	pos.y = objXfmr->YpositionAdjusted;
-	pos.z = objXfmr->ZpositionAdjusted;
-
-	color.x = objXfmr->RcolorAdjusted;
-	color.y = objXfmr->GcolorAdjusted;
-	color.z = objXfmr->BcolorAdjusted;
+	// without a display window there is no transformation manager
+	// and the passed in values are drawn as they are
+	if (nullptr != this->xfmrs)
+	{
+		// register this object with the LiveTransformer
+		// if object has already been registered, this does nothing
+		this->xfmrs->RegisterNewObject(
+			 objName,
+			 scale.x,  scale.y,  scale.z,
+			 rot.x,    rot.y,    rot.z,
+			 pos.x,    pos.y,    pos.z,
+			 color.x,  color.y,  color.z);
+
+		LiveTransformer* objXfmr = this->xfmrs->getObjectTransformer(objName);
+
+		// TODO: handle this better
+		if (objXfmr == nullptr) {
+			std::cerr << "Failed to get object transformer for '" << objName << "'" << std::endl;
+			assert(false);
+		}
+
+		scale.x = objXfmr->XscaleAdjusted;
+		scale.y = objXfmr->YscaleAdjusted;
+		scale.z = objXfmr->ZscaleAdjusted;
+
+		rot.x = objXfmr->XrotationAdjusted;
+		rot.y = objXfmr->YrotationAdjusted;
+		rot.z = objXfmr->ZrotationAdjusted;
+
+		pos.x = objXfmr->XpositionAdjusted;
+		pos.y = objXfmr->YpositionAdjusted;
+		pos.z = objXfmr->ZpositionAdjusted;
+
+		color.x = objXfmr->RcolorAdjusted;
+		color.y = objXfmr->GcolorAdjusted;
+		color.z = objXfmr->BcolorAdjusted;
+	}
 
 #endif
 
@@ -11,10 +11,18 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "FrustumCuller.h"
+#include "FrameProfiler.h"
+#include "SceneFile.h"
+#include "TextureLoader.h"
+#include "PersistentRingBuffer.h"
 
 #include <string>
 #include <vector>
 #include <functional>
+#include <cstdint>
+#include <unordered_map>
+#include <chrono>
 
 #ifdef _DEBUG
 #include "LiveTransformations/LiveTransformers.h"
@@ -35,10 +43,41 @@ public:
 	// destructor
 	~SceneManager();
 
+	// how the textures are stored on the GPU
+	enum TextureCompression
+	{
+		TEXTURE_COMPRESSION_NONE,   // GL_RGB8 and GL_RGBA8
+		TEXTURE_COMPRESSION_BC,     // BC1 for RGB images, BC3 for RGBA images
+		TEXTURE_COMPRESSION_BC7     // BC7 for all images
+	};
+
+	// a loaded texture is one layer of a texture array - the
+	// index of its TEXTURE_INFO is the handle of the texture
 	struct TEXTURE_INFO
 	{
 		std::string tag;
-		uint32_t ID;
+		std::string filename;
+		int width;
+		int height;
+		GLenum internalFormat;
+		BlockCompressor::Format compressedFormat;
+		int arrayIndex;       // -1 until the texture arrays are built
+		int layer;
+		bool bUploaded;       // its layer holds the decoded mip chain
+		bool bResident;       // uploaded and its whole texture array too
+	};
+
+	// textures of the same size and format share one
+	// GL_TEXTURE_2D_ARRAY, bound to the texture unit that
+	// matches its index
+	struct TEXTURE_ARRAY
+	{
+		GLuint ID;
+		int width;
+		int height;
+		GLenum internalFormat;
+		int layerCount;
+		int pendingLayers;    // layers still waiting for their image
 	};
 
 	struct OBJECT_MATERIAL
@@ -51,30 +90,413 @@ public:
 		std::string tag;
 	};
 
+	// one material as it is stored in the MaterialBlock uniform
+	// buffer - std140 layout, this must match the Material struct
+	// in fragmentShader.glsl
+	struct GPU_MATERIAL
+	{
+		glm::vec3 ambientColor;
+		float ambientStrength;
+		glm::vec3 diffuseColor;
+		float padding;
+		glm::vec3 specularColor;
+		float shininess;
+	};
+
+	// description of one object in the 3D scene, as it is
+	// read from the scene file - it is only read when the
+	// scene is compiled into the draw list
+	struct SCENE_OBJECT
+	{
+		std::string name;
+		int meshID;
+		unsigned int meshParts;
+		glm::vec3 scale;
+		glm::vec3 rotation;
+		glm::vec3 position;
+		glm::vec4 color;
+		std::string textureTag;
+		std::string overlayTextureTag;
+		std::string materialTag;
+	};
+
+	// compiled scene, stored as a structure of arrays so that
+	// RenderScene() only walks flat arrays of integers and
+	// matrices - entry i of every array belongs to draw i
+	struct DRAW_LIST
+	{
+		std::vector<int> meshIDs;
+		std::vector<unsigned int> meshParts;
+		std::vector<int> materialIndices;
+		std::vector<int> textureArrays;          // -1 for none
+		std::vector<int> overlayTextureArrays;   // -1 for none
+		std::vector<glm::ivec2> textureLayers;   // texture and overlay layer
+		std::vector<glm::ivec2> textureHandles;  // texture and overlay handle, -1 for none
+		std::vector<glm::vec4> colors;
+		std::vector<glm::mat4> modelMatrices;
+		std::vector<glm::mat3> normalMatrices;
+
+		size_t Size() const { return meshIDs.size(); }
+		void Reserve(size_t count)
+		{
+			meshIDs.reserve(count);
+			meshParts.reserve(count);
+			materialIndices.reserve(count);
+			textureArrays.reserve(count);
+			overlayTextureArrays.reserve(count);
+			textureLayers.reserve(count);
+			textureHandles.reserve(count);
+			colors.reserve(count);
+			modelMatrices.reserve(count);
+			normalMatrices.reserve(count);
+		}
+		void Clear()
+		{
+			meshIDs.clear();
+			meshParts.clear();
+			materialIndices.clear();
+			textureArrays.clear();
+			overlayTextureArrays.clear();
+			textureLayers.clear();
+			textureHandles.clear();
+			colors.clear();
+			modelMatrices.clear();
+			normalMatrices.clear();
+		}
+	};
+
+	// opaque draws that share the mesh, material and texture
+	// arrays - they are drawn with one instanced call that reads
+	// a range of the instance buffer, which also holds the
+	// texture layer of every draw
+	struct INSTANCE_BATCH
+	{
+		int meshID;
+		unsigned int meshParts;
+		int materialIndex;
+		int textureArray;
+		int overlayTextureArray;
+		int firstInstance;
+		int instanceCount;      // visible draws, packed at firstInstance
+		int drawCount;          // all draws of the batch
+		// visible draws at every level of detail, packed in that order
+		int lodInstanceCounts[ShapeMeshes::MAX_MESH_LODS];
+	};
+
+	// one glMultiDrawElementsIndirect call - a new call starts
+	// wherever the texture arrays or the render pass change
+	struct MULTI_DRAW_CALL
+	{
+		int firstCommand;
+		int commandCount;
+		int textureArray;
+		int overlayTextureArray;
+		bool bTransparent;
+	};
+
+	// counters of the frustum culling, gathered over one frame
+	struct CULL_STATS
+	{
+		unsigned int tested;
+		unsigned int visible;
+		unsigned int culled;
+	};
+
+	// counters of the render queue sort, gathered over one frame
+	struct SORT_STATS
+	{
+		unsigned int renderItems;
+		unsigned int stateChanges;          // state changes in sorted order
+		unsigned int stateChangesSaved;     // state changes avoided by sorting
+	};
+
+	// counters of the level of detail selection, gathered over one frame
+	struct LOD_STATS
+	{
+		unsigned int trianglesSubmitted;
+		unsigned int trianglesSaved;        // compared with drawing every object at LOD 0
+		unsigned int lodChanges;            // draws that switched their level of detail
+		unsigned int lodDraws[ShapeMeshes::MAX_MESH_LODS];   // visible draws at every level
+	};
+
+	// the benchmarks drive the scene internals directly
+	friend class SceneBenchmarks;
 
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	// meshes of the scene file, kept so that they can be loaded again
+	std::vector<SceneFile::MESH_RECORD> m_sceneMeshes;
+	// loaded textures info, indexed by texture handle
+	std::vector<TEXTURE_INFO> m_textures;
+	// texture handle of every texture tag
+	std::unordered_map<std::string, int> m_textureHandles;
+	// texture arrays holding the loaded textures
+	std::vector<TEXTURE_ARRAY> m_textureArrays;
+	// decodes the texture images on worker threads
+	TextureLoader m_textureLoader;
+	// pixel buffer object the decoded images are uploaded through
+	GLuint m_textureUploadBuffer;
+	// texture array of the 1x1 placeholder that is drawn in place
+	// of the textures that are not resident yet
+	int m_placeholderArray;
+	// set when textures became resident since the draw list was
+	// pointed at its textures
+	bool m_bDrawTexturesDirty;
+	// start of the texture loading, for reporting how long it took
+	std::chrono::steady_clock::time_point m_textureLoadStart;
+	// read the mip chains from the texture caches when they are up
+	// to date, and write them when they are not
+	bool m_bUseTextureCache;
+	// textures of the current loading that came from their cache
+	int m_texturesFromCache;
+	// block format of the textures that are created, and how
+	// hard the encoder searches for the best blocks
+	TextureCompression m_textureCompression;
+	BlockCompressor::Quality m_textureCompressionQuality;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// uniform buffer holding all the defined materials
+	GLuint m_materialBuffer;
+	// objects of the 3D scene, in definition order
+	std::vector<SCENE_OBJECT> m_sceneObjects;
+	// flat draw list compiled from the scene objects
+	DRAW_LIST m_drawList;
+	// instanced batches compiled from the draw list
+	std::vector<INSTANCE_BATCH> m_instanceBatches;
+	// draw list index of every batched instance, in batch order
+	std::vector<int> m_batchedDraws;
+	// draw list indices of the draws that are never batched
+	std::vector<int> m_unbatchedDraws;
+	// per-instance data for the instance buffer, in batch order
+	std::vector<ShapeMeshes::INSTANCE_DATA> m_instanceData;
+	// vertex buffer holding the per-instance data when the ring
+	// buffer below is not used
+	GLuint m_instanceBuffer;
+	// set when the instance data needs to be uploaded again
+	bool m_bInstanceDataDirty;
+	// draw the opaque objects with instanced batches
+	bool m_bUseInstancing;
+	// instance buffer slot of every entry in the draw list
+	std::vector<int> m_drawInstanceSlots;
+
+	// set when the meshes are packed into shared buffers and the
+	// driver can draw them with multi-draw indirect calls
+	bool m_bMultiDrawSupported;
+	// submit the render queue with multi-draw indirect calls
+	bool m_bUseMultiDraw;
+	// indirect commands of the frame and the buffer they are read from
+	std::vector<ShapeMeshes::DRAW_ELEMENTS_INDIRECT_COMMAND> m_indirectCommands;
+	GLuint m_indirectBuffer;
+	// material index of every indirect command, read through gl_DrawID
+	std::vector<GLint> m_drawMaterials;
+	GLuint m_drawDataBuffer;
+	// multi-draw calls of the frame
+	std::vector<MULTI_DRAW_CALL> m_multiDrawCalls;
+
+	// persistently mapped ring that the instanced paths write the
+	// instance data, indirect commands and draw materials of every
+	// frame into, in place of the buffers above
+	PersistentRingBuffer m_dynamicRing;
+	// write the per-frame data into the ring when the driver has
+	// buffer storage
+	bool m_bUseDynamicRing;
+	// mapped region of the frame that is being rendered, or NULL
+	unsigned char* m_pDynamicRegion;
+	// offset of the indirect commands in every region, after the
+	// instance data, and the most commands a region has room for
+	GLintptr m_ringCommandsOffset;
+	size_t m_ringCommandCapacity;
+	// the draw materials follow the commands at a bindable offset
+	GLint m_ringMaterialsAlignment;
+	// first instance of the region of this frame, added to the base
+	// instance of every instanced draw
+	GLuint m_instanceBase;
+	// counts the packings of the instance data, and the count whose
+	// data every ring region holds
+	unsigned int m_instanceDataVersion;
+	unsigned int m_regionInstanceVersions[PersistentRingBuffer::REGION_COUNT];
+
+	// view of the frame that is being rendered
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	glm::vec3 m_cameraPosition;
+
+	// render queue of the frame - one 64-bit sort key per item, where an
+	// item is an instanced batch or a single entry of the draw list
+	std::vector<uint64_t> m_sortKeys;
+	std::vector<uint32_t> m_sortItems;
+	// scratch space for the radix sort
+	std::vector<uint64_t> m_sortKeysScratch;
+	std::vector<uint32_t> m_sortItemsScratch;
+	// counters of the last sorted frame
+	SORT_STATS m_sortStats;
 
-	// load texture images and convert to OpenGL texture data
+	// view frustum of the frame that is being rendered
+	FrustumCuller m_frustumCuller;
+	// world space bounding box of every entry in the draw list
+	FrustumCuller::BOX_ARRAYS m_drawBounds;
+	// 1 for every entry of the draw list that is in the view frustum,
+	// along with the visibility of the frame before
+	std::vector<unsigned char> m_drawVisible;
+	std::vector<unsigned char> m_drawVisiblePrevious;
+	// skip the draws that are outside of the view frustum
+	bool m_bUseCulling;
+	// counters of the last culled frame
+	CULL_STATS m_cullStats;
+
+	// world space bounding sphere of every entry in the draw list,
+	// center in xyz and radius in w
+	std::vector<glm::vec4> m_drawSpheres;
+	// level of detail of every entry in the draw list, kept from
+	// frame to frame for the hysteresis
+	std::vector<int> m_drawLods;
+	// pick the level of detail of every draw from its size on screen
+	bool m_bUseLod;
+	// a draw drops to LOD n+1 when its projected diameter is below
+	// threshold n, in pixels
+	float m_lodPixelThresholds[ShapeMeshes::MAX_MESH_LODS - 1];
+	// fraction of a threshold that the diameter has to cross it by
+	// before the level of detail changes
+	float m_lodHysteresis;
+	// height of the viewport in pixels
+	float m_viewportHeight;
+	// counters of the last frame
+	LOD_STATS m_lodStats;
+	// light the objects with the light sources of the scene
+	bool m_bUseLighting;
+
+	// profiler that times the stages of RenderScene(), or NULL
+	FrameProfiler* m_pProfiler;
+	int m_cullSection;
+	int m_uploadSection;
+	int m_sortSection;
+	int m_submitSection;
+	int m_textureUploadSection;
+	int m_trianglesSubmittedCounter;
+	int m_trianglesSavedCounter;
+	int m_ringWaitsCounter;
+#ifdef _DEBUG
+	// live transformer of each entry in the draw list
+	std::vector<LiveTransformer*> m_drawTransformers;
+#endif
+
+	// precompiled handles for the per-object shader uniforms
+	ShaderManager::UniformHandle<glm::mat4> m_modelUniform;
+	ShaderManager::UniformHandle<glm::mat3> m_normalMatrixUniform;
+	ShaderManager::UniformHandle<glm::vec4> m_colorUniform;
+	ShaderManager::UniformHandle<int> m_textureUniform;
+	ShaderManager::UniformHandle<int> m_textureOverlayUniform;
+	ShaderManager::UniformHandle<int> m_textureLayerUniform;
+	ShaderManager::UniformHandle<int> m_textureOverlayLayerUniform;
+	ShaderManager::UniformHandle<int> m_drawDataBaseUniform;
+	ShaderManager::UniformHandle<glm::vec2> m_UVscaleUniform;
+	ShaderManager::UniformHandle<int> m_materialIndexUniform;
+
+	// look up the handles of the per-object shader uniforms
+	void ResolveUniformHandles();
+	// shader features of a draw with or without its textures - the
+	// draw paths add the instancing and multi-draw features
+	unsigned int GetShaderFeatures(bool bTexture, bool bTextureOverlay) const;
+
+	// register texture images and queue them to be decoded
 	bool CreateGLTexture(const char* filename, std::string tagT);
-	// bind loaded OpenGL textures to slots in memory
+	// start decoding the registered textures, allocate their
+	// texture arrays and bind the arrays to texture units
 	void BindGLTextures();
+	// allocate the texture arrays of the registered textures
+	void BuildTextureArrays();
+	// create the texture array of the placeholder texture
+	void CreatePlaceholderTexture();
+	// upload the decoded images that are ready, up to the budget
+	// of one frame
+	void StreamTextureUploads();
+	// copy the mip chain of one decoded image into its texture
+	// array layer through the pixel buffer object - returns the
+	// bytes copied
+	size_t UploadTextureImage(TextureLoader::DECODED_IMAGE& image);
+	// point the draw list at the textures that became resident
+	void RefreshDrawTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	// find the handle of a loaded texture by tag
+	int FindTextureHandle(const std::string& tag) const;
+	// texture array index and layer of a texture handle
+	int GetTextureArray(int textureHandle) const;
+	int GetTextureLayer(int textureHandle) const;
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindMaterialIndex(const std::string& tag);
+
+	// upload the defined materials into the material uniform buffer
+	void CreateMaterialBuffer();
+	// upload a single changed material into its buffer slot
+	void UpdateMaterialSlot(int materialIndex);
+#ifdef _DEBUG
+	// upload the materials that were adjusted in the live UI
+	void ApplyLiveMaterialEdits();
+	// recompute the draws whose transform or color was adjusted in the live UI
+	void ApplyLiveTransformEdits();
+#endif
+
+	// build the model matrix from scale, rotation degrees and position
+	static glm::mat4 ComposeModelMatrix(
+		const glm::vec3& scaleXYZ,
+		const glm::vec3& rotationDegrees,
+		const glm::vec3& positionXYZ);
+	// build the model matrix and the matching normal matrix
+	static void ComposeTransform(
+		const glm::vec3& scaleXYZ,
+		const glm::vec3& rotationDegrees,
+		const glm::vec3& positionXYZ,
+		glm::mat4& modelMatrix,
+		glm::mat3& normalMatrix);
+	// build the model matrix by multiplying the separate scale, rotation
+	// and translation matrices - kept for comparison
+	static glm::mat4 ComposeModelMatrixChained(
+		const glm::vec3& scaleXYZ,
+		const glm::vec3& rotationDegrees,
+		const glm::vec3& positionXYZ);
+
+	// compile the scene objects into the flat draw list
+	void CompileDrawList();
+	// compute the world space bounding box and bounding sphere of
+	// one draw list entry
+	void UpdateDrawBounds(size_t drawIndex);
+	// test the draw list against the view frustum
+	void CullDrawList();
+	// pick the level of detail of every visible draw
+	void SelectDrawLods();
+	// diameter of the bounding sphere of a draw on the screen, in pixels
+	float GetProjectedDiameter(size_t drawIndex) const;
+	// group the opaque draws of the draw list into instanced batches
+	void BuildInstanceBatches();
+	// upload the per-instance data of the batched draws
+	void UploadInstanceData();
+	// create the ring again when the draw list outgrew its regions
+	void ReserveDynamicRing();
+	// move to the next region of the ring and copy the instance
+	// data into it, unless it holds the current data already
+	void BeginDynamicRegion();
+
+	// draw one entry of the draw list without instancing
+	void RenderDraw(size_t drawIndex);
+	// draw one entry of the draw list as a single instance that
+	// reads its transform and color from the instance buffer
+	void RenderDrawInstance(size_t drawIndex);
+	// draw one instanced batch
+	void RenderInstanceBatch(size_t batchIndex);
+
+	// build and sort the render queue of this frame
+	void BuildRenderQueue();
+	// draw the sorted render queue, opaque pass then transparent pass
+	void SubmitRenderQueue();
+	// draw the sorted render queue from the shared mesh buffers with
+	// one multi-draw indirect call per texture change and pass
+	void SubmitMultiDrawQueue();
+	// distance of an object in front of the camera, for sorting
+	float GetViewDepth(const glm::mat4& modelMatrix) const;
 
 	// set the transformation values 
 	// into the transform buffer
@@ -95,8 +517,11 @@ private:
 	// set the texture data into the shader
 	void SetShaderTexture(
 		std::string textureTag);
+	void SetShaderTexture(
+		int textureHandle);
 
 	void SetShaderTextureOverlay(std::string textureTag);
+	void SetShaderTextureOverlay(int textureHandle);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -105,20 +530,106 @@ private:
 	// set the object material into the shader
 	void SetShaderMaterial(
 		std::string materialTag);
+	void SetShaderMaterial(
+		int materialIndex);
 
 public:
 
 	// The following methods are for the students to 
-	// customize for their own 3D scene
-	void PrepareScene();
+	// customize for their own 3D scene - the scene itself
+	// is described in the scene file
+	bool PrepareScene(
+		const std::string& sceneFilename,
+		bool bUseSceneCache = true,
+		bool bUseTextureCache = true);
 	void RenderScene();
 
-	void RenderBackdrop();
-	void RenderOpenBook();
-	void RenderClosedBook();
-	void RenderTambourine();
-	void RenderUpturnedBowl();
-	void RenderAquarium();
+	// set the view that the next RenderScene() call is drawn from
+	void SetViewParameters(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& cameraPosition,
+		float viewportHeight);
+
+	// render queue counters of the last rendered frame
+	SORT_STATS GetLastFrameSortStats() const { return m_sortStats; }
+	// culling counters of the last rendered frame
+	CULL_STATS GetLastFrameCullStats() const { return m_cullStats; }
+	// level of detail counters of the last rendered frame
+	LOD_STATS GetLastFrameLodStats() const { return m_lodStats; }
+
+	// draw the shapes that have levels of detail at the level that
+	// matches their size on the screen
+	void SetLodSelection(bool bEnabled);
+	// set the projected diameters in pixels below which the draws
+	// drop to LOD 1, 2 and 3
+	void SetLodThresholds(const float pixels[ShapeMeshes::MAX_MESH_LODS - 1]);
+	// set the fraction of a threshold that the diameter has to cross
+	// it by before the level of detail changes
+	void SetLodHysteresis(float hysteresis);
+
+	// write the per-frame data of the instanced paths straight into
+	// a persistently mapped ring buffer instead of respecifying
+	// buffers - falls back when the driver has no buffer storage
+	void SetPersistentBuffers(bool bEnabled);
+	// fence wait counters of the ring buffer
+	PersistentRingBuffer::RING_STATS GetRingStats() const { return m_dynamicRing.GetStats(); }
+
+	// time the stages of RenderScene() as sections of the profiler
+	void SetProfiler(FrameProfiler* pProfiler);
+
+	// wait for all the textures to be decoded and upload them, so
+	// that no placeholder is drawn anymore
+	void FinishTextureUploads();
+
+	// compress the textures that are created from now on - falls
+	// back to the formats the driver supports
+	void SetTextureCompression(TextureCompression compression, BlockCompressor::Quality quality);
+
+	// store the meshes that are loaded from now on in the given
+	// vertex layout
+	void SetMeshVertexFormat(ShapeMeshes::VertexFormat format) { m_basicMeshes->SetVertexFormat(format); }
+	// reorder the meshes that are loaded from now on for the
+	// vertex cache
+	void SetOptimizeMeshes(bool bOptimize) { m_basicMeshes->SetOptimizeMeshes(bOptimize); }
+
+	// decode the textures of a scene file and write their texture
+	// caches, without creating any OpenGL objects - returns false
+	// if the scene file or one of its textures could not be loaded
+	static bool WarmTextureCache(
+		const std::string& sceneFilename,
+		TextureCompression compression = TEXTURE_COMPRESSION_NONE,
+		BlockCompressor::Quality quality = BlockCompressor::QUALITY_NORMAL);
+
+	// draw the scene objects one at a time through TransformAndRender(),
+	// without the compiled draw list - kept for comparison
+	void RenderSceneImmediate();
+
+	// add the specified shape with given scale, rotation, position, and color or texture
+	// to the scene - it is drawn from the compiled draw list by RenderScene()
+	void AddSceneObject(
+		const std::string& objName,
+		int meshID,
+		glm::vec3 scale,
+		glm::vec3 rot,
+		glm::vec3 pos,
+		glm::vec4 color,
+		const std::string& textureName,
+		const std::string& overlayTextureName,
+		const std::string& materialName);
+
+	// commonly-used overload version
+	void AddSceneObject(
+		const std::string& objName,
+		int meshID,
+		float scaleX, float scaleY, float scaleZ,
+		float rotX,   float rotY,   float rotZ,
+		float posX,   float posY,   float posZ,
+		float colorR, float colorG, float colorB,
+		const std::string& textureName = "",
+		const std::string& overlayTextureName = "",
+		const std::string& materialName = ""
+	);
 
 	// draw the specified shape with given scale, rotation, position, and color or texture
 	void TransformAndRender(
@@ -146,13 +657,21 @@ public:
 	);
 
 	// configures the different materials for 3D objects
-	void DefineObjectMaterials();
+	void DefineObjectMaterials(const SceneFile& sceneFile);
 
 	// configures light sources for the scene
-	void SetupSceneLights();
+	void SetupSceneLights(const SceneFile& sceneFile);
 
 	// loads textures from image files
-	void LoadSceneTextures();
+	void LoadSceneTextures(const SceneFile& sceneFile);
+
+	// loads the meshes that the scene objects are drawn with
+	void LoadSceneMeshes(const SceneFile& sceneFile);
+	// loads the meshes of the scene into the passed in shapes
+	void LoadMeshes(ShapeMeshes* pMeshes) const;
+
+	// adds the objects of the scene file to the scene
+	void DefineSceneObjects(const SceneFile& sceneFile);
 
 	
 
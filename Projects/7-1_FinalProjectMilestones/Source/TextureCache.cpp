@@ -0,0 +1,537 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// load the mip chain of a texture image from its binary cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	const char CACHE_MAGIC[4] = { 'T', 'X', 'C', 'C' };
+	const char* const CACHE_EXTENSION = ".texcache";
+
+	// the levels start on 64 byte boundaries, so every level can be
+	// copied with aligned loads
+	size_t AlignOffset(size_t offset)
+	{
+		return((offset + 63) & ~(size_t)63);
+	}
+
+	// size of a level in pixels or in compressed blocks
+	uint64_t GetLevelSize(BlockCompressor::Format format, uint32_t width, uint32_t height, uint32_t channels)
+	{
+		if (BlockCompressor::FORMAT_NONE == format)
+		{
+			return((uint64_t)width * height * channels);
+		}
+		return((uint64_t)BlockCompressor::GetCompressedBytes(format, (int)width, (int)height));
+	}
+
+	// the quality only tells caches apart when the levels are compressed
+	uint32_t GetStoredQuality(BlockCompressor::Format format, BlockCompressor::Quality quality)
+	{
+		return((BlockCompressor::FORMAT_NONE == format) ? 0 : (uint32_t)quality);
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache()
+{
+	m_pHeader = NULL;
+	m_bFromCache = false;
+	m_bCacheWritten = false;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used to load the mip chain.  The cache is
+ *  only used when it was built by the same CACHE_VERSION with
+ *  the same channels, format and quality from an image file
+ *  of the same size and modification time, so any edit of
+ *  the image rebuilds it.
+ ***********************************************************/
+bool TextureCache::Load(
+	const std::string& filename,
+	int channels,
+	BlockCompressor::Format format,
+	BlockCompressor::Quality quality,
+	bool bUseCache)
+{
+	Clear();
+
+	uint64_t sourceSize = 0;
+	int64_t sourceModifiedTime = 0;
+	if (MappedFile::GetFileStamp(filename, sourceSize, sourceModifiedTime) == false)
+	{
+		return(false);
+	}
+
+	const std::string cacheFilename = GetCacheFilename(filename);
+	if ((bUseCache == true) && (m_mapping.Open(cacheFilename) == true))
+	{
+		if (AttachChain(m_mapping.GetData(), m_mapping.GetSize(), channels, format, quality, sourceSize, sourceModifiedTime) == true)
+		{
+			m_bFromCache = true;
+			return(true);
+		}
+
+		// the cache is out of date or damaged
+		m_mapping.Close();
+	}
+
+	if ((BuildChain(filename, channels, format, quality, sourceSize, sourceModifiedTime) == false) ||
+		(AttachChain(m_built.data(), m_built.size(), channels, format, quality, sourceSize, sourceModifiedTime) == false))
+	{
+		Clear();
+		return(false);
+	}
+
+	// an image that can not be cached still works, it is only
+	// decoded again on the next start
+	m_bCacheWritten = (bUseCache == true) && (WriteCache(cacheFilename) == true);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used to release the mapping or the decoded
+ *  chain of the last Load().
+ ***********************************************************/
+void TextureCache::Clear()
+{
+	m_mapping.Close();
+	std::vector<unsigned char>().swap(m_built);
+	m_pHeader = NULL;
+	m_bFromCache = false;
+	m_bCacheWritten = false;
+}
+
+/***********************************************************
+ *  GetChannels()
+ *
+ *  This method is used to get the color channels of every
+ *  pixel of the loaded levels.
+ ***********************************************************/
+int TextureCache::GetChannels() const
+{
+	return((NULL == m_pHeader) ? 0 : (int)m_pHeader->channels);
+}
+
+/***********************************************************
+ *  GetFormat()
+ *
+ *  This method is used to get the block format the loaded
+ *  levels are compressed in.
+ ***********************************************************/
+BlockCompressor::Format TextureCache::GetFormat() const
+{
+	return((NULL == m_pHeader) ? BlockCompressor::FORMAT_NONE : (BlockCompressor::Format)m_pHeader->format);
+}
+
+/***********************************************************
+ *  GetPSNR()
+ *
+ *  This method is used to get the error of the compression
+ *  of the first level, which was measured when it was built.
+ ***********************************************************/
+double TextureCache::GetPSNR() const
+{
+	return((NULL == m_pHeader) ? 0.0 : (double)m_pHeader->psnr);
+}
+
+/***********************************************************
+ *  GetLevelCount()
+ *
+ *  This method is used to get the number of loaded levels.
+ ***********************************************************/
+int TextureCache::GetLevelCount() const
+{
+	return((NULL == m_pHeader) ? 0 : (int)m_pHeader->levelCount);
+}
+
+/***********************************************************
+ *  GetLevelWidth()
+ *
+ *  This method is used to get the width of a loaded level.
+ ***********************************************************/
+int TextureCache::GetLevelWidth(int level) const
+{
+	if ((level < 0) || (level >= GetLevelCount()))
+	{
+		return(0);
+	}
+	return((int)m_pHeader->levelWidths[level]);
+}
+
+/***********************************************************
+ *  GetLevelHeight()
+ *
+ *  This method is used to get the height of a loaded level.
+ ***********************************************************/
+int TextureCache::GetLevelHeight(int level) const
+{
+	if ((level < 0) || (level >= GetLevelCount()))
+	{
+		return(0);
+	}
+	return((int)m_pHeader->levelHeights[level]);
+}
+
+/***********************************************************
+ *  GetLevelData()
+ *
+ *  This method is used to get the pixels of a loaded level.
+ ***********************************************************/
+const unsigned char* TextureCache::GetLevelData(int level) const
+{
+	if ((level < 0) || (level >= GetLevelCount()))
+	{
+		return(NULL);
+	}
+	return((const unsigned char*)m_pHeader + m_pHeader->levelOffsets[level]);
+}
+
+/***********************************************************
+ *  GetLevelBytes()
+ *
+ *  This method is used to get the size of a loaded level.
+ ***********************************************************/
+size_t TextureCache::GetLevelBytes(int level) const
+{
+	if ((level < 0) || (level >= GetLevelCount()))
+	{
+		return(0);
+	}
+	return((size_t)GetLevelSize(GetFormat(), m_pHeader->levelWidths[level], m_pHeader->levelHeights[level], m_pHeader->channels));
+}
+
+/***********************************************************
+ *  GetChainBytes()
+ *
+ *  This method is used to get the size of the loaded levels
+ *  from the start of the first to the end of the last.
+ ***********************************************************/
+size_t TextureCache::GetChainBytes() const
+{
+	int levelCount = GetLevelCount();
+	if (levelCount == 0)
+	{
+		return(0);
+	}
+	return(GetLevelOffset(levelCount - 1) + GetLevelBytes(levelCount - 1));
+}
+
+/***********************************************************
+ *  GetLevelOffset()
+ *
+ *  This method is used to get the offset of a loaded level
+ *  from the start of the first level.
+ ***********************************************************/
+size_t TextureCache::GetLevelOffset(int level) const
+{
+	if ((level < 0) || (level >= GetLevelCount()))
+	{
+		return(0);
+	}
+	return((size_t)(m_pHeader->levelOffsets[level] - m_pHeader->levelOffsets[0]));
+}
+
+/***********************************************************
+ *  GetCacheFilename()
+ *
+ *  This method is used to get the name of the cache file,
+ *  which is the image file name with an added extension, so
+ *  images that only differ in their extension do not share
+ *  a cache.
+ ***********************************************************/
+std::string TextureCache::GetCacheFilename(const std::string& filename)
+{
+	return(filename + CACHE_EXTENSION);
+}
+
+/***********************************************************
+ *  GetFullLevelCount()
+ *
+ *  This method is used to get the number of levels of a
+ *  full mip chain, one for every halving of the larger side.
+ ***********************************************************/
+int TextureCache::GetFullLevelCount(int width, int height)
+{
+	int levels = 1;
+	while ((std::max(width, height) >> levels) > 0)
+	{
+		levels++;
+	}
+	return(levels);
+}
+
+/***********************************************************
+ *  BuildChain()
+ *
+ *  This method is used to decode the image and to lay the
+ *  levels out the same way as in the cache file.  Every
+ *  level is filtered from the one before, and compressed
+ *  only once the whole chain is filtered, so the error of
+ *  the compression does not add up along the chain.
+ ***********************************************************/
+bool TextureCache::BuildChain(
+	const std::string& filename,
+	int channels,
+	BlockCompressor::Format format,
+	BlockCompressor::Quality quality,
+	uint64_t sourceSize,
+	int64_t sourceModifiedTime)
+{
+	int width = 0;
+	int height = 0;
+	int fileChannels = 0;
+
+	// indicate to always flip images vertically when loaded
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* image = stbi_load(filename.c_str(), &width, &height, &fileChannels, channels);
+	if (NULL == image)
+	{
+		return(false);
+	}
+
+	int levelCount = GetFullLevelCount(width, height);
+	if (levelCount > MAX_LEVELS)
+	{
+		stbi_image_free(image);
+		return(false);
+	}
+
+	CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceModifiedTime = sourceModifiedTime;
+	header.channels = (uint32_t)channels;
+	header.format = (uint32_t)BlockCompressor::FORMAT_NONE;
+	header.quality = GetStoredQuality(BlockCompressor::FORMAT_NONE, quality);
+	header.levelCount = (uint32_t)levelCount;
+
+	size_t totalBytes = LayoutLevels(header, width, height);
+	m_built.assign(totalBytes, 0);
+	memcpy(&m_built[0], &header, sizeof(header));
+	memcpy(&m_built[header.levelOffsets[0]], image, (size_t)width * height * channels);
+	stbi_image_free(image);
+
+	for (int level = 1; level < levelCount; level++)
+	{
+		DownsampleLevel(
+			&m_built[header.levelOffsets[level - 1]],
+			header.levelWidths[level - 1],
+			header.levelHeights[level - 1],
+			&m_built[header.levelOffsets[level]],
+			header.levelWidths[level],
+			header.levelHeights[level],
+			channels);
+	}
+
+	if (BlockCompressor::FORMAT_NONE == format)
+	{
+		return(true);
+	}
+
+	CACHE_HEADER compressedHeader = header;
+	compressedHeader.format = (uint32_t)format;
+	compressedHeader.quality = GetStoredQuality(format, quality);
+
+	std::vector<unsigned char> compressed(LayoutLevels(compressedHeader, width, height), 0);
+	for (int level = 0; level < levelCount; level++)
+	{
+		BlockCompressor::CompressImage(
+			format,
+			quality,
+			&m_built[header.levelOffsets[level]],
+			header.levelWidths[level],
+			header.levelHeights[level],
+			channels,
+			&compressed[compressedHeader.levelOffsets[level]]);
+	}
+	compressedHeader.psnr = (float)BlockCompressor::ComputePSNR(
+		format,
+		&m_built[header.levelOffsets[0]],
+		&compressed[compressedHeader.levelOffsets[0]],
+		width,
+		height,
+		channels);
+
+	memcpy(&compressed[0], &compressedHeader, sizeof(compressedHeader));
+	m_built.swap(compressed);
+
+	return(true);
+}
+
+/***********************************************************
+ *  AttachChain()
+ *
+ *  This method is used to check that the header, the level
+ *  sizes and the level offsets are consistent with the data
+ *  and with the source file, and to point the header at the
+ *  data without copying it.
+ ***********************************************************/
+bool TextureCache::AttachChain(
+	const unsigned char* pData,
+	size_t size,
+	int channels,
+	BlockCompressor::Format format,
+	BlockCompressor::Quality quality,
+	uint64_t sourceSize,
+	int64_t sourceModifiedTime)
+{
+	if ((NULL == pData) || (size < sizeof(CACHE_HEADER)))
+	{
+		return(false);
+	}
+
+	const CACHE_HEADER* pHeader = (const CACHE_HEADER*)pData;
+	if ((memcmp(pHeader->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) ||
+		(pHeader->version != CACHE_VERSION) ||
+		(pHeader->sourceSize != sourceSize) ||
+		(pHeader->sourceModifiedTime != sourceModifiedTime) ||
+		(pHeader->channels != (uint32_t)channels) ||
+		(pHeader->format != (uint32_t)format) ||
+		(pHeader->quality != GetStoredQuality(format, quality)) ||
+		(pHeader->totalBytes != size) ||
+		(pHeader->levelCount == 0) ||
+		(pHeader->levelCount > (uint32_t)MAX_LEVELS) ||
+		((int)pHeader->levelCount != GetFullLevelCount(pHeader->levelWidths[0], pHeader->levelHeights[0])))
+	{
+		return(false);
+	}
+
+	size_t levelEnd = sizeof(CACHE_HEADER);
+	for (uint32_t level = 0; level < pHeader->levelCount; level++)
+	{
+		uint32_t expectedWidth = std::max(pHeader->levelWidths[0] >> level, 1u);
+		uint32_t expectedHeight = std::max(pHeader->levelHeights[0] >> level, 1u);
+		uint64_t levelBytes = GetLevelSize(format, expectedWidth, expectedHeight, pHeader->channels);
+		if ((pHeader->levelWidths[level] != expectedWidth) ||
+			(pHeader->levelHeights[level] != expectedHeight) ||
+			(pHeader->levelOffsets[level] < levelEnd) ||
+			(pHeader->levelOffsets[level] > size) ||
+			(size - pHeader->levelOffsets[level] < levelBytes))
+		{
+			return(false);
+		}
+		levelEnd = (size_t)(pHeader->levelOffsets[level] + levelBytes);
+	}
+
+	m_pHeader = pHeader;
+	return(true);
+}
+
+/***********************************************************
+ *  WriteCache()
+ *
+ *  This method is used to write the built chain to a
+ *  temporary file that then replaces the cache file, so an
+ *  interrupted write never leaves a partial cache behind.
+ ***********************************************************/
+bool TextureCache::WriteCache(const std::string& cacheFilename) const
+{
+	const std::string temporaryFilename = cacheFilename + ".tmp";
+
+	FILE* file = fopen(temporaryFilename.c_str(), "wb");
+	if (NULL == file)
+	{
+		return(false);
+	}
+	bool bWritten = (fwrite(m_built.data(), 1, m_built.size(), file) == m_built.size());
+	bWritten = (fclose(file) == 0) && bWritten;
+
+	// rename() does not replace an existing file on every platform
+	remove(cacheFilename.c_str());
+	if ((bWritten == false) || (rename(temporaryFilename.c_str(), cacheFilename.c_str()) != 0))
+	{
+		remove(temporaryFilename.c_str());
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  LayoutLevels()
+ *
+ *  This method is used to size the levels of a full mip
+ *  chain and to place them one after the other, each on an
+ *  aligned offset after the header.
+ ***********************************************************/
+size_t TextureCache::LayoutLevels(CACHE_HEADER& header, int width, int height)
+{
+	size_t offset = AlignOffset(sizeof(CACHE_HEADER));
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		header.levelWidths[level] = (uint32_t)std::max(width >> level, 1);
+		header.levelHeights[level] = (uint32_t)std::max(height >> level, 1);
+		header.levelOffsets[level] = offset;
+		offset = AlignOffset(offset + (size_t)GetLevelSize(
+			(BlockCompressor::Format)header.format,
+			header.levelWidths[level],
+			header.levelHeights[level],
+			header.channels));
+	}
+	header.totalBytes = offset;
+
+	return(offset);
+}
+
+/***********************************************************
+ *  DownsampleLevel()
+ *
+ *  This method is used to filter a level into the next one
+ *  of half its size.  Every target pixel is the rounded
+ *  average of the 2x2 source pixels it covers - on an odd
+ *  side the last source row or column is used twice.
+ ***********************************************************/
+void TextureCache::DownsampleLevel(
+	const unsigned char* pSource,
+	int sourceWidth,
+	int sourceHeight,
+	unsigned char* pTarget,
+	int targetWidth,
+	int targetHeight,
+	int channels)
+{
+	const size_t sourceStride = (size_t)sourceWidth * channels;
+
+	for (int y = 0; y < targetHeight; y++)
+	{
+		const unsigned char* pRow0 = pSource + (size_t)std::min(y * 2, sourceHeight - 1) * sourceStride;
+		const unsigned char* pRow1 = pSource + (size_t)std::min(y * 2 + 1, sourceHeight - 1) * sourceStride;
+		unsigned char* pOut = pTarget + (size_t)y * targetWidth * channels;
+
+		for (int x = 0; x < targetWidth; x++)
+		{
+			const size_t column0 = (size_t)std::min(x * 2, sourceWidth - 1) * channels;
+			const size_t column1 = (size_t)std::min(x * 2 + 1, sourceWidth - 1) * channels;
+
+			for (int c = 0; c < channels; c++)
+			{
+				unsigned int sum = (unsigned int)pRow0[column0 + c] + pRow0[column1 + c] +
+					pRow1[column0 + c] + pRow1[column1 + c];
+				pOut[x * channels + c] = (unsigned char)((sum + 2) >> 2);
+			}
+		}
+	}
+}
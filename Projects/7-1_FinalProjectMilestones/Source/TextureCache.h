@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// load the mip chain of a texture image from its binary cache
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "BlockCompressor.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class contains the code for loading a texture image
+ *  together with its full chain of mipmap levels.  The first
+ *  load decodes the image file, builds the mip chain with a
+ *  box filter, optionally compresses every level into GPU
+ *  blocks and writes the whole chain next to the image as a
+ *  versioned binary cache.  As long as the image file
+ *  does not change, later loads map the cache and the levels
+ *  are uploaded straight from the mapping, without decoding.
+ *  The methods do not use OpenGL, so the images can be loaded
+ *  on any thread.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// version of the cache layout - increase it whenever the
+	// header or the filtering of the levels changes
+	static const uint32_t CACHE_VERSION = 2;
+	// enough levels for a 32768 pixel wide image
+	static const int MAX_LEVELS = 16;
+
+	// constructor
+	TextureCache();
+
+	// load the mip chain from the cache next to the image file if
+	// it is up to date, or decode the image with the given number
+	// of color channels and compress it into the given format -
+	// the cache is written when bUseCache is true - returns false
+	// if the image could not be loaded
+	bool Load(
+		const std::string& filename,
+		int channels,
+		BlockCompressor::Format format = BlockCompressor::FORMAT_NONE,
+		BlockCompressor::Quality quality = BlockCompressor::QUALITY_NORMAL,
+		bool bUseCache = true);
+	// release the loaded levels
+	void Clear();
+
+	// true if the last Load() read the cache instead of the image
+	bool IsFromCache() const { return m_bFromCache; }
+	// false if the last Load() decoded the image but could not
+	// write the cache
+	bool IsCacheWritten() const { return m_bCacheWritten; }
+
+	// the levels of the loaded mip chain, level 0 is the image -
+	// the rows are tightly packed, bottom row first, or the levels
+	// are rows of compressed blocks
+	int GetWidth() const { return GetLevelWidth(0); }
+	int GetHeight() const { return GetLevelHeight(0); }
+	int GetChannels() const;
+	BlockCompressor::Format GetFormat() const;
+	// PSNR in dB of the compressed image against the decoded one
+	double GetPSNR() const;
+	int GetLevelCount() const;
+	int GetLevelWidth(int level) const;
+	int GetLevelHeight(int level) const;
+	const unsigned char* GetLevelData(int level) const;
+	size_t GetLevelBytes(int level) const;
+	// the levels follow each other, with alignment padding, from
+	// GetLevelData(0) for GetChainBytes() bytes
+	size_t GetChainBytes() const;
+	// offset of a level from GetLevelData(0)
+	size_t GetLevelOffset(int level) const;
+
+	// name of the cache file of an image file
+	static std::string GetCacheFilename(const std::string& filename);
+	// number of levels of a full mip chain down to 1x1
+	static int GetFullLevelCount(int width, int height);
+
+private:
+	// start of the cache file - the levels follow it, each
+	// starting at the given offset from the file start
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		// size and modification time of the image file the cache
+		// was built from
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint32_t channels;
+		// BlockCompressor format and quality of the levels - the
+		// quality is 0 for uncompressed levels
+		uint32_t format;
+		uint32_t quality;
+		float psnr;
+		uint32_t levelCount;
+		uint32_t levelWidths[MAX_LEVELS];
+		uint32_t levelHeights[MAX_LEVELS];
+		uint64_t levelOffsets[MAX_LEVELS];
+		uint64_t totalBytes;
+	};
+
+	// the mapped cache, or the decoded chain when it was built
+	// from the image file - m_pHeader points into either
+	MappedFile m_mapping;
+	std::vector<unsigned char> m_built;
+	const CACHE_HEADER* m_pHeader;
+	bool m_bFromCache;
+	bool m_bCacheWritten;
+
+	// decode the image and build the mip chain into m_built
+	bool BuildChain(
+		const std::string& filename,
+		int channels,
+		BlockCompressor::Format format,
+		BlockCompressor::Quality quality,
+		uint64_t sourceSize,
+		int64_t sourceModifiedTime);
+	// check a cache and point the header at it - returns false if
+	// it is not a valid cache for the given source file
+	bool AttachChain(
+		const unsigned char* pData,
+		size_t size,
+		int channels,
+		BlockCompressor::Format format,
+		BlockCompressor::Quality quality,
+		uint64_t sourceSize,
+		int64_t sourceModifiedTime);
+	// write m_built to the cache file
+	bool WriteCache(const std::string& cacheFilename) const;
+
+	// fill in the level sizes and offsets of a header for the
+	// format and channels it holds - returns the total size
+	static size_t LayoutLevels(CACHE_HEADER& header, int width, int height);
+
+	// average each 2x2 block of a level into one pixel of the next
+	static void DownsampleLevel(
+		const unsigned char* pSource,
+		int sourceWidth,
+		int sourceHeight,
+		unsigned char* pTarget,
+		int targetWidth,
+		int targetHeight,
+		int channels);
+
+	// the mapping can not be shared between two objects
+	TextureCache(const TextureCache&);
+	TextureCache& operator=(const TextureCache&);
+};
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.cpp
+// ============
+// decode texture image files on a pool of worker threads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+
+#include <algorithm>
+
+// declaration of global variables
+namespace
+{
+	// the render thread keeps one core, and a few workers are
+	// enough to keep the uploads busy
+	const size_t MAX_WORKER_THREADS = 4;
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader()
+{
+	m_threadCount = 0;
+	m_bUseCache = true;
+	m_pendingCount = 0;
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Queue()
+ *
+ *  This method is used to add an image file to the queue of
+ *  images to decode.  The channels must be the color
+ *  channels of the file, so the decoded size is known ahead.
+ ***********************************************************/
+void TextureLoader::Queue(
+	int handle,
+	const std::string& filename,
+	int channels,
+	BlockCompressor::Format format,
+	BlockCompressor::Quality quality)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	DECODE_JOB job;
+	job.handle = handle;
+	job.filename = filename;
+	job.channels = channels;
+	job.format = format;
+	job.quality = quality;
+	m_jobs.push_back(job);
+	m_pendingCount++;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used to start one worker thread for every
+ *  free core, up to MAX_WORKER_THREADS and never more than
+ *  there are images to decode.
+ ***********************************************************/
+void TextureLoader::Start(bool bUseCache)
+{
+	m_bUseCache = bUseCache;
+
+	size_t jobCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		jobCount = m_jobs.size();
+	}
+
+	// hardware_concurrency() may return 0 when it is unknown
+	size_t cores = (size_t)std::thread::hardware_concurrency();
+	m_threadCount = std::min(std::min(std::max(cores, (size_t)2) - 1, MAX_WORKER_THREADS), jobCount);
+
+	for (size_t i = 0; i < m_threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureLoader::WorkerMain, this));
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used to drop the images that are still
+ *  queued, to wait for the worker threads to end and to free
+ *  the decoded images that were never picked up.
+ ***********************************************************/
+void TextureLoader::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingCount -= m_jobs.size();
+		m_jobs.clear();
+	}
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_decoded.size(); i++)
+	{
+		delete m_decoded[i].pTexture;
+	}
+	m_pendingCount -= m_decoded.size();
+	m_decoded.clear();
+}
+
+/***********************************************************
+ *  PopDecoded()
+ *
+ *  This method is used to take the oldest decoded image off
+ *  the queue, if there is one.  The caller owns the texture
+ *  and deletes it once it is uploaded.
+ ***********************************************************/
+bool TextureLoader::PopDecoded(DECODED_IMAGE& image)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_decoded.empty())
+	{
+		return(false);
+	}
+
+	image = m_decoded.front();
+	m_decoded.pop_front();
+	m_pendingCount--;
+	return(true);
+}
+
+/***********************************************************
+ *  WaitDecoded()
+ *
+ *  This method is used to take the oldest decoded image off
+ *  the queue, waiting for the workers if none is decoded yet.
+ ***********************************************************/
+bool TextureLoader::WaitDecoded(DECODED_IMAGE& image)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_decodedCondition.wait(lock, [this]() { return !m_decoded.empty() || (m_pendingCount == 0); });
+	if (m_decoded.empty())
+	{
+		return(false);
+	}
+
+	image = m_decoded.front();
+	m_decoded.pop_front();
+	m_pendingCount--;
+	return(true);
+}
+
+/***********************************************************
+ *  GetPendingCount()
+ *
+ *  This method is used to get the number of images that are
+ *  queued or decoded but not picked up yet.
+ ***********************************************************/
+size_t TextureLoader::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_pendingCount);
+}
+
+/***********************************************************
+ *  WorkerMain()
+ *
+ *  This method is run by every worker thread.  An image is
+ *  only decoded and compressed when its texture cache is
+ *  missing or out of date, in which case the cache is written
+ *  again - so the workers also compress the images in
+ *  parallel.
+ ***********************************************************/
+void TextureLoader::WorkerMain()
+{
+	for (;;)
+	{
+		DECODE_JOB job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_jobs.empty())
+			{
+				return;
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		DECODED_IMAGE image;
+		image.handle = job.handle;
+		image.filename = job.filename;
+		image.pTexture = new TextureCache();
+		if (image.pTexture->Load(job.filename, job.channels, job.format, job.quality, m_bUseCache) == false)
+		{
+			delete image.pTexture;
+			image.pTexture = NULL;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_decoded.push_back(image);
+		}
+		m_decodedCondition.notify_one();
+	}
+}
@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureloader.h
+// ============
+// decode texture image files on a pool of worker threads
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureCache.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class contains the code for decoding texture image
+ *  files in the background.  The images are queued with the
+ *  texture handle they belong to, decoded or read from their
+ *  texture cache by worker threads and picked up by the
+ *  render thread, which is the only one that talks to OpenGL.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// a decoded image with its mip chain, ready to be uploaded -
+	// pTexture is NULL when the file could not be decoded, the
+	// receiver deletes it after the upload
+	struct DECODED_IMAGE
+	{
+		int handle;
+		std::string filename;
+		TextureCache* pTexture;
+	};
+
+	// constructor
+	TextureLoader();
+	// destructor
+	~TextureLoader();
+
+	// queue an image file to be decoded with the given number
+	// of color channels and compressed into the given format
+	void Queue(
+		int handle,
+		const std::string& filename,
+		int channels,
+		BlockCompressor::Format format = BlockCompressor::FORMAT_NONE,
+		BlockCompressor::Quality quality = BlockCompressor::QUALITY_NORMAL);
+	// start the worker threads on the queued images, reading and
+	// writing the texture caches when bUseCache is true - the
+	// workers end once the queue is empty
+	void Start(bool bUseCache = true);
+	// wait for the worker threads and free the decoded images
+	// that were never picked up
+	void Stop();
+
+	// get the next decoded image without waiting - returns false
+	// if none is ready yet
+	bool PopDecoded(DECODED_IMAGE& image);
+	// get the next decoded image, waiting for one if needed -
+	// returns false when there are no more images to wait for
+	bool WaitDecoded(DECODED_IMAGE& image);
+
+	// images that were queued but not picked up yet
+	size_t GetPendingCount() const;
+	// number of worker threads of the last Start()
+	size_t GetThreadCount() const { return m_threadCount; }
+
+private:
+	struct DECODE_JOB
+	{
+		int handle;
+		std::string filename;
+		int channels;
+		BlockCompressor::Format format;
+		BlockCompressor::Quality quality;
+	};
+
+	std::vector<std::thread> m_workers;
+	size_t m_threadCount;
+	bool m_bUseCache;
+
+	// the queues are guarded by m_mutex, the render thread waits
+	// on m_decodedCondition for the workers
+	mutable std::mutex m_mutex;
+	std::condition_variable m_decodedCondition;
+	std::deque<DECODE_JOB> m_jobs;
+	std::deque<DECODED_IMAGE> m_decoded;
+	size_t m_pendingCount;
+
+	// decode queued images until the queue is empty
+	void WorkerMain();
+
+	// the worker threads can not be shared between two objects
+	TextureLoader(const TextureLoader&);
+	TextureLoader& operator=(const TextureLoader&);
+};
@@ -8,6 +8,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "GLStateCache.h"
 
 #ifdef _DEBUG
 #include "LiveTransformations/LiveTransformer.h"
@@ -26,6 +27,7 @@ namespace
 	const int WINDOW_HEIGHT = 800;
 	const char* g_ViewName = "view";
 	const char* g_ProjectionName = "projection";
+	const char* g_ViewPositionName = "viewPosition";
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -34,6 +36,9 @@ namespace
 	// these variables are used for mouse movement processing
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
+
+	// framebuffer height, kept up to date when the window is resized
+	int gFramebufferHeight = WINDOW_HEIGHT;
 	bool gFirstMouse = true;
 
 	// movement and mouse sensitivity sanity checks (experimentally derived)
@@ -71,6 +76,10 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_pHeadlessContext = NULL;
+	m_bUniformsResolved = false;
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(0.0f, 5.0f, 12.0f);
@@ -89,6 +98,11 @@ ViewManager::~ViewManager()
 	// free up allocated memory
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
+	if (NULL != m_pHeadlessContext)
+	{
+		delete m_pHeadlessContext;
+		m_pHeadlessContext = NULL;
+	}
 	if (NULL != g_pCamera)
 	{
 		delete g_pCamera;
@@ -119,18 +133,51 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	}
 	glfwMakeContextCurrent(window);
 
+	// the framebuffer can be larger than the window on high DPI
+	// displays, so its own size is tracked for the level of detail
+	int framebufferWidth = 0;
+	glfwGetFramebufferSize(window, &framebufferWidth, &gFramebufferHeight);
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Framebuffer_Size_Callback);
+
 	// tell GLFW to capture all mouse events
 	enableMouseInput(window);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// set the blending used for supporting tranparent rendering - the
+	// SceneManager only enables it for the transparent render pass
+	GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	m_pWindow = window;
 
 	return(window);
 }
 
+/***********************************************************
+ *  CreateHeadlessContext()
+ *
+ *  This method is used to create the offscreen context that
+ *  the frames are rendered with when there is no display
+ *  window.
+ ***********************************************************/
+bool ViewManager::CreateHeadlessContext()
+{
+	m_pHeadlessContext = new HeadlessContext();
+	if (m_pHeadlessContext->Create(WINDOW_WIDTH, WINDOW_HEIGHT) == false)
+	{
+		std::cout << "Failed to create the headless context" << std::endl;
+		delete m_pHeadlessContext;
+		m_pHeadlessContext = NULL;
+		return(false);
+	}
+
+	// the offscreen framebuffer is never resized
+	gFramebufferHeight = WINDOW_HEIGHT;
+
+	// the same blending as the display window
+	GLStateCache::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	return(true);
+}
+
 void ViewManager::enableMouseInput(GLFWwindow* window)
 {
 	// this callback is used to receive mouse moving events
@@ -183,6 +230,21 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	g_pCamera->ProcessMouseMovement(xOffset, yOffset);
 }
 
+/***********************************************************
+ *  Framebuffer_Size_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the framebuffer of the display window is resized.
+ ***********************************************************/
+void ViewManager::Framebuffer_Size_Callback(GLFWwindow* window, int width, int height)
+{
+	// a minimized window reports a zero size
+	if (height > 0)
+	{
+		gFramebufferHeight = height;
+	}
+}
+
 /***********************************************************
  *  Mouse_Scrollwheel_Callback()
  *
@@ -230,6 +292,12 @@ void ViewManager::Mouse_Scrollwheel_Callback(GLFWwindow* window, double xOffset,
  ***********************************************************/
 void ViewManager::ProcessKeyboardEvents()
 {
+	// there is no input without a display window
+	if (NULL == m_pWindow)
+	{
+		return;
+	}
+
 	// close the window if the escape key has been pressed
 	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 	{
@@ -321,9 +389,6 @@ void ViewManager::ProcessSceneNavigationKeyboardEvents() {
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
-	glm::mat4 view;
-	glm::mat4 projection;
-
 	// per-frame timing
 	float currentFrame = glfwGetTime();
 	gDeltaTime = currentFrame - gLastFrame;
@@ -333,6 +398,38 @@ void ViewManager::PrepareSceneView()
 	// event queue
 	ProcessKeyboardEvents();
 
+	ApplyCameraView();
+}
+
+/***********************************************************
+ *  PrepareSceneView()
+ *
+ *  This method is used for preparing the 3D scene view from
+ *  a camera that is placed by the caller, so the frames do
+ *  not depend on the input or on the time between them.
+ ***********************************************************/
+void ViewManager::PrepareSceneView(
+	const glm::vec3& cameraPosition,
+	const glm::vec3& cameraTarget)
+{
+	g_pCamera->Position = cameraPosition;
+	g_pCamera->Front = glm::normalize(cameraTarget - cameraPosition);
+
+	ApplyCameraView();
+}
+
+/***********************************************************
+ *  ApplyCameraView()
+ *
+ *  This method is used for calculating the view and the
+ *  projection of the camera and setting them into the
+ *  shader.
+ ***********************************************************/
+void ViewManager::ApplyCameraView()
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
 
@@ -361,14 +458,50 @@ void ViewManager::PrepareSceneView()
 				 0.1f, 100.0f);
 	}
 
+	// keep the matrices for the render passes of this frame
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+
 	// if the shader manager object is valid
 	if (NULL != m_pShaderManager)
 	{
+		// the shaders are loaded after this object is created, so
+		// the uniform handles are looked up on the first frame
+		if (!m_bUniformsResolved)
+		{
+			m_viewUniform = m_pShaderManager->GetUniformHandle<glm::mat4>(g_ViewName);
+			m_projectionUniform = m_pShaderManager->GetUniformHandle<glm::mat4>(g_ProjectionName);
+			m_viewPositionUniform = m_pShaderManager->GetUniformHandle<glm::vec3>(g_ViewPositionName);
+			m_bUniformsResolved = true;
+		}
+
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
+		m_pShaderManager->SetUniform(m_viewUniform, view);
 		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
+		m_pShaderManager->SetUniform(m_projectionUniform, projection);
 		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		m_pShaderManager->SetUniform(m_viewPositionUniform, g_pCamera->Position);
 	}
+}
+
+/***********************************************************
+ *  GetCameraPosition()
+ *
+ *  This method is used for getting the world position of
+ *  the camera that the scene is viewed from.
+ ***********************************************************/
+glm::vec3 ViewManager::GetCameraPosition() const
+{
+	return(g_pCamera->Position);
+}
+
+/***********************************************************
+ *  GetViewportHeight()
+ *
+ *  This method is used for getting the height in pixels of
+ *  the framebuffer that the scene is rendered into.
+ ***********************************************************/
+float ViewManager::GetViewportHeight() const
+{
+	return((float)gFramebufferHeight);
 }
\ No newline at end of file
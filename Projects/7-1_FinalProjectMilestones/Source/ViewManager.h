@@ -10,6 +10,7 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "HeadlessContext.h"
 #include "camera.h"
 
 // GLFW library
@@ -30,11 +31,30 @@ public:
 	// mouse scrollwheel callback for changing mouse sensitivity
 	static void Mouse_Scrollwheel_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// framebuffer size callback for tracking the window being resized
+	static void Framebuffer_Size_Callback(GLFWwindow* window, int width, int height);
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// offscreen context that is used instead of the window, or NULL
+	HeadlessContext* m_pHeadlessContext;
+
+	// precompiled handles for the per-frame view uniforms
+	ShaderManager::UniformHandle<glm::mat4> m_viewUniform;
+	ShaderManager::UniformHandle<glm::mat4> m_projectionUniform;
+	ShaderManager::UniformHandle<glm::vec3> m_viewPositionUniform;
+	bool m_bUniformsResolved;
+
+	// view and projection of the last prepared frame
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+
+	// calculate the projection and set the view of the camera
+	// into the shader
+	void ApplyCameraView();
 
 	// master handler for keyboard events
 	void ProcessKeyboardEvents();
@@ -49,9 +69,27 @@ private:
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+	// create an offscreen context of the window size instead of the
+	// display window - its framebuffer is created after GLEW is ready
+	bool CreateHeadlessContext();
+	// offscreen context, or NULL if a display window is used
+	HeadlessContext* GetHeadlessContext() const { return m_pHeadlessContext; }
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+	// prepare the scene view from a scripted camera, without any
+	// keyboard or mouse input
+	void PrepareSceneView(
+		const glm::vec3& cameraPosition,
+		const glm::vec3& cameraTarget);
+
+	// view and projection matrices of the last prepared frame
+	const glm::mat4& GetViewMatrix() const { return m_viewMatrix; }
+	const glm::mat4& GetProjectionMatrix() const { return m_projectionMatrix; }
+	// world position of the camera
+	glm::vec3 GetCameraPosition() const;
+	// height in pixels of the framebuffer that is rendered into
+	float GetViewportHeight() const;
 
 #ifdef _DEBUG
 	bool showTransformerUi = false;
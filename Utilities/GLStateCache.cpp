@@ -0,0 +1,446 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// skip the OpenGL state changes that would not change anything
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+// declaration of the global variables and defines
+namespace
+{
+	// value of a shadow copy that is not known, so the next
+	// call that sets it is always sent
+	const GLuint UNKNOWN_STATE = 0xFFFFFFFF;
+
+	// the texture units, targets, buffer targets and capabilities
+	// that are tracked - the others are always sent
+	const GLuint TRACKED_TEXTURE_UNITS = 32;
+	const GLenum TRACKED_TEXTURE_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY };
+	const GLenum TRACKED_BUFFER_TARGETS[] = {
+		GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+		GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_UNIFORM_BUFFER };
+	const GLenum TRACKED_CAPS[] = { GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST };
+
+	const int TEXTURE_TARGET_COUNT = sizeof(TRACKED_TEXTURE_TARGETS) / sizeof(TRACKED_TEXTURE_TARGETS[0]);
+	const int BUFFER_TARGET_COUNT = sizeof(TRACKED_BUFFER_TARGETS) / sizeof(TRACKED_BUFFER_TARGETS[0]);
+	const int CAP_COUNT = sizeof(TRACKED_CAPS) / sizeof(TRACKED_CAPS[0]);
+
+	// the shadow copy of the state of the current context
+	struct SHADOW_STATE
+	{
+		GLuint vao;
+		GLuint program;
+		GLenum activeTexture;
+		GLuint textures[TRACKED_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+		GLuint buffers[BUFFER_TARGET_COUNT];
+		GLuint caps[CAP_COUNT];
+		GLenum blendSourceFactor;
+		GLenum blendDestinationFactor;
+		GLenum depthFunc;
+		GLuint depthMask;
+		GLenum cullFace;
+	};
+
+	// shadow copy with every value unknown
+	SHADOW_STATE CreateUnknownState()
+	{
+		SHADOW_STATE state;
+
+		state.vao = UNKNOWN_STATE;
+		state.program = UNKNOWN_STATE;
+		state.activeTexture = UNKNOWN_STATE;
+		for (GLuint unit = 0; unit < TRACKED_TEXTURE_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				state.textures[unit][target] = UNKNOWN_STATE;
+			}
+		}
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			state.buffers[target] = UNKNOWN_STATE;
+		}
+		for (int cap = 0; cap < CAP_COUNT; cap++)
+		{
+			state.caps[cap] = UNKNOWN_STATE;
+		}
+		state.blendSourceFactor = UNKNOWN_STATE;
+		state.blendDestinationFactor = UNKNOWN_STATE;
+		state.depthFunc = UNKNOWN_STATE;
+		state.depthMask = UNKNOWN_STATE;
+		state.cullFace = UNKNOWN_STATE;
+
+		return(state);
+	}
+
+	SHADOW_STATE g_State = CreateUnknownState();
+
+	GLStateCache::STATE_STATS g_FrameStats = { 0, 0 };
+	GLStateCache::STATE_STATS g_LastFrameStats = { 0, 0 };
+
+	// compare the requested value against the shadow copy and
+	// store it - returns true if the call must be sent
+	inline bool UpdateShadow(GLuint& shadow, GLuint value)
+	{
+		if (shadow == value)
+		{
+			g_FrameStats.callsElided++;
+			return(false);
+		}
+
+		shadow = value;
+		g_FrameStats.callsIssued++;
+		return(true);
+	}
+
+	// index of a target in a table of tracked targets, -1 if
+	// the target is not tracked
+	int FindTarget(const GLenum* pTargets, int count, GLenum target)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (pTargets[i] == target)
+			{
+				return(i);
+			}
+		}
+		return(-1);
+	}
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used to forget the shadow copy of the
+ *  state, so that the next call of every kind is sent.
+ ***********************************************************/
+void GLStateCache::Reset()
+{
+	g_State = CreateUnknownState();
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used to bind a vertex array object.
+ ***********************************************************/
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (UpdateShadow(g_State.vao, vao))
+	{
+		glBindVertexArray(vao);
+	}
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used to make a shader program current.
+ ***********************************************************/
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (UpdateShadow(g_State.program, program))
+	{
+		glUseProgram(program);
+	}
+}
+
+/***********************************************************
+ *  ActiveTexture()
+ *
+ *  This method is used to select the texture unit that the
+ *  textures are bound to.
+ ***********************************************************/
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	if (UpdateShadow(g_State.activeTexture, unit))
+	{
+		glActiveTexture(unit);
+	}
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used to bind a texture to the active
+ *  texture unit.  When the active unit is not known, the
+ *  texture may replace any tracked binding of the target,
+ *  so those bindings are no longer known.
+ ***********************************************************/
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	int targetIndex = FindTarget(TRACKED_TEXTURE_TARGETS, TEXTURE_TARGET_COUNT, target);
+	GLuint unit = g_State.activeTexture - GL_TEXTURE0;
+
+	if ((targetIndex >= 0) && (g_State.activeTexture != UNKNOWN_STATE) && (unit < TRACKED_TEXTURE_UNITS))
+	{
+		if (UpdateShadow(g_State.textures[unit][targetIndex], texture))
+		{
+			glBindTexture(target, texture);
+		}
+		return;
+	}
+
+	if ((targetIndex >= 0) && (g_State.activeTexture == UNKNOWN_STATE))
+	{
+		for (unit = 0; unit < TRACKED_TEXTURE_UNITS; unit++)
+		{
+			g_State.textures[unit][targetIndex] = UNKNOWN_STATE;
+		}
+	}
+
+	g_FrameStats.callsIssued++;
+	glBindTexture(target, texture);
+}
+
+/***********************************************************
+ *  BindBuffer()
+ *
+ *  This method is used to bind a buffer to a target.
+ ***********************************************************/
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	int targetIndex = FindTarget(TRACKED_BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+
+	if (targetIndex < 0)
+	{
+		g_FrameStats.callsIssued++;
+		glBindBuffer(target, buffer);
+	}
+	else if (UpdateShadow(g_State.buffers[targetIndex], buffer))
+	{
+		glBindBuffer(target, buffer);
+	}
+}
+
+/***********************************************************
+ *  BindBufferBase()
+ *
+ *  This method is used to bind a buffer to an indexed
+ *  binding point.  The indexed bindings are not tracked,
+ *  so the call is always sent.
+ ***********************************************************/
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	int targetIndex = FindTarget(TRACKED_BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+
+	if (targetIndex >= 0)
+	{
+		g_State.buffers[targetIndex] = buffer;
+	}
+
+	g_FrameStats.callsIssued++;
+	glBindBufferBase(target, index, buffer);
+}
+
+/***********************************************************
+ *  BindBufferRange()
+ *
+ *  This method is used to bind a range of a buffer to an
+ *  indexed binding point.  Like BindBufferBase(), the call
+ *  is always sent.
+ ***********************************************************/
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	int targetIndex = FindTarget(TRACKED_BUFFER_TARGETS, BUFFER_TARGET_COUNT, target);
+
+	if (targetIndex >= 0)
+	{
+		g_State.buffers[targetIndex] = buffer;
+	}
+
+	g_FrameStats.callsIssued++;
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+/***********************************************************
+ *  Enable()
+ *
+ *  This method is used to enable a capability.
+ ***********************************************************/
+void GLStateCache::Enable(GLenum cap)
+{
+	int capIndex = FindTarget(TRACKED_CAPS, CAP_COUNT, cap);
+
+	if (capIndex < 0)
+	{
+		g_FrameStats.callsIssued++;
+		glEnable(cap);
+	}
+	else if (UpdateShadow(g_State.caps[capIndex], GL_TRUE))
+	{
+		glEnable(cap);
+	}
+}
+
+/***********************************************************
+ *  Disable()
+ *
+ *  This method is used to disable a capability.
+ ***********************************************************/
+void GLStateCache::Disable(GLenum cap)
+{
+	int capIndex = FindTarget(TRACKED_CAPS, CAP_COUNT, cap);
+
+	if (capIndex < 0)
+	{
+		g_FrameStats.callsIssued++;
+		glDisable(cap);
+	}
+	else if (UpdateShadow(g_State.caps[capIndex], GL_FALSE))
+	{
+		glDisable(cap);
+	}
+}
+
+/***********************************************************
+ *  BlendFunc()
+ *
+ *  This method is used to set the blending factors.
+ ***********************************************************/
+void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	if ((g_State.blendSourceFactor == sourceFactor) &&
+		(g_State.blendDestinationFactor == destinationFactor))
+	{
+		g_FrameStats.callsElided++;
+		return;
+	}
+
+	g_State.blendSourceFactor = sourceFactor;
+	g_State.blendDestinationFactor = destinationFactor;
+	g_FrameStats.callsIssued++;
+	glBlendFunc(sourceFactor, destinationFactor);
+}
+
+/***********************************************************
+ *  DepthFunc()
+ *
+ *  This method is used to set the depth comparison.
+ ***********************************************************/
+void GLStateCache::DepthFunc(GLenum func)
+{
+	if (UpdateShadow(g_State.depthFunc, func))
+	{
+		glDepthFunc(func);
+	}
+}
+
+/***********************************************************
+ *  DepthMask()
+ *
+ *  This method is used to enable or disable the writes to
+ *  the depth buffer.
+ ***********************************************************/
+void GLStateCache::DepthMask(GLboolean flag)
+{
+	if (UpdateShadow(g_State.depthMask, flag))
+	{
+		glDepthMask(flag);
+	}
+}
+
+/***********************************************************
+ *  CullFace()
+ *
+ *  This method is used to select the faces that are culled.
+ ***********************************************************/
+void GLStateCache::CullFace(GLenum mode)
+{
+	if (UpdateShadow(g_State.cullFace, mode))
+	{
+		glCullFace(mode);
+	}
+}
+
+/***********************************************************
+ *  DeleteVertexArrays()
+ *
+ *  This method is used to delete vertex array objects - a
+ *  deleted VAO that is bound leaves VAO 0 bound.
+ ***********************************************************/
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint* pArrays)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if ((pArrays[i] != 0) && (g_State.vao == pArrays[i]))
+		{
+			g_State.vao = 0;
+		}
+	}
+
+	glDeleteVertexArrays(count, pArrays);
+}
+
+/***********************************************************
+ *  DeleteBuffers()
+ *
+ *  This method is used to delete buffers - a deleted
+ *  buffer is unbound from every target it is bound to.
+ ***********************************************************/
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint* pBuffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		for (int target = 0; target < BUFFER_TARGET_COUNT; target++)
+		{
+			if ((pBuffers[i] != 0) && (g_State.buffers[target] == pBuffers[i]))
+			{
+				g_State.buffers[target] = 0;
+			}
+		}
+	}
+
+	glDeleteBuffers(count, pBuffers);
+}
+
+/***********************************************************
+ *  DeleteTextures()
+ *
+ *  This method is used to delete textures - a deleted
+ *  texture is unbound from every texture unit.
+ ***********************************************************/
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint* pTextures)
+{
+	for (GLsizei i = 0; i < count; i++)
+	{
+		for (GLuint unit = 0; unit < TRACKED_TEXTURE_UNITS; unit++)
+		{
+			for (int target = 0; target < TEXTURE_TARGET_COUNT; target++)
+			{
+				if ((pTextures[i] != 0) && (g_State.textures[unit][target] == pTextures[i]))
+				{
+					g_State.textures[unit][target] = 0;
+				}
+			}
+		}
+	}
+
+	glDeleteTextures(count, pTextures);
+}
+
+/***********************************************************
+ *  BeginFrameStats()
+ *
+ *  This method is used to start a new frame of call
+ *  counters.
+ ***********************************************************/
+void GLStateCache::BeginFrameStats()
+{
+	g_LastFrameStats = g_FrameStats;
+	g_FrameStats.callsIssued = 0;
+	g_FrameStats.callsElided = 0;
+}
+
+/***********************************************************
+ *  GetLastFrameStats()
+ *
+ *  This method is used to get the call counters of the
+ *  last completed frame.
+ ***********************************************************/
+GLStateCache::STATE_STATS GLStateCache::GetLastFrameStats()
+{
+	return(g_LastFrameStats);
+}
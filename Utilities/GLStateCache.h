@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// skip the OpenGL state changes that would not change anything
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class contains the code for changing the bound VAO,
+ *  program, textures and buffers, and the blend, depth and
+ *  cull state, through a shadow copy of the state of the
+ *  current context.  A call that requests the state the
+ *  shadow copy already holds is not sent to OpenGL.  The
+ *  state belongs to the context and not to an object, so
+ *  the methods are static - all the rendering code must go
+ *  through them, or call Reset() after changing the state
+ *  itself.  The issued and the elided calls are counted
+ *  per frame.
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// state call counters, gathered over one frame
+	struct STATE_STATS
+	{
+		unsigned int callsIssued;
+		unsigned int callsElided;
+	};
+
+	// forget the shadow copy, so that the next call of every
+	// kind is sent to OpenGL - call this after a context is
+	// made current or after code outside the cache changed state
+	static void Reset();
+
+	static void BindVertexArray(GLuint vao);
+	static void UseProgram(GLuint program);
+	static void ActiveTexture(GLenum unit);
+	// binds to the active texture unit - only the 2D and 2D
+	// array targets of the first units are tracked
+	static void BindTexture(GLenum target, GLuint texture);
+	// the element array buffer belongs to the bound VAO, so
+	// its binding is always sent
+	static void BindBuffer(GLenum target, GLuint buffer);
+	// binds the indexed binding point, which also binds the
+	// buffer to the general target
+	static void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	// only blending, depth testing and face culling are tracked
+	static void Enable(GLenum cap);
+	static void Disable(GLenum cap);
+	static void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	static void DepthFunc(GLenum func);
+	static void DepthMask(GLboolean flag);
+	static void CullFace(GLenum mode);
+
+	// delete the objects, dropping their bindings from the
+	// shadow copy like OpenGL does
+	static void DeleteVertexArrays(GLsizei count, const GLuint* pArrays);
+	static void DeleteBuffers(GLsizei count, const GLuint* pBuffers);
+	static void DeleteTextures(GLsizei count, const GLuint* pTextures);
+
+	// start a new frame of call counters - the counters of the
+	// frame that just ended are kept for GetLastFrameStats()
+	static void BeginFrameStats();
+	// call counters of the last completed frame
+	static STATE_STATS GetLastFrameStats();
+};
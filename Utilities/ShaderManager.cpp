@@ -5,6 +5,7 @@
 #include <fstream>
 #include <algorithm>
 #include <sstream>
+#include <chrono>
 using namespace std;
 
 #include <stdlib.h>
@@ -14,17 +15,71 @@ using namespace std;
 
 #include "ShaderManager.h"
 
+namespace
+{
+	// extension of the program cache files next to the vertex shader,
+	// which follows the feature mask of the variant
+	const char* PROGRAM_CACHE_EXTENSION = ".programcache";
+
+	// milliseconds since the given start time
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return(std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count());
+	}
+
+	// fold a block of bytes into a 64-bit FNV-1a hash
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+		return(hash);
+	}
+
+	// fold a string and its terminator into the hash, so that the
+	// boundaries between the strings are part of the key
+	uint64_t HashString(uint64_t hash, const char* pText)
+	{
+		if (NULL == pText)
+		{
+			pText = "";
+		}
+		return(HashBytes(hash, pText, strlen(pText) + 1));
+	}
+}
+
+/***********************************************************
+ *  ShaderManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderManager::ShaderManager()
+{
+	m_programID = 0;
+	m_bUseProgramCache = true;
+	m_pCurrentVariant = NULL;
+
+	for (int i = 0; i < VARIANT_COUNT; i++)
+	{
+		m_variants[i].featureMask = (unsigned int)i;
+		m_variants[i].programID = 0;
+	}
+}
+
 /***********************************************************
  *  LoadShaders()
  *
  *  This method is called to load the shader data from 
- *  external GLSL compatible files.
+ *  external GLSL compatible files.  The sources are kept so
+ *  the variants for the other feature masks can be compiled
+ *  when they are first used, and the variant without any
+ *  features is compiled and made current.
  ***********************************************************/
-GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path, bool bUseProgramCache){
 
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
@@ -50,12 +105,156 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 		FragmentShaderStream.close();
 	}
 
+	m_vertexFilename = vertex_file_path;
+	m_fragmentFilename = fragment_file_path;
+	m_vertexCode = VertexShaderCode;
+	m_fragmentCode = FragmentShaderCode;
+
+	// the driver must support at least one binary format to cache
+	// the programs - otherwise they are always compiled from source
+	m_bUseProgramCache = false;
+	if ((bUseProgramCache == true) && (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+	{
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		if (formatCount > 0)
+		{
+			m_bUseProgramCache = true;
+		}
+		else
+		{
+			printf("The driver has no program binary formats, the shader programs are not cached\n");
+		}
+	}
+
+	UseVariant(0);
+
+	return m_programID;
+}
+
+/***********************************************************
+ *  SwitchVariant()
+ *
+ *  This method is called by UseVariant() when the variant
+ *  changes.  Uniforms are only uploaded to the current
+ *  variant when they are set, so the values that changed
+ *  while the variant was not current are uploaded now.
+ ***********************************************************/
+void ShaderManager::SwitchVariant(unsigned int featureMask)
+{
+	SHADER_VARIANT& variant = m_variants[featureMask & (VARIANT_COUNT - 1)];
+
+	if (variant.programID == 0)
+	{
+		CompileVariant(variant);
+	}
+
+	m_pCurrentVariant = &variant;
+	m_programID = variant.programID;
+	GLStateCache::UseProgram(m_programID);
+	m_frameStats.variantSwitches++;
+
+	for (size_t i = 0; i < m_uniforms.size(); i++)
+	{
+		const UNIFORM_INFO& uniform = m_uniforms[i];
+
+		if ((variant.locations[i] >= 0) &&
+			(uniform.bShadowValid == true) &&
+			(variant.uploadedVersions[i] != uniform.version))
+		{
+			UploadShadow(variant.locations[i], uniform);
+			variant.uploadedVersions[i] = uniform.version;
+			m_frameStats.uploadsIssued++;
+		}
+	}
+}
+
+/***********************************************************
+ *  CompileVariant()
+ *
+ *  This method is used to compile and link the variant of
+ *  one feature mask, or to restore it from its program
+ *  cache, and to reflect its active uniforms.
+ ***********************************************************/
+void ShaderManager::CompileVariant(SHADER_VARIANT& variant)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::string VertexShaderCode = AddFeatureDefines(m_vertexCode, variant.featureMask);
+	std::string FragmentShaderCode = AddFeatureDefines(m_fragmentCode, variant.featureMask);
+
+	// every variant has its own cache file
+	char CacheSuffix[32];
+	snprintf(CacheSuffix, sizeof(CacheSuffix), ".%02x%s", variant.featureMask, PROGRAM_CACHE_EXTENSION);
+	std::string CacheFilename = m_vertexFilename + CacheSuffix;
+	uint64_t CacheKey = 0;
+
+	variant.programID = 0;
+	if (m_bUseProgramCache == true)
+	{
+		CacheKey = HashProgramSources(VertexShaderCode, FragmentShaderCode);
+
+		variant.programID = LoadProgramBinary(CacheFilename, CacheKey);
+		if (variant.programID != 0)
+		{
+			printf("Shader program cache hit, loaded %s in %.2f ms\n",
+				CacheFilename.c_str(), ElapsedMilliseconds(start));
+		}
+		else
+		{
+			printf("Shader program cache miss for variant 0x%02x, compiling from source\n", variant.featureMask);
+		}
+	}
+
+	if (variant.programID == 0)
+	{
+		char Description[32];
+		snprintf(Description, sizeof(Description), "variant 0x%02x", variant.featureMask);
+
+		variant.programID = BuildProgram(VertexShaderCode, FragmentShaderCode, Description);
+		printf("Compiled and linked shader %s in %.2f ms\n", Description, ElapsedMilliseconds(start));
+
+		// only a program that linked is worth caching
+		GLint LinkStatus = GL_FALSE;
+		glGetProgramiv(variant.programID, GL_LINK_STATUS, &LinkStatus);
+		if ((m_bUseProgramCache == true) && (LinkStatus == GL_TRUE))
+		{
+			if (SaveProgramBinary(CacheFilename, CacheKey, variant.programID) == true)
+			{
+				printf("Saved the shader program binary to %s\n", CacheFilename.c_str());
+			}
+			else
+			{
+				printf("Could not save the shader program binary to %s\n", CacheFilename.c_str());
+			}
+		}
+	}
+
+	// enumerate the active uniforms so callers can use precompiled handles
+	ReflectActiveUniforms(variant);
+}
+
+/***********************************************************
+ *  BuildProgram()
+ *
+ *  This method is used to compile the vertex and fragment
+ *  shader sources and link them into a new program.
+ ***********************************************************/
+GLuint ShaderManager::BuildProgram(
+	const std::string& VertexShaderCode,
+	const std::string& FragmentShaderCode,
+	const std::string& Description){
+
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
 
 	// Compile Vertex Shader
-	printf("Compiling shader : %s...", vertex_file_path);
+	printf("Compiling shader : %s (%s)...", m_vertexFilename.c_str(), Description.c_str());
 	char const * VertexSourcePointer = VertexShaderCode.c_str();
 	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
 	glCompileShader(VertexShaderID);
@@ -72,7 +271,7 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	printf("success\n");
 
 	// Compile Fragment Shader
-	printf("Compiling shader : %s...", fragment_file_path);
+	printf("Compiling shader : %s (%s)...", m_fragmentFilename.c_str(), Description.c_str());
 	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
 	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
 	glCompileShader(FragmentShaderID);
@@ -91,9 +290,13 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	// Link the program
 	printf("Linking shader program...");
 	GLuint ProgramID = glCreateProgram();
-	m_programID = ProgramID;
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	if (m_bUseProgramCache == true)
+	{
+		// ask the driver to keep the binary so it can be cached
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -106,7 +309,7 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	}
 
 	printf("success\n");
-	
+
 	glDetachShader(ProgramID, VertexShaderID);
 	glDetachShader(ProgramID, FragmentShaderID);
 	
@@ -116,4 +319,386 @@ GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fra
 	return ProgramID;
 }
 
+/***********************************************************
+ *  AddFeatureDefines()
+ *
+ *  This method is used to insert the #define of every
+ *  feature in the mask right after the version line of a
+ *  shader source, where the version line has to stay first.
+ ***********************************************************/
+std::string ShaderManager::AddFeatureDefines(const std::string& code, unsigned int featureMask)
+{
+	static const char* FeatureDefines[FEATURE_COUNT] = {
+		"USE_TEXTURE",
+		"USE_TEXTURE_OVERLAY",
+		"USE_LIGHTING",
+		"USE_INSTANCING",
+		"USE_MULTI_DRAW" };
+
+	std::string defines;
+	for (int feature = 0; feature < FEATURE_COUNT; feature++)
+	{
+		if ((featureMask & (1u << feature)) != 0)
+		{
+			defines += std::string("#define ") + FeatureDefines[feature] + "\n";
+		}
+	}
+
+	size_t insertAt = 0;
+	if (code.compare(0, 8, "#version") == 0)
+	{
+		insertAt = code.find('\n');
+		insertAt = (insertAt == std::string::npos) ? code.length() : insertAt + 1;
+	}
+
+	std::string result = code;
+	result.insert(insertAt, defines);
+	return(result);
+}
+
+/***********************************************************
+ *  ReflectActiveUniforms()
+ *
+ *  This method is called after linking to enumerate all of
+ *  the active uniforms in the variant, so that their
+ *  locations are only queried once and uploads can be
+ *  tracked.
+ ***********************************************************/
+void ShaderManager::ReflectActiveUniforms(SHADER_VARIANT& variant)
+{
+	GLuint programID = variant.programID;
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+
+	variant.locations.assign(m_uniforms.size(), -1);
+	variant.uploadedVersions.assign(m_uniforms.size(), 0);
+
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	int activeCount = 0;
+
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = GL_NONE;
+
+		glGetActiveUniform(programID, (GLuint)i, maxNameLength, &nameLength, &arraySize, &type, &nameBuffer[0]);
+		std::string name(&nameBuffer[0], nameLength);
 
+		// arrays are reported once as "name[0]" - register every
+		// element, plus the bare name which aliases element 0.  The
+		// alias shares the table entry of element 0, so an upload
+		// through either name updates the same shadow copy
+		size_t suffix = name.rfind("[0]");
+		if ((suffix != std::string::npos) && (suffix + 3 == name.length()))
+		{
+			std::string baseName = name.substr(0, suffix);
+			int baseIndex = FindUniform(baseName);
+			if ((baseIndex >= 0) && (FindUniform(name) < 0))
+			{
+				// a handle was resolved for the bare name before any
+				// variant used the array
+				m_uniformIndices[name] = baseIndex;
+			}
+
+			for (GLint element = 0; element < arraySize; element++)
+			{
+				RegisterUniform(variant, baseName + "[" + std::to_string(element) + "]", type);
+			}
+
+			int firstIndex = FindUniform(name);
+			if ((baseIndex < 0) && (firstIndex >= 0))
+			{
+				m_uniformIndices[baseName] = firstIndex;
+			}
+		}
+		else
+		{
+			RegisterUniform(variant, name, type);
+		}
+	}
+
+	for (size_t i = 0; i < variant.locations.size(); i++)
+	{
+		if (variant.locations[i] >= 0)
+		{
+			activeCount++;
+		}
+	}
+
+	printf("Reflected %d active uniforms\n", activeCount);
+}
+
+/***********************************************************
+ *  RegisterUniform()
+ *
+ *  This method is used to add the location of one uniform
+ *  to the variant, and the uniform to the table if no other
+ *  variant uses it yet.  Uniforms that live in a uniform
+ *  block have no location and are skipped.
+ ***********************************************************/
+void ShaderManager::RegisterUniform(SHADER_VARIANT& variant, const std::string& name, GLenum type)
+{
+	GLint location = glGetUniformLocation(variant.programID, name.c_str());
+	if (location < 0)
+	{
+		return;
+	}
+
+	int index = FindUniform(name);
+	if (index < 0)
+	{
+		index = AddUniform(name, type);
+	}
+	else if (m_uniforms[index].type == GL_NONE)
+	{
+		m_uniforms[index].type = type;
+	}
+
+	variant.locations[index] = location;
+}
+
+/***********************************************************
+ *  AddUniform()
+ *
+ *  This method is used to add a uniform to the table.  The
+ *  compiled variants get an entry for it as well, which
+ *  marks it as not active in them.
+ ***********************************************************/
+int ShaderManager::AddUniform(const std::string& name, GLenum type)
+{
+	UNIFORM_INFO uniform;
+	uniform.name = name;
+	uniform.type = type;
+	uniform.bShadowValid = false;
+	uniform.version = 0;
+	memset(uniform.shadow, 0, sizeof(uniform.shadow));
+
+	int index = (int)m_uniforms.size();
+	m_uniformIndices[name] = index;
+	m_uniforms.push_back(uniform);
+
+	for (int i = 0; i < VARIANT_COUNT; i++)
+	{
+		if (m_variants[i].programID != 0)
+		{
+			m_variants[i].locations.push_back(-1);
+			m_variants[i].uploadedVersions.push_back(0);
+		}
+	}
+
+	return(index);
+}
+
+/***********************************************************
+ *  UploadShadow()
+ *
+ *  This method is used to upload the shadow copy of a
+ *  uniform to the current program, with the call that
+ *  matches its reflected GLSL type.
+ ***********************************************************/
+void ShaderManager::UploadShadow(GLint location, const UNIFORM_INFO& uniform)
+{
+	const float* pValue = uniform.shadow;
+
+	switch (uniform.type)
+	{
+	case GL_FLOAT:
+		glUniform1f(location, pValue[0]);
+		break;
+	case GL_FLOAT_VEC2:
+		glUniform2fv(location, 1, pValue);
+		break;
+	case GL_FLOAT_VEC3:
+		glUniform3fv(location, 1, pValue);
+		break;
+	case GL_FLOAT_VEC4:
+		glUniform4fv(location, 1, pValue);
+		break;
+	case GL_FLOAT_MAT2:
+		glUniformMatrix2fv(location, 1, GL_FALSE, pValue);
+		break;
+	case GL_FLOAT_MAT3:
+		glUniformMatrix3fv(location, 1, GL_FALSE, pValue);
+		break;
+	case GL_FLOAT_MAT4:
+		glUniformMatrix4fv(location, 1, GL_FALSE, pValue);
+		break;
+	default:
+		// booleans, integers and samplers are stored as an int
+		int intValue;
+		memcpy(&intValue, pValue, sizeof(intValue));
+		glUniform1i(location, intValue);
+		break;
+	}
+}
+
+/***********************************************************
+ *  GetCompiledVariantCount()
+ *
+ *  This method is used to get the number of variants that
+ *  have been compiled since the shaders were loaded.
+ ***********************************************************/
+int ShaderManager::GetCompiledVariantCount() const
+{
+	int count = 0;
+	for (int i = 0; i < VARIANT_COUNT; i++)
+	{
+		if (m_variants[i].programID != 0)
+		{
+			count++;
+		}
+	}
+	return(count);
+}
+
+/***********************************************************
+ *  BeginFrameStats()
+ *
+ *  This method is called once at the start of every frame to
+ *  keep the upload and variant switch counters of the finished
+ *  frame and reset the counters for the new one.
+ ***********************************************************/
+void ShaderManager::BeginFrameStats()
+{
+	m_lastFrameStats = m_frameStats;
+	m_frameStats.uploadsIssued = 0;
+	m_frameStats.uploadsSkipped = 0;
+	m_frameStats.variantSwitches = 0;
+}
+
+/***********************************************************
+ *  HashProgramSources()
+ *
+ *  This method is used to compute the key of the program
+ *  cache.  A binary is only valid for the driver that
+ *  produced it, so the vendor, renderer and version strings
+ *  are hashed together with the shader sources.
+ ***********************************************************/
+uint64_t ShaderManager::HashProgramSources(
+	const std::string& vertexCode,
+	const std::string& fragmentCode)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	hash = HashString(hash, vertexCode.c_str());
+	hash = HashString(hash, fragmentCode.c_str());
+	hash = HashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = HashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = HashString(hash, (const char*)glGetString(GL_VERSION));
+
+	return(hash);
+}
+
+/***********************************************************
+ *  LoadProgramBinary()
+ *
+ *  This method is used to create the shader program from
+ *  the binary in the cache file.  The driver may still
+ *  reject a binary with a matching key, for example after
+ *  an update that kept the version string, in which case
+ *  the program is deleted and 0 is returned.
+ ***********************************************************/
+GLuint ShaderManager::LoadProgramBinary(const std::string& cacheFilename, uint64_t key)
+{
+	std::ifstream cacheStream(cacheFilename.c_str(), std::ios::in | std::ios::binary);
+	if (!cacheStream.is_open())
+	{
+		return(0);
+	}
+
+	PROGRAM_CACHE_HEADER header;
+	if (!cacheStream.read((char*)&header, sizeof(header)) ||
+		(memcmp(header.magic, "PRGC", 4) != 0) ||
+		(header.version != PROGRAM_CACHE_VERSION) ||
+		(header.key != key) ||
+		(header.binaryLength == 0))
+	{
+		return(0);
+	}
+
+	std::vector<char> binary(header.binaryLength);
+	if (!cacheStream.read(&binary[0], binary.size()))
+	{
+		return(0);
+	}
+
+	GLuint programID = glCreateProgram();
+	glProgramBinary(programID, (GLenum)header.binaryFormat, &binary[0], (GLsizei)binary.size());
+
+	GLint linkStatus = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus != GL_TRUE)
+	{
+		printf("The driver rejected the cached shader program binary\n");
+		glDeleteProgram(programID);
+		return(0);
+	}
+
+	return(programID);
+}
+
+/***********************************************************
+ *  SaveProgramBinary()
+ *
+ *  This method is used to write the binary of the linked
+ *  program to the cache file.  The binary is written to a
+ *  temporary file first and then renamed, so an interrupted
+ *  write never leaves a partial cache behind.
+ ***********************************************************/
+bool ShaderManager::SaveProgramBinary(const std::string& cacheFilename, uint64_t key, GLuint programID)
+{
+	GLint binaryLength = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+	{
+		return(false);
+	}
+
+	std::vector<char> binary(binaryLength);
+	GLenum binaryFormat = GL_NONE;
+	GLsizei writtenLength = 0;
+	glGetProgramBinary(programID, binaryLength, &writtenLength, &binaryFormat, &binary[0]);
+	if (writtenLength <= 0)
+	{
+		return(false);
+	}
+
+	PROGRAM_CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "PRGC", 4);
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = (uint32_t)binaryFormat;
+	header.binaryLength = (uint32_t)writtenLength;
+
+	std::string tempFilename = cacheFilename + ".tmp";
+	{
+		std::ofstream cacheStream(tempFilename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!cacheStream.is_open())
+		{
+			return(false);
+		}
+		cacheStream.write((const char*)&header, sizeof(header));
+		cacheStream.write(&binary[0], writtenLength);
+		if (!cacheStream.good())
+		{
+			cacheStream.close();
+			remove(tempFilename.c_str());
+			return(false);
+		}
+	}
+
+	// rename() does not replace an existing file on Windows
+	remove(cacheFilename.c_str());
+	if (rename(tempFilename.c_str(), cacheFilename.c_str()) != 0)
+	{
+		remove(tempFilename.c_str());
+		return(false);
+	}
+
+	return(true);
+}
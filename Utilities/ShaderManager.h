@@ -2,11 +2,17 @@
 
 #include <GL/glew.h>        // GLEW library
 
+#include "GLStateCache.h"
+
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -14,90 +20,396 @@
 class ShaderManager
 {
 public:
+	// features a shader variant is specialised for - every set bit
+	// adds its #define after the version line of both shaders, so
+	// the compiled variant carries no branches on these features
+	enum ShaderFeature
+	{
+		FEATURE_TEXTURE = 1 << 0,          // USE_TEXTURE
+		FEATURE_TEXTURE_OVERLAY = 1 << 1,  // USE_TEXTURE_OVERLAY
+		FEATURE_LIGHTING = 1 << 2,         // USE_LIGHTING
+		FEATURE_INSTANCING = 1 << 3,       // USE_INSTANCING
+		FEATURE_MULTI_DRAW = 1 << 4        // USE_MULTI_DRAW
+	};
+	// number of feature bits, and of possible variants
+	static const int FEATURE_COUNT = 5;
+	static const int VARIANT_COUNT = 1 << FEATURE_COUNT;
+
+	// reflected information about one uniform that is active in
+	// at least one variant, along with a CPU shadow copy of the
+	// last value that was set - the version counts the changes,
+	// so every variant can tell whether it holds the last value
+	struct UNIFORM_INFO
+	{
+		std::string name;
+		GLenum type;
+		bool bShadowValid;
+		unsigned int version;
+		float shadow[16];
+	};
+
+	// uniform upload counters, gathered over one frame
+	struct UNIFORM_STATS
+	{
+		unsigned int uploadsIssued;
+		unsigned int uploadsSkipped;
+		unsigned int variantSwitches;
+	};
+
+	// typed handle to a reflected uniform - resolve it once with
+	// GetUniformHandle() and then use it with SetUniform() so no
+	// string building or name lookup happens per draw
+	template <typename T>
+	struct UniformHandle
+	{
+		int index = -1;
+
+		bool IsValid() const { return index >= 0; }
+	};
+
+	// program of the current variant
 	unsigned int m_programID;
-	
+
+	// constructor
+	ShaderManager();
+
+	// read the shader sources and compile the variant without any
+	// features - every variant is compiled and linked, or restored
+	// from the binary cache next to the vertex shader when it was
+	// saved from the same sources by the same driver
 	GLuint LoadShaders(
-		const char* vertex_file_path, 
-		const char* fragment_file_path);
+		const char* vertex_file_path,
+		const char* fragment_file_path,
+		bool bUseProgramCache = true);
 
 	// activate the shader
 	// ------------------------------------------------------------------------
 	inline void use()
 	{
-		glUseProgram(m_programID);
+		GLStateCache::UseProgram(m_programID);
 	}
 
-	// utility uniform functions
+	// make the variant for a mask of ShaderFeature bits current,
+	// compiling it the first time it is used - the uniforms that
+	// changed since the variant was last current are uploaded
 	// ------------------------------------------------------------------------
-	inline void setBoolValue(const std::string &name, bool value) const
+	inline void UseVariant(unsigned int featureMask)
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), (int)value);
+		if ((NULL == m_pCurrentVariant) || (m_pCurrentVariant->featureMask != featureMask))
+		{
+			SwitchVariant(featureMask);
+		}
 	}
 
+	// feature mask of the current variant
+	unsigned int GetVariantFeatures() const
+	{
+		return (NULL != m_pCurrentVariant) ? m_pCurrentVariant->featureMask : 0;
+	}
+
+	// resolve a typed handle for the named uniform - a uniform that
+	// is not active in any compiled variant yet gets a handle too,
+	// since a variant compiled later may use it, but the handle is
+	// invalid if the GLSL type reflected so far does not match T
 	// ------------------------------------------------------------------------
-	inline void setIntValue(const std::string &name, int value) const
+	template <typename T>
+	UniformHandle<T> GetUniformHandle(const std::string& name)
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		UniformHandle<T> handle;
+		int index = FindUniform(name);
+
+		if (index < 0)
+		{
+			handle.index = AddUniform(name, GL_NONE);
+		}
+		else if ((m_uniforms[index].type == GL_NONE) || IsCompatibleType<T>(m_uniforms[index].type))
+		{
+			handle.index = index;
+		}
+		else
+		{
+			std::cout << "Uniform '" << name << "' does not match the requested handle type" << std::endl;
+		}
+
+		return(handle);
 	}
 
+	// set a value through a precompiled handle - nothing is sent
+	// to OpenGL when the value matches the shadow copy, or when the
+	// current variant does not use the uniform
 	// ------------------------------------------------------------------------
-	inline void setFloatValue(const std::string &name, float value) const
+	inline void SetUniform(UniformHandle<bool> handle, bool value)
+	{
+		int intValue = (int)value;
+		GLint location = UpdateShadow(handle.index, &intValue, sizeof(intValue));
+		if (location >= 0)
+			glUniform1i(location, intValue);
+	}
+	inline void SetUniform(UniformHandle<int> handle, int value)
+	{
+		GLint location = UpdateShadow(handle.index, &value, sizeof(value));
+		if (location >= 0)
+			glUniform1i(location, value);
+	}
+	inline void SetUniform(UniformHandle<float> handle, float value)
+	{
+		GLint location = UpdateShadow(handle.index, &value, sizeof(value));
+		if (location >= 0)
+			glUniform1f(location, value);
+	}
+	inline void SetUniform(UniformHandle<glm::vec2> handle, const glm::vec2& value)
+	{
+		GLint location = UpdateShadow(handle.index, &value[0], sizeof(value));
+		if (location >= 0)
+			glUniform2fv(location, 1, &value[0]);
+	}
+	inline void SetUniform(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+	{
+		GLint location = UpdateShadow(handle.index, &value[0], sizeof(value));
+		if (location >= 0)
+			glUniform3fv(location, 1, &value[0]);
+	}
+	inline void SetUniform(UniformHandle<glm::vec4> handle, const glm::vec4& value)
 	{
-		glUniform1f(glGetUniformLocation(m_programID, name.c_str()), value);
+		GLint location = UpdateShadow(handle.index, &value[0], sizeof(value));
+		if (location >= 0)
+			glUniform4fv(location, 1, &value[0]);
+	}
+	inline void SetUniform(UniformHandle<glm::mat2> handle, const glm::mat2& mat)
+	{
+		GLint location = UpdateShadow(handle.index, &mat[0][0], sizeof(mat));
+		if (location >= 0)
+			glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+	}
+	inline void SetUniform(UniformHandle<glm::mat3> handle, const glm::mat3& mat)
+	{
+		GLint location = UpdateShadow(handle.index, &mat[0][0], sizeof(mat));
+		if (location >= 0)
+			glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+	}
+	inline void SetUniform(UniformHandle<glm::mat4> handle, const glm::mat4& mat)
+	{
+		GLint location = UpdateShadow(handle.index, glm::value_ptr(mat), sizeof(mat));
+		if (location >= 0)
+			glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
 	}
 
+	// utility uniform functions - these look the name up in the
+	// reflected uniform table, so no GL query is made per call
 	// ------------------------------------------------------------------------
-	inline void setVec2Value(const std::string &name, const glm::vec2 &value) const
+	inline void setBoolValue(const std::string &name, bool value)
 	{
-		glUniform2fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		SetUniform(GetUniformHandle<bool>(name), value);
 	}
 
-	inline void setVec2Value(const std::string &name, float x, float y) const
+	// ------------------------------------------------------------------------
+	inline void setIntValue(const std::string &name, int value)
 	{
-		glUniform2f(glGetUniformLocation(m_programID, name.c_str()), x, y);
+		SetUniform(GetUniformHandle<int>(name), value);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec3Value(const std::string &name, const glm::vec3 &value) const
+	inline void setFloatValue(const std::string &name, float value)
 	{
-		glUniform3fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		SetUniform(GetUniformHandle<float>(name), value);
 	}
-	inline void setVec3Value(const std::string &name, float x, float y, float z) const
+
+	// ------------------------------------------------------------------------
+	inline void setVec2Value(const std::string &name, const glm::vec2 &value)
 	{
-		glUniform3f(glGetUniformLocation(m_programID, name.c_str()), x, y, z);
+		SetUniform(GetUniformHandle<glm::vec2>(name), value);
+	}
+
+	inline void setVec2Value(const std::string &name, float x, float y)
+	{
+		SetUniform(GetUniformHandle<glm::vec2>(name), glm::vec2(x, y));
+	}
+
+	// ------------------------------------------------------------------------
+	inline void setVec3Value(const std::string &name, const glm::vec3 &value)
+	{
+		SetUniform(GetUniformHandle<glm::vec3>(name), value);
+	}
+	inline void setVec3Value(const std::string &name, float x, float y, float z)
+	{
+		SetUniform(GetUniformHandle<glm::vec3>(name), glm::vec3(x, y, z));
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setVec4Value(const std::string &name, const glm::vec4 &value) const
+	inline void setVec4Value(const std::string &name, const glm::vec4 &value)
 	{
-		glUniform4fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		SetUniform(GetUniformHandle<glm::vec4>(name), value);
 	}
 	inline void setVec4Value(const std::string &name, float x, float y, float z, float w)
 	{
-		glUniform4f(glGetUniformLocation(m_programID, name.c_str()), x, y, z, w);
+		SetUniform(GetUniformHandle<glm::vec4>(name), glm::vec4(x, y, z, w));
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat2Value(const std::string &name, const glm::mat2 &mat) const
+	inline void setMat2Value(const std::string &name, const glm::mat2 &mat)
 	{
-		glUniformMatrix2fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		SetUniform(GetUniformHandle<glm::mat2>(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat3Value(const std::string &name, const glm::mat3 &mat) const
+	inline void setMat3Value(const std::string &name, const glm::mat3 &mat)
 	{
-		glUniformMatrix3fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		SetUniform(GetUniformHandle<glm::mat3>(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setMat4Value(const std::string &name, const glm::mat4 &mat) const
+	inline void setMat4Value(const std::string &name, const glm::mat4 &mat)
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+		SetUniform(GetUniformHandle<glm::mat4>(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
-	inline void setSampler2DValue(const std::string& name, const int &value) const
+	inline void setSampler2DValue(const std::string& name, const int &value)
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		SetUniform(GetUniformHandle<int>(name), value);
 	}
-};
\ No newline at end of file
+
+	// start a new frame of upload counters - the counters of the
+	// frame that just ended are kept for GetLastFrameStats()
+	void BeginFrameStats();
+	// upload counters of the last completed frame
+	UNIFORM_STATS GetLastFrameStats() const { return m_lastFrameStats; }
+	// number of variants that have been compiled so far
+	int GetCompiledVariantCount() const;
+
+private:
+	// one specialised program - the locations and the uploaded
+	// versions are indexed like m_uniforms
+	struct SHADER_VARIANT
+	{
+		unsigned int featureMask;
+		GLuint programID;
+		std::vector<GLint> locations;              // -1 if not active
+		std::vector<unsigned int> uploadedVersions;
+	};
+
+	// version of the program cache layout
+	static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+	// start of a program cache file, followed by the program binary
+	struct PROGRAM_CACHE_HEADER
+	{
+		char magic[4];
+		uint32_t version;
+		// hash of the shader sources and the GL driver strings
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+	};
+
+	// uniforms of all the compiled variants, filled in by their
+	// reflection and by GetUniformHandle()
+	std::vector<UNIFORM_INFO> m_uniforms;
+	// lookup from uniform name to index in m_uniforms
+	std::unordered_map<std::string, int> m_uniformIndices;
+
+	// the shader sources the variants are compiled from
+	std::string m_vertexFilename;
+	std::string m_fragmentFilename;
+	std::string m_vertexCode;
+	std::string m_fragmentCode;
+	bool m_bUseProgramCache;
+	// variants indexed by feature mask, a programID of 0 means
+	// that the variant has not been compiled yet
+	SHADER_VARIANT m_variants[VARIANT_COUNT];
+	SHADER_VARIANT* m_pCurrentVariant;
+
+	UNIFORM_STATS m_frameStats = { 0, 0, 0 };
+	UNIFORM_STATS m_lastFrameStats = { 0, 0, 0 };
+
+	// compile the variant if needed, make it current and upload
+	// the uniforms it is behind on
+	void SwitchVariant(unsigned int featureMask);
+	// compile and link the variant of a feature mask
+	void CompileVariant(SHADER_VARIANT& variant);
+	// compile and link the shader sources into a new program
+	GLuint BuildProgram(
+		const std::string& vertexCode,
+		const std::string& fragmentCode,
+		const std::string& description);
+	// add the #define lines of a feature mask after the version line
+	static std::string AddFeatureDefines(const std::string& code, unsigned int featureMask);
+
+	// enumerate the active uniforms of a linked variant
+	void ReflectActiveUniforms(SHADER_VARIANT& variant);
+	// add the location of one uniform to the variant
+	void RegisterUniform(SHADER_VARIANT& variant, const std::string& name, GLenum type);
+	// add a uniform to the table and to every variant - returns its index
+	int AddUniform(const std::string& name, GLenum type);
+	// upload the shadow copy of a uniform to the current program
+	void UploadShadow(GLint location, const UNIFORM_INFO& uniform);
+
+	// hash the shader sources together with the vendor, renderer
+	// and version strings of the GL driver
+	static uint64_t HashProgramSources(
+		const std::string& vertexCode,
+		const std::string& fragmentCode);
+	// create a program from the cached binary - returns 0 if there
+	// is no cache for the key or the driver rejects the binary
+	static GLuint LoadProgramBinary(const std::string& cacheFilename, uint64_t key);
+	// write the binary of the linked program to the cache file
+	static bool SaveProgramBinary(const std::string& cacheFilename, uint64_t key, GLuint programID);
+
+	// get the index of the named uniform, -1 if it is not active
+	int FindUniform(const std::string& name) const
+	{
+		std::unordered_map<std::string, int>::const_iterator it = m_uniformIndices.find(name);
+		return (it != m_uniformIndices.end()) ? it->second : -1;
+	}
+
+	// compare the value against the shadow copy of the uniform and
+	// store it - returns the location the changed value must be
+	// uploaded to in the current variant, or -1 if there is none
+	inline GLint UpdateShadow(int index, const void* value, size_t size)
+	{
+		if (index < 0)
+		{
+			return(-1);
+		}
+
+		UNIFORM_INFO& uniform = m_uniforms[index];
+
+		if (uniform.bShadowValid && (memcmp(uniform.shadow, value, size) == 0))
+		{
+			m_frameStats.uploadsSkipped++;
+			return(-1);
+		}
+
+		memcpy(uniform.shadow, value, size);
+		uniform.bShadowValid = true;
+		uniform.version++;
+
+		// the other variants pick the value up when they become current
+		if ((NULL == m_pCurrentVariant) || (m_pCurrentVariant->locations[index] < 0))
+		{
+			return(-1);
+		}
+
+		m_pCurrentVariant->uploadedVersions[index] = uniform.version;
+		m_frameStats.uploadsIssued++;
+		return(m_pCurrentVariant->locations[index]);
+	}
+
+	// check whether a GLSL uniform type can be set from a C++ type
+	template <typename T>
+	static bool IsCompatibleType(GLenum type);
+};
+
+template <> inline bool ShaderManager::IsCompatibleType<bool>(GLenum type) { return (type == GL_BOOL) || (type == GL_INT); }
+template <> inline bool ShaderManager::IsCompatibleType<int>(GLenum type)
+{
+	return (type == GL_INT) || (type == GL_BOOL) ||
+		(type == GL_SAMPLER_2D) || (type == GL_SAMPLER_2D_ARRAY) || (type == GL_SAMPLER_CUBE);
+}
+template <> inline bool ShaderManager::IsCompatibleType<float>(GLenum type) { return type == GL_FLOAT; }
+template <> inline bool ShaderManager::IsCompatibleType<glm::vec2>(GLenum type) { return type == GL_FLOAT_VEC2; }
+template <> inline bool ShaderManager::IsCompatibleType<glm::vec3>(GLenum type) { return type == GL_FLOAT_VEC3; }
+template <> inline bool ShaderManager::IsCompatibleType<glm::vec4>(GLenum type) { return type == GL_FLOAT_VEC4; }
+template <> inline bool ShaderManager::IsCompatibleType<glm::mat2>(GLenum type) { return type == GL_FLOAT_MAT2; }
+template <> inline bool ShaderManager::IsCompatibleType<glm::mat3>(GLenum type) { return type == GL_FLOAT_MAT3; }
+template <> inline bool ShaderManager::IsCompatibleType<glm::mat4>(GLenum type) { return type == GL_FLOAT_MAT4; }
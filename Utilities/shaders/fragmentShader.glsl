@@ -1,5 +1,11 @@
 #version 440 core
 
+// the ShaderManager compiles one variant of this shader for every
+// feature mask in use - it adds USE_TEXTURE, USE_TEXTURE_OVERLAY,
+// USE_LIGHTING and USE_INSTANCING after the version line
+
+// std140 layout, 48 bytes per material - this must match
+// SceneManager::GPU_MATERIAL
 struct Material 
 {
     vec3 ambientColor;
@@ -20,91 +26,89 @@ struct LightSource
 };
 
 #define TOTAL_LIGHTS 2
+// must match MAX_MATERIALS and MATERIAL_BLOCK_BINDING in SceneManager
+#define MAX_MATERIALS 64
+#define MATERIAL_BLOCK_BINDING 0
 
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+flat in vec4 fragmentInstanceColor;
+flat in int fragmentMaterialIndex;
+// texture array layers of the texture and the overlay texture
+flat in ivec2 fragmentTextureLayers;
 
 out vec4 outFragmentColor;
 
-uniform bool bUseTexture=false;
-uniform bool bUseTextureOverlay=false;
-uniform bool bUseLighting=false;
 uniform vec4 objectColor = vec4(1.0f);
-uniform sampler2D objectTexture;
-uniform sampler2D objectTextureOverlay;
+uniform sampler2DArray objectTexture;
+uniform sampler2DArray objectTextureOverlay;
 uniform vec3 viewPosition;
 uniform vec2 UVscale = vec2(1.0f, 1.0f);
 uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+
+// all defined materials, uploaded once by the SceneManager
+layout(std140, binding = MATERIAL_BLOCK_BINDING) uniform MaterialBlock
+{
+    Material materials[MAX_MATERIALS];
+};
 
 // TODO: remove
 uniform bool bUseLightDiffuseColor=false;
 
 // function prototypes
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
 
 void main()
 {
-   vec4 effectiveObjectColor;
-   vec4 effectiveTextureColor;
-   
-   if ((bUseTexture == false) && (bUseTextureOverlay == true))
-   {
-		vec4 textureOverlayColor = texture(objectTextureOverlay, fragmentTextureCoordinate * UVscale);
-		effectiveObjectColor = mix(objectColor, textureOverlayColor, 0.5);
-   }
-   else if ((bUseTexture == true) && (bUseTextureOverlay == true))
-   {
-      vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-	  vec4 textureOverlayColor = texture(objectTextureOverlay, fragmentTextureCoordinate * UVscale);
-	  effectiveTextureColor = mix(textureColor, textureOverlayColor, 0.5);
-   }
-   else if ((bUseTexture == true) && (bUseTextureOverlay == false))
-   {
-      effectiveTextureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-   }
-   else
-   {
-      effectiveObjectColor = objectColor;
-   }
-
-   if(bUseLighting == true)
-   {
-      // properties
-      vec3 lightNormal = normalize(fragmentVertexNormal);
-      vec3 viewDirection = normalize(viewPosition - fragmentPosition);
-      vec3 phongResult = vec3(0.0f);
-
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
-      {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
-      }   
-    
-      if(bUseTexture == true)
-      {
-         outFragmentColor = vec4(phongResult * effectiveTextureColor.xyz, 1.0);
-      }
-      else
-      {
-         outFragmentColor = vec4(phongResult * effectiveObjectColor.xyz, objectColor.w);
-      }
-   }
-   else 
+   // instanced draws carry their color per instance
+#ifdef USE_INSTANCING
+   vec4 baseColor = fragmentInstanceColor;
+#else
+   vec4 baseColor = objectColor;
+#endif
+
+   // the layer of the texture array is the third texture coordinate
+   vec3 textureCoordinate = vec3(fragmentTextureCoordinate * UVscale, float(fragmentTextureLayers.x));
+   vec3 overlayCoordinate = vec3(fragmentTextureCoordinate * UVscale, float(fragmentTextureLayers.y));
+
+#if defined(USE_TEXTURE) && defined(USE_TEXTURE_OVERLAY)
+   vec4 textureColor = texture(objectTexture, textureCoordinate);
+   vec4 textureOverlayColor = texture(objectTextureOverlay, overlayCoordinate);
+   vec4 surfaceColor = mix(textureColor, textureOverlayColor, 0.5);
+#elif defined(USE_TEXTURE)
+   vec4 surfaceColor = texture(objectTexture, textureCoordinate);
+#elif defined(USE_TEXTURE_OVERLAY)
+   vec4 textureOverlayColor = texture(objectTextureOverlay, overlayCoordinate);
+   vec4 surfaceColor = mix(baseColor, textureOverlayColor, 0.5);
+#else
+   vec4 surfaceColor = baseColor;
+#endif
+
+#ifdef USE_LIGHTING
+   // properties
+   vec3 lightNormal = normalize(fragmentVertexNormal);
+   vec3 viewDirection = normalize(viewPosition - fragmentPosition);
+   vec3 phongResult = vec3(0.0f);
+   Material material = materials[fragmentMaterialIndex];
+
+   for(int i = 0; i < TOTAL_LIGHTS; i++)
    {
-      if(bUseTexture == true)
-      {
-         outFragmentColor = effectiveTextureColor;
-      }
-      else
-      {
-         outFragmentColor = effectiveObjectColor;
-      }
-   }
+      phongResult += CalcLightSource(lightSources[i], material, lightNormal, fragmentPosition, viewDirection); 
+   }   
+
+#ifdef USE_TEXTURE
+   outFragmentColor = vec4(phongResult * surfaceColor.xyz, 1.0);
+#else
+   outFragmentColor = vec4(phongResult * surfaceColor.xyz, baseColor.w);
+#endif
+#else
+   outFragmentColor = surfaceColor;
+#endif
 }
 
 // calculates the color when using a directional light.
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+vec3 CalcLightSource(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
 {
    vec3 ambient;
    vec3 diffuse;
@@ -1,20 +1,82 @@
-#version 330 core
+#version 440 core
+#extension GL_ARB_shader_draw_parameters : enable
+// the ShaderManager compiles one variant of this shader for every
+// feature mask in use - it adds USE_INSTANCING and USE_MULTI_DRAW
+// after the version line
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+// per-instance data, only read when USE_INSTANCING is defined
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec4 inInstanceColor;
+layout (location = 8) in ivec2 inInstanceTextureLayers;
+// every mesh VAO feeds the same scale and offset to all of its
+// vertices - the compact vertex layout stores the positions as
+// fractions of the mesh bounding box, the float layout uses a
+// scale of 1 and an offset of 0
+layout (location = 9) in vec3 inPositionScale;
+layout (location = 10) in vec3 inPositionOffset;
+// per-instance normal matrix, the inverse transpose of the upper
+// 3x3 of the model matrix - only read when USE_INSTANCING is defined
+layout (location = 11) in mat3 inInstanceNormal;
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+flat out vec4 fragmentInstanceColor;
+flat out int fragmentMaterialIndex;
+flat out ivec2 fragmentTextureLayers;
 
 uniform mat4 model;
+uniform mat3 normalMatrix = mat3(1.0f);
 uniform mat4 view;
 uniform mat4 projection;
+uniform int materialIndex = 0;
+uniform int textureLayer = 0;
+uniform int textureOverlayLayer = 0;
+
+#if defined(USE_MULTI_DRAW) && defined(GL_ARB_shader_draw_parameters)
+// must match DRAW_DATA_BINDING in SceneManager
+#define DRAW_DATA_BINDING 1
+
+// material index of every command of the multi-draw calls, the
+// commands of one call start at drawDataBase
+layout(std430, binding = DRAW_DATA_BINDING) readonly buffer DrawDataBlock
+{
+    int drawMaterials[];
+};
+uniform int drawDataBase = 0;
+#endif
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = inVertexNormal;
+   // instanced draws take the model and normal matrices, color and
+   // texture array layers from the instance buffer
+#ifdef USE_INSTANCING
+   mat4 modelMatrix = inInstanceModel;
+   mat3 normalModelMatrix = inInstanceNormal;
+   fragmentInstanceColor = inInstanceColor;
+   fragmentTextureLayers = inInstanceTextureLayers;
+#else
+   mat4 modelMatrix = model;
+   mat3 normalModelMatrix = normalMatrix;
+   fragmentInstanceColor = vec4(1.0f);
+   fragmentTextureLayers = ivec2(textureLayer, textureOverlayLayer);
+#endif
+
+   // multi-draw calls take the material of each command from the draw data
+#if defined(USE_MULTI_DRAW) && defined(GL_ARB_shader_draw_parameters)
+   fragmentMaterialIndex = drawMaterials[drawDataBase + gl_DrawIDARB];
+#else
+   fragmentMaterialIndex = materialIndex;
+#endif
+
+   vec3 vertexPosition = inVertexPosition * inPositionScale + inPositionOffset;
+
+   fragmentPosition = vec3(modelMatrix * vec4(vertexPosition, 1.0));
+   gl_Position = projection * view * modelMatrix * vec4(vertexPosition, 1.0f);
+   // the normal matrix keeps the normals perpendicular to the
+   // surface when an object is scaled unevenly
+   fragmentVertexNormal = normalModelMatrix * inVertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
 }
\ No newline at end of file